@@ -17,8 +17,6 @@
 
 LOG_MODULE_REGISTER(gc9a01, CONFIG_DISPLAY_LOG_LEVEL);
 
-#define GC9A01_SPI_PROFILING
-
 /**
  * gc9a01 display controller driver.
  *
@@ -172,15 +170,76 @@ struct gc9a01_frame {
     struct gc9a01_point start, end;
 };
 
+struct gc9a01_frame_stats {
+    uint32_t frame_start;
+    uint32_t transfer_start;
+    uint32_t wire_cycles;
+    uint32_t num_writes;
+    uint32_t num_bytes;
+    uint32_t num_transactions;
+    uint32_t num_skipped_window_cmds;
+};
+
+struct gc9a01_data {
+    const struct device *dev;
+    struct k_mutex lock;
+    struct k_work_delayable bus_idle_work;
+    bool bus_active;
+    // False when the controller window is unknown, e.g. after reset or sleep.
+    bool frame_valid;
+#ifdef CONFIG_GC9A01_ASYNC_WRITE
+    struct spi_buf tx_buf;
+    struct spi_buf_set tx_buf_set;
+    struct k_poll_signal transfer_signal;
+    struct k_poll_event transfer_event;
+#endif
+#ifdef CONFIG_GC9A01_FRAME_PROFILING
+    struct gc9a01_frame_stats stats;
+    uint32_t last_frame_start;
+#endif
+};
+
 static struct gc9a01_frame frame = {{0, 0}, {DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1}};
 
+static inline void gc9a01_count_transaction(const struct device *dev)
+{
+#ifdef CONFIG_GC9A01_FRAME_PROFILING
+    struct gc9a01_data *data = dev->data;
+    data->stats.num_transactions++;
+#endif
+}
+
+#ifdef CONFIG_GC9A01_ASYNC_WRITE
+static int gc9a01_wait_transfer_done(const struct device *dev)
+{
+    struct gc9a01_data *data = dev->data;
+    unsigned int signaled;
+    int result;
+
+    k_poll(&data->transfer_event, 1, K_FOREVER);
+    k_poll_signal_check(&data->transfer_signal, &signaled, &result);
+    k_poll_signal_reset(&data->transfer_signal);
+    data->transfer_event.state = K_POLL_STATE_NOT_READY;
+#ifdef CONFIG_GC9A01_FRAME_PROFILING
+    data->stats.wire_cycles += k_cycle_get_32() - data->stats.transfer_start;
+#endif
+    if (result != 0) {
+        LOG_ERR("Failed sending data");
+        return -EIO;
+    }
+    return 0;
+}
+#endif
+
 static inline int gc9a01_write_cmd(const struct device *dev, uint8_t cmd,
                                    const uint8_t *data, size_t len)
 {
     const struct gc9a01_config *config = dev->config;
     struct spi_buf buf = {.buf = &cmd, .len = sizeof(cmd)};
     struct spi_buf_set buf_set = {.buffers = &buf, .count = 1};
+
     gpio_pin_set_dt(&config->dc_gpio, 0);
+    gc9a01_count_transaction(dev);
     if (spi_write_dt(&config->bus, &buf_set) != 0) {
         LOG_ERR("Failed sending data");
         return -EIO;
@@ -190,6 +249,7 @@ static inline int gc9a01_write_cmd(const struct device *dev, uint8_t cmd,
         buf.buf = (void *)data;
         buf.len = len;
         gpio_pin_set_dt(&config->dc_gpio, 1);
+        gc9a01_count_transaction(dev);
         if (spi_write_dt(&config->bus, &buf_set) != 0) {
             LOG_ERR("Failed sending data");
             return -EIO;
@@ -199,69 +259,219 @@ static inline int gc9a01_write_cmd(const struct device *dev, uint8_t cmd,
     return 0;
 }
 
-static void gc9a01_set_frame(const struct device *dev, struct gc9a01_frame frame)
+static void gc9a01_set_frame(const struct device *dev, struct gc9a01_frame new_frame)
 {
     uint8_t data[4];
+    struct gc9a01_data *drv_data = dev->data;
+
+    // RAMWR always restarts at the top left of the window, so if the window is the
+    // same as for the previous write there is no need to send it again.
+    if (!drv_data->frame_valid || new_frame.start.X != frame.start.X || new_frame.end.X != frame.end.X) {
+        data[0] = (new_frame.start.X >> 8) & 0xFF;
+        data[1] = new_frame.start.X & 0xFF;
+        data[2] = (new_frame.end.X >> 8) & 0xFF;
+        data[3] = new_frame.end.X & 0xFF;
+        gc9a01_write_cmd(dev, COL_ADDR_SET, data, sizeof(data));
+    }
+#ifdef CONFIG_GC9A01_FRAME_PROFILING
+    else {
+        drv_data->stats.num_skipped_window_cmds++;
+    }
+#endif
+
+    if (!drv_data->frame_valid || new_frame.start.Y != frame.start.Y || new_frame.end.Y != frame.end.Y) {
+        data[0] = (new_frame.start.Y >> 8) & 0xFF;
+        data[1] = new_frame.start.Y & 0xFF;
+        data[2] = (new_frame.end.Y >> 8) & 0xFF;
+        data[3] = new_frame.end.Y & 0xFF;
+        gc9a01_write_cmd(dev, ROW_ADDR_SET, data, sizeof(data));
+    }
+#ifdef CONFIG_GC9A01_FRAME_PROFILING
+    else {
+        drv_data->stats.num_skipped_window_cmds++;
+    }
+#endif
 
-    data[0] = (frame.start.X >> 8) & 0xFF;
-    data[1] = frame.start.X & 0xFF;
-    data[2] = (frame.end.X >> 8) & 0xFF;
-    data[3] = frame.end.X & 0xFF;
-    gc9a01_write_cmd(dev, COL_ADDR_SET, data, sizeof(data));
-
-    data[0] = (frame.start.Y >> 8) & 0xFF;
-    data[1] = frame.start.Y & 0xFF;
-    data[2] = (frame.end.Y >> 8) & 0xFF;
-    data[3] = frame.end.Y & 0xFF;
-    gc9a01_write_cmd(dev, ROW_ADDR_SET, data, sizeof(data));
+    frame = new_frame;
+    drv_data->frame_valid = true;
+}
+
+static int gc9a01_write_pixels(const struct device *dev, const void *buf, size_t len)
+{
+    int rc;
+#ifdef CONFIG_GC9A01_ASYNC_WRITE
+    const struct gc9a01_config *config = dev->config;
+    struct gc9a01_data *data = dev->data;
+
+    rc = gc9a01_write_cmd(dev, GC9A01A_RAMWR, NULL, 0);
+    if (rc != 0) {
+        return rc;
+    }
+
+    data->tx_buf.buf = (void *)buf;
+    data->tx_buf.len = len;
+    data->tx_buf_set.buffers = &data->tx_buf;
+    data->tx_buf_set.count = 1;
+
+    gpio_pin_set_dt(&config->dc_gpio, 1);
+#ifdef CONFIG_GC9A01_FRAME_PROFILING
+    data->stats.transfer_start = k_cycle_get_32();
+#endif
+    gc9a01_count_transaction(dev);
+    rc = spi_transceive_signal(config->bus.bus, &config->bus.config, &data->tx_buf_set, NULL,
+                               &data->transfer_signal);
+    if (rc != 0) {
+        LOG_ERR("Failed sending data");
+        return -EIO;
+    }
+
+    // The caller may reuse the buffer as soon as display_write returns, with LVGL double buffering
+    // it renders the next stripe into it right after the flush, so the transfer must be done first.
+    rc = gc9a01_wait_transfer_done(dev);
+#else
+#ifdef CONFIG_GC9A01_FRAME_PROFILING
+    struct gc9a01_data *data = dev->data;
+    data->stats.transfer_start = k_cycle_get_32();
+#endif
+    rc = gc9a01_write_cmd(dev, GC9A01A_RAMWR, buf, len);
+#ifdef CONFIG_GC9A01_FRAME_PROFILING
+    data->stats.wire_cycles += k_cycle_get_32() - data->stats.transfer_start;
+#endif
+#endif
+    return rc;
+}
+
+static int gc9a01_bus_acquire(const struct device *dev)
+{
+    int rc;
+    const struct gc9a01_config *config = dev->config;
+    struct gc9a01_data *data = dev->data;
+
+    if (data->bus_active) {
+        return 0;
+    }
+
+    // Not called in __ASSERT, it would not be called at all with asserts disabled.
+    rc = pm_device_action_run(config->bus.bus, PM_DEVICE_ACTION_RESUME);
+    __ASSERT(rc == 0 || rc == -EALREADY, "Failed resume SPI Bus");
+    if (rc != 0 && rc != -EALREADY) {
+        LOG_ERR("Failed resume SPI Bus: %d", rc);
+        return rc;
+    }
+    data->bus_active = true;
+#ifdef CONFIG_GC9A01_FRAME_PROFILING
+    memset(&data->stats, 0, sizeof(data->stats));
+    data->stats.frame_start = k_cycle_get_32();
+#endif
+
+    return 0;
+}
+
+static void gc9a01_bus_release(const struct device *dev)
+{
+    int rc;
+    const struct gc9a01_config *config = dev->config;
+    struct gc9a01_data *data = dev->data;
+
+    if (!data->bus_active) {
+        return;
+    }
+
+    rc = pm_device_action_run(config->bus.bus, PM_DEVICE_ACTION_SUSPEND);
+    __ASSERT(rc == 0 || rc == -EALREADY, "Failed suspend SPI Bus");
+    if (rc != 0 && rc != -EALREADY) {
+        LOG_ERR("Failed suspend SPI Bus: %d", rc);
+    }
+    data->bus_active = false;
+
+#ifdef CONFIG_GC9A01_FRAME_PROFILING
+    uint32_t now = k_cycle_get_32();
+    uint32_t frame_us = k_cyc_to_us_ceil32(now - data->stats.frame_start);
+    uint32_t wire_us = k_cyc_to_us_ceil32(data->stats.wire_cycles);
+    uint32_t period_us = k_cyc_to_us_ceil32(data->stats.frame_start - data->last_frame_start);
+
+    // The bus idle timeout is included in frame_us, remove it to get the time spent flushing.
+    frame_us -= MIN(frame_us, CONFIG_GC9A01_BUS_IDLE_TIMEOUT_MS * USEC_PER_MSEC);
+    LOG_INF("Frame: %d writes, %d transactions (%d window cmds skipped), %d bytes, wire %d us, flush %d us, %d fps",
+            data->stats.num_writes, data->stats.num_transactions, data->stats.num_skipped_window_cmds,
+            data->stats.num_bytes, wire_us, frame_us, period_us > 0 ? USEC_PER_SEC / period_us : 0);
+    data->last_frame_start = data->stats.frame_start;
+#endif
+}
+
+static void gc9a01_bus_idle_work(struct k_work *work)
+{
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct gc9a01_data *data = CONTAINER_OF(dwork, struct gc9a01_data, bus_idle_work);
+
+    k_mutex_lock(&data->lock, K_FOREVER);
+    gc9a01_bus_release(data->dev);
+    k_mutex_unlock(&data->lock);
 }
 
 static int gc9a01_blanking_off(const struct device *dev)
 {
-    return gc9a01_write_cmd(dev, GC9A01A_DISPON, NULL, 0);
+    int rc;
+    struct gc9a01_data *data = dev->data;
+
+    k_mutex_lock(&data->lock, K_FOREVER);
+    rc = gc9a01_write_cmd(dev, GC9A01A_DISPON, NULL, 0);
+    k_mutex_unlock(&data->lock);
+
+    return rc;
 }
 
 static int gc9a01_blanking_on(const struct device *dev)
 {
-    return gc9a01_write_cmd(dev, GC9A01A_DISPOFF, NULL, 0);
+    int rc;
+    struct gc9a01_data *data = dev->data;
+
+    k_mutex_lock(&data->lock, K_FOREVER);
+    rc = gc9a01_write_cmd(dev, GC9A01A_DISPOFF, NULL, 0);
+    k_mutex_unlock(&data->lock);
+
+    return rc;
 }
 
 static int gc9a01_write(const struct device *dev, const uint16_t x, const uint16_t y,
                         const struct display_buffer_descriptor *desc,
                         const void *buf)
 {
-    const struct gc9a01_config *config = dev->config;
-    __ASSERT(pm_device_action_run(config->bus.bus, PM_DEVICE_ACTION_RESUME) == 0, "Failed resume SPI Bus");
-#ifdef GC9A01_SPI_PROFILING
-    uint32_t start_time;
-    uint32_t stop_time;
-    uint32_t cycles_spent;
-    uint32_t nanoseconds_spent;
-#endif
+    int rc;
+    struct gc9a01_data *data = dev->data;
+    struct gc9a01_frame new_frame;
     uint16_t x_end_idx = x + desc->width - 1;
     uint16_t y_end_idx = y + desc->height - 1;
 
-    frame.start.X = x;
-    frame.end.X = x_end_idx;
-    frame.start.Y = y;
-    frame.end.Y = y_end_idx;
-    gc9a01_set_frame(dev, frame);
+    k_mutex_lock(&data->lock, K_FOREVER);
+
+    // Bus is kept resumed until no write has been done for CONFIG_GC9A01_BUS_IDLE_TIMEOUT_MS,
+    // that way all stripes in one frame share one resume/suspend.
+    rc = gc9a01_bus_acquire(dev);
+    if (rc != 0) {
+        k_mutex_unlock(&data->lock);
+        return rc;
+    }
+
+    new_frame.start.X = x;
+    new_frame.end.X = x_end_idx;
+    new_frame.start.Y = y;
+    new_frame.end.Y = y_end_idx;
+    gc9a01_set_frame(dev, new_frame);
 
     size_t len = (x_end_idx + 1 - x) * (y_end_idx + 1 - y) * 16 / 8;
     //printk("x_start: %d, y_start: %d, x_end: %d, y_end: %d, buf_size: %d, pitch: %d len: %d\n", x, y, x_end_idx, y_end_idx, desc->buf_size, desc->pitch, len);
 
-#ifdef GC9A01_SPI_PROFILING
-    start_time = k_cycle_get_32();
-#endif
-    gc9a01_write_cmd(dev, GC9A01A_RAMWR, buf, len);
-#ifdef GC9A01_SPI_PROFILING
-    stop_time = k_cycle_get_32();
-    cycles_spent = stop_time - start_time;
-    nanoseconds_spent = k_cyc_to_ns_ceil32(cycles_spent);
-    LOG_DBG("%d =>: %dns", len, nanoseconds_spent);
+    rc = gc9a01_write_pixels(dev, buf, len);
+#ifdef CONFIG_GC9A01_FRAME_PROFILING
+    data->stats.num_writes++;
+    data->stats.num_bytes += len;
 #endif
-    __ASSERT(pm_device_action_run(config->bus.bus, PM_DEVICE_ACTION_SUSPEND) == 0, "Failed suspend SPI Bus");
-    return 0;
+
+    k_work_reschedule(&data->bus_idle_work, K_MSEC(CONFIG_GC9A01_BUS_IDLE_TIMEOUT_MS));
+    k_mutex_unlock(&data->lock);
+
+    return rc;
 }
 
 static int gc9a01_read(const struct device *dev, const uint16_t x, const uint16_t y,
@@ -343,8 +553,10 @@ static int gc9a01_controller_init(const struct device *dev)
         i++;
     }
 
-    __ASSERT(pm_device_action_run(config->bus.bus, PM_DEVICE_ACTION_SUSPEND) == 0, "Failed suspend SPI Bus");
-    return 0;
+    rc = pm_device_action_run(config->bus.bus, PM_DEVICE_ACTION_SUSPEND);
+    __ASSERT(rc == 0, "Failed suspend SPI Bus");
+
+    return rc;
 }
 
 static int gc9a01_init(const struct device *dev)
@@ -374,12 +586,42 @@ static int gc9a01_init(const struct device *dev)
     return gc9a01_controller_init(dev);
 }
 
+static int gc9a01_driver_init(const struct device *dev)
+{
+    struct gc9a01_data *data = dev->data;
+
+    data->dev = dev;
+    k_mutex_init(&data->lock);
+    k_work_init_delayable(&data->bus_idle_work, gc9a01_bus_idle_work);
+#ifdef CONFIG_GC9A01_ASYNC_WRITE
+    k_poll_signal_init(&data->transfer_signal);
+    k_poll_event_init(&data->transfer_event, K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &data->transfer_signal);
+#endif
+
+    return gc9a01_init(dev);
+}
+
 static int gc9a01_pm_action(const struct device *dev,
                             enum pm_device_action action)
 {
     int err = 0;
     const struct gc9a01_config *config = dev->config;
-    __ASSERT(pm_device_action_run(config->bus.bus, PM_DEVICE_ACTION_RESUME) == 0, "Failed resume SPI Bus");
+    struct gc9a01_data *data = dev->data;
+
+    // Finish any ongoing frame so the bus is in a known state.
+    k_work_cancel_delayable(&data->bus_idle_work);
+    k_mutex_lock(&data->lock, K_FOREVER);
+    gc9a01_bus_release(dev);
+    // Controller window may be lost when sleeping or powered off.
+    data->frame_valid = false;
+
+    err = pm_device_action_run(config->bus.bus, PM_DEVICE_ACTION_RESUME);
+    __ASSERT(err == 0 || err == -EALREADY, "Failed resume SPI Bus");
+    if (err != 0 && err != -EALREADY) {
+        LOG_ERR("%s: failed resume SPI Bus: %d", dev->name, err);
+        k_mutex_unlock(&data->lock);
+        return err;
+    }
 
     switch (action) {
         case PM_DEVICE_ACTION_RESUME:
@@ -411,6 +653,8 @@ static int gc9a01_pm_action(const struct device *dev,
         LOG_ERR("%s: failed to set power mode", dev->name);
     }
 
+    k_mutex_unlock(&data->lock);
+
     return err;
 }
 
@@ -421,6 +665,8 @@ static const struct gc9a01_config gc9a01_config = {
     .bl_gpio = GPIO_DT_SPEC_INST_GET(0, bl_gpios),
 };
 
+static struct gc9a01_data gc9a01_data;
+
 static struct display_driver_api gc9a01_driver_api = {
     .blanking_on = gc9a01_blanking_on,
     .blanking_off = gc9a01_blanking_off,
@@ -435,5 +681,5 @@ static struct display_driver_api gc9a01_driver_api = {
 };
 
 PM_DEVICE_DT_INST_DEFINE(0, gc9a01_pm_action);
-DEVICE_DT_INST_DEFINE(0, gc9a01_init, PM_DEVICE_DT_INST_GET(0), NULL, &gc9a01_config, POST_KERNEL,
+DEVICE_DT_INST_DEFINE(0, gc9a01_driver_init, PM_DEVICE_DT_INST_GET(0), &gc9a01_data, &gc9a01_config, POST_KERNEL,
                       CONFIG_DISPLAY_INIT_PRIORITY, &gc9a01_driver_api);
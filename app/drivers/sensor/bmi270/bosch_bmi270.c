@@ -23,6 +23,10 @@
 #include "trigger/bosch_bmi270_interrupt.h"
 #endif
 
+#if CONFIG_BMI270_PLUS_FIFO
+#include "private/bosch_bmi270_fifo.h"
+#endif
+
 #define DT_DRV_COMPAT                   bosch_bmi270_plus
 #define BMI2_READ_WRITE_LEN             UINT8_C(46)
 
@@ -298,6 +302,19 @@ static int bmi270_attr_set(const struct device *p_dev, enum sensor_channel chann
             default:
                 return -ENOTSUP;
         }
+    } else if (channel == SENSOR_CHAN_FIFO) {
+        // FIFO configuration channel. Supported options:
+        //  - Configuration
+        //      p_value.val1:
+        //          - Watermark in frames, 0 disables the FIFO
+        switch (attribute) {
+#ifdef CONFIG_BMI270_PLUS_FIFO
+            case SENSOR_ATTR_CONFIGURATION:
+                return bmi2_configure_fifo(p_dev, p_value->val1);
+#endif
+            default:
+                return -ENOTSUP;
+        }
     } else if (channel == SENSOR_CHAN_CONFIG) {
         // TODO: Implement this
         return -ENOTSUP;
@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include <zephyr/device.h>
+
 /** @brief Step counting sensor channel.
 */
 #define SENSOR_CHAN_STEPS               (SENSOR_CHAN_PRIV_START + 1)
@@ -28,6 +30,10 @@
 */
 #define SENSOR_CHAN_CONFIG              (SENSOR_CHAN_PRIV_START + 5)
 
+/** @brief FIFO configuration and watermark trigger channel.
+*/
+#define SENSOR_CHAN_FIFO                (SENSOR_CHAN_PRIV_START + 6)
+
 /** @brief Wrist gesture detection like flick in/out, push arm down(pivot up, wrist jiggle/shake).
 */
 #define SENSOR_TRIG_WRIST_GESTURE       (SENSOR_TRIG_PRIV_START + 1)
@@ -50,6 +56,10 @@
 */
 #define SENSOR_TRIG_SIG_MOTION          (SENSOR_TRIG_PRIV_START + 5)
 
+/** @brief The FIFO reached the configured watermark. Use bmi270_fifo_read to drain it.
+*/
+#define SENSOR_TRIG_FIFO_WATERMARK      (SENSOR_TRIG_PRIV_START + 6)
+
 /** @brief
 */
 #define BOSCH_BMI270_FEAT_ENABLE        (0x01 << 0x00)
@@ -166,4 +176,23 @@
 
 #define BOSCH_BMI270_GYR_OSR4           0x00
 #define BOSCH_BMI270_GYR_OSR2           0x01
-#define BOSCH_BMI270_GYR_OSR1           0x02
\ No newline at end of file
+#define BOSCH_BMI270_GYR_OSR1           0x02
+
+/** @brief One FIFO frame, accelerometer in m/s^2 and gyroscope in rad/s.
+*/
+struct bmi270_fifo_frame {
+    float acc[3];
+    float gyr[3];
+};
+
+/** @brief              Read all frames from the FIFO with one bulk transfer.
+ *                      The FIFO is enabled with sensor_attr_set on SENSOR_CHAN_FIFO and SENSOR_ATTR_CONFIGURATION,
+ *                      val1 is the watermark in frames and 0 disables the FIFO.
+ *  @param p_dev        BMI270 device
+ *  @param p_frames     Frames in the order they were sampled, oldest first
+ *  @param max_frames   Size of p_frames, frames not read are left in the FIFO
+ *  @param p_period_us  Time between two frames
+ *  @return             Number of frames read or negative error code
+*/
+int bmi270_fifo_read(const struct device *p_dev, struct bmi270_fifo_frame *p_frames, uint16_t max_frames,
+                     uint32_t *p_period_us);
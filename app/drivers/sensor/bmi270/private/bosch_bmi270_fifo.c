@@ -0,0 +1,153 @@
+/* bosch_bmi270_fifo.c - Driver for Bosch BMI270 IMU. */
+
+/*
+ * Copyright (c) 2023, Daniel Kampert
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+#include <zephyr/drivers/sensor.h>
+
+#include "bosch_bmi270_config.h"
+#include "bosch_bmi270_fifo.h"
+
+LOG_MODULE_REGISTER(bosch_bmi270_fifo, CONFIG_BOSCH_BMI270_PLUS_LOG_LEVEL);
+
+/** @brief      Convert an ODR register value to the time between two samples.
+ *  @param odr  ODR register value
+ *  @return     Sample period in us
+*/
+static uint32_t bmi2_odr_to_period_us(uint8_t odr)
+{
+    // Each step doubles the rate, 100 Hz is the reference.
+    if (odr >= BOSCH_BMI270_ACC_ODR_100_HZ) {
+        return 10000 >> (odr - BOSCH_BMI270_ACC_ODR_100_HZ);
+    }
+
+    return 10000 << (BOSCH_BMI270_ACC_ODR_100_HZ - odr);
+}
+
+int bmi2_configure_fifo(const struct device *p_dev, int32_t watermark)
+{
+    struct sensor_value odr;
+    struct bmi270_data *data = p_dev->data;
+
+    if ((watermark < 0) || (watermark > CONFIG_BMI270_PLUS_FIFO_MAX_FRAMES)) {
+        return -EINVAL;
+    }
+
+    // Always start from a disabled FIFO, also when only the watermark is changed.
+    if ((bmi2_map_data_int(BMI2_FWM_INT, BMI2_INT_NONE, &data->bmi2) != BMI2_OK) ||
+        (bmi2_set_fifo_config(BMI2_FIFO_ALL_EN, BMI2_DISABLE, &data->bmi2) != BMI2_OK)) {
+        return -EFAULT;
+    }
+
+    if (watermark == 0) {
+        if (data->fifo_enabled) {
+            LOG_DBG("Disable FIFO");
+
+            data->fifo_enabled = false;
+            odr.val1 = data->fifo_restore_gyr_odr;
+
+            return bmi2_set_gyro_odr(p_dev, &odr);
+        }
+
+        return 0;
+    }
+
+    if (data->acc_odr < BOSCH_BMI270_GYR_ODR_25_HZ) {
+        return -ENOTSUP;
+    }
+
+    LOG_DBG("Enable FIFO with watermark %d", watermark);
+
+    if (!data->fifo_enabled) {
+        data->fifo_restore_gyr_odr = data->gyr_odr;
+    }
+
+    // Run the gyroscope at the accelerometer rate so every frame holds both.
+    odr.val1 = data->acc_odr;
+    if (bmi2_set_gyro_odr(p_dev, &odr) != 0) {
+        return -EFAULT;
+    }
+
+    if ((bmi2_set_fifo_config(BMI2_FIFO_ACC_EN | BMI2_FIFO_GYR_EN | BMI2_FIFO_HEADER_EN, BMI2_ENABLE,
+                              &data->bmi2) != BMI2_OK) ||
+        (bmi2_set_fifo_wm(watermark * BOSCH_BMI270_FIFO_FRAME_LENGTH, &data->bmi2) != BMI2_OK) ||
+        (bmi2_set_command_register(BMI2_FIFO_FLUSH_CMD, &data->bmi2) != BMI2_OK) ||
+        (bmi2_map_data_int(BMI2_FWM_INT, BMI2_INT2, &data->bmi2) != BMI2_OK)) {
+        return -EFAULT;
+    }
+
+    data->fifo_enabled = true;
+
+    return 0;
+}
+
+int bmi270_fifo_read(const struct device *p_dev, struct bmi270_fifo_frame *p_frames, uint16_t max_frames,
+                     uint32_t *p_period_us)
+{
+    float acc_scale;
+    float gyr_scale;
+    uint16_t fifo_length;
+    uint16_t acc_length;
+    uint16_t gyr_length;
+    uint16_t num_frames;
+    struct bmi2_fifo_frame fifo;
+    struct bmi270_data *data = p_dev->data;
+
+    if (!data->fifo_enabled) {
+        return -ENODATA;
+    }
+
+    if (bmi2_get_fifo_length(&fifo_length, &data->bmi2) != BMI2_OK) {
+        return -EFAULT;
+    }
+
+    *p_period_us = bmi2_odr_to_period_us(data->acc_odr);
+
+    if (fifo_length == 0) {
+        return 0;
+    }
+
+    // Frames that does not fit are left in the FIFO for the next read.
+    max_frames = MIN(max_frames, CONFIG_BMI270_PLUS_FIFO_MAX_FRAMES);
+
+    memset(&fifo, 0, sizeof(fifo));
+    fifo.data = data->fifo_raw;
+    fifo.length = MIN(fifo_length, max_frames * BOSCH_BMI270_FIFO_FRAME_LENGTH);
+
+    if (bmi2_read_fifo_data(&fifo, &data->bmi2) != BMI2_OK) {
+        return -EFAULT;
+    }
+
+    acc_length = max_frames;
+    gyr_length = max_frames;
+
+    // Warnings like an empty FIFO are positive.
+    if ((bmi2_extract_accel(data->fifo_acc, &acc_length, &fifo, &data->bmi2) < BMI2_OK) ||
+        (bmi2_extract_gyro(data->fifo_gyr, &gyr_length, &fifo, &data->bmi2) < BMI2_OK)) {
+        return -EFAULT;
+    }
+
+    if (acc_length != gyr_length) {
+        LOG_DBG("Unmatched frames, accel: %u, gyro: %u", acc_length, gyr_length);
+    }
+
+    num_frames = MIN(acc_length, gyr_length);
+
+    acc_scale = ((float)data->acc_range * SENSOR_G) / (1000000.0f * INT16_MAX);
+    gyr_scale = ((float)data->gyr_range * SENSOR_PI) / (180.0f * 1000000.0f * INT16_MAX);
+
+    for (int i = 0; i < num_frames; i++) {
+        p_frames[i].acc[0] = data->fifo_acc[i].x * acc_scale;
+        p_frames[i].acc[1] = data->fifo_acc[i].y * acc_scale;
+        p_frames[i].acc[2] = data->fifo_acc[i].z * acc_scale;
+        p_frames[i].gyr[0] = data->fifo_gyr[i].x * gyr_scale;
+        p_frames[i].gyr[1] = data->fifo_gyr[i].y * gyr_scale;
+        p_frames[i].gyr[2] = data->fifo_gyr[i].z * gyr_scale;
+    }
+
+    return num_frames;
+}
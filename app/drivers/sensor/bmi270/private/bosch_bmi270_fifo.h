@@ -0,0 +1,19 @@
+/* bosch_bmi270_fifo.h - Driver for Bosch BMI270 IMU. */
+
+/*
+ * Copyright (c) 2023, Daniel Kampert
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "bosch_bmi270_types.h"
+
+/** @brief              Enable the FIFO with accelerometer and gyroscope frames and map the watermark
+ *                      interrupt to INT2. The gyroscope runs at the accelerometer ODR while the FIFO is enabled.
+ *  @param p_dev
+ *  @param watermark    Watermark in frames, 0 disables the FIFO and restores the gyroscope ODR
+ *  @return             0 when successful
+*/
+int bmi2_configure_fifo(const struct device *p_dev, int32_t watermark);
@@ -16,6 +16,10 @@
 #include "bmi2.h"
 #include "bmi270.h"
 
+/** @brief Size of a FIFO frame in header mode with accelerometer and gyroscope data.
+*/
+#define BOSCH_BMI270_FIFO_FRAME_LENGTH  13
+
 /** @brief 
 */
 struct bmi270_config {
@@ -48,6 +52,11 @@ struct bmi270_data {
     sensor_trigger_handler_t motion;
 #endif
 
+#ifdef CONFIG_BMI270_PLUS_FIFO
+    const struct sensor_trigger *fifo_trig;
+    sensor_trigger_handler_t fifo_watermark;
+#endif
+
 #if defined(CONFIG_BMI270_PLUS_TRIGGER_OWN_THREAD)
     struct k_sem sem;
 #elif defined(CONFIG_BMI270_PLUS_TRIGGER_GLOBAL_THREAD)
@@ -67,4 +76,12 @@ struct bmi270_data {
     uint8_t gyr_odr;
     uint8_t gyr_osr;
     struct bmi2_dev bmi2;
+
+#ifdef CONFIG_BMI270_PLUS_FIFO
+    bool fifo_enabled;
+    uint8_t fifo_restore_gyr_odr;
+    uint8_t fifo_raw[CONFIG_BMI270_PLUS_FIFO_MAX_FRAMES * BOSCH_BMI270_FIFO_FRAME_LENGTH];
+    struct bmi2_sens_axes_data fifo_acc[CONFIG_BMI270_PLUS_FIFO_MAX_FRAMES];
+    struct bmi2_sens_axes_data fifo_gyr[CONFIG_BMI270_PLUS_FIFO_MAX_FRAMES];
+#endif
 };
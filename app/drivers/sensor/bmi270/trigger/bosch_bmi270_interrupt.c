@@ -63,6 +63,22 @@ static void bmi2_gpio_on_interrupt_callback(const struct device *p_dev, struct g
     bmi2_handle_int(data->dev);
 }
 
+#ifdef CONFIG_BMI270_PLUS_FIFO
+/** @brief          The interrupt is edge triggered, but the watermark interrupt stays active as long as
+ *                  the FIFO is above the watermark. Process it again if it was raised while disabled.
+ *  @param p_dev
+*/
+static void bmi2_check_pending_int(const struct device *p_dev)
+{
+    struct bmi270_data *data = p_dev->data;
+    const struct bmi270_config *config = p_dev->config;
+
+    if (data->fifo_enabled && (gpio_pin_get_dt(&config->int_gpio) > 0)) {
+        bmi2_handle_int(p_dev);
+    }
+}
+#endif
+
 /** @brief          
  *  @param p_dev	
 */
@@ -83,6 +99,23 @@ static void bmi2_process_int(const struct device *p_dev)
 
     LOG_DBG("Status: %u", status);
 
+#ifdef CONFIG_BMI270_PLUS_FIFO
+    if (status & BMI2_FWM_INT_STATUS_MASK) {
+        if (data->fifo_watermark) {
+            data->fifo_watermark(p_dev, data->fifo_trig);
+        }
+
+        // The watermark fires several times per second, only poll the features
+        // when a feature interrupt is pending as well.
+        status &= ~BMI2_FWM_INT_STATUS_MASK;
+        if (status == 0) {
+            bmi2_enable_int(p_dev, true);
+            bmi2_check_pending_int(p_dev);
+            return;
+        }
+    }
+#endif
+
     if (status & BMI270_SIG_MOT_STATUS_MASK) {
         LOG_DBG("BMI270_SIG_MOT_STATUS_MASK");
 
@@ -170,6 +203,9 @@ static void bmi2_process_int(const struct device *p_dev)
     }
 
     bmi2_enable_int(p_dev, true);
+#ifdef CONFIG_BMI270_PLUS_FIFO
+    bmi2_check_pending_int(p_dev);
+#endif
 }
 
 #ifdef CONFIG_BMI270_PLUS_TRIGGER_OWN_THREAD
@@ -274,7 +310,31 @@ int bmi270_trigger_set(const struct device *p_dev, const struct sensor_trigger *
     struct bmi270_data *data = p_dev->data;
     const struct bmi270_config *config = p_dev->config;
 
-    if ((!config->int_gpio.port) || ((p_trig->chan != SENSOR_CHAN_GESTURE) && (p_trig->chan != SENSOR_CHAN_ALL))) {
+    if (!config->int_gpio.port) {
+        return -ENOTSUP;
+    }
+
+#ifdef CONFIG_BMI270_PLUS_FIFO
+    // The FIFO has its own trigger, so it can be used next to the feature handlers.
+    if (p_trig->chan == SENSOR_CHAN_FIFO) {
+        if ((uint8_t)p_trig->type != SENSOR_TRIG_FIFO_WATERMARK) {
+            return -ENOTSUP;
+        }
+
+        data->fifo_trig = p_trig;
+        data->fifo_watermark = handler;
+
+        if (handler != NULL) {
+            bmi2_enable_int(p_dev, true);
+        }
+
+        LOG_DBG("FIFO watermark trigger installed");
+
+        return 0;
+    }
+#endif
+
+    if ((p_trig->chan != SENSOR_CHAN_GESTURE) && (p_trig->chan != SENSOR_CHAN_ALL)) {
         return -ENOTSUP;
     }
 
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""
+Print the RAM used by the BLE data event and the buffers carrying its large payloads.
+
+Runs after every build on the new image. Pass an image built before the payloads were moved into
+buffers with --baseline to print the old and new sizes next to each other.
+"""
+
+import argparse
+import re
+import subprocess
+import sys
+
+# Sizes of all symbols matching a pattern are added together.
+GROUPS = [
+    ("ble_data_event (zbus message)", r"^_zbus_message_ble_comm_data_chan$"),
+    ("BLE comm buffer pool", r"ble_comm_buf_pool"),
+    ("AMS artist buffer", r"^music_artist$"),
+    ("Music info kept by the apps", r"^last_music_info$"),
+]
+
+
+def read_symbol_sizes(nm, elf):
+    output = subprocess.run([nm, "--print-size", "--radix=d", elf], capture_output=True, text=True, check=True).stdout
+    sizes = {}
+    for line in output.splitlines():
+        fields = line.split()
+        # Symbols without a size only have address, type and name.
+        if len(fields) == 4:
+            name = fields[3]
+            sizes[name] = sizes.get(name, 0) + int(fields[1])
+    return sizes
+
+
+def group_size(sizes, pattern):
+    return sum(size for name, size in sizes.items() if re.search(pattern, name))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Print the BLE data event and buffer pool sizes of a build.")
+    parser.add_argument("elf", help="zephyr.elf of the build")
+    parser.add_argument("--baseline", help="zephyr.elf of an older build to compare with")
+    parser.add_argument("--nm", default="nm", help="nm of the toolchain used for the build")
+    args = parser.parse_args()
+
+    try:
+        new_sizes = read_symbol_sizes(args.nm, args.elf)
+        old_sizes = read_symbol_sizes(args.nm, args.baseline) if args.baseline else None
+    except (OSError, subprocess.CalledProcessError) as e:
+        print("Failed to read symbols: %s" % e)
+        # Only informational, don't fail the build.
+        return 0
+
+    for label, pattern in GROUPS:
+        new_size = group_size(new_sizes, pattern)
+        if old_sizes is None:
+            print("%s: %d bytes" % (label, new_size))
+        else:
+            old_size = group_size(old_sizes, pattern)
+            print("%s: %d -> %d bytes (%+d)" % (label, old_size, new_size, new_size - old_size))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
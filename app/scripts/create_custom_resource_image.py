@@ -1,75 +1,238 @@
 import os
+import time
 import argparse
 from struct import *
 
 MAX_FILE_NAME = 32
-FILE_TABLE_MAX_LEN = 32000
+MAX_NUM_FILES = 1024
+TABLE_HEADER_MAGIC = 0x0A0A0A0C
+FNV_OFFSET_BASIS = 2166136261
+FNV_PRIME = 16777619
+
+COMPRESSION_NONE = 0
+COMPRESSION_RLE = 1
+# Uncompressed size of one independently compressed chunk is the largest
+# multiple of the RLE unit size that fits in this.
+COMPRESSION_CHUNK_MAX_LEN = 4096
+# Only store a file compressed if it saves at least this much
+COMPRESSION_MIN_SAVING = 0.1
+
+# LVGL v8 color formats, used to pick the RLE unit size (bytes per pixel)
+LV_IMG_CF_TRUE_COLOR = 4
+LV_IMG_CF_TRUE_COLOR_ALPHA = 5
+LV_IMG_CF_TRUE_COLOR_CHROMA_KEYED = 6
 """
 magic_number:uint32
 header_len:uint32
 total_length:uint32
 num_files:uint32
-filename[MAX_FILE_NAME + 1]
-offset:uint32
-len:uint32
-filename[MAX_FILE_NAME + 1]
+name_hash:uint32        (num_files entries, sorted ascending)
+name_hash:uint32
+...
+filename[MAX_FILE_NAME] (num_files entries, same order as the hashes)
 offset:uint32
-len:uint32
+len:uint32              Uncompressed length
+stored_len:uint32       Length in the image
+compression:uint32      Bits 0-7 compression type, bits 8-15 RLE unit size
 ...
+
+A compressed file is stored as:
+chunk_offsets:uint32[num_chunks + 1], relative to start of the stored file
+chunk data
+
+RLE chunk data is a sequence of tokens operating on units of unit size bytes:
+ctrl:uint8 < 0x80   ctrl + 1 literal units follows
+ctrl:uint8 >= 0x80  one unit follows that is repeated (ctrl & 0x7F) + 2 times
+The bytes after the last whole unit in a chunk are stored raw at the end.
 """
 
 
-def create_custom_raw_fs_image(img_filename, source_dir, block_size=4096):
+def file_name_hash(name):
+    """32-bit FNV-1a, must match file_name_hash() in zsw_lvgl_spi_decoder.c"""
+    hash = FNV_OFFSET_BASIS
+    for c in bytes(name, "utf-8")[:MAX_FILE_NAME]:
+        hash ^= c
+        hash = (hash * FNV_PRIME) & 0xFFFFFFFF
+    return hash
+
+
+def rle_unit_size(data):
+    if len(data) < 4:
+        return 1
+    color_format = data[0] & 0x1F
+    if color_format in (LV_IMG_CF_TRUE_COLOR, LV_IMG_CF_TRUE_COLOR_CHROMA_KEYED):
+        return 2
+    if color_format == LV_IMG_CF_TRUE_COLOR_ALPHA:
+        return 3
+    return 1
+
+
+def rle_chunk_len(unit):
+    return (COMPRESSION_CHUNK_MAX_LEN // unit) * unit
+
+
+def rle_compress_chunk(chunk, unit):
+    out = bytearray()
+    units = [chunk[i : i + unit] for i in range(0, len(chunk) - len(chunk) % unit, unit)]
+    literals = []
+
+    def flush_literals():
+        while literals:
+            part = literals[:128]
+            del literals[:128]
+            out.append(len(part) - 1)
+            for u in part:
+                out.extend(u)
+
+    i = 0
+    while i < len(units):
+        run = 1
+        while i + run < len(units) and run < 129 and units[i + run] == units[i]:
+            run += 1
+        if run >= 2:
+            flush_literals()
+            out.append(0x80 | (run - 2))
+            out.extend(units[i])
+            i += run
+        else:
+            literals.append(units[i])
+            i += 1
+    flush_literals()
+    out.extend(chunk[len(chunk) - len(chunk) % unit :])
+    return out
+
+
+def rle_decompress_chunk(data, unit, chunk_len):
+    out = bytearray()
+    pos = 0
+    while len(out) + unit <= chunk_len:
+        ctrl = data[pos]
+        pos += 1
+        if ctrl & 0x80:
+            out.extend(data[pos : pos + unit] * ((ctrl & 0x7F) + 2))
+            pos += unit
+        else:
+            count = (ctrl + 1) * unit
+            out.extend(data[pos : pos + count])
+            pos += count
+    out.extend(data[pos : pos + chunk_len - len(out)])
+    return out
+
+
+def rle_compress(data, unit):
+    chunk_len = rle_chunk_len(unit)
+    chunks = [
+        rle_compress_chunk(data[i : i + chunk_len], unit)
+        for i in range(0, len(data), chunk_len)
+    ]
+    offset = (len(chunks) + 1) * 4
+    table = bytearray()
+    for chunk in chunks:
+        table.extend(pack("<I", offset))
+        offset += len(chunk)
+    table.extend(pack("<I", offset))
+    return table + b"".join(chunks)
+
+
+def rle_decompress(data, unit, uncompressed_len):
+    chunk_len = rle_chunk_len(unit)
+    out = bytearray()
+    for i in range((uncompressed_len + chunk_len - 1) // chunk_len):
+        start, end = unpack_from("<II", data, i * 4)
+        out.extend(
+            rle_decompress_chunk(
+                data[start:end], unit, min(chunk_len, uncompressed_len - len(out))
+            )
+        )
+    return out
+
+
+def encode_file(data, compress):
+    """Returns (stored data, compression field)"""
+    if not compress or len(data) == 0:
+        return data, COMPRESSION_NONE
+    unit = rle_unit_size(data)
+    compressed = rle_compress(data, unit)
+    if len(compressed) > len(data) * (1 - COMPRESSION_MIN_SAVING):
+        return data, COMPRESSION_NONE
+    if rle_decompress(compressed, unit, len(data)) != data:
+        raise Exception("RLE round trip failed")
+    return compressed, COMPRESSION_RLE | (unit << 8)
+
+
+def create_custom_raw_fs_image(
+    img_filename, source_dir, block_size=4096, compress=True, print_stats=False
+):
     table = {}
     offset = 0
     files_image = bytearray()
     header_images = bytearray()
+    hash_images = bytearray()
     for root, dirs, files in os.walk(source_dir):
         print(f"root {root} dirs {dirs} files {files}")
         for filename in files:
             path = os.path.join(root, filename)
             relpath = os.path.relpath(path, start=source_dir)
+            if len(filename) > MAX_FILE_NAME:
+                print("Filename to long, skipping", filename, len(filename))
+                continue
             print(f"Adding {path}")
             with open(path, "rb") as infile:
-                files_image.extend(infile.read())
-                table[filename] = {"offset": offset, "len": infile.tell()}
-                offset = offset + infile.tell()
+                data = infile.read()
+            start = time.perf_counter()
+            stored, compression = encode_file(data, compress)
+            table[filename] = {
+                "offset": offset,
+                "len": len(data),
+                "stored_len": len(stored),
+                "compression": compression,
+                "time": time.perf_counter() - start,
+            }
+            # Keep file data word aligned for the flash driver
+            stored = stored + bytearray(-len(stored) % 4)
+            files_image.extend(stored)
+            offset = offset + len(stored)
     print(table)
-    for name, data in table.items():
-        if len(name) <= MAX_FILE_NAME:
-            header_images = header_images + pack(
-                f"<{MAX_FILE_NAME}sII",
-                bytes(name, "utf-8"),
-                data["offset"],
-                data["len"],
-            )
-        else:
-            print("Filename to long, skipping", name, len(name))
 
-    # Insert dummy values as header length and total length so we can get the size of the header
-    fake_header = header_image = (
-        pack("<IIII", 0x0A0A0A0A, len(table), 0, 0) + header_images
-    )
-    print("header len", len(fake_header))
+    if len(table) > MAX_NUM_FILES:
+        print(
+            "Too many files, increase the max number of files on target",
+            MAX_NUM_FILES,
+            "<",
+            len(table),
+        )
+        exit(1)
+
+    # Sort by hash so target can binary search the hash array and only keep that in RAM
+    for name in sorted(table, key=lambda name: (file_name_hash(name), name)):
+        data = table[name]
+        hash_images = hash_images + pack("<I", file_name_hash(name))
+        header_images = header_images + pack(
+            f"<{MAX_FILE_NAME}sIIII",
+            bytes(name, "utf-8"),
+            data["offset"],
+            data["len"],
+            data["stored_len"],
+            data["compression"],
+        )
+
+    header_len = 16 + len(hash_images) + len(header_images)
+    print("header len", header_len)
     real_header = (
         pack(
             "<IIII",
-            0x0A0A0A0A,
-            len(fake_header),
-            len(fake_header) + len(files_image),
+            TABLE_HEADER_MAGIC,
+            header_len,
+            header_len + len(files_image),
             len(table),
         )
+        + hash_images
         + header_images
     )
 
-    if len(header_images) > FILE_TABLE_MAX_LEN:
-        print(
-            "File table is to big, increase the size on target size",
-            FILE_TABLE_MAX_LEN,
-            "<",
-            len(header_images),
-        )
-        exit(1)
+    if print_stats:
+        print_compression_stats(table)
+
     # Add header length
     with open(img_filename, "wb") as f:
         f.write(real_header)
@@ -77,10 +240,41 @@ def create_custom_raw_fs_image(img_filename, source_dir, block_size=4096):
         f.write(bytearray(4096)) # TODO: Workaround due to a bug that last few bytes are not received on target.
 
 
+def print_compression_stats(table, spi_bytes_per_sec=8000000):
+    """Print stored vs raw size and the estimated flash transfer time at the given QSPI throughput."""
+    total_len = sum(data["len"] for data in table.values())
+    total_stored = sum(data["stored_len"] for data in table.values())
+    print(
+        f"{'File':<{MAX_FILE_NAME}} {'Raw':>9} {'Stored':>9} {'Ratio':>6} {'Raw ms':>7} {'Stored ms':>9} {'Pack ms':>8}"
+    )
+    for name, data in sorted(table.items(), key=lambda item: -item[1]["len"]):
+        print(
+            f"{name:<{MAX_FILE_NAME}} {data['len']:>9} {data['stored_len']:>9} "
+            f"{data['stored_len'] / max(data['len'], 1):>6.2f} "
+            f"{data['len'] * 1000 / spi_bytes_per_sec:>7.2f} "
+            f"{data['stored_len'] * 1000 / spi_bytes_per_sec:>9.2f} "
+            f"{data['time'] * 1000:>8.1f}"
+        )
+    print(
+        f"{'Total':<{MAX_FILE_NAME}} {total_len:>9} {total_stored:>9} "
+        f"{total_stored / max(total_len, 1):>6.2f} "
+        f"{total_len * 1000 / spi_bytes_per_sec:>7.2f} "
+        f"{total_stored * 1000 / spi_bytes_per_sec:>9.2f}"
+    )
+
+
 if __name__ == "__main__":
     parser = argparse.ArgumentParser()
     parser.add_argument("--img-filename", default="littlefs.img")
     parser.add_argument("--block-size", type=int, default=4096)
+    parser.add_argument(
+        "--no-compress", action="store_true", help="Store all files uncompressed"
+    )
+    parser.add_argument(
+        "--stats",
+        action="store_true",
+        help="Print a size and estimated load time comparison per file",
+    )
     parser.add_argument("source")
     args = parser.parse_args()
 
@@ -88,4 +282,6 @@ if __name__ == "__main__":
     block_size = args.block_size
     source_dir = args.source
 
-    create_custom_raw_fs_image(img_filename, source_dir, block_size)
+    create_custom_raw_fs_image(
+        img_filename, source_dir, block_size, not args.no_compress, args.stats
+    )
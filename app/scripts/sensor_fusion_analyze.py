@@ -16,10 +16,116 @@ logged_data = []
 num_discard = 5
 
 
-def run_fusion(data_list):
-    sample_rate = 100  # 100 Hz
+def print_timing_stats(timestamp):
+    # Timestamps are taken from the IMU sample count, the time between two samples
+    # shows how stable the delta time used by the fusion on the watch is.
+    delta_time = np.diff(timestamp)
+    period = np.median(delta_time)
+    jitter = np.abs(delta_time - period)
+
+    print("Sample rate: %.1f Hz" % (1 / period))
+    print(
+        "Delta time min: %.1f us, max: %.1f us, std: %.1f us"
+        % (np.min(delta_time) * 1e6, np.max(delta_time) * 1e6, np.std(delta_time) * 1e6)
+    )
+    print(
+        "Jitter avg: %.1f us, max: %.1f us, samples off by more than 10%%: %d"
+        % (np.mean(jitter) * 1e6, np.max(jitter) * 1e6, np.sum(jitter > period / 10))
+    )
+
+    return period
+
+
+def print_euler_diff(euler_a, euler_b):
+    # Wrap to +-180 so a yaw of 179 and -179 is 2 degrees apart.
+    diff = (euler_a - euler_b + 180) % 360 - 180
+    for index, axis in enumerate(("Roll", "Pitch", "Yaw")):
+        print(
+            "%-5s diff rms: %.3f deg, max: %.3f deg"
+            % (axis, np.sqrt(np.mean(diff[:, index] ** 2)), np.max(np.abs(diff[:, index])))
+        )
+
+    return diff
+
+
+def compare_reference(file_name, use_magnetometer):
+    # The gyroscope, accelerometer and magnetometer columns are the exact input to the AHRS on the
+    # watch, after unit conversion and offset correction. Running the reference Fusion implementation
+    # on them shows the numeric error of the watch (or --fusion-replay-out) implementation.
+    data = np.genfromtxt(file_name, delimiter=",")
+    data = data[~np.isnan(data).any(axis=1)]
+    timestamp = data[:, 0]
+    period = print_timing_stats(timestamp)
+    sample_rate = round(1 / period)
+
+    # Same delta time as the watch, the sample period is used for the first sample and after gaps.
+    delta_time = np.diff(timestamp, prepend=timestamp[0] - period)
+    delta_time[(delta_time <= 0) | (delta_time > 10 * period)] = period
+
+    ahrs = imufusion.Ahrs()
+    ahrs.settings = imufusion.Settings(
+        imufusion.CONVENTION_NWU, 0.5, 2000, 10, 10, 5 * sample_rate
+    )
+
+    euler = np.empty((len(timestamp), 3))
+    for index in range(len(timestamp)):
+        if use_magnetometer:
+            ahrs.update(data[index, 4:7], data[index, 7:10], data[index, 10:13], delta_time[index])
+        else:
+            ahrs.update_no_magnetometer(data[index, 4:7], data[index, 7:10], delta_time[index])
+        euler[index] = ahrs.quaternion.to_euler()
+
+    print("Difference to reference implementation, the output has 0.1 deg resolution:")
+    print_euler_diff(data[:, 1:4], euler)
+
+
+def compare_runs(file_a, file_b):
+    # Compares the Euler angles of two runs of the same recording, for example a recording from
+    # the watch and the output of replaying it on native_posix with --fusion-replay-out.
+    data_a = np.genfromtxt(file_a, delimiter=",")
+    data_b = np.genfromtxt(file_b, delimiter=",")
+    data_a = data_a[~np.isnan(data_a).any(axis=1)]
+    data_b = data_b[~np.isnan(data_b).any(axis=1)]
+    num_samples = min(len(data_a), len(data_b))
+
+    if len(data_a) != len(data_b):
+        print(
+            "Runs have different length (%d and %d), comparing the first %d samples"
+            % (len(data_a), len(data_b), num_samples)
+        )
+    data_a = data_a[:num_samples]
+    data_b = data_b[:num_samples]
 
+    for name, data in ((file_a, data_a), (file_b, data_b)):
+        print("%s:" % name)
+        print_timing_stats(data[:, 0])
+
+    diff = print_euler_diff(data_a[:, 1:4], data_b[:, 1:4])
+
+    timestamp = data_a[:, 0] - data_a[0, 0]
+    figure, axes = pyplot.subplots(nrows=2, sharex=True)
+    figure.suptitle("%s vs %s" % (file_a, file_b))
+
+    for index, (axis, color) in enumerate(
+        (("Roll", "tab:orange"), ("Pitch", "tab:green"), ("Yaw", "tab:blue"))
+    ):
+        axes[0].plot(timestamp, data_a[:, index + 1], color, label=axis)
+        axes[0].plot(timestamp, data_b[:, index + 1], color, linestyle="--")
+        axes[1].plot(timestamp, diff[:, index], color, label=axis)
+    axes[0].set_ylabel("Degrees")
+    axes[0].grid()
+    axes[0].legend()
+    axes[0].set_ylim(-180, 180)
+    axes[1].set_ylabel("Difference")
+    axes[1].grid()
+    axes[1].legend()
+
+    pyplot.show(block="no_block" not in sys.argv)
+
+
+def run_fusion(data_list):
     timestamp = data_list[:, 0]
+    sample_rate = round(1 / print_timing_stats(timestamp))
     euler_from_watch = data_list[:, 1:4]
     gyroscope = data_list[:, 4:7]
     accelerometer = data_list[:, 7:10]
@@ -300,8 +406,35 @@ if __name__ == "__main__":
         "--data", type=str, help="Don't collect data, use data from file instead."
     )
 
+    parser.add_argument(
+        "--compare",
+        nargs=2,
+        metavar=("A", "B"),
+        help="Compare the orientation and timing of two runs, for example a recording and a --fusion-replay-out.",
+    )
+
+    parser.add_argument(
+        "--reference",
+        type=str,
+        help="Compare the orientation in a recording or --fusion-replay-out against the reference Fusion implementation.",
+    )
+
+    parser.add_argument(
+        "--no_magnetometer",
+        action="store_true",
+        help="Use with --reference when CONFIG_SENSOR_FUSION_INCLUDE_MAGNETOMETER is disabled.",
+    )
+
     args = parser.parse_args()
 
+    if args.reference:
+        compare_reference(args.reference, not args.no_magnetometer)
+        sys.exit(0)
+
+    if args.compare:
+        compare_runs(args.compare[0], args.compare[1])
+        sys.exit(0)
+
     if args.data:
         data_list = np.genfromtxt(args.data, delimiter=",")
         run_fusion(data_list)
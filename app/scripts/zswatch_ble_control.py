@@ -7,6 +7,10 @@ import asyncio
 from bleak import BleakScanner, BleakClient, BleakError
 import numpy as np
 import time
+import ctypes
+import os
+import socket
+import struct
 
 import platform
 
@@ -18,6 +22,31 @@ UART_SERVICE_UUID = "6E400001-B5A3-F393-E0A9-E50E24DCCA9E"
 UART_RX_CHAR_UUID = "6E400002-B5A3-F393-E0A9-E50E24DCCA9E"
 UART_TX_CHAR_UUID = "6E400003-B5A3-F393-E0A9-E50E24DCCA9E"
 
+# IMU stream over L2CAP, see src/ble/ble_imu_stream.c
+IMU_STREAM_PSM = 0x81
+IMU_STREAM_HEADER = struct.Struct("<HBBII6h")
+IMU_STREAM_FLAG_SAMPLES_LOST = 0x01
+
+# Linux (BlueZ) only, Python's socket module can't connect L2CAP to an LE address.
+AF_BLUETOOTH = 31
+BTPROTO_L2CAP = 0
+SOL_BLUETOOTH = 274
+BT_SECURITY = 4
+BT_SECURITY_LOW = 1
+BT_SECURITY_MEDIUM = 2
+BDADDR_LE_PUBLIC = 1
+BDADDR_LE_RANDOM = 2
+
+
+class _SockaddrL2(ctypes.Structure):
+    _fields_ = [
+        ("l2_family", ctypes.c_ushort),
+        ("l2_psm", ctypes.c_ushort),
+        ("l2_bdaddr", ctypes.c_uint8 * 6),
+        ("l2_cid", ctypes.c_ushort),
+        ("l2_bdaddr_type", ctypes.c_uint8),
+    ]
+
 
 def handle_disconnect(device: BleakClient):
     print("______ZSWatch disconnected", device.address)
@@ -140,3 +169,141 @@ async def zsw_disconnect(client):
 
 def zsw_list_uart_devices(timeout):
     return asyncio.run(list_uart_devices(timeout))
+
+
+def decode_imu_stream_sdu(data):
+    """
+    Decode one SDU from the IMU stream.
+    Returns (sequence number, flags, timestamps in s, samples) where samples is a Nx6 array
+    with accelerometer x, y, z in g and gyroscope x, y, z in deg/s.
+    Timestamps are the lower 32 bits of the watch uptime, so they wrap every 71 minutes.
+    """
+    seq, num_samples, flags, timestamp_us, period_us, *first = IMU_STREAM_HEADER.unpack_from(data)
+    samples = np.empty((num_samples, 6), dtype=np.int32)
+    samples[0] = first
+    pos = IMU_STREAM_HEADER.size
+
+    for index in range(1, num_samples):
+        for axis in range(6):
+            value = 0
+            shift = 0
+            while True:
+                byte = data[pos]
+                pos += 1
+                value |= (byte & 0x7F) << shift
+                shift += 7
+                if byte < 0x80:
+                    break
+            # Zigzag decode
+            samples[index, axis] = samples[index - 1, axis] + ((value >> 1) ^ -(value & 1))
+
+    timestamps = (timestamp_us + np.arange(num_samples) * period_us) / 1e6
+    scaled = np.hstack((samples[:, 0:3] / 1000.0, samples[:, 3:6] / 10.0))
+
+    return seq, flags, timestamps, scaled
+
+
+def zsw_imu_stream_connect(address, psm=IMU_STREAM_PSM, random_address=True, encrypt=True):
+    """
+    Open the IMU stream L2CAP channel, returns a file descriptor where every read is one SDU.
+    The watch must not be connected to anything else, for example a phone.
+    """
+    libc = ctypes.CDLL(None, use_errno=True)
+    fd = libc.socket(AF_BLUETOOTH, socket.SOCK_SEQPACKET, BTPROTO_L2CAP)
+    if fd < 0:
+        raise OSError(ctypes.get_errno(), "Failed creating L2CAP socket")
+
+    security = struct.pack("BB", BT_SECURITY_MEDIUM if encrypt else BT_SECURITY_LOW, 0)
+    libc.setsockopt(fd, SOL_BLUETOOTH, BT_SECURITY, security, len(security))
+
+    addr = _SockaddrL2()
+    addr.l2_family = AF_BLUETOOTH
+    addr.l2_psm = psm
+    addr.l2_bdaddr[:] = reversed(bytes.fromhex(address.replace(":", "")))
+    addr.l2_bdaddr_type = BDADDR_LE_RANDOM if random_address else BDADDR_LE_PUBLIC
+
+    if libc.connect(fd, ctypes.byref(addr), ctypes.sizeof(addr)) != 0:
+        err = ctypes.get_errno()
+        os.close(fd)
+        raise OSError(err, "Failed connecting L2CAP to %s" % address)
+
+    return fd
+
+
+def zsw_imu_stream_set_rate(fd, rate_hz):
+    os.write(fd, struct.pack("<H", rate_hz))
+
+
+def zsw_imu_stream_receive(fd, duration, callback=None):
+    """
+    Receive the IMU stream for duration seconds and print throughput and lost data.
+    Returns (timestamps, samples) of everything received.
+    """
+    timestamps = []
+    samples = []
+    last_seq = None
+    lost_sdus = 0
+    lost_flags = 0
+    num_bytes = 0
+    start = time.time()
+
+    while time.time() - start < duration:
+        data = os.read(fd, 65535)
+        if len(data) == 0:
+            print("IMU stream closed by the watch")
+            break
+        num_bytes += len(data)
+        seq, flags, sdu_timestamps, sdu_samples = decode_imu_stream_sdu(data)
+
+        if last_seq is not None and seq != (last_seq + 1) & 0xFFFF:
+            lost_sdus += (seq - last_seq - 1) & 0xFFFF
+        if flags & IMU_STREAM_FLAG_SAMPLES_LOST:
+            lost_flags += 1
+        last_seq = seq
+
+        timestamps.append(sdu_timestamps)
+        samples.append(sdu_samples)
+        if callback:
+            callback(sdu_timestamps, sdu_samples)
+
+    elapsed = time.time() - start
+    timestamps = np.concatenate(timestamps) if timestamps else np.empty(0)
+    samples = np.concatenate(samples) if samples else np.empty((0, 6))
+    print(
+        "Received %d samples (%.1f Hz), %d bytes (%.1f bytes/sample), %d SDUs lost, %d times samples dropped on the watch"
+        % (
+            len(samples),
+            len(samples) / elapsed,
+            num_bytes,
+            num_bytes / max(len(samples), 1),
+            lost_sdus,
+            lost_flags,
+        )
+    )
+
+    return timestamps, samples
+
+
+if __name__ == "__main__":
+    import argparse
+
+    parser = argparse.ArgumentParser(description="Receive the raw IMU stream from ZSWatch over L2CAP (Linux only).")
+    parser.add_argument("address", help="Bluetooth address of the watch")
+    parser.add_argument("--psm", type=lambda x: int(x, 0), default=IMU_STREAM_PSM)
+    parser.add_argument("--public", action="store_true", help="The watch uses a public address")
+    parser.add_argument("--no_encrypt", action="store_true", help="Use with CONFIG_BLE_DISABLE_PAIRING_REQUIRED")
+    parser.add_argument("--rate", type=int, help="Sample rate in Hz, 25 Hz times a power of two")
+    parser.add_argument("--duration", type=float, default=10, help="Seconds to receive")
+    parser.add_argument("--out", type=str, help="Save samples as CSV: t, accel x,y,z (g), gyro x,y,z (deg/s)")
+    args = parser.parse_args()
+
+    fd = zsw_imu_stream_connect(args.address, args.psm, not args.public, not args.no_encrypt)
+    try:
+        if args.rate:
+            zsw_imu_stream_set_rate(fd, args.rate)
+        timestamps, samples = zsw_imu_stream_receive(fd, args.duration)
+    finally:
+        os.close(fd)
+
+    if args.out:
+        np.savetxt(args.out, np.column_stack((timestamps, samples)), delimiter=",")
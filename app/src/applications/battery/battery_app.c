@@ -13,9 +13,22 @@
 #include "battery_ui.h"
 
 #define SETTING_BATTERY_HIST    "battery/hist"
+#define SETTING_BATTERY_HIST_HOURLY "battery/hist_1h"
+#define SETTING_BATTERY_HIST_DAILY  "battery/hist_1d"
 #define SAMPLE_INTERVAL_MIN     15
 #define SAMPLE_INTERVAL_MS      (SAMPLE_INTERVAL_MIN * 60 * 1000)
 #define MAX_SAMPLES             (7 * 24 * (60 / SAMPLE_INTERVAL_MIN)) // One week of 15 minute samples
+#define SAMPLES_PER_HOUR        (60 / SAMPLE_INTERVAL_MIN)
+#define SAMPLES_PER_DAY         (24 * SAMPLES_PER_HOUR)
+#define HOURLY_NUM_BUCKETS      (14 * 24)   // Two weeks
+#define DAILY_NUM_BUCKETS       90
+#define CHART_NUM_POINTS        (7 * 24)    // One point per hour for the last week
+
+enum battery_channel {
+    BATTERY_CHANNEL_PERCENT,
+    BATTERY_CHANNEL_VOLTAGE,
+    BATTERY_NUM_CHANNELS
+};
 
 static void battery_app_start(lv_obj_t *root, lv_group_t *group);
 static void battery_app_stop(void);
@@ -25,6 +38,7 @@ static void on_battery_hist_clear_cb(void);
 
 static uint8_t compresse_voltage_in_byte(int mV);
 static int decompress_voltage_from_byte(uint8_t voltage_byte);
+static int16_t battery_sample_value(const void *p_sample, uint8_t channel);
 
 ZBUS_CHAN_DECLARE(battery_sample_data_chan);
 ZBUS_LISTENER_DEFINE(battery_app_battery_event, zbus_battery_sample_data_callback);
@@ -41,6 +55,12 @@ typedef struct {
 
 static zsw_battery_sample_t samples[MAX_SAMPLES];
 static zsw_history_t battery_context;
+static zsw_history_tier_t hourly_tier;
+static zsw_history_point_t hourly_buckets[HOURLY_NUM_BUCKETS * BATTERY_NUM_CHANNELS];
+static zsw_history_tier_t daily_tier;
+static zsw_history_point_t daily_buckets[DAILY_NUM_BUCKETS * BATTERY_NUM_CHANNELS];
+static zsw_history_point_t chart_percent[CHART_NUM_POINTS];
+static zsw_history_point_t chart_voltage[CHART_NUM_POINTS];
 static uint64_t last_battery_sample_time = 0;
 
 static application_t app = {
@@ -52,18 +72,23 @@ static application_t app = {
 
 static void battery_app_start(lv_obj_t *root, lv_group_t *group)
 {
-    zsw_battery_sample_t sample;
+    int num_points;
     struct battery_sample_event initial_sample;
 
+    // The week is drawn from the hourly tier instead of every sample.
+    num_points = zsw_history_query(&battery_context, MAX_SAMPLES, BATTERY_CHANNEL_PERCENT, chart_percent,
+                                   CHART_NUM_POINTS);
+    zsw_history_query(&battery_context, MAX_SAMPLES, BATTERY_CHANNEL_VOLTAGE, chart_voltage, CHART_NUM_POINTS);
+    num_points = MAX(num_points, 0);
+
 #if CONFIG_DT_HAS_NORDIC_NPM1300_ENABLED
-    battery_ui_show(root, on_battery_hist_clear_cb, zsw_history_samples(&battery_context) + 1, true);
+    battery_ui_show(root, on_battery_hist_clear_cb, num_points + 1, true);
 #else
-    battery_ui_show(root, on_battery_hist_clear_cb, zsw_history_samples(&battery_context) + 1, false);
+    battery_ui_show(root, on_battery_hist_clear_cb, num_points + 1, false);
 #endif
 
-    for (int i = 0; i < zsw_history_samples(&battery_context); i++) {
-        zsw_history_get(&battery_context, &sample, i);
-        battery_ui_add_measurement(sample.percent, decompress_voltage_from_byte(sample.mv_with_decimals));
+    for (int i = 0; i < num_points; i++) {
+        battery_ui_add_measurement(chart_percent[i].avg, chart_voltage[i].avg);
     }
 
     if (zbus_chan_read(&battery_sample_data_chan, &initial_sample, K_MSEC(100)) == 0) {
@@ -131,6 +156,17 @@ static int decompress_voltage_from_byte(uint8_t voltage_byte)
     return (voltage_byte * 10) + 3000;
 }
 
+static int16_t battery_sample_value(const void *p_sample, uint8_t channel)
+{
+    const zsw_battery_sample_t *sample = p_sample;
+
+    if (channel == BATTERY_CHANNEL_PERCENT) {
+        return sample->percent;
+    }
+
+    return decompress_voltage_from_byte(sample->mv_with_decimals);
+}
+
 static int battery_app_add(void)
 {
     zsw_app_manager_add_application(&app);
@@ -141,6 +177,11 @@ static int battery_app_add(void)
     }
 
     zsw_history_init(&battery_context, MAX_SAMPLES, sizeof(zsw_battery_sample_t), samples, SETTING_BATTERY_HIST);
+    zsw_history_rollup_init(&battery_context, battery_sample_value, BATTERY_NUM_CHANNELS);
+    zsw_history_add_tier(&battery_context, &hourly_tier, SAMPLES_PER_HOUR, HOURLY_NUM_BUCKETS, hourly_buckets,
+                         SETTING_BATTERY_HIST_HOURLY);
+    zsw_history_add_tier(&battery_context, &daily_tier, SAMPLES_PER_DAY, DAILY_NUM_BUCKETS, daily_buckets,
+                         SETTING_BATTERY_HIST_DAILY);
 
     if (zsw_history_load(&battery_context)) {
         LOG_ERR("Error during settings_load_subtree!");
@@ -77,7 +77,7 @@ static void zbus_ble_comm_data_callback(const struct zbus_channel *chan)
     // We are here in host bluetooth thread.
     const struct ble_data_event *event = zbus_chan_const_msg(chan);
     if (event->data.type == BLE_COMM_DATA_TYPE_MUSIC_INFO) {
-        memcpy(&last_music_info, &event->data.data.music_info, sizeof(ble_comm_music_info_t));
+        ble_comm_music_info_copy(&last_music_info, &event->data.data.music_info);
         k_work_submit(&update_ui_work);
     } else if (event->data.type == BLE_COMM_DATA_TYPE_MUSIC_STATE) {
         memcpy(&last_music_state, &event->data.data.music_state, sizeof(ble_comm_music_state_t));
@@ -88,13 +88,18 @@ static void zbus_ble_comm_data_callback(const struct zbus_channel *chan)
 static void handle_update_ui(struct k_work *item)
 {
     char buf[5 * MAX_MUSIC_FIELD_LENGTH];
+    ble_comm_music_info_t music_info = {0};
+
     if (running) {
-        if (strlen(last_music_info.track_name) > 0) {
-            snprintf(buf, sizeof(buf), "Track: %s", last_music_info.track_name);
+        // Take a reference, the listener may replace last_music_info meanwhile.
+        ble_comm_music_info_copy(&music_info, &last_music_info);
+        if (music_info.track_name != NULL && strlen(music_info.track_name) > 0) {
+            snprintf(buf, sizeof(buf), "Track: %s", music_info.track_name);
             progress_seconds = 0;
-            music_control_ui_music_info(last_music_info.track_name, last_music_info.artist);
+            music_control_ui_music_info(music_info.track_name, music_info.artist);
             music_control_ui_set_track_progress(0);
         }
+        ble_comm_music_info_release(&music_info);
 
         if (last_music_state.position >= 0) {
             music_control_ui_set_music_state(last_music_state.playing,
@@ -29,12 +29,13 @@ static application_t app = {
 
 static void notification_app_zbus_notification_callback(const struct zbus_channel *chan)
 {
-    zsw_not_mngr_notification_t *not;
+    static zsw_not_mngr_notification_copy_t copy;
 
     LOG_DBG("New notification available");
 
-    not = zsw_notification_manager_get_newest();
-    notifications_ui_add_notification(not, notification_group);
+    if (zsw_notification_manager_get_newest(&copy) == 0) {
+        notifications_ui_add_notification(&copy.notification, notification_group);
+    }
 }
 
 static void notification_app_zbus_notification_remove_callback(const struct zbus_channel *chan)
@@ -52,22 +53,20 @@ static void on_notification_page_notification_close(uint32_t not_id)
     zsw_notification_manager_remove(not_id);
 }
 
-static void notification_app_start(lv_obj_t *root, lv_group_t *group)
+static void add_stored_notification(const zsw_not_mngr_notification_t *notification, void *user_data)
 {
-    static uint32_t num_notifications;
-
-    // TODO: Can we remove this buffer in some way because we already have one notification buffer?
-    static zsw_not_mngr_notification_t notifications[ZSW_NOTIFICATION_MGR_MAX_STORED];
+    // The UI copies the strings into its labels, so they are not used after this returns.
+    notifications_ui_add_notification(notification, notification_group);
+}
 
+static void notification_app_start(lv_obj_t *root, lv_group_t *group)
+{
     notification_group = group;
 
-    zsw_notification_manager_get_all(notifications, &num_notifications);
     notifications_ui_page_init(on_notification_page_notification_close);
     notifications_ui_page_create(root, notification_group);
 
-    for (uint32_t i = 0; i < num_notifications; i++) {
-        notifications_ui_add_notification(&notifications[i], notification_group);
-    }
+    zsw_notification_manager_for_each(add_stored_notification, NULL);
 }
 
 static void notification_app_stop(void)
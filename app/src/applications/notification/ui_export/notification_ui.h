@@ -6,8 +6,10 @@
 #include "managers/zsw_notification_manager.h"
 #include "ui/utils/zsw_ui_utils.h"
 
+// The notification is copied, the one passed to notifications_ui_add_notification is only valid during the call.
 typedef struct {
-    zsw_not_mngr_notification_t *notification;
+    uint32_t id;
+    uint32_t timestamp;
     lv_obj_t *deltaLabel;
     lv_obj_t *panel;
 } active_notification_t;
@@ -20,6 +22,6 @@ void notifications_ui_page_create(lv_obj_t *parent, lv_group_t *group);
 
 void notifications_ui_page_close(void);
 
-void notifications_ui_add_notification(zsw_not_mngr_notification_t *not, lv_group_t *group);
+void notifications_ui_add_notification(const zsw_not_mngr_notification_t *not, lv_group_t *group);
 
 void notifications_ui_remove_notification(uint32_t id);
\ No newline at end of file
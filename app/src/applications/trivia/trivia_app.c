@@ -24,6 +24,7 @@
 
 /*Get 1x easy question with true/false type*/
 #define HTTP_REQUEST_URL "https://opentdb.com/api.php?amount=1&difficulty=easy&type=boolean"
+#define HTTP_RESPONSE_MAX_SIZE 1024
 
 LOG_MODULE_REGISTER(trivia_app, CONFIG_ZSW_TRIVIA_APP_LOG_LEVEL);
 
@@ -42,6 +43,8 @@ typedef struct trivia_app_question {
 
 static trivia_app_question_t trivia_app_question;
 static bool active;
+static bool request_pending;
+static char http_response[HTTP_RESPONSE_MAX_SIZE];
 
 static application_t app = {
     .name = "Trivia",
@@ -71,8 +74,9 @@ static int trivia_app_add(void)
     return 0;
 }
 
-static void http_rsp_cb(ble_http_status_code_t status, char *response)
+static void http_rsp_cb(ble_http_status_code_t status, char *response, size_t len, void *user_data)
 {
+    request_pending = false;
     if (status == BLE_HTTP_STATUS_OK && active) {
         cJSON *parsed_response = cJSON_Parse(response);
         if (parsed_response == NULL) {
@@ -102,9 +106,23 @@ static void http_rsp_cb(ble_http_status_code_t status, char *response)
 static void request_new_question()
 {
     /// @todo create a more generic error code that would cover when GadgetBridge doesn't allow HTTP over BLE, potentially a Systemwide pop-up
-    if (zsw_ble_http_get(HTTP_REQUEST_URL, http_rsp_cb) == -EINVAL) {
+    int ret;
+    zsw_ble_http_request_t request = {
+        .buf = http_response,
+        .buf_size = sizeof(http_response),
+        .on_done = http_rsp_cb,
+    };
+
+    // The response buffer is shared, wait for the pending request.
+    if (request_pending) {
+        return;
+    }
+
+    ret = zsw_ble_http_get(HTTP_REQUEST_URL, &request);
+    if (ret == -EINVAL) {
         trivia_ui_not_supported();
     }
+    request_pending = ret == 0;
 }
 
 static void on_button_click(trivia_button_t trivia_button)
@@ -231,6 +231,18 @@ int watchface_app_get_face_info(int index, const lv_img_dsc_t **preview,  const
     return 0;
 }
 
+static void set_music_info(void)
+{
+    ble_comm_music_info_t music_info = {0};
+
+    // Take a reference, the listener may replace last_music_info meanwhile.
+    ble_comm_music_info_copy(&music_info, &last_music_info);
+    if (music_info.track_name != NULL && strlen(music_info.track_name) > 0) {
+        zsw_watchface_dropdown_ui_set_music_info(music_info.track_name, music_info.artist);
+    }
+    ble_comm_music_info_release(&music_info);
+}
+
 static void refresh_ui(void)
 {
     uint32_t steps;
@@ -246,9 +258,7 @@ static void refresh_ui(void)
         // TODO: Add calculation for distance and kcal
         watchfaces[watchface_settings.watchface_index]->set_step(steps, 0, 0);
     }
-    if (strlen(last_music_info.track_name) > 0) {
-        zsw_watchface_dropdown_ui_set_music_info(last_music_info.track_name, last_music_info.artist);
-    }
+    set_music_info();
 }
 
 static void general_work(struct k_work *item)
@@ -365,7 +375,7 @@ static void update_ui_from_event(struct k_work *item)
         } else if (last_data_update_type == BLE_COMM_DATA_TYPE_SET_TIME) {
             k_work_reschedule(&date_work.work, K_NO_WAIT);
         } else if (last_data_update_type == BLE_COMM_DATA_TYPE_MUSIC_INFO) {
-            zsw_watchface_dropdown_ui_set_music_info(last_music_info.track_name, last_music_info.artist);
+            set_music_info();
         }
         return;
     }
@@ -379,7 +389,7 @@ static void zbus_ble_comm_data_callback(const struct zbus_channel *chan)
         memcpy(&last_weather_data, &event->data.data.weather, sizeof(event->data.data.weather));
     }
     if (event->data.type == BLE_COMM_DATA_TYPE_MUSIC_INFO) {
-        memcpy(&last_music_info, &event->data.data.music_info, sizeof(event->data.data.music_info));
+        ble_comm_music_info_copy(&last_music_info, &event->data.data.music_info);
     }
     if (running && !is_suspended) {
         k_work_submit(&update_ui_work);
@@ -16,6 +16,7 @@ LOG_MODULE_REGISTER(weather_app, LOG_LEVEL_DBG);
 #define HTTP_REQUEST_URL_FMT "https://api.open-meteo.com/v1/forecast?latitude=%f&longitude=%f&current=wind_speed_10m,temperature_2m,apparent_temperature,weather_code&daily=weather_code,temperature_2m_max,temperature_2m_min,apparent_temperature_max,apparent_temperature_min,precipitation_sum,rain_sum,precipitation_probability_max&wind_speed_unit=ms&timezone=auto&forecast_days=%d"
 
 #define MAX_GPS_AGED_TIME_MS 30 * 60 * 1000
+#define HTTP_RESPONSE_MAX_SIZE 2048
 
 // Functions needed for all applications
 static void weather_app_start(lv_obj_t *root, lv_group_t *group);
@@ -33,6 +34,8 @@ static uint64_t last_update_gps_time;
 static uint64_t last_update_weather_time;
 static double last_lat;
 static double last_lon;
+static bool request_pending;
+static char http_response[HTTP_RESPONSE_MAX_SIZE];
 
 static application_t app = {
     .name = "Weather",
@@ -41,13 +44,14 @@ static application_t app = {
     .stop_func = weather_app_stop
 };
 
-static void http_rsp_cb(ble_http_status_code_t status, char *response)
+static void http_rsp_cb(ble_http_status_code_t status, char *response, size_t len, void *user_data)
 {
     zsw_timeval_t time_now;
     weather_ui_current_weather_data_t current_weather;
     weather_ui_forecast_data_t forecasts[WEATHER_UI_NUM_FORECASTS];
     char *days[] = { "SUN", "MON", "TUE", "WED", "THU", "FRI", "SAT"};
 
+    request_pending = false;
     if (!active) {
         return;
     }
@@ -89,15 +93,26 @@ static void http_rsp_cb(ble_http_status_code_t status, char *response)
         last_update_weather_time = k_uptime_get();
         ble_comm_request_gps_status(false);
     } else {
-        LOG_ERR("HTTP request failed\n");
+        LOG_ERR("HTTP request failed: %d\n", status);
     }
 }
 
 static void fetch_weather_data(double lat, double lon)
 {
     char weather_url[512];
+    zsw_ble_http_request_t request = {
+        .buf = http_response,
+        .buf_size = sizeof(http_response),
+        .on_done = http_rsp_cb,
+    };
+
+    // The response buffer is shared, wait for the pending request.
+    if (request_pending) {
+        return;
+    }
+
     snprintf(weather_url, sizeof(weather_url), HTTP_REQUEST_URL_FMT, lat, lon, WEATHER_UI_NUM_FORECASTS);
-    zsw_ble_http_get(weather_url, http_rsp_cb);
+    request_pending = zsw_ble_http_get(weather_url, &request) == 0;
     // TODO Handle if HTTP requests are not enabled or supported on phone.
 }
 
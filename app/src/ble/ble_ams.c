@@ -14,6 +14,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <zephyr/logging/log.h>
 #include <zephyr/bluetooth/bluetooth.h>
@@ -54,6 +55,9 @@ static const enum bt_ams_track_attribute_id entity_update_track[] = {
 
 static struct bt_ams_client ams_c;
 static char msg_buff[MAX_MUSIC_FIELD_LENGTH + 1];
+// Artist and duration arrive before the title, which completes the music info.
+static char music_artist[MAX_MUSIC_FIELD_LENGTH + 1];
+static int music_duration;
 static struct bt_conn *current_conn;
 
 static void ble_ams_delayed_write_handle(struct k_work *item);
@@ -169,30 +173,39 @@ static void notify_eu_cb(struct bt_ams_client *ams_c,
         msg_buff[notif->len] = '\0';
         LOG_DBG("AMS EU: %s %s", str_hex, msg_buff);
 
-        static struct ble_data_event evt_music_inf = {0};
-
         if (notif->ent_attr.entity == BT_AMS_ENTITY_ID_TRACK &&
             attr_val == BT_AMS_TRACK_ATTRIBUTE_ID_ARTIST) {
-            evt_music_inf.data.type = BLE_COMM_DATA_TYPE_MUSIC_INFO;
-            memcpy(&evt_music_inf.data.data.music_info.artist, msg_buff, notif->len);
+            strcpy(music_artist, msg_buff);
         }
 
         if (notif->ent_attr.entity == BT_AMS_ENTITY_ID_TRACK &&
             attr_val == BT_AMS_TRACK_ATTRIBUTE_ID_DURATION) {
-            evt_music_inf.data.type = BLE_COMM_DATA_TYPE_MUSIC_INFO;
             // A string containing the floating point value of the total duration of the track in seconds.
-            evt_music_inf.data.data.music_info.duration = (int)atof(msg_buff);
+            music_duration = (int)atof(msg_buff);
         }
 
         if (notif->ent_attr.entity == BT_AMS_ENTITY_ID_TRACK &&
             attr_val == BT_AMS_TRACK_ATTRIBUTE_ID_TITLE) {
-            evt_music_inf.data.type = BLE_COMM_DATA_TYPE_MUSIC_INFO;
-            memcpy(&evt_music_inf.data.data.music_info.track_name, msg_buff, notif->len);
-
-            // Only publish when all music information is received, otherwise values are overwritten
-            zbus_chan_pub(&ble_comm_data_chan, &evt_music_inf, K_MSEC(250));
+            struct ble_data_event evt_music_inf = {0};
+            struct net_buf *buf;
+
+            buf = ble_comm_buf_alloc(strlen(music_artist) + 1 + notif->len + 1 + 1);
+            if (buf != NULL) {
+                evt_music_inf.data.type = BLE_COMM_DATA_TYPE_MUSIC_INFO;
+                evt_music_inf.data.data.music_info.buf = buf;
+                evt_music_inf.data.data.music_info.artist = ble_comm_buf_add_str(buf, music_artist,
+                                                                                 strlen(music_artist));
+                evt_music_inf.data.data.music_info.album = ble_comm_buf_add_str(buf, "", 0);
+                evt_music_inf.data.data.music_info.track_name = ble_comm_buf_add_str(buf, msg_buff, notif->len);
+                evt_music_inf.data.data.music_info.duration = music_duration;
+
+                // Only publish when all music information is received, otherwise values are overwritten
+                zbus_chan_pub(&ble_comm_data_chan, &evt_music_inf, K_MSEC(250));
+                net_buf_unref(buf);
+            }
 
-            memset(&evt_music_inf, 0, sizeof(evt_music_inf));
+            music_artist[0] = '\0';
+            music_duration = 0;
         }
 
         if (notif->ent_attr.entity == BT_AMS_ENTITY_ID_PLAYER &&
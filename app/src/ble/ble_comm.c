@@ -25,6 +25,10 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <zephyr/zbus/zbus.h>
+#include <zephyr/sys/ring_buffer.h>
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif
 
 #include "ui/zsw_ui.h"
 #include "gadgetbridge/ble_gadgetbridge.h"
@@ -42,6 +46,8 @@ static void ble_connected(struct bt_conn *conn, uint8_t err);
 static void ble_disconnected(struct bt_conn *conn, uint8_t reason);
 static void param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency, uint16_t timeout);
 static void bt_receive_cb(struct bt_conn *conn, const uint8_t *const data, uint16_t len);
+static void bt_sent_cb(struct bt_conn *conn);
+static void tx_work_handler(struct k_work *item);
 static void update_conn_interval_slow_handler(struct k_work *item);
 static void update_conn_interval_short_handler(struct k_work *item);
 
@@ -68,6 +74,7 @@ static const struct bt_data ad_nus[] = {
 
 K_WORK_DELAYABLE_DEFINE(conn_interval_slow_work, update_conn_interval_slow_handler);
 K_WORK_DELAYABLE_DEFINE(conn_interval_fast_work, update_conn_interval_short_handler);
+K_WORK_DELAYABLE_DEFINE(tx_work, tx_work_handler);
 
 ZBUS_CHAN_DECLARE(ble_comm_data_chan);
 ZBUS_CHAN_DECLARE(music_control_data_chan);
@@ -79,8 +86,19 @@ static int pairing_enabled;
 
 static struct ble_transport_cb ble_transport_callbacks = {
     .data_receive = bt_receive_cb,
+    .data_sent = bt_sent_cb,
 };
 
+NET_BUF_POOL_VAR_DEFINE(ble_comm_buf_pool, CONFIG_ZSW_BLE_COMM_BUF_COUNT, CONFIG_ZSW_BLE_COMM_BUF_POOL_SIZE, 0, NULL);
+static struct k_spinlock music_info_lock;
+
+// Data waiting to be sent to the phone, protected by tx_mutex.
+RING_BUF_DECLARE(tx_ring_buf, CONFIG_ZSW_BLE_COMM_TX_BUF_SIZE);
+static K_MUTEX_DEFINE(tx_mutex);
+static atomic_t tx_in_flight;
+static ble_comm_tx_stats_t tx_stats;
+static int64_t tx_busy_start_ms;
+
 static void auth_cancel(struct bt_conn *conn)
 {
     LOG_ERR("Pairing cancelled");
@@ -173,10 +191,90 @@ int ble_comm_init(void)
 
 int ble_comm_send(uint8_t *data, uint16_t len)
 {
-    if (len > max_send_len) {
-        return -EMSGSIZE;
+    int ret = 0;
+
+    k_mutex_lock(&tx_mutex, K_FOREVER);
+    if (!ble_transport_is_subscribed(current_conn)) {
+        ret = -EINVAL;
+    } else if (ring_buf_space_get(&tx_ring_buf) < len) {
+        tx_stats.rejected++;
+        ret = -ENOMEM;
+    } else {
+        if (ring_buf_is_empty(&tx_ring_buf)) {
+            tx_busy_start_ms = k_uptime_get();
+        }
+        ring_buf_put(&tx_ring_buf, data, len);
+        tx_stats.messages++;
+        tx_stats.max_queued = MAX(tx_stats.max_queued, ring_buf_size_get(&tx_ring_buf));
+    }
+    k_mutex_unlock(&tx_mutex);
+
+    if (ret == 0) {
+        k_work_reschedule(&tx_work, K_NO_WAIT);
+    }
+
+    return ret;
+}
+
+void ble_comm_get_tx_stats(ble_comm_tx_stats_t *stats)
+{
+    k_mutex_lock(&tx_mutex, K_FOREVER);
+    *stats = tx_stats;
+    stats->queued = ring_buf_size_get(&tx_ring_buf);
+    stats->in_flight = atomic_get(&tx_in_flight);
+    k_mutex_unlock(&tx_mutex);
+}
+
+struct net_buf *ble_comm_buf_alloc(size_t size)
+{
+    struct net_buf *buf;
+
+    buf = net_buf_alloc_len(&ble_comm_buf_pool, size, K_MSEC(100));
+    if (buf == NULL) {
+        LOG_WRN("No event buffer for %d bytes", size);
     }
-    return ble_transport_send(current_conn, data, len);
+
+    return buf;
+}
+
+const char *ble_comm_buf_add_str(struct net_buf *buf, const char *str, size_t len)
+{
+    char *dst;
+
+    if (net_buf_tailroom(buf) == 0) {
+        return "";
+    }
+
+    len = MIN(len, net_buf_tailroom(buf) - 1);
+    dst = net_buf_add(buf, len + 1);
+    memcpy(dst, str, len);
+    dst[len] = '\0';
+
+    return dst;
+}
+
+void ble_comm_music_info_copy(ble_comm_music_info_t *dst, const ble_comm_music_info_t *src)
+{
+    struct net_buf *old_buf;
+    k_spinlock_key_t key = k_spin_lock(&music_info_lock);
+
+    old_buf = dst->buf;
+    *dst = *src;
+    if (dst->buf) {
+        net_buf_ref(dst->buf);
+    }
+    k_spin_unlock(&music_info_lock, key);
+
+    if (old_buf) {
+        net_buf_unref(old_buf);
+    }
+}
+
+void ble_comm_music_info_release(ble_comm_music_info_t *info)
+{
+    ble_comm_music_info_t empty = { 0 };
+
+    ble_comm_music_info_copy(info, &empty);
 }
 
 void ble_comm_set_pairable(bool pairable)
@@ -276,6 +374,72 @@ static void update_conn_interval_short_handler(struct k_work *item)
     }
 }
 
+static void tx_queue_flush(void)
+{
+    if (!ring_buf_is_empty(&tx_ring_buf)) {
+        tx_stats.busy_ms += k_uptime_get() - tx_busy_start_ms;
+        tx_stats.dropped += ring_buf_size_get(&tx_ring_buf);
+        ring_buf_reset(&tx_ring_buf);
+    }
+}
+
+static void tx_work_handler(struct k_work *item)
+{
+    // Only accessed from the system workqueue.
+    static uint8_t buf[CONFIG_BT_L2CAP_TX_MTU - 3];
+    uint32_t len;
+    int ret;
+
+    k_mutex_lock(&tx_mutex, K_FOREVER);
+    while (current_conn != NULL && atomic_get(&tx_in_flight) < CONFIG_ZSW_BLE_COMM_TX_MAX_IN_FLIGHT) {
+        // The Gadgetbridge protocol is a stream of newline terminated messages, so queued messages
+        // are coalesced into as few notifications as possible and may be split anywhere.
+        len = ring_buf_peek(&tx_ring_buf, buf, MIN(max_send_len, sizeof(buf)));
+        if (len == 0) {
+            break;
+        }
+
+        atomic_inc(&tx_in_flight);
+        ret = ble_transport_send(current_conn, buf, len);
+        if (ret != 0) {
+            atomic_dec(&tx_in_flight);
+            if (ret == -ENOMEM || ret == -ENOBUFS) {
+                // Out of TX buffers, retried when a notification in flight is sent or after a short delay.
+                if (atomic_get(&tx_in_flight) == 0) {
+                    k_work_schedule(&tx_work, K_MSEC(10));
+                }
+            } else {
+                LOG_WRN("Failed sending, dropping queued data: %d", ret);
+                tx_queue_flush();
+            }
+            break;
+        }
+
+        ring_buf_get(&tx_ring_buf, NULL, len);
+        tx_stats.notifications++;
+        tx_stats.bytes_sent += len;
+        if (ring_buf_is_empty(&tx_ring_buf)) {
+            tx_stats.busy_ms += k_uptime_get() - tx_busy_start_ms;
+        }
+    }
+    k_mutex_unlock(&tx_mutex);
+}
+
+static void bt_sent_cb(struct bt_conn *conn)
+{
+    atomic_val_t in_flight;
+
+    // Callbacks for notifications from before a disconnect may come after the counter was cleared.
+    do {
+        in_flight = atomic_get(&tx_in_flight);
+        if (in_flight == 0) {
+            return;
+        }
+    } while (!atomic_cas(&tx_in_flight, in_flight, in_flight - 1));
+
+    k_work_reschedule(&tx_work, K_NO_WAIT);
+}
+
 static void mtu_exchange_cb(struct bt_conn *conn, uint8_t err, struct bt_gatt_exchange_params *params)
 {
     if (!err) {
@@ -344,8 +508,12 @@ static void ble_disconnected(struct bt_conn *conn, uint8_t reason)
 
     if (current_conn) {
         k_work_cancel_delayable(&conn_interval_slow_work);
+        k_mutex_lock(&tx_mutex, K_FOREVER);
+        tx_queue_flush();
+        atomic_clear(&tx_in_flight);
         bt_conn_unref(current_conn);
         current_conn = NULL;
+        k_mutex_unlock(&tx_mutex);
     }
 }
 
@@ -359,4 +527,28 @@ static void bt_receive_cb(struct bt_conn *conn, const uint8_t *const data, uint1
     LOG_HEXDUMP_DBG(data, len, "RX");
 
     ble_gadgetbridge_input(data, len);
-}
\ No newline at end of file
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_tx_stats(const struct shell *sh, size_t argc, char **argv)
+{
+    ble_comm_tx_stats_t stats;
+
+    ble_comm_get_tx_stats(&stats);
+
+    shell_print(sh, "Queued: %u bytes (max %u of %u), in flight: %u", stats.queued, stats.max_queued,
+                CONFIG_ZSW_BLE_COMM_TX_BUF_SIZE, stats.in_flight);
+    shell_print(sh, "Messages: %u, rejected: %u, dropped: %u bytes", stats.messages, stats.rejected, stats.dropped);
+    shell_print(sh, "Sent: %u bytes in %u notifications, %u bytes/s while busy", stats.bytes_sent,
+                stats.notifications, stats.busy_ms ? (uint32_t)((uint64_t)stats.bytes_sent * 1000 / stats.busy_ms) : 0);
+
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_ble_comm,
+                               SHELL_CMD(tx_stats, NULL, "Print phone TX queue statistics", cmd_tx_stats),
+                               SHELL_SUBCMD_SET_END
+                              );
+
+SHELL_CMD_REGISTER(ble_comm, &sub_ble_comm, "BLE phone communication", NULL);
+#endif
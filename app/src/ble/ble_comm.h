@@ -18,6 +18,7 @@
 #pragma once
 
 #include <zephyr/kernel.h>
+#include <zephyr/net/buf.h>
 
 #define MAX_MUSIC_FIELD_LENGTH          100
 #define MAX_HTTP_FIELD_LENGTH           2000
@@ -69,9 +70,11 @@ typedef struct ble_comm_weather {
 } ble_comm_weather_t;
 
 typedef struct ble_comm_music_info {
-    char artist[MAX_MUSIC_FIELD_LENGTH + 1];
-    char album[MAX_MUSIC_FIELD_LENGTH + 1];
-    char track_name[MAX_MUSIC_FIELD_LENGTH + 1];
+    // Holds the strings below, use ble_comm_music_info_copy to keep them after the event.
+    struct net_buf *buf;
+    const char *artist;
+    const char *album;
+    const char *track_name;
     int duration;
     int track_count;
     int track_num;
@@ -89,8 +92,13 @@ typedef struct ble_comm_remote_control {
 } ble_comm_remote_control_t;
 
 typedef struct ble_comm_http_response {
-    char err[MAX_HTTP_FIELD_LENGTH + 1];
-    char response[MAX_HTTP_FIELD_LENGTH + 1];
+    // Holds the strings below, one of err and response is empty. NULL for a response received in chunks,
+    // then the strings are only valid during the callback.
+    struct net_buf *buf;
+    const char *err;
+    const char *response;
+    uint16_t response_len;
+    bool more;              // More chunks of the response follow
     int id;
 } ble_comm_http_response_t;
 
@@ -123,18 +131,64 @@ typedef struct ble_comm_cb_data {
 
 typedef void(*on_data_cb_t)(ble_comm_cb_data_t *data);
 
+typedef struct ble_comm_tx_stats {
+    uint32_t queued;            // Bytes in the TX queue
+    uint32_t max_queued;        // Max bytes in the TX queue
+    uint32_t in_flight;         // Notifications waiting to be sent by the BLE stack
+    uint32_t messages;          // Successful ble_comm_send calls
+    uint32_t rejected;          // ble_comm_send calls rejected because the TX queue was full
+    uint32_t dropped;           // Queued bytes dropped on disconnect or send failure
+    uint32_t notifications;     // Notifications sent
+    uint32_t bytes_sent;
+    uint32_t busy_ms;           // Time with data in the TX queue, bytes_sent / busy_ms is the throughput
+} ble_comm_tx_stats_t;
+
 /** @brief
  *  @return 0 when successful
 */
 int ble_comm_init(void);
 
-/** @brief
+/** @brief Queue data to be sent to the phone. The data is copied and sent in notifications of up to MTU - 3 bytes.
  *  @param data
  *  @param len
- *  @return     0 when successful
+ *  @return     0 when queued, -EINVAL if not connected or notifications not enabled, -ENOMEM if the TX queue is full
 */
 int ble_comm_send(uint8_t *data, uint16_t len);
 
+/** @brief Get statistics for the data sent with ble_comm_send.
+ *  @param stats
+*/
+void ble_comm_get_tx_stats(ble_comm_tx_stats_t *stats);
+
+/** @brief Allocate a buffer from the shared pool for a large event payload. The zbus listeners run during
+ *         zbus_chan_pub, so the publisher releases the buffer with net_buf_unref after publishing.
+ *         A listener that keeps the payload after returning takes its own reference with net_buf_ref.
+ *  @param size Number of bytes needed
+ *  @return     The buffer, NULL if the pool is exhausted
+*/
+struct net_buf *ble_comm_buf_alloc(size_t size);
+
+/** @brief Append a null terminated copy of a string to a buffer from ble_comm_buf_alloc, truncated if it does not fit.
+ *  @param buf
+ *  @param str
+ *  @param len  Length of str
+ *  @return     The copy in buf
+*/
+const char *ble_comm_buf_add_str(struct net_buf *buf, const char *str, size_t len);
+
+/** @brief Copy music info and take a reference to its strings, the strings previously in dst are released.
+ *         Safe to use while another thread copies to src, so a listener can copy to a static ble_comm_music_info_t
+ *         that the UI takes a copy of.
+ *  @param dst
+ *  @param src
+*/
+void ble_comm_music_info_copy(ble_comm_music_info_t *dst, const ble_comm_music_info_t *src);
+
+/** @brief Release the strings in music info taken with ble_comm_music_info_copy.
+ *  @param info
+*/
+void ble_comm_music_info_release(ble_comm_music_info_t *info);
+
 /** @brief
  *  @param pairable
  *  @return         0 when successful
@@ -2,16 +2,24 @@
 #include <zephyr/kernel.h>
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/zbus/zbus.h>
 #include <events/ble_event.h>
-#include <cJSON.h>
 
 LOG_MODULE_REGISTER(ble_http, LOG_LEVEL_DBG);
 
 #define GB_HTTP_REQUEST_FMT "{\"t\":\"http\", \"url\":\"%s\", id:\"%d\"} \n"
 
-#define HTTP_TIMEOUT_SECONDS 5
+#define HTTP_TIMEOUT_MS     5000
+
+typedef struct ble_http_pending {
+    zsw_ble_http_request_t request;
+    int id;                 // 0 when the slot is free
+    int64_t deadline_ms;
+    size_t len;             // Bytes written to request.buf
+    bool truncated;
+} ble_http_pending_t;
 
 static void zbus_ble_comm_data_callback(const struct zbus_channel *chan);
 static void ble_http_timeout_handler(struct k_work *work);
@@ -20,84 +28,167 @@ ZBUS_LISTENER_DEFINE(ble_http_lis, zbus_ble_comm_data_callback);
 ZBUS_CHAN_DECLARE(ble_comm_data_chan);
 ZBUS_CHAN_ADD_OBS(ble_comm_data_chan, ble_http_lis, 1);
 
-static bool request_pending;
+static ble_http_pending_t pending[CONFIG_ZSW_BLE_HTTP_MAX_REQUESTS];
 static uint16_t request_id;
-static ble_http_callback ble_http_cb;
+// Recursive, so callbacks can make new requests.
+static K_MUTEX_DEFINE(http_mutex);
 
 K_WORK_DELAYABLE_DEFINE(ble_http_timeout_work, ble_http_timeout_handler);
 
+static ble_http_pending_t *find_pending(int id)
+{
+    for (int i = 0; i < ARRAY_SIZE(pending); i++) {
+        if (pending[i].id != 0 && pending[i].id == id) {
+            return &pending[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void schedule_timeout(void)
+{
+    int64_t next_deadline_ms = INT64_MAX;
+
+    for (int i = 0; i < ARRAY_SIZE(pending); i++) {
+        if (pending[i].id != 0) {
+            next_deadline_ms = MIN(next_deadline_ms, pending[i].deadline_ms);
+        }
+    }
+
+    if (next_deadline_ms == INT64_MAX) {
+        k_work_cancel_delayable(&ble_http_timeout_work);
+    } else {
+        k_work_reschedule(&ble_http_timeout_work, K_MSEC(MAX(next_deadline_ms - k_uptime_get(), 0)));
+    }
+}
+
+static void complete(ble_http_pending_t *req, ble_http_status_code_t status)
+{
+    zsw_ble_http_request_t request = req->request;
+    char *response = NULL;
+
+    if ((status == BLE_HTTP_STATUS_OK || status == BLE_HTTP_STATUS_TOO_LARGE) && request.on_data == NULL) {
+        response = request.buf;
+    }
+
+    // Free the slot first, so the callback can make a new request.
+    req->id = 0;
+    request.on_done(status, response, req->len, request.user_data);
+}
+
 static void ble_http_timeout_handler(struct k_work *work)
 {
-    LOG_WRN("HTTP Timeout");
-    ble_http_cb(BLE_HTTP_STATUS_TIMEOUT, NULL);
+    int64_t now = k_uptime_get();
+
+    k_mutex_lock(&http_mutex, K_FOREVER);
+    for (int i = 0; i < ARRAY_SIZE(pending); i++) {
+        if (pending[i].id != 0 && pending[i].deadline_ms <= now) {
+            LOG_WRN("HTTP Timeout, id: %d", pending[i].id);
+            complete(&pending[i], BLE_HTTP_STATUS_TIMEOUT);
+        }
+    }
+    schedule_timeout();
+    k_mutex_unlock(&http_mutex);
+}
+
+static void append_response(ble_http_pending_t *req, const char *data, size_t len)
+{
+    size_t copy_len;
+
+    if (req->request.on_data) {
+        req->request.on_data(data, len, req->request.user_data);
+        return;
+    }
+
+    copy_len = MIN(len, req->request.buf_size - 1 - req->len);
+    memcpy(&req->request.buf[req->len], data, copy_len);
+    req->len += copy_len;
+    req->request.buf[req->len] = '\0';
+    req->truncated |= copy_len < len;
 }
 
 static void zbus_ble_comm_data_callback(const struct zbus_channel *chan)
 {
     const struct ble_data_event *event = zbus_chan_const_msg(chan);
+    const ble_comm_http_response_t *response = &event->data.data.http_response;
+    ble_http_pending_t *req;
 
-    if (event->data.type == BLE_COMM_DATA_TYPE_HTTP) {
-        if (event->data.data.http_response.id != request_id) {
-            LOG_WRN("Not the expected response ID, was: %d, expected: %d", event->data.data.http_response.id, request_id);
-            return;
-        }
-        struct k_work_sync sync;
-        k_work_cancel_delayable_sync(&ble_http_timeout_work, &sync);
-        request_pending = false;
-
-        if (strlen(event->data.data.http_response.err) > 0) {
-            LOG_WRN("HTTP request failed: %s", event->data.data.http_response.err);
-        } else if (strlen(event->data.data.http_response.response) > 0) {
-            char *fixed_rsp = k_malloc(strlen(event->data.data.http_response.response) + 1);
-            __ASSERT(fixed_rsp, "Failed to allocate memory for fixed_rsp");
-            // As the response from Gadgetbride contains two characters like this[\\, "] instead of just one character [\"],
-            // we need to remove them for it to be avalid JSON accepted by cJSON
-            int i;
-            int j;
-            for (i = 0, j = 0; i < strlen(event->data.data.http_response.response) - 1;) {
-                if (event->data.data.http_response.response[i] == '\\' && event->data.data.http_response.response[i + 1] == '"') {
-                    fixed_rsp[j] = '\"';
-                    j++;
-                    i += 2;
-                } else {
-                    fixed_rsp[j] = event->data.data.http_response.response[i];
-                    j++;
-                    i++;
-                }
-            }
-            fixed_rsp[j - 1] = '\0'; // Remove the last " as it belongs not to the data
-            ble_http_cb(BLE_HTTP_STATUS_OK, fixed_rsp);
-            k_free(fixed_rsp);
+    if (event->data.type != BLE_COMM_DATA_TYPE_HTTP) {
+        return;
+    }
+
+    k_mutex_lock(&http_mutex, K_FOREVER);
+    req = find_pending(response->id);
+    if (req == NULL) {
+        LOG_WRN("Response for unknown request ID: %d", response->id);
+    } else if (strlen(response->err) > 0) {
+        LOG_WRN("HTTP request failed: %s", response->err);
+        complete(req, BLE_HTTP_STATUS_ERROR);
+    } else {
+        // Gadgetbridge sends the response as an escaped JSON string, it's already unescaped when parsed.
+        append_response(req, response->response, response->response_len);
+        if (response->more) {
+            req->deadline_ms = k_uptime_get() + req->request.timeout_ms;
+        } else {
+            complete(req, req->truncated ? BLE_HTTP_STATUS_TOO_LARGE : BLE_HTTP_STATUS_OK);
         }
     }
+    schedule_timeout();
+    k_mutex_unlock(&http_mutex);
 }
 
-int zsw_ble_http_get(char *url, ble_http_callback cb)
+int zsw_ble_http_get(const char *url, const zsw_ble_http_request_t *request)
 {
     int ret;
-    char *request;
+    char *request_str;
+    ble_http_pending_t *req = NULL;
+
+    __ASSERT(request->on_done, "on_done is required");
+    __ASSERT(request->on_data || (request->buf && request->buf_size > 0), "buf or on_data is required");
+
+    k_mutex_lock(&http_mutex, K_FOREVER);
+    for (int i = 0; i < ARRAY_SIZE(pending) && req == NULL; i++) {
+        if (pending[i].id == 0) {
+            req = &pending[i];
+        }
+    }
 
-    if (request_pending) {
-        // TODO implement a queue for requests
+    if (req == NULL) {
+        k_mutex_unlock(&http_mutex);
         return -EBUSY;
     }
 
-    request_id++;
+    // 0 marks a free slot
+    if (++request_id == 0) {
+        request_id = 1;
+    }
 
-    request = k_malloc(strlen(url) + strlen(GB_HTTP_REQUEST_FMT) + 1);
-    __ASSERT(request, "Failed to allocate memory for request URL");
+    request_str = k_malloc(strlen(url) + strlen(GB_HTTP_REQUEST_FMT) + 1);
+    __ASSERT(request_str, "Failed to allocate memory for request URL");
 
-    snprintf(request, strlen(url) + strlen(GB_HTTP_REQUEST_FMT) + 1, GB_HTTP_REQUEST_FMT, url, request_id);
-    ret = ble_comm_send(request, strlen(request));
-    k_free(request);
+    snprintf(request_str, strlen(url) + strlen(GB_HTTP_REQUEST_FMT) + 1, GB_HTTP_REQUEST_FMT, url, request_id);
+    ret = ble_comm_send(request_str, strlen(request_str));
+    k_free(request_str);
     if (ret != 0) {
+        k_mutex_unlock(&http_mutex);
         return ret;
     }
 
-    ble_http_cb = cb;
-    request_pending = true;
+    req->request = *request;
+    if (req->request.timeout_ms == 0) {
+        req->request.timeout_ms = HTTP_TIMEOUT_MS;
+    }
+    if (req->request.buf) {
+        req->request.buf[0] = '\0';
+    }
+    req->id = request_id;
+    req->len = 0;
+    req->truncated = false;
+    req->deadline_ms = k_uptime_get() + req->request.timeout_ms;
 
-    k_work_schedule(&ble_http_timeout_work, K_SECONDS(HTTP_TIMEOUT_SECONDS));
+    schedule_timeout();
+    k_mutex_unlock(&http_mutex);
 
     return 0;
-}
\ No newline at end of file
+}
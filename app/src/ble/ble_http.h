@@ -1,32 +1,60 @@
+#pragma once
+
+#include <stddef.h>
 #include <stdint.h>
-#include "cJSON.h"
 
 typedef enum {
     BLE_HTTP_STATUS_OK,
     BLE_HTTP_STATUS_TIMEOUT,
     BLE_HTTP_STATUS_BUSY,
+    BLE_HTTP_STATUS_ERROR,
+    BLE_HTTP_STATUS_TOO_LARGE,
 } ble_http_status_code_t;
 
 /**
- * @brief Callback function for HTTP GET requests.
+ * @brief Callback for each part of a streamed HTTP response.
  *
- * This callback function is invoked when an HTTP GET request has been completed.
+ * @param data      Part of the response, unescaped and null terminated. Only valid during the callback and may
+ *                  end in the middle of a UTF-8 sequence.
+ * @param len       Length of data.
+ * @param user_data user_data from the request.
+ */
+typedef void (*ble_http_data_callback)(const char *data, size_t len, void *user_data);
+
+/**
+ * @brief Callback for a completed HTTP GET request.
  *
- * @param status    The status of the HTTP GET request.
- * @param response  The response data.
+ * @param status    BLE_HTTP_STATUS_OK when the whole response was received. BLE_HTTP_STATUS_TOO_LARGE when
+ *                  it was truncated to fit in the buffer.
+ * @param response  The response in the request buffer, null terminated. NULL when streamed or on error.
+ * @param len       Length of the response in the buffer.
+ * @param user_data user_data from the request.
  */
-typedef void (*ble_http_callback)(ble_http_status_code_t status, char *response);
+typedef void (*ble_http_callback)(ble_http_status_code_t status, char *response, size_t len, void *user_data);
+
+typedef struct zsw_ble_http_request {
+    // The response is unescaped into buf while received. Not used when on_data is set.
+    char *buf;
+    size_t buf_size;
+    // Optional, called with the response while received instead of filling buf.
+    ble_http_data_callback on_data;
+    // Called once when the request completes, fails or times out.
+    ble_http_callback on_done;
+    void *user_data;
+    // Max time without receiving any of the response, 0 for the default.
+    uint32_t timeout_ms;
+} zsw_ble_http_request_t;
 
 /**
- * @brief Sends an HTTP GET request to the specified URL.
+ * @brief Sends an HTTP GET request to the specified URL through the phone.
  *
- * This function sends an HTTP GET request to the specified URL and invokes the provided callback function
- * when the response is received. The callback function is passed the status code and the response data in
- * JSON format. The cJSON object parameter will be deleted automatically after the callback function returns.
- * Hence it shall not attempt to deleted in the callback.
+ * Up to CONFIG_ZSW_BLE_HTTP_MAX_REQUESTS requests can be pending at the same time. The request is copied,
+ * but buf must stay valid until on_done is called. on_data and on_done are called from the Gadgetbridge work
+ * queue thread, which publishes the responses on the BLE data zbus channel. When a request times out, on_done
+ * is called from the system work queue instead.
  *
  * @param url The URL to send the GET request to.
- * @param cb The callback function to invoke when the response is received.
- * @return Returns 0 on success, or a negative error code on failure.
+ * @param request Where to put the response and the callbacks.
+ * @return 0 on success, -EBUSY if too many requests are pending, or the error from ble_comm_send.
  */
-int zsw_ble_http_get(char *url, ble_http_callback cb);
\ No newline at end of file
+int zsw_ble_http_get(const char *url, const zsw_ble_http_request_t *request);
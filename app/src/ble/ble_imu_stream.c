@@ -0,0 +1,405 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Streams every accelerometer and gyroscope sample from the IMU FIFO over an L2CAP
+ * connection oriented channel, see scripts/zswatch_ble_control.py for a receiver.
+ *
+ * Every SDU is independent, little endian:
+ *   uint16 sequence number, increased for every SDU sent
+ *   uint8  number of samples
+ *   uint8  flags, STREAM_FLAG_*
+ *   uint32 uptime in us of the first sample (lower 32 bits)
+ *   uint32 time between samples in us
+ *   int16  accel x,y,z in mg and gyro x,y,z in 0.1 deg/s of the first sample
+ *   For every following sample the 6 differences to the previous sample, zigzag varint encoded.
+ *
+ * A central writes a uint16 with the wanted sample rate in Hz to the channel to change the rate.
+ * The IMU runs faster when another user, like sensor fusion, needs a higher rate.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/l2cap.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "ble/ble_imu_stream.h"
+#include "sensors/zsw_imu.h"
+
+LOG_MODULE_REGISTER(ble_imu_stream, CONFIG_ZSW_BLE_LOG_LEVEL);
+
+#define STREAM_HEADER_LEN           12
+#define STREAM_NUM_AXES             6
+// Zigzag encoded difference of two int16 is at most 17 bits, 3 bytes as varint.
+#define STREAM_SAMPLE_MAX_LEN       (STREAM_NUM_AXES * 3)
+#define STREAM_MAX_SAMPLES          UINT8_MAX
+#define STREAM_DEFAULT_RATE_HZ      100
+
+// Samples was dropped since the previous SDU, because no buffer was free.
+#define STREAM_FLAG_SAMPLES_LOST    BIT(0)
+
+#define SENSOR_GF                   9.80665f
+
+BUILD_ASSERT(CONFIG_ZSW_IMU_STREAM_SDU_SIZE > STREAM_HEADER_LEN + STREAM_SAMPLE_MAX_LEN, "SDU size too small");
+
+static int stream_accept(struct bt_conn *conn, struct bt_l2cap_server *server, struct bt_l2cap_chan **chan);
+static void stream_connected(struct bt_l2cap_chan *chan);
+static void stream_disconnected(struct bt_l2cap_chan *chan);
+static int stream_recv(struct bt_l2cap_chan *chan, struct net_buf *buf);
+static void stream_batch_callback(const zsw_imu_batch_t *batch);
+
+NET_BUF_POOL_FIXED_DEFINE(stream_pool, CONFIG_ZSW_IMU_STREAM_BUF_COUNT,
+                          BT_L2CAP_SDU_BUF_SIZE(CONFIG_ZSW_IMU_STREAM_SDU_SIZE),
+                          CONFIG_BT_CONN_TX_USER_DATA_SIZE, NULL);
+
+static const struct bt_l2cap_chan_ops stream_chan_ops = {
+    .connected = stream_connected,
+    .disconnected = stream_disconnected,
+    .recv = stream_recv,
+};
+
+static struct bt_l2cap_le_chan stream_chan = {
+    .chan.ops = &stream_chan_ops,
+};
+
+static struct bt_l2cap_server stream_server = {
+    .psm = CONFIG_ZSW_IMU_STREAM_PSM,
+#if CONFIG_BLE_DISABLE_PAIRING_REQUIRED
+    .sec_level = BT_SECURITY_L1,
+#else
+    .sec_level = BT_SECURITY_L2,
+#endif
+    .accept = stream_accept,
+};
+
+static K_MUTEX_DEFINE(stream_mutex);
+static bool chan_in_use;
+static bool connected;
+static struct net_buf *sdu;
+static uint8_t *sdu_header;
+static uint16_t sdu_max_len;
+static uint16_t seq;
+static bool samples_lost;
+static int16_t last_sample[STREAM_NUM_AXES];
+static int64_t next_timestamp_us;
+static uint32_t sdu_period_us;
+static ble_imu_stream_stats_t stats;
+
+#ifdef CONFIG_ZSW_IMU_BATCHING
+// Rate requested from zsw_imu, 0 when none.
+static uint16_t requested_rate_hz;
+#else
+// No IMU FIFO, like on native_posix. Stream a generated pattern to test a receiver with.
+#define PATTERN_INTERVAL_MS         100
+#define PATTERN_MAX_SAMPLES         (1600 * PATTERN_INTERVAL_MS / 1000)
+
+static void pattern_timer_expiry(struct k_timer *timer);
+static void pattern_generate(struct k_work *item);
+
+K_WORK_DEFINE(pattern_work, pattern_generate);
+K_TIMER_DEFINE(pattern_timer, pattern_timer_expiry, NULL);
+
+static uint16_t pattern_rate_hz = STREAM_DEFAULT_RATE_HZ;
+static int64_t pattern_next_us;
+#endif
+
+static int16_t to_int16(float value)
+{
+    return (int16_t)CLAMP(lroundf(value), INT16_MIN, INT16_MAX);
+}
+
+static void encode_varint(struct net_buf *buf, uint32_t value)
+{
+    while (value >= 0x80) {
+        net_buf_add_u8(buf, (value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    net_buf_add_u8(buf, value);
+}
+
+static void stream_flush_locked(void)
+{
+    uint16_t len;
+    uint8_t num_samples;
+    int ret;
+
+    if (sdu == NULL) {
+        return;
+    }
+
+    len = sdu->len;
+    num_samples = sdu_header[2];
+    ret = bt_l2cap_chan_send(&stream_chan.chan, sdu);
+    if (ret < 0) {
+        LOG_DBG("bt_l2cap_chan_send err: %d", ret);
+        net_buf_unref(sdu);
+        stats.dropped++;
+    } else {
+        stats.sdus++;
+        stats.samples += num_samples;
+        stats.bytes += len;
+    }
+    sdu = NULL;
+    sdu_header = NULL;
+}
+
+static bool stream_start_sdu_locked(const int16_t *sample, int64_t timestamp_us, uint32_t period_us)
+{
+    sdu = net_buf_alloc(&stream_pool, K_NO_WAIT);
+    if (sdu == NULL) {
+        // All buffers are waiting for the radio, the central is not keeping up.
+        samples_lost = true;
+        return false;
+    }
+    net_buf_reserve(sdu, BT_L2CAP_SDU_CHAN_SEND_RESERVE);
+
+    sdu_header = net_buf_add(sdu, STREAM_HEADER_LEN);
+    sys_put_le16(seq++, &sdu_header[0]);
+    sdu_header[2] = 1;
+    sdu_header[3] = samples_lost ? STREAM_FLAG_SAMPLES_LOST : 0;
+    sys_put_le32((uint32_t)timestamp_us, &sdu_header[4]);
+    sys_put_le32(period_us, &sdu_header[8]);
+    for (int i = 0; i < STREAM_NUM_AXES; i++) {
+        net_buf_add_le16(sdu, sample[i]);
+    }
+
+    samples_lost = false;
+    sdu_period_us = period_us;
+
+    return true;
+}
+
+static void stream_add_sample_locked(const struct bmi270_fifo_frame *frame, int64_t timestamp_us, uint32_t period_us)
+{
+    int16_t sample[STREAM_NUM_AXES];
+    int32_t delta;
+
+    for (int i = 0; i < 3; i++) {
+        sample[i] = to_int16(frame->acc[i] * (1000.0f / SENSOR_GF));
+        sample[i + 3] = to_int16(frame->gyr[i] * (1800.0f / M_PI));
+    }
+
+    // The receiver calculates the time of every sample from the first, start a new SDU
+    // if the time does not follow, like after a rate change or a resync of the IMU clock.
+    if (sdu != NULL && (period_us != sdu_period_us ||
+                        llabs(timestamp_us - next_timestamp_us) > period_us / 2 ||
+                        sdu_header[2] == STREAM_MAX_SAMPLES ||
+                        sdu->len + STREAM_SAMPLE_MAX_LEN > sdu_max_len)) {
+        stream_flush_locked();
+    }
+
+    if (sdu == NULL) {
+        if (!stream_start_sdu_locked(sample, timestamp_us, period_us)) {
+            return;
+        }
+    } else {
+        for (int i = 0; i < STREAM_NUM_AXES; i++) {
+            delta = (int32_t)sample[i] - last_sample[i];
+            encode_varint(sdu, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+        }
+        sdu_header[2]++;
+    }
+
+    memcpy(last_sample, sample, sizeof(last_sample));
+    next_timestamp_us = timestamp_us + period_us;
+}
+
+static void stream_batch_callback(const zsw_imu_batch_t *batch)
+{
+    k_mutex_lock(&stream_mutex, K_FOREVER);
+    if (connected) {
+        for (int i = 0; i < batch->num_samples; i++) {
+            stream_add_sample_locked(&batch->samples[i], batch->timestamp_us + (int64_t)i * batch->period_us,
+                                     batch->period_us);
+        }
+    }
+    k_mutex_unlock(&stream_mutex);
+}
+
+#ifndef CONFIG_ZSW_IMU_BATCHING
+static void pattern_timer_expiry(struct k_timer *timer)
+{
+    k_work_submit(&pattern_work);
+}
+
+static void pattern_generate(struct k_work *item)
+{
+    static struct bmi270_fifo_frame frames[PATTERN_MAX_SAMPLES];
+    uint32_t period_us = USEC_PER_SEC / pattern_rate_hz;
+    int num_samples = MIN(PATTERN_INTERVAL_MS * pattern_rate_hz / MSEC_PER_SEC, PATTERN_MAX_SAMPLES);
+    zsw_imu_batch_t batch = {
+        .samples = frames,
+        .num_samples = num_samples,
+        .timestamp_us = pattern_next_us,
+        .period_us = period_us,
+    };
+
+    // 1 Hz sine on every axis with a different phase, 1 g and 90 deg/s amplitude.
+    for (int i = 0; i < num_samples; i++) {
+        float t = (pattern_next_us + (int64_t)i * period_us) / 1000000.0f;
+        for (int axis = 0; axis < 3; axis++) {
+            float phase = 2 * M_PI * t + axis * (2 * M_PI / 3);
+            frames[i].acc[axis] = SENSOR_GF * sinf(phase);
+            frames[i].gyr[axis] = (M_PI / 2) * cosf(phase);
+        }
+    }
+    pattern_next_us += (int64_t)num_samples * period_us;
+
+    stream_batch_callback(&batch);
+}
+#endif
+
+static int stream_set_rate(uint16_t rate_hz)
+{
+#ifdef CONFIG_ZSW_IMU_BATCHING
+    int ret;
+
+    if (rate_hz == requested_rate_hz) {
+        return 0;
+    }
+
+    // The old rate is released after the new one is requested, so the IMU is not set to another rate in between.
+    ret = zsw_imu_request_sample_rate(rate_hz);
+    if (ret == 0) {
+        if (requested_rate_hz != 0) {
+            zsw_imu_release_sample_rate(requested_rate_hz);
+        }
+        requested_rate_hz = rate_hz;
+    }
+
+    return ret;
+#else
+    if (rate_hz == 0 || rate_hz > 1600) {
+        return -EINVAL;
+    }
+    pattern_rate_hz = rate_hz;
+    return 0;
+#endif
+}
+
+static int stream_accept(struct bt_conn *conn, struct bt_l2cap_server *server, struct bt_l2cap_chan **chan)
+{
+    int ret = -ENOMEM;
+
+    k_mutex_lock(&stream_mutex, K_FOREVER);
+    if (!chan_in_use) {
+        chan_in_use = true;
+        *chan = &stream_chan.chan;
+        ret = 0;
+    }
+    k_mutex_unlock(&stream_mutex);
+
+    return ret;
+}
+
+static void stream_connected(struct bt_l2cap_chan *chan)
+{
+    struct bt_l2cap_le_chan *le_chan = BT_L2CAP_LE_CHAN(chan);
+
+    k_mutex_lock(&stream_mutex, K_FOREVER);
+    sdu_max_len = MIN(CONFIG_ZSW_IMU_STREAM_SDU_SIZE, le_chan->tx.mtu);
+    seq = 0;
+    samples_lost = false;
+    memset(&stats, 0, sizeof(stats));
+    connected = true;
+    k_mutex_unlock(&stream_mutex);
+
+    LOG_INF("IMU stream connected, SDU size %d", sdu_max_len);
+
+    stream_set_rate(CONFIG_ZSW_IMU_STREAM_RATE_HZ);
+#ifdef CONFIG_ZSW_IMU_BATCHING
+    zsw_imu_feature_enable(ZSW_IMU_FEATURE_GYRO, false);
+    zsw_imu_batch_subscribe(stream_batch_callback);
+#else
+    pattern_next_us = k_ticks_to_us_floor64(k_uptime_ticks());
+    k_timer_start(&pattern_timer, K_MSEC(PATTERN_INTERVAL_MS), K_MSEC(PATTERN_INTERVAL_MS));
+#endif
+}
+
+static void stream_disconnected(struct bt_l2cap_chan *chan)
+{
+    // Stop the producer outside of the mutex, it waits for an ongoing batch callback.
+#ifdef CONFIG_ZSW_IMU_BATCHING
+    zsw_imu_batch_unsubscribe(stream_batch_callback);
+    // Both are reference counted in zsw_imu, other users keep the gyroscope and their rate.
+    zsw_imu_feature_disable(ZSW_IMU_FEATURE_GYRO);
+    if (requested_rate_hz != 0) {
+        zsw_imu_release_sample_rate(requested_rate_hz);
+        requested_rate_hz = 0;
+    }
+#else
+    struct k_work_sync sync;
+
+    k_timer_stop(&pattern_timer);
+    k_work_cancel_sync(&pattern_work, &sync);
+    pattern_rate_hz = STREAM_DEFAULT_RATE_HZ;
+#endif
+
+    k_mutex_lock(&stream_mutex, K_FOREVER);
+    connected = false;
+    if (sdu != NULL) {
+        net_buf_unref(sdu);
+        sdu = NULL;
+        sdu_header = NULL;
+    }
+    chan_in_use = false;
+    k_mutex_unlock(&stream_mutex);
+
+    LOG_INF("IMU stream disconnected, sent %d SDUs, %d samples, %d bytes, dropped %d SDUs",
+            stats.sdus, stats.samples, stats.bytes, stats.dropped);
+}
+
+static int stream_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
+{
+    uint16_t rate_hz;
+
+    if (buf->len != sizeof(uint16_t)) {
+        LOG_WRN("Unknown command of length %d", buf->len);
+        return 0;
+    }
+
+    rate_hz = sys_get_le16(buf->data);
+    if (stream_set_rate(rate_hz) != 0) {
+        LOG_WRN("Unsupported rate %d Hz", rate_hz);
+    }
+
+    return 0;
+}
+
+void ble_imu_stream_get_stats(ble_imu_stream_stats_t *p_stats)
+{
+    k_mutex_lock(&stream_mutex, K_FOREVER);
+    memcpy(p_stats, &stats, sizeof(stats));
+    k_mutex_unlock(&stream_mutex);
+}
+
+int ble_imu_stream_init(void)
+{
+    int ret = bt_l2cap_server_register(&stream_server);
+
+    if (ret != 0) {
+        LOG_ERR("bt_l2cap_server_register err: %d", ret);
+    }
+
+    return ret;
+}
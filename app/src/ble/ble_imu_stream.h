@@ -0,0 +1,22 @@
+#pragma once
+
+#include <zephyr/kernel.h>
+
+typedef struct ble_imu_stream_stats {
+    uint32_t sdus;          // SDUs sent
+    uint32_t dropped;       // SDUs dropped because no buffer was free or the send failed
+    uint32_t samples;       // Samples in sent SDUs
+    uint32_t bytes;         // Payload bytes in sent SDUs
+} ble_imu_stream_stats_t;
+
+/**
+ * @brief Register the L2CAP server streaming accelerometer and gyroscope samples.
+ *        Streaming starts when a central connects to CONFIG_ZSW_IMU_STREAM_PSM.
+ * @return 0 on success, negative error code from bt_l2cap_server_register otherwise.
+ */
+int ble_imu_stream_init(void);
+
+/**
+ * @brief Get stats since the last channel was connected.
+ */
+void ble_imu_stream_get_stats(ble_imu_stream_stats_t *stats);
@@ -78,6 +78,18 @@ int ble_transport_init(struct ble_transport_cb *callback)
     return 0;
 }
 
+static void on_sent(struct bt_conn *conn, void *user_data)
+{
+    if (callbacks->data_sent) {
+        callbacks->data_sent(conn);
+    }
+}
+
+bool ble_transport_is_subscribed(struct bt_conn *connection)
+{
+    return connection && bt_gatt_is_subscribed(connection, &nus_service.attrs[2], BT_GATT_CCC_NOTIFY);
+}
+
 int ble_transport_send(struct bt_conn *connection, const uint8_t *data, uint16_t length)
 {
     struct bt_gatt_notify_params params = {0};
@@ -86,6 +98,7 @@ int ble_transport_send(struct bt_conn *connection, const uint8_t *data, uint16_t
     params.attr = attr;
     params.data = data;
     params.len = length;
+    params.func = on_sent;
 
     if (connection && bt_gatt_is_subscribed(connection, attr, BT_GATT_CCC_NOTIFY)) {
         return bt_gatt_notify_cb(connection, &params);
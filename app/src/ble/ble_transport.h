@@ -32,7 +32,10 @@
 
 struct ble_transport_cb {
     void (*data_receive)(struct bt_conn *connection, const uint8_t *const data, uint16_t length);
+    // Called when a notification from ble_transport_send has been sent.
+    void (*data_sent)(struct bt_conn *connection);
 };
 
 int ble_transport_init(struct ble_transport_cb *callback);
+bool ble_transport_is_subscribed(struct bt_conn *connection);
 int ble_transport_send(struct bt_conn *connection, const uint8_t *data, uint16_t length);
\ No newline at end of file
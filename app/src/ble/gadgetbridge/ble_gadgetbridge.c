@@ -1,15 +1,18 @@
-#include <zephyr/sys/base64.h>
+#include <zephyr/init.h>
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/hci.h>
+#include <zephyr/bluetooth/l2cap.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/kernel.h>
 #include <zephyr/zbus/zbus.h>
+#include <zephyr/sys/atomic.h>
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif
 #include <string.h>
-#include <ctype.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <math.h>
-#include <cJSON.h>
 
 #include "ui/zsw_ui.h"
 #include "ble/ble_comm.h"
@@ -17,19 +20,49 @@
 #include "events/ble_event.h"
 #include "events/music_event.h"
 #include "ble_gadgetbridge.h"
+#include "ble_gadgetbridge_tokenizer.h"
 
 LOG_MODULE_REGISTER(ble_gadgetbridge, CONFIG_ZSW_BLE_LOG_LEVEL);
 
-typedef enum parse_state {
-    WAIT_GB,
-    WAIT_END,
-    PARSE_STATE_DONE,
-} parse_state_t;
-
-static uint8_t num_parsed_brackets;
-static parse_state_t parse_state = WAIT_GB;
-static uint16_t parsed_data_index = 0;
+typedef struct gb_message_handler {
+    const char *type;
+    int (*handler)(gb_field_t *fields, int num_fields);
+} gb_message_handler_t;
+
+// Received fragments are queued in a single producer (BT RX thread), single consumer (parse work)
+// ring as a 16-bit length followed by the data. A length of 0 marks that fragments were dropped.
+#define RX_RING_SIZE            CONFIG_ZSW_GADGETBRIDGE_RX_BUF_SIZE
+// Data is received as writes without prepare, so a fragment is at most the ATT MTU we receive with
+// minus the opcode and handle of the write.
+#define ATT_WRITE_HDR_SIZE      3
+#define MAX_FRAGMENT_LENGTH     (BT_L2CAP_RX_MTU - ATT_WRITE_HDR_SIZE)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(RX_RING_SIZE), "CONFIG_ZSW_GADGETBRIDGE_RX_BUF_SIZE must be a power of two");
+
+static struct {
+    atomic_t queued_fragments;
+    atomic_t dropped_fragments;
+    atomic_t max_buffered_bytes;
+    uint32_t parsed_messages;
+    uint32_t dropped_messages;
+} stats;
+
+static void parse_work_handler(struct k_work *work);
+
+static K_THREAD_STACK_DEFINE(gb_work_q_stack, CONFIG_ZSW_GADGETBRIDGE_THREAD_STACK_SIZE);
+static struct k_work_q gb_work_q;
+static K_WORK_DEFINE(parse_work, parse_work_handler);
+
+static uint8_t rx_ring[RX_RING_SIZE];
+static atomic_t rx_ring_head;
+static atomic_t rx_ring_tail;
+static bool rx_overflow;
+
+static gb_tokenizer_t tokenizer;
+// Decoded keys and values of the message being received
 static uint8_t receive_buf[MAX_GB_PACKET_LENGTH];
+// Request id of the HTTP response being streamed
+static int stream_http_id;
 
 static void music_control_event_callback(const struct zbus_channel *chan);
 static void parse_time_zone(char *offset);
@@ -118,298 +151,67 @@ static void parse_time_zone(char *offset)
     }
 }
 
-static char *extract_value_str(char *key, char *data, int *value_len)
+static bool field_is(const gb_field_t *field, const char *key)
 {
-    bool base64 = false;
-    char *start;
-    char *end;
-    char *str = strstr(data, key);
-    *value_len = 0;
-    if (str == NULL) {
-        return NULL;
-    }
-    str += strlen(key);
-
-    if (strncmp(str, "atob(", strlen("atob(")) == 0) {
-        str += strlen("atob(");
-        base64 = true;
-    }
-
-    if (*str != '\"') {
-        return NULL; // Seems to be an INT?
-    }
-    str++;
-    if (*str == '\0') {
-        return NULL; // Got end of data
-    }
-    end = strstr(str, "\"");
-    if (end == NULL) {
-        return NULL; // No end of value
-    }
+    return strcmp(field->key, key) == 0;
+}
 
-    start = str;
-    if (base64) {
-        // Since the size of the decoded result is 33% smaller, the decoded result can be stored in the original text buffer
-        size_t msg_size = end - start;
-        size_t decoded_len;
-        base64_decode(str, msg_size, &decoded_len, str, msg_size);
-        *value_len = decoded_len;
-    } else {
-        *value_len = end - start;
-    }
+static int32_t field_int32(const gb_field_t *field)
+{
+    return strtol(field->value, NULL, 10);
+}
 
-    return start;
+static uint32_t field_uint32(const gb_field_t *field)
+{
+    return strtoul(field->value, NULL, 10);
 }
 
-static uint32_t extract_value_uint32(char *key, char *data)
+static void field_copy_str(const gb_field_t *field, char *dst, size_t dst_size)
 {
-    char *start;
-    char *str = strstr(data, key);
-    char *end;
-    uint32_t id;
+    size_t len = MIN(field->value_len, dst_size - 1);
 
-    if (str == NULL) {
-        return 0;
-    }
-    str += strlen(key);
-    if (!isdigit((int) * str)) {
-        return 0; // No number found
-    }
-    start = str;
-    id = strtol(str, &end, 10);
-    // TODO error checking
-    return id;
+    memcpy(dst, field->value, len);
+    dst[len] = '\0';
 }
 
-static int32_t extract_value_int32(char *key, char *data)
+static size_t field_str_size(const gb_field_t *field, size_t max_len)
 {
-    char *start;
-    char *str = strstr(data, key);
-    char *end;
-    int32_t id;
-
-    if (str == NULL) {
-        return 0;
-    }
-    str += strlen(key);
-    if (!isdigit((int) * str)) {
-        return 0; // No number found
-    }
-    start = str;
-    id = strtol(str, &end, 10);
-    // TODO error checking
-    return id;
+    return (field ? MIN(field->value_len, max_len) : 0) + 1;
 }
 
-static void convert_to_encoded_text(char *data, int len, char *out_data, int out_buf_len)
+static const char *field_add_str(struct net_buf *buf, const gb_field_t *field, size_t max_len)
 {
-    int i = 0, j = 0;
-    // https://www.utf8-chartable.de/
-    uint8_t basic_latin_utf16_to_utf8_table[0x80][3] = {
-        // utf-16 => 2 byte utf-8
-        {0x80, 0xc2, 0x80},
-        {0x81, 0xc2, 0x81},
-        {0x82, 0xc2, 0x82},
-        {0x83, 0xc2, 0x83},
-        {0x84, 0xc2, 0x84},
-        {0x85, 0xc2, 0x85},
-        {0x86, 0xc2, 0x86},
-        {0x87, 0xc2, 0x87},
-        {0x88, 0xc2, 0x88},
-        {0x89, 0xc2, 0x89},
-        {0x8A, 0xc2, 0x8a},
-        {0x8B, 0xc2, 0x8b},
-        {0x8C, 0xc2, 0x8c},
-        {0x8D, 0xc2, 0x8d},
-        {0x8E, 0xc2, 0x8e},
-        {0x8F, 0xc2, 0x8f},
-        {0x90, 0xc2, 0x90},
-        {0x91, 0xc2, 0x91},
-        {0x92, 0xc2, 0x92},
-        {0x93, 0xc2, 0x93},
-        {0x94, 0xc2, 0x94},
-        {0x95, 0xc2, 0x95},
-        {0x96, 0xc2, 0x96},
-        {0x97, 0xc2, 0x97},
-        {0x98, 0xc2, 0x98},
-        {0x99, 0xc2, 0x99},
-        {0x9A, 0xc2, 0x9a},
-        {0x9B, 0xc2, 0x9b},
-        {0x9C, 0xc2, 0x9c},
-        {0x9D, 0xc2, 0x9d},
-        {0x9E, 0xc2, 0x9e},
-        {0x9F, 0xc2, 0x9f},
-        {0xA0, 0xc2, 0xa0},
-        {0xA1, 0xc2, 0xa1},
-        {0xA2, 0xc2, 0xa2},
-        {0xA3, 0xc2, 0xa3},
-        {0xA4, 0xc2, 0xa4},
-        {0xA5, 0xc2, 0xa5},
-        {0xA6, 0xc2, 0xa6},
-        {0xA7, 0xc2, 0xa7},
-        {0xA8, 0xc2, 0xa8},
-        {0xA9, 0xc2, 0xa9},
-        {0xAA, 0xc2, 0xaa},
-        {0xAB, 0xc2, 0xab},
-        {0xAC, 0xc2, 0xac},
-        {0xAD, 0xc2, 0xad},
-        {0xAE, 0xc2, 0xae},
-        {0xAF, 0xc2, 0xaf},
-        {0xB0, 0xc2, 0xb0},
-        {0xB1, 0xc2, 0xb1},
-        {0xB2, 0xc2, 0xb2},
-        {0xB3, 0xc2, 0xb3},
-        {0xB4, 0xc2, 0xb4},
-        {0xB5, 0xc2, 0xb5},
-        {0xB6, 0xc2, 0xb6},
-        {0xB7, 0xc2, 0xb7},
-        {0xB8, 0xc2, 0xb8},
-        {0xB9, 0xc2, 0xb9},
-        {0xBA, 0xc2, 0xba},
-        {0xBB, 0xc2, 0xbb},
-        {0xBC, 0xc2, 0xbc},
-        {0xBD, 0xc2, 0xbd},
-        {0xBE, 0xc2, 0xbe},
-        {0xBF, 0xc2, 0xbf},
-        {0xC0, 0xc3, 0x80},
-        {0xC1, 0xc3, 0x81},
-        {0xC2, 0xc3, 0x82},
-        {0xC3, 0xc3, 0x83},
-        {0xC4, 0xc3, 0x84},
-        {0xC5, 0xc3, 0x85},
-        {0xC6, 0xc3, 0x86},
-        {0xC7, 0xc3, 0x87},
-        {0xC8, 0xc3, 0x88},
-        {0xC9, 0xc3, 0x89},
-        {0xCA, 0xc3, 0x8a},
-        {0xCB, 0xc3, 0x8b},
-        {0xCC, 0xc3, 0x8c},
-        {0xCD, 0xc3, 0x8d},
-        {0xCE, 0xc3, 0x8e},
-        {0xCF, 0xc3, 0x8f},
-        {0xD0, 0xc3, 0x90},
-        {0xD1, 0xc3, 0x91},
-        {0xD2, 0xc3, 0x92},
-        {0xD3, 0xc3, 0x93},
-        {0xD4, 0xc3, 0x94},
-        {0xD5, 0xc3, 0x95},
-        {0xD6, 0xc3, 0x96},
-        {0xD7, 0xc3, 0x97},
-        {0xD8, 0xc3, 0x98},
-        {0xD9, 0xc3, 0x99},
-        {0xDA, 0xc3, 0x9a},
-        {0xDB, 0xc3, 0x9b},
-        {0xDC, 0xc3, 0x9c},
-        {0xDD, 0xc3, 0x9d},
-        {0xDE, 0xc3, 0x9e},
-        {0xDF, 0xc3, 0x9f},
-        {0xE0, 0xc3, 0xa0},
-        {0xE1, 0xc3, 0xa1},
-        {0xE2, 0xc3, 0xa2},
-        {0xE3, 0xc3, 0xa3},
-        {0xE4, 0xc3, 0xa4},
-        {0xE5, 0xc3, 0xa5},
-        {0xE6, 0xc3, 0xa6},
-        {0xE7, 0xc3, 0xa7},
-        {0xE8, 0xc3, 0xa8},
-        {0xE9, 0xc3, 0xa9},
-        {0xEA, 0xc3, 0xaa},
-        {0xEB, 0xc3, 0xab},
-        {0xEC, 0xc3, 0xac},
-        {0xED, 0xc3, 0xad},
-        {0xEE, 0xc3, 0xae},
-        {0xEF, 0xc3, 0xaf},
-        {0xF0, 0xc3, 0xb0},
-        {0xF1, 0xc3, 0xb1},
-        {0xF2, 0xc3, 0xb2},
-        {0xF3, 0xc3, 0xb3},
-        {0xF4, 0xc3, 0xb4},
-        {0xF5, 0xc3, 0xb5},
-        {0xF6, 0xc3, 0xb6},
-        {0xF7, 0xc3, 0xb7},
-        {0xF8, 0xc3, 0xb8},
-        {0xF9, 0xc3, 0xb9},
-        {0xFA, 0xc3, 0xba},
-        {0xFB, 0xc3, 0xbb},
-        {0xFC, 0xc3, 0xbc},
-        {0xFD, 0xc3, 0xbd},
-        {0xFE, 0xc3, 0xbe},
-        {0xFF, 0xc3, 0xbf},
-    };
-
-    // For none ascii characters Gadgetbridge encodes them in a strange utf-16 way.
-    // For example Gadgetbridge sends ö as just 0xF6 byte, but then it sends ä as "\xe4" (4 bytes) string.
-    // Which is very strange.
-    // LVGL works with ascii, and properly formatted utf-8.
-    while (data[i] != '\0' && i < len - 3 && j < out_buf_len - 3) {
-        if (data[i] == '\\' && data[i + 1] == 'x') {
-            // Parse string "\xe4" as 0xe4
-            char hex[3] = {data[i + 2], data[i + 3], '\0'};
-            int value = strtol(hex, NULL, 16);
-            if (value < 0x80) {
-                // Character encoded in a string, but it's an normal ascii, just copy it.
-                out_data[j] = value;
-            } else {
-                // Character encoded as "\xe4" (4 bytes)
-                out_data[j] = basic_latin_utf16_to_utf8_table[value - 0x80][1];
-                j++;
-                out_data[j] = basic_latin_utf16_to_utf8_table[value - 0x80][2];
-                j++;
-            }
-            i += 4;
-        } else if (data[i] >= 0x80) {
-            // Character encoded as utf-16, but in a single byte and the value is not ascii.
-            out_data[j] = basic_latin_utf16_to_utf8_table[data[i] - 0x80][1];
-            j++;
-            out_data[j] = basic_latin_utf16_to_utf8_table[data[i] - 0x80][2];
-            j++;
-            i++;
-        } else {
-            // Ascii character, just copy it.
-            out_data[j] = data[i];
-            i++;
-            j++;
-        }
-    }
-    // Copy the rest of the data
-    for (; i < len; i++) {
-        out_data[j] = data[i];
-        j++;
-    }
-    out_data[j] = '\0';
+    return ble_comm_buf_add_str(buf, field ? field->value : "", field_str_size(field, max_len) - 1);
 }
 
-static int parse_notify(char *data, int len)
+static int parse_notify(gb_field_t *fields, int num_fields)
 {
     struct ble_data_event cb;
     memset(&cb, 0, sizeof(cb));
 
     cb.data.type = BLE_COMM_DATA_TYPE_NOTIFY;
-    cb.data.data.notify.id = extract_value_uint32("\"id\":", data);
-    cb.data.data.notify.src = extract_value_str("\"src\":", data, &cb.data.data.notify.src_len);
-    cb.data.data.notify.sender = extract_value_str("\"sender\":", data, &cb.data.data.notify.sender_len);
-    cb.data.data.notify.title = extract_value_str("\"title\":", data, &cb.data.data.notify.title_len);
-    cb.data.data.notify.subject = extract_value_str("\"subject\":", data, &cb.data.data.notify.subject_len);
-    cb.data.data.notify.body = extract_value_str("\"body\":", data, &cb.data.data.notify.body_len);
-
-    // Little hack since we know it's JSON, we can terminate all values in the data
-    // which saves us some hassle and we can just pass all values null terminated
-    // to the callback. Make sure to do it after finish parsing!
-    if (cb.data.data.notify.src) {
-        cb.data.data.notify.src[cb.data.data.notify.src_len] = '\0';
-    }
-    if (cb.data.data.notify.sender) {
-        cb.data.data.notify.sender[cb.data.data.notify.sender_len] = '\0';
-    }
-    if (cb.data.data.notify.title) {
-        cb.data.data.notify.title[cb.data.data.notify.title_len] = '\0';
-    }
 
-    if (cb.data.data.notify.subject) {
-        cb.data.data.notify.subject[cb.data.data.notify.subject_len] = '\0';
-    }
-    if (cb.data.data.notify.body) {
-        cb.data.data.notify.body[cb.data.data.notify.body_len] = '\0';
+    // All values are null terminated by the tokenizer, so they can be passed as is.
+    for (int i = 0; i < num_fields; i++) {
+        gb_field_t *field = &fields[i];
+        if (field_is(field, "id")) {
+            cb.data.data.notify.id = field_uint32(field);
+        } else if (field_is(field, "src")) {
+            cb.data.data.notify.src = field->value;
+            cb.data.data.notify.src_len = field->value_len;
+        } else if (field_is(field, "sender")) {
+            cb.data.data.notify.sender = field->value;
+            cb.data.data.notify.sender_len = field->value_len;
+        } else if (field_is(field, "title")) {
+            cb.data.data.notify.title = field->value;
+            cb.data.data.notify.title_len = field->value_len;
+        } else if (field_is(field, "subject")) {
+            cb.data.data.notify.subject = field->value;
+            cb.data.data.notify.subject_len = field->value_len;
+        } else if (field_is(field, "body")) {
+            cb.data.data.notify.body = field->value;
+            cb.data.data.notify.body_len = field->value_len;
+        }
     }
 
     send_ble_data_event(&cb);
@@ -417,37 +219,48 @@ static int parse_notify(char *data, int len)
     return 0;
 }
 
-static int parse_notify_delete(char *data, int len)
+static int parse_notify_delete(gb_field_t *fields, int num_fields)
 {
     struct ble_data_event cb;
     memset(&cb, 0, sizeof(cb));
 
     cb.data.type = BLE_COMM_DATA_TYPE_NOTIFY_REMOVE;
-    cb.data.data.notify.id = extract_value_uint32("\"id\":", data);
+    for (int i = 0; i < num_fields; i++) {
+        if (field_is(&fields[i], "id")) {
+            cb.data.data.notify.id = field_uint32(&fields[i]);
+        }
+    }
 
     send_ble_data_event(&cb);
 
     return 0;
 }
 
-static int parse_weather(char *data, int len)
+static int parse_weather(gb_field_t *fields, int num_fields)
 {
     //{t:"weather",temp:268,hum:97,code:802,txt:"slightly cloudy",wind:2.0,wdir:14,loc:"MALMO"
-    int temp_len;
-    char *temp_value;
+    int32_t temperature_k = 0;
     float temperature;
     struct ble_data_event cb;
     memset(&cb, 0, sizeof(cb));
 
     cb.data.type = BLE_COMM_DATA_TYPE_WEATHER;
-    int32_t temperature_k = extract_value_uint32("\"temp\":", data);
-    cb.data.data.weather.humidity = extract_value_uint32("\"hum\":", data);
-    cb.data.data.weather.weather_code = extract_value_uint32("\"code\":", data);
-    cb.data.data.weather.wind = extract_value_uint32("\"wind\":", data);
-    cb.data.data.weather.wind_direction = extract_value_uint32("\"wdir\":", data);
-    temp_value = extract_value_str("\"txt\":", data, &temp_len);
-
-    strncpy(cb.data.data.weather.report_text, temp_value, MIN(temp_len, MAX_MUSIC_FIELD_LENGTH));
+    for (int i = 0; i < num_fields; i++) {
+        gb_field_t *field = &fields[i];
+        if (field_is(field, "temp")) {
+            temperature_k = field_int32(field);
+        } else if (field_is(field, "hum")) {
+            cb.data.data.weather.humidity = field_uint32(field);
+        } else if (field_is(field, "code")) {
+            cb.data.data.weather.weather_code = field_uint32(field);
+        } else if (field_is(field, "wind")) {
+            cb.data.data.weather.wind = field_uint32(field);
+        } else if (field_is(field, "wdir")) {
+            cb.data.data.weather.wind_direction = field_uint32(field);
+        } else if (field_is(field, "txt")) {
+            field_copy_str(field, cb.data.data.weather.report_text, sizeof(cb.data.data.weather.report_text));
+        }
+    }
 
     // App sends temperature in Kelvin
     temperature = temperature_k - 273.15f;
@@ -458,48 +271,70 @@ static int parse_weather(char *data, int len)
     return 0;
 }
 
-static int parse_musicinfo(char *data, int len)
+static int parse_musicinfo(gb_field_t *fields, int num_fields)
 {
     // {t:"musicinfo",artist:"Ava Max",album:"Heaven & Hell",track:"Sweet but Psycho",dur:187,c:-1,n:-1}
-    char *temp_value;
-    int temp_len;
+    gb_field_t *artist = NULL;
+    gb_field_t *album = NULL;
+    gb_field_t *track = NULL;
+    struct net_buf *buf;
     struct ble_data_event cb;
     memset(&cb, 0, sizeof(cb));
 
     cb.data.type = BLE_COMM_DATA_TYPE_MUSIC_INFO;
-    cb.data.data.music_info.duration = extract_value_int32("\"dur\":", data);
-    cb.data.data.music_info.track_count = extract_value_int32("\"c\":", data);
-    cb.data.data.music_info.track_num = extract_value_int32("\"n\":", data);
-    temp_value = extract_value_str("\"artist\":", data, &temp_len);
-    strncpy(cb.data.data.music_info.artist, temp_value, MIN(temp_len, MAX_MUSIC_FIELD_LENGTH));
-    temp_value = extract_value_str("\"album\":", data, &temp_len);
-    strncpy(cb.data.data.music_info.album, temp_value, MIN(temp_len, MAX_MUSIC_FIELD_LENGTH));
-    temp_value = extract_value_str("\"track\":", data, &temp_len);
-    strncpy(cb.data.data.music_info.track_name, temp_value, MIN(temp_len, MAX_MUSIC_FIELD_LENGTH));
+    for (int i = 0; i < num_fields; i++) {
+        gb_field_t *field = &fields[i];
+        if (field_is(field, "dur")) {
+            cb.data.data.music_info.duration = field_int32(field);
+        } else if (field_is(field, "c")) {
+            cb.data.data.music_info.track_count = field_int32(field);
+        } else if (field_is(field, "n")) {
+            cb.data.data.music_info.track_num = field_int32(field);
+        } else if (field_is(field, "artist")) {
+            artist = field;
+        } else if (field_is(field, "album")) {
+            album = field;
+        } else if (field_is(field, "track")) {
+            track = field;
+        }
+    }
+
+    buf = ble_comm_buf_alloc(field_str_size(artist, MAX_MUSIC_FIELD_LENGTH) +
+                             field_str_size(album, MAX_MUSIC_FIELD_LENGTH) +
+                             field_str_size(track, MAX_MUSIC_FIELD_LENGTH));
+    if (buf == NULL) {
+        return -ENOMEM;
+    }
+
+    cb.data.data.music_info.buf = buf;
+    cb.data.data.music_info.artist = field_add_str(buf, artist, MAX_MUSIC_FIELD_LENGTH);
+    cb.data.data.music_info.album = field_add_str(buf, album, MAX_MUSIC_FIELD_LENGTH);
+    cb.data.data.music_info.track_name = field_add_str(buf, track, MAX_MUSIC_FIELD_LENGTH);
 
     send_ble_data_event(&cb);
+    net_buf_unref(buf);
 
     return 0;
 }
 
-static int parse_musicstate(char *data, int len)
+static int parse_musicstate(gb_field_t *fields, int num_fields)
 {
-    // {t:"musicinfo",artist:"Ava Max",album:"Heaven & Hell",track:"Sweet but Psycho",dur:187,c:-1,n:-1}
-    char *temp_value;
-    int temp_len;
+    // {t:"musicstate",state:"play",position:0,shuffle:1,repeat:1}
     struct ble_data_event cb;
     memset(&cb, 0, sizeof(cb));
 
     cb.data.type = BLE_COMM_DATA_TYPE_MUSIC_STATE;
-    cb.data.data.music_state.position = extract_value_int32("\"position\":", data);
-    cb.data.data.music_state.shuffle = extract_value_int32("\"shuffle\":", data);
-    cb.data.data.music_state.repeat = extract_value_int32("\"repeat\":", data);
-
-    temp_value = extract_value_str("\"state\":", data, &temp_len);
-    if (strncmp(temp_value, "play", temp_len) == 0) {
-        cb.data.data.music_state.playing = true;
-    } else {
-        cb.data.data.music_state.playing = false;
+    for (int i = 0; i < num_fields; i++) {
+        gb_field_t *field = &fields[i];
+        if (field_is(field, "position")) {
+            cb.data.data.music_state.position = field_int32(field);
+        } else if (field_is(field, "shuffle")) {
+            cb.data.data.music_state.shuffle = field_int32(field);
+        } else if (field_is(field, "repeat")) {
+            cb.data.data.music_state.repeat = field_int32(field);
+        } else if (field_is(field, "state")) {
+            cb.data.data.music_state.playing = strcmp(field->value, "play") == 0;
+        }
     }
 
     send_ble_data_event(&cb);
@@ -507,130 +342,199 @@ static int parse_musicstate(char *data, int len)
     return 0;
 }
 
-static int parse_httpstate(char *data, int len)
+static int parse_http_id(const gb_field_t *field)
+{
+    char *end_data;
+    int id;
+
+    errno = 0;
+    id = strtol(field->value, &end_data, 10);
+    if (field->value == end_data || errno != 0) {
+        LOG_WRN("Failed parsing http request id");
+        return -1;
+    }
+
+    return id;
+}
+
+static int parse_httpstate(gb_field_t *fields, int num_fields)
 {
     // {"t":"http","resp":"{\"response_code\":0,\"results\":[{\"type\":\"boolean\",\"difficulty\":\"easy\",\"category\":\"Geography\",\"question\":\"Hungary is the only country in the world beginning with H.\",\"correct_answer\":\"False\",\"incorrect_answers\":[\"True\"]}]}"}
-    char *temp_value;
-    int temp_len;
+    // {"t":"http","err":"Internet access not enabled in this Gadgetbridge build"}
+    gb_field_t *resp = NULL;
+    gb_field_t *err = NULL;
+    struct net_buf *buf;
     struct ble_data_event cb;
     memset(&cb, 0, sizeof(cb));
 
     cb.data.type = BLE_COMM_DATA_TYPE_HTTP;
-
-    temp_value = extract_value_str("\"id\":", data, &temp_len);
-    if (temp_value) {
-        errno = 0;
-        char *end_data;
-        cb.data.data.http_response.id  = strtol(temp_value, &end_data, 10);
-        if (temp_value == end_data || errno != 0) {
-            LOG_WRN("Failed parsing http request id");
-            cb.data.data.http_response.id = -1;
+    cb.data.data.http_response.id = -1;
+
+    for (int i = 0; i < num_fields; i++) {
+        gb_field_t *field = &fields[i];
+        if (field_is(field, "id")) {
+            cb.data.data.http_response.id = parse_http_id(field);
+        } else if (field_is(field, "err")) {
+            err = field;
+        } else if (field_is(field, "resp")) {
+            resp = field;
         }
-    } else {
-        cb.data.data.http_response.id = -1;
     }
 
-    // {"t":"http","err":"Internet access not enabled in this Gadgetbridge build"}
-    temp_value = extract_value_str("\"err\":", data, &temp_len);
+    // A streamed response is not in the fields, see on_stream_chunk.
+    if (err == NULL && resp == NULL) {
+        return 0;
+    }
 
-    if (temp_value != NULL) {
-        LOG_ERR("HTTP err: %s", temp_value);
-        memcpy(cb.data.data.http_response.err, temp_value, temp_len);
-        send_ble_data_event(&cb);
+    buf = ble_comm_buf_alloc(field_str_size(err ? err : resp, MAX_HTTP_FIELD_LENGTH));
+    if (buf == NULL) {
+        return -ENOMEM;
+    }
+    cb.data.data.http_response.buf = buf;
+
+    // The response is unescaped by the tokenizer and is valid JSON as is.
+    if (err != NULL) {
+        LOG_ERR("HTTP err: %s", err->value);
+        cb.data.data.http_response.err = field_add_str(buf, err, MAX_HTTP_FIELD_LENGTH);
+        cb.data.data.http_response.response = "";
     } else {
-        temp_value = extract_value_str("\"resp\":", data, &temp_len);
-        if (temp_value) {
-            LOG_DBG("HTTP response: %s", temp_value);
-            memcpy(cb.data.data.http_response.response, temp_value,
-                   (strlen(temp_value) > MAX_HTTP_FIELD_LENGTH) ? MAX_HTTP_FIELD_LENGTH : strlen(temp_value)); /// @todo cast?
-            send_ble_data_event(&cb);
-        }
+        LOG_DBG("HTTP response: %s", resp->value);
+        cb.data.data.http_response.err = "";
+        cb.data.data.http_response.response = field_add_str(buf, resp, MAX_HTTP_FIELD_LENGTH);
+        cb.data.data.http_response.response_len = strlen(cb.data.data.http_response.response);
     }
 
+    send_ble_data_event(&cb);
+    net_buf_unref(buf);
+
     return 0;
 }
 
-static int parse_gps_data(char *data, int len)
+static int parse_gps_data(gb_field_t *fields, int num_fields)
 {
     //{"t":"gps","lat":55.6135542,"lon":12.9747185,"alt":41.900001525878906,"speed":0.1458607256412506,"time":1717002933835,"satellites":0,"hdop":16.215999603271484,"externalSource":true,"gpsSource":"network"}
     struct ble_data_event cb;
     memset(&cb, 0, sizeof(cb));
 
     cb.data.type = BLE_COMM_DATA_TYPE_GPS;
-
-    cJSON *root = cJSON_Parse(data);
-    if (root == NULL) {
-        return -EINVAL;
+    cb.data.data.gps.lat = -1;
+    cb.data.data.gps.lon = -1;
+    cb.data.data.gps.alt = -1;
+    cb.data.data.gps.speed = -1;
+    cb.data.data.gps.time = -1;
+    cb.data.data.gps.satellites = -1;
+    cb.data.data.gps.hdop = -1;
+
+    for (int i = 0; i < num_fields; i++) {
+        gb_field_t *field = &fields[i];
+        if (field_is(field, "lat")) {
+            cb.data.data.gps.lat = strtod(field->value, NULL);
+        } else if (field_is(field, "lon")) {
+            cb.data.data.gps.lon = strtod(field->value, NULL);
+        } else if (field_is(field, "alt")) {
+            cb.data.data.gps.alt = strtod(field->value, NULL);
+        } else if (field_is(field, "speed")) {
+            cb.data.data.gps.speed = strtod(field->value, NULL);
+        } else if (field_is(field, "time")) {
+            cb.data.data.gps.time = strtoull(field->value, NULL, 10);
+        } else if (field_is(field, "satellites")) {
+            cb.data.data.gps.satellites = field_int32(field);
+        } else if (field_is(field, "hdop")) {
+            cb.data.data.gps.hdop = strtof(field->value, NULL);
+        }
     }
 
-    cJSON *lat = cJSON_GetObjectItem(root, "lat");
-    cJSON *lon = cJSON_GetObjectItem(root, "lon");
-    cJSON *alt = cJSON_GetObjectItem(root, "alt");
-    cJSON *speed = cJSON_GetObjectItem(root, "speed");
-    cJSON *time = cJSON_GetObjectItem(root, "time");
-    cJSON *satellites = cJSON_GetObjectItem(root, "satellites");
-    cJSON *hdop = cJSON_GetObjectItem(root, "hdop");
-
-    cb.data.data.gps.lat = lat != NULL ? lat->valuedouble : -1;
-    cb.data.data.gps.lon = lon != NULL ? lon->valuedouble : -1;
-    cb.data.data.gps.alt = alt != NULL ? alt->valuedouble : -1;
-    cb.data.data.gps.speed = speed != NULL ? speed->valuedouble : -1;
-    cb.data.data.gps.time = time != NULL ? time->valuedouble : -1;
-    cb.data.data.gps.satellites = satellites != NULL ? satellites->valueint : -1;
-    cb.data.data.gps.hdop = hdop != NULL ? hdop->valuedouble : -1;
-
-    cJSON_Delete(root);
-
     send_ble_data_event(&cb);
 
     return 0;
 }
 
-static int parse_data(char *data, int len)
+static const gb_message_handler_t message_handlers[] = {
+    { "notify", parse_notify },
+    { "notify-", parse_notify_delete },
+    { "weather", parse_weather },
+    { "musicinfo", parse_musicinfo },
+    { "musicstate", parse_musicstate },
+    { "http", parse_httpstate },
+    { "gps", parse_gps_data },
+};
+
+static bool on_stream_begin(const gb_field_t *fields, int num_fields, const char *key)
 {
-    int type_len;
-    char *type;
-    uint8_t input_data_utf8[MAX_GB_PACKET_LENGTH];
+    const char *type = NULL;
+    const gb_field_t *id = NULL;
 
-    memset(input_data_utf8, 0, sizeof(input_data_utf8));
-    // Convert data from Gadgetbridge into properly encoded text.
-    convert_to_encoded_text(data, len, input_data_utf8, sizeof(input_data_utf8));
-    data = input_data_utf8;
-
-    type = extract_value_str("\"t\":", data, &type_len);
-    if (type == NULL) {
-        return -1;
+    // HTTP responses are passed on in chunks while received, so they can be larger than receive_buf.
+    // Gadgetbridge sends t and id before resp, otherwise the response is received as a field.
+    if (strcmp(key, "resp") != 0) {
+        return false;
     }
 
-    if (strlen("notify") == type_len && strncmp(type, "notify", type_len) == 0) {
-        return parse_notify(data, len);
+    for (int i = 0; i < num_fields; i++) {
+        if (field_is(&fields[i], "t")) {
+            type = fields[i].value;
+        } else if (field_is(&fields[i], "id")) {
+            id = &fields[i];
+        }
     }
 
-    if (strlen("notify-") == type_len && strncmp(type, "notify-", type_len) == 0) {
-        return parse_notify_delete(data, len);
+    if (type == NULL || strcmp(type, "http") != 0 || id == NULL) {
+        return false;
     }
 
-    if (strlen("weather") == type_len && strncmp(type, "weather", type_len) == 0) {
-        return parse_weather(data, len);
-    }
+    stream_http_id = parse_http_id(id);
+
+    return true;
+}
 
-    if (strlen("musicinfo") == type_len && strncmp(type, "musicinfo", type_len) == 0) {
-        return parse_musicinfo(data, len);
+static void on_stream_chunk(gb_tokenizer_chunk_t type, char *data, uint16_t len)
+{
+    struct ble_data_event cb;
+    memset(&cb, 0, sizeof(cb));
+
+    cb.data.type = BLE_COMM_DATA_TYPE_HTTP;
+    cb.data.data.http_response.id = stream_http_id;
+    cb.data.data.http_response.err = "";
+    cb.data.data.http_response.response = "";
+
+    if (type == GB_TOKENIZER_CHUNK_ABORT) {
+        cb.data.data.http_response.err = "Response dropped";
+    } else {
+        // Points into receive_buf, only valid during the publish.
+        cb.data.data.http_response.response = data;
+        cb.data.data.http_response.response_len = len;
+        cb.data.data.http_response.more = type == GB_TOKENIZER_CHUNK_DATA;
     }
 
-    if (strlen("musicstate") == type_len && strncmp(type, "musicstate", type_len) == 0) {
-        return parse_musicstate(data, len);
+    send_ble_data_event(&cb);
+}
+
+static void handle_gb_object(gb_field_t *fields, int num_fields)
+{
+    const char *type = NULL;
+
+    for (int i = 0; i < num_fields; i++) {
+        if (field_is(&fields[i], "t")) {
+            type = fields[i].value;
+            break;
+        }
     }
 
-    if (strlen("http") == type_len && strncmp(type, "http", type_len) == 0) {
-        return parse_httpstate(data, len);
+    stats.parsed_messages++;
+
+    if (type == NULL) {
+        LOG_WRN("Message without type");
+        return;
     }
 
-    if (strlen("gps") == type_len && strncmp(type, "gps", type_len) == 0) {
-        return parse_gps_data(data, len);
+    for (int i = 0; i < ARRAY_SIZE(message_handlers); i++) {
+        if (strcmp(type, message_handlers[i].type) == 0) {
+            message_handlers[i].handler(fields, num_fields);
+            return;
+        }
     }
 
-    return 0;
+    LOG_DBG("Unhandled message type: %s", type);
 }
 
 static void parse_remote_control(char *data, int len)
@@ -651,93 +555,182 @@ static void parse_remote_control(char *data, int len)
     send_ble_data_event(&cb);
 }
 
-void ble_gadgetbridge_input(const uint8_t *const data, uint16_t len)
+static bool is_gb_packet_start(const uint8_t *data, uint16_t len)
 {
+    // Gadgetbridge prefixes every GB( with a DLE (0x10) byte.
+    if (len > 0 && data[0] == 0x10) {
+        data++;
+        len--;
+    }
+    return len >= strlen("GB(") && strncmp(data, "GB(", strlen("GB(")) == 0;
+}
+
+static void parse_fragment(uint8_t *data, uint16_t len)
+{
+    int ret;
+
     LOG_HEXDUMP_DBG(data, len, "RX");
 
     if (strncmp("Control:", data, MIN(strlen("Control:"), len)) == 0) {
         char *time_start = strstr(data, "Control:");
+        stats.parsed_messages++;
         return parse_remote_control(time_start + strlen("Control:"), len - strlen("Control:"));
     }
 
-    char *gb_start = strstr(data, "GB(");
-    if (gb_start && parse_state != WAIT_GB) {
+    if (!gb_tokenizer_is_idle(&tokenizer) && is_gb_packet_start(data, len)) {
         LOG_ERR("Parsing error, was waiting end, but got GB");
-        parse_state = WAIT_GB;
+        stats.dropped_messages++;
+        gb_tokenizer_reset(&tokenizer);
     }
 
-    char *time_start = strstr(data, "setTime(");
-    if (time_start && parse_state == WAIT_GB) {
-        time_start += strlen("setTime(");
-        parse_time(time_start);
-        return;
+    if (gb_tokenizer_is_idle(&tokenizer)) {
+        char *time_start = strstr(data, "setTime(");
+        if (time_start) {
+            time_start += strlen("setTime(");
+            stats.parsed_messages++;
+            parse_time(time_start);
+            return;
+        }
+
+        // ie. ;E.setTimeZone(1.0);
+        char *offset = strstr(data, ";E.setTimeZone(");
+        if (offset) {
+            offset += strlen(";E.setTimeZone(");
+            stats.parsed_messages++;
+            parse_time_zone(offset);
+            return;
+        }
     }
 
-    // ie. ;E.setTimeZone(1.0);
-    char *offset = strstr(data, ";E.setTimeZone(");
-    if (offset && parse_state == WAIT_GB) {
-        offset += strlen(";E.setTimeZone(");
-        parse_time_zone(offset);
-        return;
+    ret = gb_tokenizer_feed(&tokenizer, data, len);
+    if (ret == -ENOMEM) {
+        LOG_ERR("Data from Gadgetbridge does not fit in MAX_GB_PACKET_LENGTH (%d)", MAX_GB_PACKET_LENGTH);
+        stats.dropped_messages++;
+    } else if (ret != 0) {
+        LOG_WRN("Malformed data from Gadgetbridge: %d", ret);
+        stats.dropped_messages++;
     }
+}
 
-    switch (parse_state) {
-        case WAIT_GB: {
-            if (gb_start) {
-                gb_start += 3;
-                parse_state = WAIT_END;
-                num_parsed_brackets = 0;
-                parsed_data_index = 0;
-                memset(receive_buf, 0, sizeof(receive_buf));
-                uint32_t index = gb_start - (char *)data;
-                for (int i = index; i < len; i++) {
-                    receive_buf[parsed_data_index] = data[i];
-                    parsed_data_index++;
-                    if (data[i] == '{') {
-                        num_parsed_brackets++;
-                    } else if (data[i] == '}') {
-                        num_parsed_brackets--;
-                        if (num_parsed_brackets == 0) {
-                            parse_state = PARSE_STATE_DONE;
-                            break;
-                        }
-                    }
-                }
-            }
-            break;
-        }
-        case WAIT_END: {
-            for (int i = 0; i < len; i++) {
-                receive_buf[parsed_data_index] = data[i];
-                parsed_data_index++;
-                if (parsed_data_index >= MAX_GB_PACKET_LENGTH) {
-                    LOG_ERR("Data from Gadgetbridge does not fit in MAX_GB_PACKET_LENGTH (%d)", MAX_GB_PACKET_LENGTH);
-                    parse_state = WAIT_GB;
-                    break;
-                }
-                if (data[i] == '{') {
-                    num_parsed_brackets++;
-                } else if (data[i] == '}') {
-                    num_parsed_brackets--;
-                    if (num_parsed_brackets == 0) {
-                        parse_state = PARSE_STATE_DONE;
-                        break;
-                    }
-                }
+static void rx_ring_copy_in(uint32_t index, const void *data, uint16_t len)
+{
+    uint32_t offset = index & (RX_RING_SIZE - 1);
+    uint32_t first = MIN(len, RX_RING_SIZE - offset);
+
+    memcpy(&rx_ring[offset], data, first);
+    memcpy(rx_ring, (const uint8_t *)data + first, len - first);
+}
+
+static void rx_ring_copy_out(uint32_t index, void *data, uint16_t len)
+{
+    uint32_t offset = index & (RX_RING_SIZE - 1);
+    uint32_t first = MIN(len, RX_RING_SIZE - offset);
+
+    memcpy(data, &rx_ring[offset], first);
+    memcpy((uint8_t *)data + first, rx_ring, len - first);
+}
+
+static void parse_work_handler(struct k_work *work)
+{
+    // One extra byte to null terminate, the setTime and Control parsing depends on it.
+    static uint8_t fragment[MAX_FRAGMENT_LENGTH + 1];
+    uint32_t tail = atomic_get(&rx_ring_tail);
+    uint16_t len;
+
+    while (tail != (uint32_t)atomic_get(&rx_ring_head)) {
+        rx_ring_copy_out(tail, &len, sizeof(len));
+        tail += sizeof(len);
+        if (len == 0) {
+            // Fragments were dropped before this one, a half received message can't be completed.
+            if (!gb_tokenizer_is_idle(&tokenizer)) {
+                stats.dropped_messages++;
+                gb_tokenizer_reset(&tokenizer);
             }
-            break;
-        }
-        case PARSE_STATE_DONE: {
-            LOG_WRN("Busy parsing, ingnoring...");
-            break;
+        } else {
+            rx_ring_copy_out(tail, fragment, len);
+            tail += len;
+            fragment[len] = '\0';
+            parse_fragment(fragment, len);
         }
-        default:
-            LOG_WRN("Unhandled state");
-            break;
+        // Release the space only after the fragment is copied out.
+        atomic_set(&rx_ring_tail, tail);
+    }
+}
+
+void ble_gadgetbridge_input(const uint8_t *const data, uint16_t len)
+{
+    // Only called from the BT RX thread, which is the single producer of the ring.
+    uint32_t head = atomic_get(&rx_ring_head);
+    uint32_t used = head - (uint32_t)atomic_get(&rx_ring_tail);
+    uint32_t needed = sizeof(len) + len + (rx_overflow ? sizeof(len) : 0);
+    uint16_t discontinuity_marker = 0;
+
+    if (len == 0) {
+        return;
     }
-    if (parse_state == PARSE_STATE_DONE) {
-        parse_state = WAIT_GB;
-        LOG_DBG("%s", receive_buf);
-        parse_data(receive_buf, parsed_data_index);
+
+    if (len > MAX_FRAGMENT_LENGTH || RX_RING_SIZE - used < needed) {
+        atomic_inc(&stats.dropped_fragments);
+        rx_overflow = true;
+        return;
+    }
+
+    if (rx_overflow) {
+        rx_ring_copy_in(head, &discontinuity_marker, sizeof(discontinuity_marker));
+        head += sizeof(discontinuity_marker);
+        rx_overflow = false;
     }
-}
\ No newline at end of file
+    rx_ring_copy_in(head, &len, sizeof(len));
+    head += sizeof(len);
+    rx_ring_copy_in(head, data, len);
+    head += len;
+    // Publish the fragment to the consumer only after it's written.
+    atomic_set(&rx_ring_head, head);
+
+    atomic_inc(&stats.queued_fragments);
+    atomic_set(&stats.max_buffered_bytes, MAX((uint32_t)atomic_get(&stats.max_buffered_bytes), used + needed));
+    k_work_submit_to_queue(&gb_work_q, &parse_work);
+}
+
+void ble_gadgetbridge_get_stats(ble_gadgetbridge_stats_t *out)
+{
+    out->queued_fragments = atomic_get(&stats.queued_fragments);
+    out->dropped_fragments = atomic_get(&stats.dropped_fragments);
+    out->max_buffered_bytes = atomic_get(&stats.max_buffered_bytes);
+    out->parsed_messages = stats.parsed_messages;
+    out->dropped_messages = stats.dropped_messages;
+}
+
+static int ble_gadgetbridge_init(void)
+{
+    gb_tokenizer_init(&tokenizer, receive_buf, sizeof(receive_buf), handle_gb_object);
+    gb_tokenizer_set_stream_cb(&tokenizer, on_stream_begin, on_stream_chunk);
+
+    k_work_queue_start(&gb_work_q, gb_work_q_stack, K_THREAD_STACK_SIZEOF(gb_work_q_stack),
+                       CONFIG_ZSW_GADGETBRIDGE_THREAD_PRIORITY, NULL);
+    k_thread_name_set(&gb_work_q.thread, "gadgetbridge");
+
+    return 0;
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_gadgetbridge_stats(const struct shell *sh, size_t argc, char **argv)
+{
+    ble_gadgetbridge_stats_t gb_stats;
+
+    ble_gadgetbridge_get_stats(&gb_stats);
+    shell_print(sh, "Fragments queued: %d, dropped: %d, max buffered: %d/%d bytes", gb_stats.queued_fragments,
+                gb_stats.dropped_fragments, gb_stats.max_buffered_bytes, RX_RING_SIZE);
+    shell_print(sh, "Messages parsed: %d, dropped: %d", gb_stats.parsed_messages, gb_stats.dropped_messages);
+
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(gadgetbridge_cmds,
+                               SHELL_CMD(stats, NULL, "Print receive statistics", cmd_gadgetbridge_stats),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(gadgetbridge, &gadgetbridge_cmds, "Gadgetbridge protocol", NULL);
+#endif
+
+SYS_INIT(ble_gadgetbridge_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
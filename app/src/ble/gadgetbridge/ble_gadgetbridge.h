@@ -7,4 +7,22 @@
 
 #define MAX_GB_PACKET_LENGTH                    2000
 
-void ble_gadgetbridge_input(const uint8_t *const data, uint16_t len);
\ No newline at end of file
+typedef struct ble_gadgetbridge_stats {
+    uint32_t queued_fragments;      // Received BLE packets queued for parsing
+    uint32_t dropped_fragments;     // Received BLE packets dropped because the receive buffer was full
+    uint32_t max_buffered_bytes;    // Receive buffer high watermark
+    uint32_t parsed_messages;       // Complete messages parsed
+    uint32_t dropped_messages;      // Partially received messages dropped due to lost data or parse errors
+} ble_gadgetbridge_stats_t;
+
+/** @brief Queue received data for parsing. Parsing is done in a separate thread,
+ *         this only copies the data and must only be called from one thread.
+ *  @param data Received data, can be any part of a message.
+ *  @param len Length of data.
+*/
+void ble_gadgetbridge_input(const uint8_t *const data, uint16_t len);
+
+/** @brief Get receive and parse statistics.
+ *  @param stats Filled with the statistics.
+*/
+void ble_gadgetbridge_get_stats(ble_gadgetbridge_stats_t *stats);
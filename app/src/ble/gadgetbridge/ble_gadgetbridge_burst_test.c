@@ -0,0 +1,190 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Replays bursts of Gadgetbridge notifications on native_posix, like a group chat flood, run with:
+ *   zephyr.exe --gb-burst-test=500
+ * Feeds the given number of notifications to ble_gadgetbridge_input in BLE sized fragments from a thread with higher
+ * priority than the parser, as the BT RX thread would, in bursts that fill the receive buffer. Checks that every
+ * notification is parsed once and in order without drops. Then sends a burst larger than the receive buffer and
+ * checks that the overflow is counted, no notification is corrupted and parsing recovers. Exits with 0 on success.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/zbus/zbus.h>
+
+#include "zsw_bench.h"
+#include "ble_gadgetbridge.h"
+#include "events/ble_event.h"
+
+// Payload of a write with the default ATT MTU of 23 bytes.
+#define BURST_FRAGMENT_LEN  20
+#define BURST_MESSAGE_LEN   256
+#define BURST_TIMEOUT_MS    5000
+
+static void zbus_ble_comm_data_callback(const struct zbus_channel *chan);
+
+ZBUS_LISTENER_DEFINE(gb_burst_test_lis, zbus_ble_comm_data_callback);
+ZBUS_CHAN_DECLARE(ble_comm_data_chan);
+ZBUS_CHAN_ADD_OBS(ble_comm_data_chan, gb_burst_test_lis, 1);
+
+static uint32_t test_count;
+static bool running;
+static uint32_t next_id;
+static uint32_t num_received;
+static uint32_t num_wrong;
+
+static struct args_struct_t test_options[] = {
+    {
+        .option = "gb-burst-test",
+        .name = "messages",
+        .type = 'u',
+        .dest = (void *) &test_count,
+        .descript = "Replay this many Gadgetbridge notifications in bursts and check none are lost, exits when done"
+    },
+    ARG_TABLE_ENDMARKER
+};
+
+static int format_body(char *buf, size_t size, uint32_t id)
+{
+    return snprintf(buf, size, "Message %u in the group chat, sent as fast as Gadgetbridge can", id);
+}
+
+static int format_message(char *buf, size_t size, uint32_t id)
+{
+    char body[BURST_MESSAGE_LEN];
+
+    format_body(body, sizeof(body), id);
+    return snprintf(buf, size,
+                    "\x10GB({t:\"notify\",id:%u,src:\"WhatsApp\",title:\"Family\",sender:\"Anna\",body:\"%s\"})\n",
+                    id, body);
+}
+
+// Called from the Gadgetbridge parser thread.
+static void zbus_ble_comm_data_callback(const struct zbus_channel *chan)
+{
+    const struct ble_data_event *event = zbus_chan_const_msg(chan);
+    const ble_comm_notify_t *notify = &event->data.data.notify;
+    char body[BURST_MESSAGE_LEN];
+    int body_len;
+
+    if (!running || event->data.type != BLE_COMM_DATA_TYPE_NOTIFY) {
+        return;
+    }
+
+    // Notifications lost to an overflow are skipped, but the ones received must be complete and in order.
+    body_len = format_body(body, sizeof(body), notify->id);
+    if (notify->id < next_id || notify->body_len != body_len || memcmp(notify->body, body, body_len) != 0) {
+        printk("Wrong notification %u, expected id >= %u: %.*s\n", notify->id, next_id, notify->body_len,
+               notify->body);
+        num_wrong++;
+    }
+    next_id = notify->id + 1;
+    num_received++;
+}
+
+static void replay(uint32_t first_id, uint32_t num_messages)
+{
+    char message[BURST_MESSAGE_LEN];
+
+    for (uint32_t id = first_id; id < first_id + num_messages; id++) {
+        int len = format_message(message, sizeof(message), id);
+
+        for (int offset = 0; offset < len; offset += BURST_FRAGMENT_LEN) {
+            ble_gadgetbridge_input((const uint8_t *)&message[offset], MIN(BURST_FRAGMENT_LEN, len - offset));
+        }
+    }
+}
+
+static void wait_received(uint32_t num_expected)
+{
+    for (int waited_ms = 0; num_received < num_expected && waited_ms < BURST_TIMEOUT_MS; waited_ms += 10) {
+        k_msleep(10);
+    }
+    // Anything dropped is parsed by now as well.
+    k_msleep(10);
+}
+
+static int gb_burst_test(void)
+{
+    char message[BURST_MESSAGE_LEN];
+    ble_gadgetbridge_stats_t start;
+    ble_gadgetbridge_stats_t stats;
+    // Longest possible message, so a burst never overflows the receive buffer.
+    uint32_t message_len = format_message(message, sizeof(message), UINT32_MAX);
+    // Each fragment is stored with a 16-bit length in the receive buffer.
+    uint32_t buffered_len = message_len + DIV_ROUND_UP(message_len, BURST_FRAGMENT_LEN) * sizeof(uint16_t);
+    uint32_t burst_len = CONFIG_ZSW_GADGETBRIDGE_RX_BUF_SIZE / buffered_len;
+    uint32_t overflow_len = 2 * burst_len;
+    uint32_t id = 0;
+
+    if (test_count == 0) {
+        return ZSW_BENCH_NOT_RUN;
+    }
+
+    ble_gadgetbridge_get_stats(&start);
+    running = true;
+
+    // Bursts that fit in the receive buffer are queued while the parser is starved and parsed after, none may drop.
+    while (id < test_count) {
+        uint32_t num_messages = MIN(burst_len, test_count - id);
+
+        replay(id, num_messages);
+        id += num_messages;
+        wait_received(id);
+    }
+
+    ble_gadgetbridge_get_stats(&stats);
+    printk("Bursts of %u messages, received %u of %u, %u wrong, fragments dropped %u, max buffered %u/%u bytes\n",
+           burst_len, num_received, test_count, num_wrong, stats.dropped_fragments - start.dropped_fragments,
+           stats.max_buffered_bytes, CONFIG_ZSW_GADGETBRIDGE_RX_BUF_SIZE);
+    if (num_received != test_count || num_wrong != 0 || stats.dropped_fragments != start.dropped_fragments ||
+        stats.dropped_messages != start.dropped_messages) {
+        printk("Burst test failed\n");
+        return 1;
+    }
+
+    // A burst larger than the receive buffer must be dropped cleanly, and the message after it parsed.
+    start = stats;
+    num_received = 0;
+    replay(id, overflow_len);
+    id += overflow_len;
+    wait_received(burst_len);
+    replay(id, 1);
+    wait_received(num_received + 1);
+
+    ble_gadgetbridge_get_stats(&stats);
+    printk("Overflow burst of %u messages, received %u, %u wrong, fragments dropped %u, messages dropped %u\n",
+           overflow_len + 1, num_received, num_wrong, stats.dropped_fragments - start.dropped_fragments,
+           stats.dropped_messages - start.dropped_messages);
+    if (num_wrong != 0 || next_id != id + 1 || stats.dropped_fragments == start.dropped_fragments ||
+        num_received < burst_len || num_received > overflow_len) {
+        printk("Overflow test failed\n");
+        return 1;
+    }
+
+    running = false;
+    printk("Burst test passed\n");
+
+    return 0;
+}
+
+// Above the parser priority like the BT RX thread, so a burst is queued before any of it is parsed.
+ZSW_BENCH_DEFINE_PRIO(gb_burst_test, 2048, CONFIG_ZSW_GADGETBRIDGE_THREAD_PRIORITY - 1, ZSW_BENCH_START_DELAY_MS,
+                      test_options, gb_burst_test);
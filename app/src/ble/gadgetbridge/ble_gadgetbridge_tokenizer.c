@@ -0,0 +1,418 @@
+#include <errno.h>
+#include <string.h>
+#include <zephyr/sys/base64.h>
+
+#include "ble_gadgetbridge_tokenizer.h"
+
+/*
+ * Single pass tokenizer for the JSON-like messages Gadgetbridge sends wrapped in GB(...).
+ * Keys and decoded values are written to the buffer as they arrive, so nothing is
+ * scanned twice and a message can be split into any number of BLE packets.
+ *
+ * Gadgetbridge quirks that are handled:
+ * - Keys can be both quoted and unquoted.
+ * - Strings can be wrapped in atob("...") and are then base64 decoded.
+ * - Non ASCII characters are sent either as a single Latin-1 byte or as "\xe4",
+ *   both are converted to UTF-8 as that is what LVGL expects.
+*/
+
+typedef enum tokenizer_state {
+    STATE_WAIT_GB,
+    STATE_WAIT_OBJECT,
+    STATE_WAIT_KEY,
+    STATE_KEY,
+    STATE_BARE_KEY,
+    STATE_WAIT_COLON,
+    STATE_WAIT_VALUE,
+    STATE_ATOB,
+    STATE_STRING,
+    STATE_STRING_ESCAPE,
+    STATE_STRING_HEX,
+    STATE_LITERAL,
+    STATE_NESTED,
+    STATE_AFTER_VALUE,
+} tokenizer_state_t;
+
+static const char gb_start[] = "GB(";
+static const char atob_start[] = "atob(\"";
+
+static bool is_whitespace(uint8_t c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool is_key_char(uint8_t c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+}
+
+static int hex_value(uint8_t c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static void flush_chunk(gb_tokenizer_t *tokenizer, gb_tokenizer_chunk_t type)
+{
+    uint16_t len = tokenizer->buf_used - tokenizer->value_start;
+
+    tokenizer->buf[tokenizer->buf_used] = '\0';
+    tokenizer->chunk_cb(type, (char *)&tokenizer->buf[tokenizer->value_start], len);
+    tokenizer->buf_used = tokenizer->value_start;
+}
+
+static int emit(gb_tokenizer_t *tokenizer, uint8_t c)
+{
+    // Always leave room for the null terminator
+    if (tokenizer->buf_used + 1 >= tokenizer->buf_size) {
+        if (!tokenizer->streaming || tokenizer->buf_used == tokenizer->value_start) {
+            return -ENOMEM;
+        }
+        flush_chunk(tokenizer, GB_TOKENIZER_CHUNK_DATA);
+    }
+    tokenizer->buf[tokenizer->buf_used++] = c;
+    return 0;
+}
+
+static int emit_utf8(gb_tokenizer_t *tokenizer, uint16_t code_point)
+{
+    int ret;
+
+    if (code_point < 0x80) {
+        return emit(tokenizer, code_point);
+    } else if (code_point < 0x800) {
+        ret = emit(tokenizer, 0xC0 | (code_point >> 6));
+    } else {
+        ret = emit(tokenizer, 0xE0 | (code_point >> 12));
+        ret = ret ? ret : emit(tokenizer, 0x80 | ((code_point >> 6) & 0x3F));
+    }
+    return ret ? ret : emit(tokenizer, 0x80 | (code_point & 0x3F));
+}
+
+static void begin_object(gb_tokenizer_t *tokenizer)
+{
+    tokenizer->buf_used = 0;
+    tokenizer->num_fields = 0;
+    tokenizer->state = STATE_WAIT_KEY;
+}
+
+static int end_key(gb_tokenizer_t *tokenizer)
+{
+    int ret = emit(tokenizer, '\0');
+    // Key is only added to the field list when the value is complete
+    tokenizer->value_start = tokenizer->buf_used;
+    return ret;
+}
+
+static int end_value(gb_tokenizer_t *tokenizer, bool is_string)
+{
+    gb_field_t *field;
+    size_t decoded_len;
+
+    if (tokenizer->streaming) {
+        tokenizer->streaming = false;
+        flush_chunk(tokenizer, GB_TOKENIZER_CHUNK_END);
+        // Streamed values are not passed on as fields, drop the key.
+        tokenizer->buf_used = tokenizer->key_start;
+        tokenizer->state = STATE_AFTER_VALUE;
+        return 0;
+    }
+
+    if (is_string && tokenizer->atob) {
+        // Decoded data is always shorter than the base64 text, decode in place.
+        if (base64_decode(&tokenizer->buf[tokenizer->value_start], tokenizer->buf_used - tokenizer->value_start,
+                          &decoded_len, &tokenizer->buf[tokenizer->value_start],
+                          tokenizer->buf_used - tokenizer->value_start) != 0) {
+            decoded_len = 0;
+        }
+        tokenizer->buf_used = tokenizer->value_start + decoded_len;
+    }
+
+    if (tokenizer->num_fields == GB_TOKENIZER_MAX_FIELDS) {
+        // No room for more fields, drop it.
+        tokenizer->buf_used = tokenizer->key_start;
+        tokenizer->state = STATE_AFTER_VALUE;
+        return 0;
+    }
+
+    field = &tokenizer->fields[tokenizer->num_fields++];
+    field->key = (char *)&tokenizer->buf[tokenizer->key_start];
+    field->value = (char *)&tokenizer->buf[tokenizer->value_start];
+    field->value_len = tokenizer->buf_used - tokenizer->value_start;
+    field->is_string = is_string;
+    tokenizer->state = STATE_AFTER_VALUE;
+
+    return emit(tokenizer, '\0');
+}
+
+static void end_object(gb_tokenizer_t *tokenizer)
+{
+    tokenizer->state = STATE_WAIT_GB;
+    tokenizer->match_index = 0;
+    if (tokenizer->object_cb) {
+        tokenizer->object_cb(tokenizer->fields, tokenizer->num_fields);
+    }
+}
+
+static int process_string_char(gb_tokenizer_t *tokenizer, uint8_t c)
+{
+    if (c == '"') {
+        return end_value(tokenizer, true);
+    } else if (c == '\\' && !tokenizer->atob) {
+        tokenizer->state = STATE_STRING_ESCAPE;
+        return 0;
+    } else if (c >= 0x80) {
+        // Gadgetbridge sends Latin-1 characters as a single byte
+        return emit_utf8(tokenizer, c);
+    }
+    return emit(tokenizer, c);
+}
+
+static int process_escape_char(gb_tokenizer_t *tokenizer, uint8_t c)
+{
+    tokenizer->state = STATE_STRING;
+
+    switch (c) {
+        case 'x':
+        case 'u':
+            tokenizer->state = STATE_STRING_HEX;
+            tokenizer->hex_digits = c == 'x' ? 2 : 4;
+            tokenizer->hex_value = 0;
+            return 0;
+        case 'n':
+            return emit(tokenizer, '\n');
+        case 't':
+            return emit(tokenizer, '\t');
+        case 'r':
+            return emit(tokenizer, '\r');
+        case 'b':
+        case 'f':
+            return 0;
+        default:
+            // \" \\ \/ and anything unknown is the character itself
+            return emit(tokenizer, c);
+    }
+}
+
+static int process_hex_char(gb_tokenizer_t *tokenizer, uint8_t c)
+{
+    int value = hex_value(c);
+
+    if (value < 0) {
+        return -EINVAL;
+    }
+
+    tokenizer->hex_value = (tokenizer->hex_value << 4) | value;
+    if (--tokenizer->hex_digits == 0) {
+        tokenizer->state = STATE_STRING;
+        return emit_utf8(tokenizer, tokenizer->hex_value);
+    }
+    return 0;
+}
+
+static int process_nested_char(gb_tokenizer_t *tokenizer, uint8_t c)
+{
+    if (tokenizer->nested_in_string) {
+        if (tokenizer->nested_escape) {
+            tokenizer->nested_escape = false;
+        } else if (c == '\\') {
+            tokenizer->nested_escape = true;
+        } else if (c == '"') {
+            tokenizer->nested_in_string = false;
+        }
+    } else if (c == '"') {
+        tokenizer->nested_in_string = true;
+    } else if (c == '{' || c == '[') {
+        tokenizer->nested_depth++;
+    } else if (c == '}' || c == ']') {
+        if (--tokenizer->nested_depth == 0) {
+            // Nested values are not passed on, drop the key.
+            tokenizer->buf_used = tokenizer->key_start;
+            tokenizer->state = STATE_AFTER_VALUE;
+        }
+    }
+    return 0;
+}
+
+static int process_char(gb_tokenizer_t *tokenizer, uint8_t c)
+{
+    switch (tokenizer->state) {
+        case STATE_WAIT_GB:
+            if (c == gb_start[tokenizer->match_index]) {
+                tokenizer->match_index++;
+                if (tokenizer->match_index == strlen(gb_start)) {
+                    tokenizer->state = STATE_WAIT_OBJECT;
+                }
+            } else {
+                tokenizer->match_index = c == gb_start[0] ? 1 : 0;
+            }
+            return 0;
+        case STATE_WAIT_OBJECT:
+            if (c == '{') {
+                begin_object(tokenizer);
+                return 0;
+            }
+            return is_whitespace(c) ? 0 : -EINVAL;
+        case STATE_WAIT_KEY:
+            if (is_whitespace(c) || c == ',') {
+                return 0;
+            }
+            if (c == '}') {
+                end_object(tokenizer);
+                return 0;
+            }
+            tokenizer->key_start = tokenizer->buf_used;
+            if (c == '"') {
+                tokenizer->state = STATE_KEY;
+                return 0;
+            } else if (is_key_char(c)) {
+                tokenizer->state = STATE_BARE_KEY;
+                return emit(tokenizer, c);
+            }
+            return -EINVAL;
+        case STATE_KEY:
+            if (c == '"') {
+                tokenizer->state = STATE_WAIT_COLON;
+                return end_key(tokenizer);
+            }
+            return emit(tokenizer, c);
+        case STATE_BARE_KEY:
+            if (is_key_char(c)) {
+                return emit(tokenizer, c);
+            }
+            if (c == ':') {
+                tokenizer->state = STATE_WAIT_VALUE;
+                return end_key(tokenizer);
+            } else if (is_whitespace(c)) {
+                tokenizer->state = STATE_WAIT_COLON;
+                return end_key(tokenizer);
+            }
+            return -EINVAL;
+        case STATE_WAIT_COLON:
+            if (c == ':') {
+                tokenizer->state = STATE_WAIT_VALUE;
+                return 0;
+            }
+            return is_whitespace(c) ? 0 : -EINVAL;
+        case STATE_WAIT_VALUE:
+            tokenizer->atob = false;
+            if (is_whitespace(c)) {
+                return 0;
+            } else if (c == '"') {
+                tokenizer->state = STATE_STRING;
+                tokenizer->streaming = tokenizer->stream_begin_cb &&
+                                       tokenizer->stream_begin_cb(tokenizer->fields, tokenizer->num_fields,
+                                                                  (char *)&tokenizer->buf[tokenizer->key_start]);
+                return 0;
+            } else if (c == atob_start[0]) {
+                tokenizer->state = STATE_ATOB;
+                tokenizer->match_index = 1;
+                return 0;
+            } else if (c == '{' || c == '[') {
+                tokenizer->state = STATE_NESTED;
+                tokenizer->nested_depth = 1;
+                tokenizer->nested_in_string = false;
+                tokenizer->nested_escape = false;
+                return 0;
+            } else if (c == ',' || c == '}') {
+                return -EINVAL;
+            }
+            // Number, true, false or null
+            tokenizer->state = STATE_LITERAL;
+            return emit(tokenizer, c);
+        case STATE_ATOB:
+            if (c != atob_start[tokenizer->match_index]) {
+                return -EINVAL;
+            }
+            tokenizer->match_index++;
+            if (tokenizer->match_index == strlen(atob_start)) {
+                tokenizer->state = STATE_STRING;
+                tokenizer->atob = true;
+            }
+            return 0;
+        case STATE_STRING:
+            return process_string_char(tokenizer, c);
+        case STATE_STRING_ESCAPE:
+            return process_escape_char(tokenizer, c);
+        case STATE_STRING_HEX:
+            return process_hex_char(tokenizer, c);
+        case STATE_LITERAL:
+            if (is_whitespace(c) || c == ',' || c == '}' || c == ')') {
+                int ret = end_value(tokenizer, false);
+                return ret ? ret : process_char(tokenizer, c);
+            }
+            return emit(tokenizer, c);
+        case STATE_NESTED:
+            return process_nested_char(tokenizer, c);
+        case STATE_AFTER_VALUE:
+            if (is_whitespace(c) || c == ')') {
+                // ) closes atob(
+                return 0;
+            } else if (c == ',') {
+                tokenizer->state = STATE_WAIT_KEY;
+                return 0;
+            } else if (c == '}') {
+                end_object(tokenizer);
+                return 0;
+            }
+            return -EINVAL;
+        default:
+            return -EINVAL;
+    }
+}
+
+void gb_tokenizer_init(gb_tokenizer_t *tokenizer, uint8_t *buf, uint16_t buf_size,
+                       gb_tokenizer_object_cb_t object_cb)
+{
+    memset(tokenizer, 0, sizeof(gb_tokenizer_t));
+    tokenizer->buf = buf;
+    tokenizer->buf_size = buf_size;
+    tokenizer->object_cb = object_cb;
+    gb_tokenizer_reset(tokenizer);
+}
+
+void gb_tokenizer_set_stream_cb(gb_tokenizer_t *tokenizer, gb_tokenizer_stream_begin_cb_t stream_begin_cb,
+                                gb_tokenizer_chunk_cb_t chunk_cb)
+{
+    tokenizer->stream_begin_cb = stream_begin_cb;
+    tokenizer->chunk_cb = chunk_cb;
+}
+
+void gb_tokenizer_reset(gb_tokenizer_t *tokenizer)
+{
+    if (tokenizer->streaming) {
+        tokenizer->streaming = false;
+        tokenizer->chunk_cb(GB_TOKENIZER_CHUNK_ABORT, NULL, 0);
+    }
+    tokenizer->state = STATE_WAIT_GB;
+    tokenizer->match_index = 0;
+    tokenizer->buf_used = 0;
+    tokenizer->num_fields = 0;
+}
+
+bool gb_tokenizer_is_idle(const gb_tokenizer_t *tokenizer)
+{
+    return tokenizer->state == STATE_WAIT_GB;
+}
+
+int gb_tokenizer_feed(gb_tokenizer_t *tokenizer, const uint8_t *data, size_t len)
+{
+    int ret;
+    int err = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        ret = process_char(tokenizer, data[i]);
+        if (ret != 0) {
+            err = ret;
+            gb_tokenizer_reset(tokenizer);
+        }
+    }
+
+    return err;
+}
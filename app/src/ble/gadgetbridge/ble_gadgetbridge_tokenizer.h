@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define GB_TOKENIZER_MAX_FIELDS     24
+
+typedef struct gb_field {
+    char *key;          // Null terminated
+    char *value;        // Null terminated, strings are unescaped, UTF-8 and base64 decoded
+    uint16_t value_len;
+    bool is_string;
+} gb_field_t;
+
+/** @brief Called for every complete GB({...}) object with its top level fields.
+ *         Nested objects and arrays are skipped. Fields are only valid during the callback,
+ *         but may be modified by it.
+*/
+typedef void (*gb_tokenizer_object_cb_t)(gb_field_t *fields, int num_fields);
+
+typedef enum gb_tokenizer_chunk {
+    GB_TOKENIZER_CHUNK_DATA,    // Part of the value, more follows
+    GB_TOKENIZER_CHUNK_END,     // Last part of the value
+    GB_TOKENIZER_CHUNK_ABORT,   // The object was malformed, drop what was received of the value
+} gb_tokenizer_chunk_t;
+
+/** @brief Called when a string value starts, with the fields received so far in the object.
+ *  @return true to receive the value in chunks instead of as a field, so it can be larger than the buffer.
+*/
+typedef bool (*gb_tokenizer_stream_begin_cb_t)(const gb_field_t *fields, int num_fields, const char *key);
+
+/** @brief Called with the unescaped parts of a streamed value. The data is null terminated and only valid during the
+ *         callback. A chunk may end in the middle of a UTF-8 sequence.
+*/
+typedef void (*gb_tokenizer_chunk_cb_t)(gb_tokenizer_chunk_t type, char *data, uint16_t len);
+
+typedef struct gb_tokenizer {
+    uint8_t state;
+    uint8_t match_index;
+    uint8_t nested_depth;
+    uint8_t hex_digits;
+    uint16_t hex_value;
+    bool nested_in_string;
+    bool nested_escape;
+    bool atob;
+    bool streaming;
+    uint16_t key_start;
+    uint16_t value_start;
+    uint8_t *buf;
+    uint16_t buf_size;
+    uint16_t buf_used;
+    int num_fields;
+    gb_field_t fields[GB_TOKENIZER_MAX_FIELDS];
+    gb_tokenizer_object_cb_t object_cb;
+    gb_tokenizer_stream_begin_cb_t stream_begin_cb;
+    gb_tokenizer_chunk_cb_t chunk_cb;
+} gb_tokenizer_t;
+
+/** @brief Init the tokenizer.
+ *  @param tokenizer Tokenizer to init.
+ *  @param buf Buffer for decoded keys and values of one object.
+ *  @param buf_size Size of buf.
+ *  @param object_cb Called for every complete object.
+*/
+void gb_tokenizer_init(gb_tokenizer_t *tokenizer, uint8_t *buf, uint16_t buf_size,
+                       gb_tokenizer_object_cb_t object_cb);
+
+/** @brief Set callbacks for receiving string values in chunks while they are received.
+ *  @param tokenizer Tokenizer.
+ *  @param stream_begin_cb Decides which values to stream.
+ *  @param chunk_cb Called with the parts of streamed values.
+*/
+void gb_tokenizer_set_stream_cb(gb_tokenizer_t *tokenizer, gb_tokenizer_stream_begin_cb_t stream_begin_cb,
+                                gb_tokenizer_chunk_cb_t chunk_cb);
+
+/** @brief Drop any partially received object and wait for the next GB(.
+*/
+void gb_tokenizer_reset(gb_tokenizer_t *tokenizer);
+
+/** @brief Check if the tokenizer is between objects.
+ *  @return true if waiting for GB(, false if in the middle of an object.
+*/
+bool gb_tokenizer_is_idle(const gb_tokenizer_t *tokenizer);
+
+/** @brief Feed received data, can be split at any byte. Every byte is looked at once.
+ *  @param tokenizer Tokenizer.
+ *  @param data Received data.
+ *  @param len Length of data.
+ *  @return 0 on success, -EINVAL if the data is malformed or -ENOMEM if an object does not fit in the buffer.
+ *          On error the object is dropped and the rest of data is searched for the next GB(.
+*/
+int gb_tokenizer_feed(gb_tokenizer_t *tokenizer, const uint8_t *data, size_t len);
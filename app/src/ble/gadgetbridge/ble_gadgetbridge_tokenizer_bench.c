@@ -0,0 +1,348 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Test and benchmark of the Gadgetbridge tokenizer on native_posix, run with:
+ *   zephyr.exe --gb-tokenizer-bench=1000
+ * Feeds recorded Gadgetbridge traffic split at every possible fragment size and checks the decoded fields, checks
+ * that malformed and too large messages are dropped without affecting the next message, and that streamed values
+ * are received in full. Then feeds the traffic the given number of times in BLE sized fragments and prints the
+ * throughput in bytes and the peak stack used by gb_tokenizer_feed. Exits with 0 when all checks passed.
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+
+#include "zsw_bench.h"
+#include "ble_gadgetbridge.h"
+#include "ble_gadgetbridge_tokenizer.h"
+
+// Payload of a notification with the default ATT MTU of 23 bytes.
+#define BENCH_FRAGMENT_LEN  20
+#define STREAM_BUF_LEN      64
+#define STACK_PAINT_LEN     4096
+#define STACK_PAINT_BYTE    0xA5
+
+typedef struct recorded_message_t {
+    const char *data;
+    const char *fields[2 * GB_TOKENIZER_MAX_FIELDS + 1];    // Expected key and value pairs, NULL terminated
+} recorded_message_t;
+
+// Messages as sent by Gadgetbridge, each starting with a DLE byte.
+static const recorded_message_t recorded_traffic[] = {
+    {
+        "\x10GB({t:\"notify\",id:1717002933,src:\"Messenger\",title:\"Anna\",body:\"Lunch at the caf\xe9 at 12?\"})\n",
+        {
+            "t", "notify", "id", "1717002933", "src", "Messenger", "title", "Anna",
+            "body", "Lunch at the caf\xc3\xa9 at 12?", NULL
+        }
+    },
+    {
+        "\x10GB({t:\"notify\",id:1717002934,src:\"Gmail\",title:\"jakob@mail.se\",sender:\"Jakob\","
+        "subject:\"Re: \\\"Release\\\"\",body:\"Hej d\\u00e5 \\u2764\\nSee \\xe4 attached\"})\n",
+        {
+            "t", "notify", "id", "1717002934", "src", "Gmail", "title", "jakob@mail.se", "sender", "Jakob",
+            "subject", "Re: \"Release\"", "body", "Hej d\xc3\xa5 \xe2\x9d\xa4\nSee \xc3\xa4 attached", NULL
+        }
+    },
+    {
+        "\x10GB({t:\"notify\",id:1717002935,src:\"Signal\",title:atob(\"R3JvdXAgY2hhdA==\"),"
+        "body:atob(\"SGVsbG8gd29ybGQh\")})\n",
+        { "t", "notify", "id", "1717002935", "src", "Signal", "title", "Group chat", "body", "Hello world!", NULL }
+    },
+    {
+        "\x10GB({t:\"notify-\",id:1717002933})\n",
+        { "t", "notify-", "id", "1717002933", NULL }
+    },
+    {
+        "\x10GB({t:\"musicinfo\",artist:\"Ava Max\",album:\"Heaven & Hell\",track:\"Sweet but Psycho\","
+        "dur:187,c:-1,n:-1})\n",
+        {
+            "t", "musicinfo", "artist", "Ava Max", "album", "Heaven & Hell", "track", "Sweet but Psycho", "dur", "187",
+            "c", "-1", "n", "-1", NULL
+        }
+    },
+    {
+        "\x10GB({t:\"musicstate\",state:\"play\",position:37,shuffle:1,repeat:0})\n",
+        { "t", "musicstate", "state", "play", "position", "37", "shuffle", "1", "repeat", "0", NULL }
+    },
+    {
+        "\x10GB({t:\"weather\",temp:268,hi:271,lo:265,hum:97,rain:20,uv:1,code:802,txt:\"slightly cloudy\",wind:2.0,"
+        "wdir:14,loc:\"MALMO\",f:[{hi:272,lo:266,code:800,txt:\"clear {sky}\"},{hi:270,lo:264,code:600}]})\n",
+        {
+            "t", "weather", "temp", "268", "hi", "271", "lo", "265", "hum", "97", "rain", "20", "uv", "1",
+            "code", "802",
+            "txt", "slightly cloudy", "wind", "2.0", "wdir", "14", "loc", "MALMO", NULL
+        }
+    },
+    {
+        "\x10GB({\"t\":\"gps\",\"lat\":55.6135542,\"lon\":12.9747185,\"alt\":41.900001525878906,"
+        "\"speed\":0.1458607256412506,\"time\":1717002933835,\"satellites\":0,\"hdop\":16.215999603271484,"
+        "\"externalSource\":true,\"gpsSource\":\"network\"})\n",
+        {
+            "t", "gps", "lat", "55.6135542", "lon", "12.9747185", "alt", "41.900001525878906",
+            "speed", "0.1458607256412506", "time", "1717002933835", "satellites", "0", "hdop", "16.215999603271484",
+            "externalSource", "true", "gpsSource", "network", NULL
+        }
+    },
+    {
+        "\x10GB({\"t\":\"http\",\"id\":\"42\",\"resp\":\"{\\\"response_code\\\":0,\\\"results\\\":[{\\\"type\\\":"
+        "\\\"boolean\\\",\\\"question\\\":\\\"Hungary is the only country in the world beginning with H.\\\"}]}\"})\n",
+        {
+            "t", "http", "id", "42", "resp", "{\"response_code\":0,\"results\":[{\"type\":\"boolean\",\"question\":"
+            "\"Hungary is the only country in the world beginning with H.\"}]}", NULL
+        }
+    },
+    {
+        "\x10GB({t:\"call\",cmd:\"incoming\",name:\"Mom\",number:\"+46701234567\"})\n",
+        { "t", "call", "cmd", "incoming", "name", "Mom", "number", "+46701234567", NULL }
+    },
+};
+
+static uint32_t bench_count;
+static gb_tokenizer_t tokenizer;
+static uint8_t buf[MAX_GB_PACKET_LENGTH];
+static const recorded_message_t *expected;
+static uint32_t num_objects;
+static uint32_t num_errors;
+static char stream_data[MAX_GB_PACKET_LENGTH];
+static uint16_t stream_len;
+static bool stream_ended;
+static uintptr_t painted_start;
+
+static struct args_struct_t bench_options[] = {
+    {
+        .option = "gb-tokenizer-bench",
+        .name = "iterations",
+        .type = 'u',
+        .dest = (void *) &bench_count,
+        .descript = "Test the Gadgetbridge tokenizer, then feed recorded traffic this many times, exits when done"
+    },
+    ARG_TABLE_ENDMARKER
+};
+
+static void check_object_cb(gb_field_t *fields, int num_fields)
+{
+    int num_expected = 0;
+
+    num_objects++;
+    if (expected == NULL) {
+        return;
+    }
+
+    while (expected->fields[2 * num_expected] != NULL) {
+        num_expected++;
+    }
+    if (num_fields != num_expected) {
+        printk("Expected %d fields, got %d: %s\n", num_expected, num_fields, expected->data + 1);
+        num_errors++;
+        return;
+    }
+
+    for (int i = 0; i < num_fields; i++) {
+        const char *key = expected->fields[2 * i];
+        const char *value = expected->fields[2 * i + 1];
+
+        if (strcmp(fields[i].key, key) != 0 || strcmp(fields[i].value, value) != 0 ||
+            fields[i].value_len != strlen(value)) {
+            printk("Expected %s:%s, got %s:%s\n", key, value, fields[i].key, fields[i].value);
+            num_errors++;
+            return;
+        }
+    }
+}
+
+static bool stream_begin_cb(const gb_field_t *fields, int num_fields, const char *key)
+{
+    stream_len = 0;
+    stream_ended = false;
+
+    return strcmp(key, "resp") == 0;
+}
+
+static void stream_chunk_cb(gb_tokenizer_chunk_t type, char *data, uint16_t len)
+{
+    if (type == GB_TOKENIZER_CHUNK_ABORT || stream_len + len >= sizeof(stream_data)) {
+        num_errors++;
+        return;
+    }
+    memcpy(&stream_data[stream_len], data, len);
+    stream_len += len;
+    stream_data[stream_len] = '\0';
+    stream_ended = type == GB_TOKENIZER_CHUNK_END;
+}
+
+static int feed_fragments(const char *data, size_t len, size_t fragment_len)
+{
+    int err = 0;
+
+    for (size_t offset = 0; offset < len; offset += fragment_len) {
+        int ret = gb_tokenizer_feed(&tokenizer, (const uint8_t *)&data[offset], MIN(fragment_len, len - offset));
+
+        err = ret ? ret : err;
+    }
+
+    return err;
+}
+
+static int test_recorded_traffic(void)
+{
+    gb_tokenizer_init(&tokenizer, buf, sizeof(buf), check_object_cb);
+
+    for (int i = 0; i < ARRAY_SIZE(recorded_traffic); i++) {
+        size_t len = strlen(recorded_traffic[i].data);
+
+        expected = &recorded_traffic[i];
+        // Every split of the message into fragments must give the same fields.
+        for (size_t fragment_len = 1; fragment_len <= len; fragment_len++) {
+            num_objects = 0;
+            if (feed_fragments(expected->data, len, fragment_len) != 0 || num_objects != 1 ||
+                !gb_tokenizer_is_idle(&tokenizer)) {
+                printk("Failed message %d in %zu byte fragments\n", i, fragment_len);
+                num_errors++;
+                break;
+            }
+        }
+    }
+
+    return num_errors == 0 ? 0 : 1;
+}
+
+static int test_dropped_messages(void)
+{
+    static char large_message[MAX_GB_PACKET_LENGTH + 64];
+    const char *malformed = "\x10GB({t:\"notify\" id:1,body:\"lost\"})\n";
+    const recorded_message_t *next = &recorded_traffic[3];
+    int ret;
+
+    gb_tokenizer_init(&tokenizer, buf, sizeof(buf), check_object_cb);
+    expected = next;
+
+    // The next message in the same data is still parsed after the malformed one.
+    num_objects = 0;
+    ret = gb_tokenizer_feed(&tokenizer, (const uint8_t *)malformed, strlen(malformed));
+    if (ret != -EINVAL || feed_fragments(next->data, strlen(next->data), BENCH_FRAGMENT_LEN) != 0 ||
+        num_objects != 1) {
+        printk("Malformed message not dropped: %d, %d objects\n", ret, num_objects);
+        return 1;
+    }
+
+    // A value larger than the buffer drops the message.
+    num_objects = 0;
+    strcpy(large_message, "\x10GB({t:\"notify\",id:2,body:\"");
+    memset(&large_message[strlen(large_message)], 'a', sizeof(large_message) - strlen(large_message));
+    strcpy(&large_message[sizeof(large_message) - strlen("\"})\n") - 1], "\"})\n");
+    ret = feed_fragments(large_message, strlen(large_message), BENCH_FRAGMENT_LEN);
+    if (ret != -ENOMEM || num_objects != 0 || !gb_tokenizer_is_idle(&tokenizer) ||
+        feed_fragments(next->data, strlen(next->data), BENCH_FRAGMENT_LEN) != 0 || num_objects != 1) {
+        printk("Too large message not dropped: %d, %d objects\n", ret, num_objects);
+        return 1;
+    }
+
+    return num_errors == 0 ? 0 : 1;
+}
+
+static int test_streamed_value(void)
+{
+    static uint8_t small_buf[STREAM_BUF_LEN];
+    const recorded_message_t *http = &recorded_traffic[8];
+    const char *resp = http->fields[5];
+
+    // The response is larger than the buffer, so it is only received complete when streamed.
+    gb_tokenizer_init(&tokenizer, small_buf, sizeof(small_buf), NULL);
+    gb_tokenizer_set_stream_cb(&tokenizer, stream_begin_cb, stream_chunk_cb);
+    if (feed_fragments(http->data, strlen(http->data), BENCH_FRAGMENT_LEN) != 0 || !stream_ended ||
+        stream_len != strlen(resp) || strcmp(stream_data, resp) != 0) {
+        printk("Streamed value not received: %d of %zu bytes\n", stream_len, strlen(resp));
+        return 1;
+    }
+
+    return num_errors == 0 ? 0 : 1;
+}
+
+// native_posix runs threads on host stacks Zephyr does not track. Fill the stack below the caller with a pattern, the
+// deepest overwritten byte after calling the tokenizer is its peak usage.
+static __noinline void paint_stack(void)
+{
+    volatile uint8_t area[STACK_PAINT_LEN];
+
+    for (int i = 0; i < STACK_PAINT_LEN; i++) {
+        area[i] = STACK_PAINT_BYTE;
+    }
+    painted_start = (uintptr_t)area;
+}
+
+static __noinline size_t get_stack_used(uintptr_t stack_top)
+{
+    const volatile uint8_t *p = (const volatile uint8_t *)painted_start;
+
+    while ((uintptr_t)p < stack_top && *p == STACK_PAINT_BYTE) {
+        p++;
+    }
+
+    return stack_top - (uintptr_t)p;
+}
+
+static __noinline size_t measure_peak_stack(void)
+{
+    uintptr_t stack_top = (uintptr_t)__builtin_frame_address(0);
+
+    paint_stack();
+    for (int i = 0; i < ARRAY_SIZE(recorded_traffic); i++) {
+        feed_fragments(recorded_traffic[i].data, strlen(recorded_traffic[i].data), BENCH_FRAGMENT_LEN);
+    }
+
+    return get_stack_used(stack_top);
+}
+
+static int gb_tokenizer_bench(void)
+{
+    uint32_t num_bytes = 0;
+    int64_t start_us;
+    bool all_parsed;
+
+    if (bench_count == 0) {
+        return ZSW_BENCH_NOT_RUN;
+    }
+
+    if (test_recorded_traffic() != 0 || test_dropped_messages() != 0 || test_streamed_value() != 0) {
+        printk("Gadgetbridge tokenizer test failed, %d errors\n", num_errors);
+        return 1;
+    }
+    printk("Gadgetbridge tokenizer test passed\n");
+
+    expected = NULL;
+    gb_tokenizer_init(&tokenizer, buf, sizeof(buf), check_object_cb);
+    num_objects = 0;
+    start_us = zsw_bench_time_us();
+    for (uint32_t i = 0; i < bench_count; i++) {
+        for (int j = 0; j < ARRAY_SIZE(recorded_traffic); j++) {
+            size_t len = strlen(recorded_traffic[j].data);
+
+            feed_fragments(recorded_traffic[j].data, len, BENCH_FRAGMENT_LEN);
+            num_bytes += len;
+        }
+    }
+    zsw_bench_print_result("Tokenize (bytes)", num_bytes, zsw_bench_time_us() - start_us);
+    all_parsed = num_objects == bench_count * ARRAY_SIZE(recorded_traffic);
+    printk("Objects: %d of %d\n", num_objects, bench_count * ARRAY_SIZE(recorded_traffic));
+    printk("Peak stack in gb_tokenizer_feed: %zu bytes\n", measure_peak_stack());
+
+    return all_parsed ? 0 : 1;
+}
+
+ZSW_BENCH_DEFINE(gb_tokenizer_bench, 4096, bench_options, gb_tokenizer_bench);
@@ -19,6 +19,8 @@
 #include <zephyr/bluetooth/uuid.h>
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
 #include <zephyr/zbus/zbus.h>
 #include <zephyr/drivers/sensor.h>
 
@@ -35,8 +37,46 @@
 
 LOG_MODULE_REGISTER(zsw_gatt_sensor_server, CONFIG_ZSW_BLE_LOG_LEVEL);
 
+#define SENSOR_TICK_MS              100
+#define SENSOR_DEFAULT_PERIOD_MS    SENSOR_TICK_MS
+#define SENSOR_MAX_VALUES           3
+
+// Attribute index of the sensor value in every sensor service.
+#define SENSOR_ATTR_VALUE           2
+
+#define SENSOR_NUM_STREAM_VALUES    13
+
+#define STREAM_HEADER_LEN           (sizeof(uint32_t) + sizeof(uint8_t))
+#define STREAM_MAX_LEN              (STREAM_HEADER_LEN + SENSOR_NUM_STREAM_VALUES * sizeof(int16_t))
+#define STREAM_SUBSCRIBED           BIT(SENSOR_NUM)
+
+typedef enum sensor_id {
+    SENSOR_TEMPERATURE,
+    SENSOR_HUMIDITY,
+    SENSOR_PRESSURE,
+    SENSOR_ACCEL,
+    SENSOR_GYRO,
+    SENSOR_MAG,
+    SENSOR_LIGHT,
+    SENSOR_NUM
+} sensor_id_t;
+
+#define SENSOR_MASK_ALL             (BIT(SENSOR_NUM) - 1)
+
+typedef struct sensor_readings {
+    uint8_t valid_mask;
+    float values[SENSOR_NUM][SENSOR_MAX_VALUES];
+} sensor_readings_t;
+
 static ssize_t on_read(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len, uint16_t offset);
+static ssize_t on_period_read(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                              uint16_t offset);
+static ssize_t on_period_write(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf, uint16_t len,
+                               uint16_t offset, uint8_t flags);
+static ssize_t on_stream_write(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf, uint16_t len,
+                               uint16_t offset, uint8_t flags);
 static void on_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value);
+static void on_stream_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value);
 static void disconnected(struct bt_conn *conn, uint8_t reason);
 
 static void zbus_periodic_fast_callback(const struct zbus_channel *chan);
@@ -54,200 +94,358 @@ BT_CONN_CB_DEFINE(conn_callbacks) = {
 #define ZSW_GATT_READ_WRITE_PERM    BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT
 #endif
 
-BT_GATT_SERVICE_DEFINE(temp_service,
-                       BT_GATT_PRIMARY_SERVICE(ADAFRUIT_SERVICE_TEMPERATURE),
-                       BT_GATT_CHARACTERISTIC(ADAFRUIT_CHAR_TEMPERATURE,
-                                              BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_WRITE_WITHOUT_RESP | BT_GATT_CHRC_READ,
-                                              ZSW_GATT_READ_WRITE_PERM,
-                                              on_read, NULL, NULL),
-                       BT_GATT_CCC(on_ccc_cfg_changed, ZSW_GATT_READ_WRITE_PERM)
-                      );
+#define ZSW_SENSOR_CHRC_PROPS       BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_WRITE_WITHOUT_RESP | BT_GATT_CHRC_READ
+
+// Adafruit sensor service, the measurement period sets how often the sensor is notified.
+#define ZSW_SENSOR_SERVICE_DEFINE(_name, _service_uuid, _char_uuid)                                                 \
+    BT_GATT_SERVICE_DEFINE(_name,                                                                                   \
+                           BT_GATT_PRIMARY_SERVICE(_service_uuid),                                                  \
+                           BT_GATT_CHARACTERISTIC(_char_uuid,                                                       \
+                                                  ZSW_SENSOR_CHRC_PROPS,                                            \
+                                                  ZSW_GATT_READ_WRITE_PERM,                                         \
+                                                  on_read, NULL, NULL),                                             \
+                           BT_GATT_CCC(on_ccc_cfg_changed, ZSW_GATT_READ_WRITE_PERM),                               \
+                           BT_GATT_CHARACTERISTIC(ADAFRUIT_MEASUREMENT_PERIOD_ID,                                   \
+                                                  BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,                           \
+                                                  ZSW_GATT_READ_WRITE_PERM,                                         \
+                                                  on_period_read, on_period_write, NULL)                            \
+                          )
+
+ZSW_SENSOR_SERVICE_DEFINE(temp_service, ADAFRUIT_SERVICE_TEMPERATURE, ADAFRUIT_CHAR_TEMPERATURE);
+ZSW_SENSOR_SERVICE_DEFINE(accel_service, ADAFRUIT_SERVICE_ACCEL, ADAFRUIT_CHAR_ACCEL);
+ZSW_SENSOR_SERVICE_DEFINE(humidity_service, ADAFRUIT_SERVICE_HUMIDITY, ADAFRUIT_CHAR_HUMIDITY);
+ZSW_SENSOR_SERVICE_DEFINE(pressure_service, ADAFRUIT_SERVICE_PRESSURE, ADAFRUIT_CHAR_PRESSURE);
+ZSW_SENSOR_SERVICE_DEFINE(mag_service, ADAFRUIT_SERVICE_MAG, ADAFRUIT_CHAR_MAG);
+ZSW_SENSOR_SERVICE_DEFINE(gyro_service, ADAFRUIT_SERVICE_GYRO, ADAFRUIT_CHAR_GYRO);
+ZSW_SENSOR_SERVICE_DEFINE(light_service, ADAFRUIT_SERVICE_LIGHT, ADAFRUIT_CHAR_LIGHT);
 
-BT_GATT_SERVICE_DEFINE(accel_service,
-                       BT_GATT_PRIMARY_SERVICE(ADAFRUIT_SERVICE_ACCEL),
-                       BT_GATT_CHARACTERISTIC(ADAFRUIT_CHAR_ACCEL,
-                                              BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_WRITE_WITHOUT_RESP | BT_GATT_CHRC_READ,
+/*
+ * Every notification on the stream characteristic is one little endian frame:
+ *   uint32 timestamp in ms since boot
+ *   uint8  bitmask of the sensors in the frame, bit index is sensor_id_t
+ *   int16  values of the sensors in the bitmask, in sensor_id_t order:
+ *          temperature 0.01 C, humidity 0.01 %, pressure 10 Pa, accel x,y,z 0.01 m/s2,
+ *          gyro x,y,z 0.1 deg/s, mag x,y,z mG, light lux
+ * A sensor is in the frame when its measurement period has passed. Write a uint8 bitmask to the
+ * characteristic to select sensors for the connection, default is all.
+ */
+BT_GATT_SERVICE_DEFINE(stream_service,
+                       BT_GATT_PRIMARY_SERVICE(ZSW_SERVICE_SENSOR_STREAM),
+                       BT_GATT_CHARACTERISTIC(ZSW_CHAR_SENSOR_STREAM,
+                                              BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_WRITE_WITHOUT_RESP,
                                               ZSW_GATT_READ_WRITE_PERM,
-                                              on_read, NULL, NULL),
-                       BT_GATT_CCC(on_ccc_cfg_changed, ZSW_GATT_READ_WRITE_PERM)
+                                              NULL, on_stream_write, NULL),
+                       BT_GATT_CCC(on_stream_ccc_cfg_changed, ZSW_GATT_READ_WRITE_PERM)
                       );
 
-BT_GATT_SERVICE_DEFINE(humidity_service,
-                       BT_GATT_PRIMARY_SERVICE(ADAFRUIT_SERVICE_HUMIDITY),
-                       BT_GATT_CHARACTERISTIC(ADAFRUIT_CHAR_HUMIDITY,
-                                              BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_WRITE_WITHOUT_RESP | BT_GATT_CHRC_READ,
-                                              ZSW_GATT_READ_WRITE_PERM,
-                                              on_read, NULL, NULL),
-                       BT_GATT_CCC(on_ccc_cfg_changed, ZSW_GATT_READ_WRITE_PERM)
-                      );
+static const struct bt_gatt_service_static *sensor_services[SENSOR_NUM] = {
+    [SENSOR_TEMPERATURE] = &temp_service,
+    [SENSOR_HUMIDITY] = &humidity_service,
+    [SENSOR_PRESSURE] = &pressure_service,
+    [SENSOR_ACCEL] = &accel_service,
+    [SENSOR_GYRO] = &gyro_service,
+    [SENSOR_MAG] = &mag_service,
+    [SENSOR_LIGHT] = &light_service,
+};
 
-BT_GATT_SERVICE_DEFINE(pressure_service,
-                       BT_GATT_PRIMARY_SERVICE(ADAFRUIT_SERVICE_PRESSURE),
-                       BT_GATT_CHARACTERISTIC(ADAFRUIT_CHAR_PRESSURE,
-                                              BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_WRITE_WITHOUT_RESP | BT_GATT_CHRC_READ,
-                                              ZSW_GATT_READ_WRITE_PERM,
-                                              on_read, NULL, NULL),
-                       BT_GATT_CCC(on_ccc_cfg_changed, ZSW_GATT_READ_WRITE_PERM)
-                      );
+static const uint8_t sensor_num_values[SENSOR_NUM] = {
+    [SENSOR_TEMPERATURE] = 1,
+    [SENSOR_HUMIDITY] = 1,
+    [SENSOR_PRESSURE] = 1,
+    [SENSOR_ACCEL] = 3,
+    [SENSOR_GYRO] = 3,
+    [SENSOR_MAG] = 3,
+    [SENSOR_LIGHT] = 1,
+};
 
-BT_GATT_SERVICE_DEFINE(mag_service,
-                       BT_GATT_PRIMARY_SERVICE(ADAFRUIT_SERVICE_MAG),
-                       BT_GATT_CHARACTERISTIC(ADAFRUIT_CHAR_MAG,
-                                              BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_WRITE_WITHOUT_RESP | BT_GATT_CHRC_READ,
-                                              ZSW_GATT_READ_WRITE_PERM,
-                                              on_read, NULL, NULL),
-                       BT_GATT_CCC(on_ccc_cfg_changed, ZSW_GATT_READ_WRITE_PERM)
-                      );
+// Scale from the sensor API unit to the stream unit.
+static const float sensor_stream_scale[SENSOR_NUM] = {
+    [SENSOR_TEMPERATURE] = 100.0f,
+    [SENSOR_HUMIDITY] = 100.0f,
+    [SENSOR_PRESSURE] = 100.0f,                     // kPa
+    [SENSOR_ACCEL] = 100.0f,
+    [SENSOR_GYRO] = 10.0f * 180.0f / 3.14159265f,   // rad/s
+    [SENSOR_MAG] = 1000.0f,                         // Gauss
+    [SENSOR_LIGHT] = 1.0f,
+};
 
-BT_GATT_SERVICE_DEFINE(gyro_service,
-                       BT_GATT_PRIMARY_SERVICE(ADAFRUIT_SERVICE_GYRO),
-                       BT_GATT_CHARACTERISTIC(ADAFRUIT_CHAR_GYRO,
-                                              BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_WRITE_WITHOUT_RESP | BT_GATT_CHRC_READ,
-                                              ZSW_GATT_READ_WRITE_PERM,
-                                              on_read, NULL, NULL),
-                       BT_GATT_CCC(on_ccc_cfg_changed, ZSW_GATT_READ_WRITE_PERM)
-                      );
-BT_GATT_SERVICE_DEFINE(light_service,
-                       BT_GATT_PRIMARY_SERVICE(ADAFRUIT_SERVICE_LIGHT),
-                       BT_GATT_CHARACTERISTIC(ADAFRUIT_CHAR_LIGHT,
-                                              BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_WRITE_WITHOUT_RESP | BT_GATT_CHRC_READ,
-                                              ZSW_GATT_READ_WRITE_PERM,
-                                              on_read, NULL, NULL),
-                       BT_GATT_CCC(on_ccc_cfg_changed, ZSW_GATT_READ_WRITE_PERM)
-                      );
+// Bit per sensor_id_t with notifications on for any connection, and STREAM_SUBSCRIBED.
+static atomic_t subscribed_mask;
+static bool streaming;
+static uint16_t period_ticks[SENSOR_NUM] = {
+    [0 ... SENSOR_NUM - 1] = SENSOR_DEFAULT_PERIOD_MS / SENSOR_TICK_MS
+};
+static uint8_t stream_masks[CONFIG_BT_MAX_CONN] = {
+    [0 ... CONFIG_BT_MAX_CONN - 1] = SENSOR_MASK_ALL
+};
+static uint32_t tick;
 
-static bool notif_enabled;
+static int get_sensor_id(const struct bt_gatt_attr *attr)
+{
+    for (int i = 0; i < SENSOR_NUM; i++) {
+        const struct bt_gatt_service_static *service = sensor_services[i];
+        if (attr >= service->attrs && attr < &service->attrs[service->attr_count]) {
+            return i;
+        }
+    }
+
+    return -ENOENT;
+}
+
+static int read_sensor(sensor_id_t id, float *values)
+{
+    float unused;
+    int ret;
+
+    switch (id) {
+        case SENSOR_TEMPERATURE:
+            return zsw_environment_sensor_get(&values[0], &unused, &unused);
+        case SENSOR_HUMIDITY:
+            return zsw_environment_sensor_get(&unused, &values[0], &unused);
+        case SENSOR_PRESSURE:
+            return zsw_environment_sensor_get(&unused, &unused, &values[0]);
+        case SENSOR_ACCEL:
+            return zsw_imu_fetch_accel_f(&values[0], &values[1], &values[2]);
+        case SENSOR_GYRO:
+            return zsw_imu_fetch_gyro_f(&values[0], &values[1], &values[2]);
+        case SENSOR_MAG:
+            ret = zsw_magnetometer_set_enable(true);
+            if (ret == 0) {
+                ret = zsw_magnetometer_get_all(&values[0], &values[1], &values[2]);
+                zsw_magnetometer_set_enable(false);
+            }
+            return ret;
+        case SENSOR_LIGHT:
+            return zsw_light_sensor_get_light(&values[0]);
+        default:
+            return -EINVAL;
+    }
+}
+
+static void read_sensors(sensor_readings_t *readings, uint8_t mask)
+{
+    float temperature;
+    float humidity;
+    float pressure;
+    uint8_t env_mask = BIT(SENSOR_TEMPERATURE) | BIT(SENSOR_HUMIDITY) | BIT(SENSOR_PRESSURE);
+
+    readings->valid_mask = 0;
+
+    // One environment sensor fetch gives all three.
+    if ((mask & env_mask) && zsw_environment_sensor_get(&temperature, &humidity, &pressure) == 0) {
+        readings->values[SENSOR_TEMPERATURE][0] = temperature;
+        readings->values[SENSOR_HUMIDITY][0] = humidity;
+        readings->values[SENSOR_PRESSURE][0] = pressure;
+        readings->valid_mask |= mask & env_mask;
+    }
+
+    for (int i = SENSOR_ACCEL; i < SENSOR_NUM; i++) {
+        if ((mask & BIT(i)) && read_sensor(i, readings->values[i]) == 0) {
+            readings->valid_mask |= BIT(i);
+        }
+    }
+}
 
 static ssize_t on_read(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len, uint16_t offset)
 {
-    int16_t x;
-    int16_t y;
-    int16_t z;
-    int write_len;
-    float temperature = 0.0;
-    float pressure = 0.0;
-    float humidity = 0.0;
-    float *f_ptr;
-
-    f_ptr = (float *)buf;
-    write_len = 0;
-
-    zsw_environment_sensor_get(&temperature, &humidity, &pressure);
-
-    if (bt_gatt_attr_get_handle(attr) == bt_gatt_attr_get_handle(&temp_service.attrs[2])) {
-        f_ptr[0] = temperature;
-        write_len = sizeof(float);
-    } else if (bt_gatt_attr_get_handle(attr) == bt_gatt_attr_get_handle(&accel_service.attrs[2])) {
-        zsw_imu_fetch_accel(&x, &y, &z);
-        f_ptr[0] = x;
-        f_ptr[1] = y;
-        f_ptr[2] = z;
-        write_len = 3 * sizeof(float);
-    } else if (bt_gatt_attr_get_handle(attr) == bt_gatt_attr_get_handle(&humidity_service.attrs[2])) {
-        f_ptr[0] = humidity;
-        write_len = sizeof(float);
-    } else if (bt_gatt_attr_get_handle(attr) == bt_gatt_attr_get_handle(&pressure_service.attrs[2])) {
-        f_ptr[0] = pressure;
-        write_len = sizeof(float);
-    } else if (bt_gatt_attr_get_handle(attr) == bt_gatt_attr_get_handle(&mag_service.attrs[2])) {
-        zsw_magnetometer_set_enable(true);
-        zsw_magnetometer_get_all(&f_ptr[0], &f_ptr[1], &f_ptr[2]);
-        zsw_magnetometer_set_enable(false);
-        write_len = 3 * sizeof(float);
-    } else if (bt_gatt_attr_get_handle(attr) == bt_gatt_attr_get_handle(&gyro_service.attrs[2])) {
-        zsw_imu_fetch_gyro(&x, &y, &z);
-        f_ptr[0] = x;
-        f_ptr[1] = y;
-        f_ptr[2] = z;
-        write_len = 3 * sizeof(float);
-    } else if (bt_gatt_attr_get_handle(attr) == bt_gatt_attr_get_handle(&light_service.attrs[2])) {
-        zsw_light_sensor_get_light(&f_ptr[0]);
-        write_len = sizeof(float);
-    }
-
-    return write_len;
+    int id = get_sensor_id(attr);
+    float values[SENSOR_MAX_VALUES];
+
+    if (id < 0 || read_sensor(id, values) != 0) {
+        return 0;
+    }
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, values, sensor_num_values[id] * sizeof(float));
 }
 
-static void on_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+static ssize_t on_period_read(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf, uint16_t len,
+                              uint16_t offset)
 {
-    ARG_UNUSED(attr);
+    int id = get_sensor_id(attr);
+    int32_t period_ms;
+
+    if (id < 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+    }
 
-    // TODO handle notifications per connection per service.
-    if (!notif_enabled && (value == BT_GATT_CCC_NOTIFY)) {
-        notif_enabled = true;
+    // -1 means the sensor is not measured, same as the Adafruit Bluefruit services.
+    period_ms = sys_cpu_to_le32(period_ticks[id] > 0 ? period_ticks[id] * SENSOR_TICK_MS : -1);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &period_ms, sizeof(period_ms));
+}
+
+static ssize_t on_period_write(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf, uint16_t len,
+                               uint16_t offset, uint8_t flags)
+{
+    int id = get_sensor_id(attr);
+    int32_t period_ms;
+
+    if (id < 0) {
+        return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+    }
+
+    if (offset != 0 || len != sizeof(int32_t)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    period_ms = (int32_t)sys_get_le32(buf);
+    period_ticks[id] = period_ms > 0 ? MIN(DIV_ROUND_UP(period_ms, SENSOR_TICK_MS), UINT16_MAX) : 0;
+    LOG_DBG("Sensor %d period %d ms", id, period_ticks[id] * SENSOR_TICK_MS);
+
+    return len;
+}
+
+static ssize_t on_stream_write(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf, uint16_t len,
+                               uint16_t offset, uint8_t flags)
+{
+    if (offset != 0 || len != sizeof(uint8_t)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    stream_masks[bt_conn_index(conn)] = ((const uint8_t *)buf)[0] & SENSOR_MASK_ALL;
+
+    return len;
+}
+
+static void update_streaming(void)
+{
+    bool enable = atomic_get(&subscribed_mask) != 0;
+
+    if (enable == streaming) {
+        return;
+    }
+    streaming = enable;
+
+    if (enable) {
+        tick = 0;
         zsw_imu_feature_enable(ZSW_IMU_FEATURE_GYRO, false);
         ble_comm_short_connection_interval();
         zsw_periodic_chan_add_obs(&periodic_event_100ms_chan, &azsw_gatt_sensor_server_lis);
-    } else if (notif_enabled && (value != BT_GATT_CCC_NOTIFY)) {
-        // If any char get notify off, then stop sending at all.
-        // TODO Keep track of which ones have notify on.
+    } else {
         ble_comm_long_connection_interval();
         zsw_periodic_chan_rm_obs(&periodic_event_100ms_chan, &azsw_gatt_sensor_server_lis);
         zsw_imu_feature_disable(ZSW_IMU_FEATURE_GYRO);
-        notif_enabled = false;
     }
 }
 
+static void on_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    int id = get_sensor_id(attr);
+
+    if (id < 0) {
+        return;
+    }
+
+    // Value is the combined value of all connections, per connection state is checked when sending.
+    if (value == BT_GATT_CCC_NOTIFY) {
+        atomic_set_bit(&subscribed_mask, id);
+    } else {
+        atomic_clear_bit(&subscribed_mask, id);
+    }
+    update_streaming();
+}
+
+static void on_stream_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+    ARG_UNUSED(attr);
+
+    if (value == BT_GATT_CCC_NOTIFY) {
+        atomic_or(&subscribed_mask, STREAM_SUBSCRIBED);
+    } else {
+        atomic_and(&subscribed_mask, ~STREAM_SUBSCRIBED);
+    }
+    update_streaming();
+}
+
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
-    // TODO Handle multiple connections
-    zsw_periodic_chan_rm_obs(&periodic_event_100ms_chan, &azsw_gatt_sensor_server_lis);
-    notif_enabled = false;
+    // The stack calls the CCC callbacks when a characteristic has no subscribed connection left.
+    stream_masks[bt_conn_index(conn)] = SENSOR_MASK_ALL;
+}
+
+static int pack_stream_frame(uint8_t *buf, const sensor_readings_t *readings, uint8_t mask)
+{
+    int len = STREAM_HEADER_LEN;
+
+    sys_put_le32(k_uptime_get_32(), buf);
+    buf[sizeof(uint32_t)] = mask;
+
+    for (int i = 0; i < SENSOR_NUM; i++) {
+        if (!(mask & BIT(i))) {
+            continue;
+        }
+        for (int j = 0; j < sensor_num_values[i]; j++) {
+            float value = readings->values[i][j] * sensor_stream_scale[i];
+            sys_put_le16((int16_t)CLAMP(value, INT16_MIN, INT16_MAX), &buf[len]);
+            len += sizeof(int16_t);
+        }
+    }
+
+    return len;
+}
+
+static void send_to_conn(struct bt_conn *conn, void *data)
+{
+    const sensor_readings_t *readings = data;
+    struct bt_gatt_notify_params params[SENSOR_NUM] = { 0 };
+    struct bt_conn_info info;
+    uint8_t stream_buf[STREAM_MAX_LEN];
+    uint8_t stream_mask;
+    int num_params = 0;
+    int len;
+
+    if (bt_conn_get_info(conn, &info) != 0 || info.state != BT_CONN_STATE_CONNECTED) {
+        return;
+    }
+
+    for (int i = 0; i < SENSOR_NUM; i++) {
+        const struct bt_gatt_attr *attr = &sensor_services[i]->attrs[SENSOR_ATTR_VALUE];
+        if ((readings->valid_mask & BIT(i)) && bt_gatt_is_subscribed(conn, attr, BT_GATT_CCC_NOTIFY)) {
+            params[num_params].attr = attr;
+            params[num_params].data = readings->values[i];
+            params[num_params].len = sensor_num_values[i] * sizeof(float);
+            num_params++;
+        }
+    }
+
+    // Sent in one ATT PDU when the client supports multiple handle value notifications.
+    if (num_params > 0) {
+        bt_gatt_notify_multiple(conn, num_params, params);
+    }
+
+    stream_mask = readings->valid_mask & stream_masks[bt_conn_index(conn)];
+    if (stream_mask != 0 && bt_gatt_is_subscribed(conn, &stream_service.attrs[2], BT_GATT_CCC_NOTIFY)) {
+        len = pack_stream_frame(stream_buf, readings, stream_mask);
+        if (len > bt_gatt_get_mtu(conn) - 3) {
+            LOG_WRN("Sensor stream frame does not fit in MTU %d", bt_gatt_get_mtu(conn));
+            return;
+        }
+        bt_gatt_notify(conn, &stream_service.attrs[1], stream_buf, len);
+    }
 }
 
 static void zbus_periodic_fast_callback(const struct zbus_channel *chan)
 {
-    int16_t x;
-    int16_t y;
-    int16_t z;
-    int write_len;
-    float *f_ptr;
-    float pressure = 0.0;
-    float humidity = 0.0;
-    float temperature = 0.0;
-    uint8_t buf[CONFIG_BT_L2CAP_TX_MTU];
-
-    f_ptr = (float *)buf;
-
-    // TODO use bt_gatt_notify_multiple instead of many bt_gatt_notify
-    zsw_environment_sensor_get(&temperature, &humidity, &pressure);
-    f_ptr[0] = temperature;
-    write_len = sizeof(float);
-    bt_gatt_notify(NULL, &temp_service.attrs[1], &buf, write_len);
-
-    f_ptr[0] = humidity;
-    write_len = sizeof(float);
-    bt_gatt_notify(NULL, &humidity_service.attrs[1], &buf, write_len);
-
-    f_ptr[0] = pressure;
-    write_len = sizeof(float);
-    bt_gatt_notify(NULL, &pressure_service.attrs[1], &buf, write_len);
-
-    if (zsw_imu_fetch_accel(&x, &y, &z) == 0) {
-        f_ptr[0] = x;
-        f_ptr[1] = y;
-        f_ptr[2] = z;
-        write_len = 3 * sizeof(float);
-        bt_gatt_notify(NULL, &accel_service.attrs[1], &buf, write_len);
-    }
-
-    if (zsw_imu_fetch_gyro(&x, &y, &z) == 0) {
-        f_ptr[0] = x;
-        f_ptr[1] = y;
-        f_ptr[2] = z;
-        write_len = 3 * sizeof(float);
-        bt_gatt_notify(NULL, &gyro_service.attrs[1], &buf, write_len);
-    }
-
-    if (zsw_magnetometer_set_enable(true) == 0) {
-        zsw_magnetometer_get_all(&f_ptr[0], &f_ptr[1], &f_ptr[2]);
-        zsw_magnetometer_set_enable(false);
-        write_len = 3 * sizeof(float);
-        bt_gatt_notify(NULL, &mag_service.attrs[1], &buf, write_len);
-    }
-
-    if (zsw_light_sensor_get_light(&f_ptr[0]) == 0) {
-        write_len = sizeof(float);
-        bt_gatt_notify(NULL, &light_service.attrs[1], &buf, write_len);
-    }
-}
\ No newline at end of file
+    sensor_readings_t readings;
+    atomic_val_t subscribed = atomic_get(&subscribed_mask);
+    uint8_t due_mask = 0;
+
+    for (int i = 0; i < SENSOR_NUM; i++) {
+        if (period_ticks[i] > 0 && (tick % period_ticks[i]) == 0) {
+            due_mask |= BIT(i);
+        }
+    }
+    tick++;
+
+    // Only read sensors somebody will get.
+    if (!(subscribed & STREAM_SUBSCRIBED)) {
+        due_mask &= subscribed;
+    }
+
+    if (due_mask == 0) {
+        return;
+    }
+
+    read_sensors(&readings, due_mask);
+    bt_conn_foreach(BT_CONN_TYPE_LE, send_to_conn, &readings);
+}
@@ -52,5 +52,9 @@
 
 #define ADAFRUIT_MEASUREMENT_PERIOD_ID  BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0xADAF0001, 0xC332, 0x42A8, 0x93BD, 0x25E905756CB8))
 
+// Packed binary stream of all enabled sensors, see zsw_gatt_sensor_server.c for the format.
+#define ZSW_SERVICE_SENSOR_STREAM       BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x5a570100, 0x6f32, 0x4a26, 0x8d8a, 0x2a5b3d5a57a1))
+#define ZSW_CHAR_SENSOR_STREAM          BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x5a570101, 0x6f32, 0x4a26, 0x8d8a, 0x2a5b3d5a57a1))
+
 #define BLE_UUID_TRANSPORT_VAL \
     BT_UUID_128_ENCODE(0x6e400001, 0xb5a3, 0xf393, 0xe0a9, 0xe50e24dcca9e)
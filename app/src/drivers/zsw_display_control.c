@@ -26,6 +26,8 @@
 #include <zephyr/drivers/display.h>
 #include <zephyr/logging/log.h>
 #include "lvgl.h"
+#include "drivers/zsw_render_profiler.h"
+#include "drivers/zsw_refresh_governor.h"
 
 #include <zephyr/drivers/counter.h>
 
@@ -34,6 +36,7 @@ LOG_MODULE_REGISTER(display_control, LOG_LEVEL_WRN);
 #define DISPLAY_BRIGHTNESS_LEVELS 32
 
 static void lvgl_render(struct k_work *item);
+static void lvgl_render_start_cb(lv_disp_drv_t *disp_drv);
 static void set_brightness_level(uint8_t brightness);
 static void brightness_alarm_start_cb(const struct device *counter_dev, uint8_t chan_id, uint32_t ticks,
                                       void *user_data);
@@ -100,6 +103,16 @@ void zsw_display_control_init(void)
         pm_device_action_run(touch_dev, PM_DEVICE_ACTION_SUSPEND);
     }
 
+    if (lv_disp_get_default()) {
+        lv_disp_get_default()->driver->render_start_cb = lvgl_render_start_cb;
+#ifdef CONFIG_ZSW_RENDER_PROFILER
+        zsw_render_profiler_init();
+#endif
+#ifdef CONFIG_ZSW_REFRESH_GOVERNOR
+        zsw_refresh_governor_init();
+#endif
+    }
+
     display_state = DISPLAY_STATE_SLEEPING;
 }
 
@@ -265,7 +278,12 @@ static void lvgl_render(struct k_work *item)
     // Workaround due to https://github.com/zephyrproject-rtos/zephyr/issues/71410
     // we need to run lv_task_handler from main thread and disable CONFIG_LV_Z_FLUSH_THREAD
 #ifndef CONFIG_BOARD_NATIVE_POSIX
-    const int64_t next_update_in_ms = lv_task_handler();
+    int64_t next_update_in_ms = lv_task_handler();
+#ifdef CONFIG_ZSW_REFRESH_GOVERNOR
+    if (zsw_refresh_governor_update()) {
+        next_update_in_ms = 0;
+    }
+#endif
     if (first_render_since_poweron) {
         zsw_display_control_set_brightness(last_brightness);
         first_render_since_poweron = false;
@@ -274,6 +292,58 @@ static void lvgl_render(struct k_work *item)
 #endif
 }
 
+static bool should_merge_areas(const lv_area_t *a, const lv_area_t *b, lv_area_t *merged)
+{
+    merged->x1 = MIN(a->x1, b->x1);
+    merged->y1 = MIN(a->y1, b->y1);
+    merged->x2 = MAX(a->x2, b->x2);
+    merged->y2 = MAX(a->y2, b->y2);
+
+    // Every flushed area costs a window setup and RAMWR command on the display bus
+    // plus render setup in LVGL. Merge when the extra pixels are cheaper than that.
+    return lv_area_get_size(merged) <= lv_area_get_size(a) + lv_area_get_size(b) +
+           CONFIG_ZSW_DISPLAY_AREA_MERGE_OVERHEAD_PX;
+}
+
+static void lvgl_render_start_cb(lv_disp_drv_t *disp_drv)
+{
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    lv_area_t merged;
+    bool changed = true;
+
+#ifdef CONFIG_ZSW_REFRESH_GOVERNOR
+    zsw_refresh_governor_frame_rendered();
+#endif
+
+    if (disp == NULL) {
+        return;
+    }
+
+    // LVGL only joins areas when the result is smaller than the sum of both,
+    // which leaves many small areas (like a second hand tick) as separate flushes.
+    // Always merge into the later area, LVGL has already decided which area is the last
+    // one to be rendered and that one must not be marked as joined.
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < disp->inv_p; i++) {
+            if (disp->inv_area_joined[i]) {
+                continue;
+            }
+            for (int j = i + 1; j < disp->inv_p; j++) {
+                if (disp->inv_area_joined[j]) {
+                    continue;
+                }
+                if (should_merge_areas(&disp->inv_areas[i], &disp->inv_areas[j], &merged)) {
+                    lv_area_copy(&disp->inv_areas[j], &merged);
+                    disp->inv_area_joined[i] = 1;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
 static void set_brightness_level(uint8_t brightness)
 {
     uint8_t npulses;
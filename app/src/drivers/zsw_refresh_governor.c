@@ -0,0 +1,238 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/zbus/zbus.h>
+#include <zephyr/logging/log.h>
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif
+#include <lvgl.h>
+
+#include "zsw_cpu_freq.h"
+#include "events/activity_event.h"
+#include "drivers/zsw_refresh_governor.h"
+
+LOG_MODULE_REGISTER(refresh_governor, LOG_LEVEL_INF);
+
+static void zbus_activity_event_callback(const struct zbus_channel *chan);
+
+ZBUS_CHAN_DECLARE(activity_state_data_chan);
+ZBUS_LISTENER_DEFINE(refresh_governor_activity_lis, zbus_activity_event_callback);
+ZBUS_CHAN_ADD_OBS(activity_state_data_chan, refresh_governor_activity_lis, 1);
+
+static struct k_spinlock lock;
+static zsw_refresh_mode_t mode = ZSW_REFRESH_MODE_INTERACTIVE;
+static uint32_t mode_start_ms;
+static zsw_refresh_mode_stats_t mode_stats[ZSW_REFRESH_MODE_NUM];
+
+// Power manager starts in active state.
+static atomic_t power_active = ATOMIC_INIT(1);
+static uint32_t last_interactive_ms;
+
+static void set_mode_locked(zsw_refresh_mode_t new_mode)
+{
+    uint32_t now = k_uptime_get_32();
+
+    mode_stats[mode].time_ms += now - mode_start_ms;
+    mode_stats[new_mode].entered++;
+    mode_start_ms = now;
+    mode = new_mode;
+}
+
+static void set_refresh_periods(uint32_t refr_period_ms, uint32_t indev_period_ms)
+{
+    lv_disp_t *disp = lv_disp_get_default();
+    lv_indev_t *indev = NULL;
+
+    if (disp && disp->refr_timer) {
+        lv_timer_set_period(disp->refr_timer, refr_period_ms);
+    }
+
+    while ((indev = lv_indev_get_next(indev)) != NULL) {
+        if (indev->driver->read_timer) {
+            lv_timer_set_period(indev->driver->read_timer, indev_period_ms);
+        }
+    }
+}
+
+static bool is_interactive(void)
+{
+    lv_indev_t *indev = NULL;
+
+    if (lv_anim_count_running() > 0) {
+        return true;
+    }
+
+    // Scroll throw and elastic bounce continues after the finger is released.
+    while ((indev = lv_indev_get_next(indev)) != NULL) {
+        if (lv_indev_get_scroll_obj(indev) != NULL) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool zsw_refresh_governor_update(void)
+{
+    zsw_refresh_mode_t new_mode;
+    zsw_refresh_mode_t old_mode;
+    uint32_t now = k_uptime_get_32();
+    k_spinlock_key_t key;
+
+    key = k_spin_lock(&lock);
+    old_mode = mode;
+    mode_stats[mode].wakeups++;
+    k_spin_unlock(&lock, key);
+
+    if (!atomic_get(&power_active)) {
+        return false;
+    }
+
+    // Coming back from inactive means the user just looked at the watch, expect input.
+    if (is_interactive() || old_mode == ZSW_REFRESH_MODE_OFF) {
+        last_interactive_ms = now;
+    }
+
+    if ((now - last_interactive_ms) < CONFIG_ZSW_REFRESH_GOVERNOR_INTERACTIVE_HOLD_MS ||
+        lv_disp_get_inactive_time(NULL) < CONFIG_ZSW_REFRESH_GOVERNOR_INTERACTIVE_HOLD_MS) {
+        new_mode = ZSW_REFRESH_MODE_INTERACTIVE;
+    } else {
+        new_mode = ZSW_REFRESH_MODE_IDLE;
+    }
+
+    if (new_mode == old_mode) {
+        return false;
+    }
+
+    LOG_DBG("%s -> %s", zsw_refresh_governor_mode_str(old_mode), zsw_refresh_governor_mode_str(new_mode));
+
+    key = k_spin_lock(&lock);
+    set_mode_locked(new_mode);
+    k_spin_unlock(&lock, key);
+
+    if (new_mode == ZSW_REFRESH_MODE_INTERACTIVE) {
+#ifdef CONFIG_ZSW_REFRESH_GOVERNOR_CPU_SCALING
+        zsw_cpu_set_freq(ZSW_CPU_FREQ_FAST, true);
+#endif
+        set_refresh_periods(CONFIG_LV_DISP_DEF_REFR_PERIOD, CONFIG_LV_INDEV_DEF_READ_PERIOD);
+        // Timers was scheduled with the slow periods, run them again with the new ones.
+        return true;
+    } else {
+#ifdef CONFIG_ZSW_REFRESH_GOVERNOR_CPU_SCALING
+        zsw_cpu_set_freq(ZSW_CPU_FREQ_DEFAULT, true);
+#endif
+        set_refresh_periods(CONFIG_ZSW_REFRESH_GOVERNOR_IDLE_REFR_PERIOD_MS,
+                            CONFIG_ZSW_REFRESH_GOVERNOR_IDLE_INDEV_PERIOD_MS);
+        return false;
+    }
+}
+
+void zsw_refresh_governor_frame_rendered(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    mode_stats[mode].frames++;
+    k_spin_unlock(&lock, key);
+}
+
+void zsw_refresh_governor_get_stats(zsw_refresh_governor_stats_t *stats)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    stats->mode = mode;
+    memcpy(stats->modes, mode_stats, sizeof(mode_stats));
+    stats->modes[mode].time_ms += k_uptime_get_32() - mode_start_ms;
+    k_spin_unlock(&lock, key);
+}
+
+const char *zsw_refresh_governor_mode_str(zsw_refresh_mode_t refresh_mode)
+{
+    switch (refresh_mode) {
+        case ZSW_REFRESH_MODE_OFF:
+            return "off";
+        case ZSW_REFRESH_MODE_IDLE:
+            return "idle";
+        case ZSW_REFRESH_MODE_INTERACTIVE:
+            return "interactive";
+        default:
+            return "unknown";
+    }
+}
+
+void zsw_refresh_governor_init(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    mode_start_ms = k_uptime_get_32();
+    last_interactive_ms = mode_start_ms;
+    mode_stats[mode].entered = 1;
+    k_spin_unlock(&lock, key);
+}
+
+static void zbus_activity_event_callback(const struct zbus_channel *chan)
+{
+    const struct activity_state_event *event = zbus_chan_const_msg(chan);
+    k_spinlock_key_t key;
+
+    atomic_set(&power_active, event->state == ZSW_ACTIVITY_STATE_ACTIVE);
+
+    // LVGL is stopped when not active, only account for the time here.
+    // The refresh periods are updated from the LVGL thread when it starts again.
+    if (event->state != ZSW_ACTIVITY_STATE_ACTIVE) {
+        key = k_spin_lock(&lock);
+        if (mode != ZSW_REFRESH_MODE_OFF) {
+            set_mode_locked(ZSW_REFRESH_MODE_OFF);
+        }
+        k_spin_unlock(&lock, key);
+    }
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_refresh_governor_stats(const struct shell *sh, size_t argc, char **argv)
+{
+    zsw_refresh_governor_stats_t stats;
+
+    zsw_refresh_governor_get_stats(&stats);
+
+    shell_print(sh, "Mode: %s", zsw_refresh_governor_mode_str(stats.mode));
+    shell_print(sh, "Idle period: refresh %d ms, input %d ms. Interactive period: refresh %d ms, input %d ms",
+                CONFIG_ZSW_REFRESH_GOVERNOR_IDLE_REFR_PERIOD_MS, CONFIG_ZSW_REFRESH_GOVERNOR_IDLE_INDEV_PERIOD_MS,
+                CONFIG_LV_DISP_DEF_REFR_PERIOD, CONFIG_LV_INDEV_DEF_READ_PERIOD);
+
+    for (int i = 0; i < ZSW_REFRESH_MODE_NUM; i++) {
+        zsw_refresh_mode_stats_t *mode_stat = &stats.modes[i];
+        uint32_t minutes_x1000 = MAX(mode_stat->time_ms / 60, 1);
+
+        shell_print(sh, "%-12s entered: %d, time: %d s, wakeups: %d (%d/min), frames: %d (%d/min)",
+                    zsw_refresh_governor_mode_str(i), mode_stat->entered, mode_stat->time_ms / 1000,
+                    mode_stat->wakeups, (uint32_t)((uint64_t)mode_stat->wakeups * 1000 / minutes_x1000),
+                    mode_stat->frames, (uint32_t)((uint64_t)mode_stat->frames * 1000 / minutes_x1000));
+    }
+
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(refresh_governor_cmds,
+                               SHELL_CMD(stats, NULL, "Print wakeups and frames rendered per refresh mode",
+                                         cmd_refresh_governor_stats),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(refresh_governor, &refresh_governor_cmds, "LVGL refresh rate governor", NULL);
+#endif
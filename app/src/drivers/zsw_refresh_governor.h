@@ -0,0 +1,63 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum zsw_refresh_mode_t {
+    ZSW_REFRESH_MODE_OFF,           // Power manager is not active, display is not rendered
+    ZSW_REFRESH_MODE_IDLE,          // No input or animation, slow refresh and input polling
+    ZSW_REFRESH_MODE_INTERACTIVE,   // Input, scrolling or animation in progress
+    ZSW_REFRESH_MODE_NUM,
+} zsw_refresh_mode_t;
+
+typedef struct zsw_refresh_mode_stats_t {
+    uint32_t time_ms;       // Total time spent in the mode
+    uint32_t wakeups;       // Number of times the LVGL task handler was run
+    uint32_t frames;        // Number of refreshes that rendered anything
+    uint32_t entered;       // Number of times the mode was entered
+} zsw_refresh_mode_stats_t;
+
+typedef struct zsw_refresh_governor_stats_t {
+    zsw_refresh_mode_t mode;
+    zsw_refresh_mode_stats_t modes[ZSW_REFRESH_MODE_NUM];
+} zsw_refresh_governor_stats_t;
+
+/** @brief Setup the governor for the default LVGL display and input devices.
+ *         Must be called after LVGL and the display is initialized.
+*/
+void zsw_refresh_governor_init(void);
+
+/** @brief Evaluate the refresh policy. Must be called from the LVGL thread after every lv_task_handler.
+ *  @return true if the refresh periods was changed and the LVGL task handler should run again right away.
+*/
+bool zsw_refresh_governor_update(void);
+
+/** @brief Count a rendered frame. Must be called from the LVGL thread.
+*/
+void zsw_refresh_governor_frame_rendered(void);
+
+/** @brief Get the current mode and the wakeups and frames rendered in each mode.
+ *  @param stats Filled with the statistics, time in the current mode is included.
+*/
+void zsw_refresh_governor_get_stats(zsw_refresh_governor_stats_t *stats);
+
+/** @brief Name of a refresh mode, for logging.
+*/
+const char *zsw_refresh_governor_mode_str(zsw_refresh_mode_t mode);
@@ -0,0 +1,339 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif
+#include <lvgl.h>
+
+#include "drivers/zsw_render_profiler.h"
+#include "managers/zsw_app_manager.h"
+#include "applications/watchface/watchface_app.h"
+#ifdef CONFIG_BOARD_NATIVE_POSIX
+#include "zsw_bench.h"
+#endif
+
+LOG_MODULE_REGISTER(render_profiler, LOG_LEVEL_INF);
+
+#define MAX_SCREENS             16
+#define NUM_HISTOGRAM_BUCKETS   ARRAY_SIZE(histogram_limits_ms)
+
+typedef struct render_sample_t {
+    const char *app_name;   // NULL when the watchface is shown
+    int8_t      watchface;
+    uint32_t    timestamp_ms;
+    uint32_t    render_us;
+    uint32_t    flush_us;
+    uint32_t    pixels;
+} render_sample_t;
+
+typedef struct screen_stats_t {
+    const char *app_name;
+    int8_t      watchface;
+    uint32_t    frames;
+    uint64_t    render_us;
+    uint64_t    flush_us;
+    uint64_t    pixels;
+    uint32_t    max_frame_us;
+    uint32_t    first_timestamp_ms;
+    uint32_t    last_timestamp_ms;
+    uint32_t    histogram[6];
+} screen_stats_t;
+
+static void profiler_flush_cb(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p);
+static void profiler_wait_cb(lv_disp_drv_t *disp_drv);
+static void profiler_refr_timer_cb(lv_timer_t *timer);
+static void dump_work_handler(struct k_work *work);
+
+static const uint32_t histogram_limits_ms[] = {5, 10, 20, 33, 50, UINT32_MAX};
+
+static K_WORK_DELAYABLE_DEFINE(dump_work, dump_work_handler);
+
+// Protects the sample ring and screen_stats. Frames are recorded from the LVGL thread and read from the
+// shell and the system work queue.
+static K_MUTEX_DEFINE(profiler_mutex);
+
+static render_sample_t samples[CONFIG_ZSW_RENDER_PROFILER_NUM_SAMPLES];
+static uint32_t sample_head;
+static uint32_t num_samples;
+static uint32_t num_dropped;
+static screen_stats_t screen_stats[MAX_SCREENS];
+
+static void (*orig_flush_cb)(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p);
+static void (*orig_wait_cb)(lv_disp_drv_t *disp_drv);
+
+// State for the refresh currently in progress, only accessed from the LVGL thread.
+static uint32_t flush_cycles;
+static uint32_t wait_start_cycles;
+static uint32_t frame_pixels;
+
+#ifdef CONFIG_BOARD_NATIVE_POSIX
+// Simulated time does not advance while LVGL renders, measure with the host clock instead.
+static inline uint32_t get_cycles(void)
+{
+    return (uint32_t)zsw_bench_time_us();
+}
+
+static inline uint32_t cycles_to_us(uint32_t cycles)
+{
+    return cycles;
+}
+#else
+static inline uint32_t get_cycles(void)
+{
+    return k_cycle_get_32();
+}
+
+static inline uint32_t cycles_to_us(uint32_t cycles)
+{
+    return k_cyc_to_us_ceil32(cycles);
+}
+#endif
+
+static inline void end_wait(void)
+{
+    if (wait_start_cycles != 0) {
+        flush_cycles += get_cycles() - wait_start_cycles;
+        wait_start_cycles = 0;
+    }
+}
+
+static void profiler_wait_cb(lv_disp_drv_t *disp_drv)
+{
+    // LVGL calls this repeatedly while waiting for the previous flush to complete.
+    // Waiting ends when LVGL calls flush_cb next or the refresh is done.
+    if (wait_start_cycles == 0) {
+        wait_start_cycles = get_cycles();
+    }
+    if (orig_wait_cb) {
+        orig_wait_cb(disp_drv);
+    }
+}
+
+static void profiler_flush_cb(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    uint32_t start;
+
+    end_wait();
+    frame_pixels += lv_area_get_size(area);
+
+    start = get_cycles();
+    orig_flush_cb(disp_drv, area, color_p);
+    flush_cycles += get_cycles() - start;
+}
+
+static void profiler_refr_timer_cb(lv_timer_t *timer)
+{
+    uint32_t start;
+    uint32_t total_us;
+    render_sample_t *sample;
+
+    flush_cycles = 0;
+    wait_start_cycles = 0;
+    frame_pixels = 0;
+
+    start = get_cycles();
+    _lv_disp_refr_timer(timer);
+    end_wait();
+
+    if (frame_pixels == 0) {
+        // Nothing was invalidated, not a frame.
+        return;
+    }
+
+    total_us = cycles_to_us(get_cycles() - start);
+
+    // Never stall rendering while a dump is reading the samples, drop the frame instead.
+    if (k_mutex_lock(&profiler_mutex, K_NO_WAIT) != 0) {
+        num_dropped++;
+        return;
+    }
+
+    sample = &samples[sample_head];
+    sample->app_name = zsw_app_manager_get_current_app_name();
+    sample->watchface = sample->app_name ? -1 : watchface_app_get_current_face();
+    sample->timestamp_ms = k_uptime_get_32();
+    sample->flush_us = MIN(cycles_to_us(flush_cycles), total_us);
+    sample->render_us = total_us - sample->flush_us;
+    sample->pixels = frame_pixels;
+
+    sample_head = (sample_head + 1) % CONFIG_ZSW_RENDER_PROFILER_NUM_SAMPLES;
+    num_samples = MIN(num_samples + 1, CONFIG_ZSW_RENDER_PROFILER_NUM_SAMPLES);
+
+    k_mutex_unlock(&profiler_mutex);
+}
+
+static screen_stats_t *get_screen_stats(const render_sample_t *sample, int *num_screens)
+{
+    for (int i = 0; i < *num_screens; i++) {
+        if (screen_stats[i].app_name == sample->app_name && screen_stats[i].watchface == sample->watchface) {
+            return &screen_stats[i];
+        }
+    }
+
+    if (*num_screens == MAX_SCREENS) {
+        return NULL;
+    }
+
+    memset(&screen_stats[*num_screens], 0, sizeof(screen_stats_t));
+    screen_stats[*num_screens].app_name = sample->app_name;
+    screen_stats[*num_screens].watchface = sample->watchface;
+    screen_stats[*num_screens].first_timestamp_ms = sample->timestamp_ms;
+
+    return &screen_stats[(*num_screens)++];
+}
+
+// Must be called with profiler_mutex held.
+static int collect_screen_stats(void)
+{
+    int num_screens = 0;
+    uint32_t oldest = (sample_head + CONFIG_ZSW_RENDER_PROFILER_NUM_SAMPLES - num_samples) %
+                      CONFIG_ZSW_RENDER_PROFILER_NUM_SAMPLES;
+
+    for (int i = 0; i < num_samples; i++) {
+        const render_sample_t *sample = &samples[(oldest + i) % CONFIG_ZSW_RENDER_PROFILER_NUM_SAMPLES];
+        screen_stats_t *stats = get_screen_stats(sample, &num_screens);
+        uint32_t frame_us = sample->render_us + sample->flush_us;
+
+        if (stats == NULL) {
+            continue;
+        }
+
+        stats->frames++;
+        stats->render_us += sample->render_us;
+        stats->flush_us += sample->flush_us;
+        stats->pixels += sample->pixels;
+        stats->max_frame_us = MAX(stats->max_frame_us, frame_us);
+        stats->last_timestamp_ms = sample->timestamp_ms;
+
+        for (int j = 0; j < NUM_HISTOGRAM_BUCKETS; j++) {
+            if (frame_us < histogram_limits_ms[j] * USEC_PER_MSEC) {
+                stats->histogram[j]++;
+                break;
+            }
+        }
+    }
+
+    return num_screens;
+}
+
+void zsw_render_profiler_dump(void)
+{
+    int num_screens;
+
+    k_mutex_lock(&profiler_mutex, K_FOREVER);
+    num_screens = collect_screen_stats();
+
+    LOG_PRINTK("Render profile, %d frames, %d dropped while dumping\n", num_samples, num_dropped);
+    for (int i = 0; i < num_screens; i++) {
+        screen_stats_t *stats = &screen_stats[i];
+        uint32_t duration_ms = stats->last_timestamp_ms - stats->first_timestamp_ms;
+
+        if (stats->app_name) {
+            LOG_PRINTK("%s:\n", stats->app_name);
+        } else {
+            LOG_PRINTK("Watchface %d:\n", stats->watchface);
+        }
+        LOG_PRINTK("  frames: %d, %d.%d fps\n", stats->frames,
+                   duration_ms ? (stats->frames - 1) * 1000 / duration_ms : 0,
+                   duration_ms ? ((stats->frames - 1) * 10000 / duration_ms) % 10 : 0);
+        LOG_PRINTK("  avg render: %d us, avg flush: %d us, max frame: %d us, avg px: %d\n",
+                   (uint32_t)(stats->render_us / stats->frames), (uint32_t)(stats->flush_us / stats->frames),
+                   stats->max_frame_us, (uint32_t)(stats->pixels / stats->frames));
+        LOG_PRINTK("  frame time <5ms: %d <10ms: %d <20ms: %d <33ms: %d <50ms: %d >=50ms: %d\n",
+                   stats->histogram[0], stats->histogram[1], stats->histogram[2], stats->histogram[3],
+                   stats->histogram[4], stats->histogram[5]);
+    }
+    k_mutex_unlock(&profiler_mutex);
+}
+
+void zsw_render_profiler_get_frame_stats(uint32_t *p_frames, uint32_t *p_avg_frame_us, uint32_t *p_max_frame_us)
+{
+    uint64_t total_us = 0;
+    uint32_t max_us = 0;
+
+    k_mutex_lock(&profiler_mutex, K_FOREVER);
+    for (int i = 0; i < num_samples; i++) {
+        uint32_t frame_us = samples[i].render_us + samples[i].flush_us;
+
+        total_us += frame_us;
+        max_us = MAX(max_us, frame_us);
+    }
+    *p_frames = num_samples;
+    *p_avg_frame_us = num_samples ? (uint32_t)(total_us / num_samples) : 0;
+    *p_max_frame_us = max_us;
+    k_mutex_unlock(&profiler_mutex);
+}
+
+void zsw_render_profiler_reset(void)
+{
+    k_mutex_lock(&profiler_mutex, K_FOREVER);
+    sample_head = 0;
+    num_samples = 0;
+    num_dropped = 0;
+    k_mutex_unlock(&profiler_mutex);
+}
+
+static void dump_work_handler(struct k_work *work)
+{
+    zsw_render_profiler_dump();
+    k_work_schedule(&dump_work, K_SECONDS(CONFIG_ZSW_RENDER_PROFILER_DUMP_INTERVAL_S));
+}
+
+void zsw_render_profiler_init(void)
+{
+    lv_disp_t *disp = lv_disp_get_default();
+
+    if (disp == NULL || disp->refr_timer == NULL) {
+        LOG_ERR("No LVGL display to profile");
+        return;
+    }
+
+    orig_flush_cb = disp->driver->flush_cb;
+    orig_wait_cb = disp->driver->wait_cb;
+    disp->driver->flush_cb = profiler_flush_cb;
+    disp->driver->wait_cb = profiler_wait_cb;
+    lv_timer_set_cb(disp->refr_timer, profiler_refr_timer_cb);
+
+    if (CONFIG_ZSW_RENDER_PROFILER_DUMP_INTERVAL_S > 0) {
+        k_work_schedule(&dump_work, K_SECONDS(CONFIG_ZSW_RENDER_PROFILER_DUMP_INTERVAL_S));
+    }
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_render_profiler_dump(const struct shell *sh, size_t argc, char **argv)
+{
+    zsw_render_profiler_dump();
+    return 0;
+}
+
+static int cmd_render_profiler_reset(const struct shell *sh, size_t argc, char **argv)
+{
+    zsw_render_profiler_reset();
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(render_profiler_cmds,
+                               SHELL_CMD(dump, NULL, "Print render statistics per screen", cmd_render_profiler_dump),
+                               SHELL_CMD(reset, NULL, "Clear recorded frames", cmd_render_profiler_reset),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(render_profiler, &render_profiler_cmds, "LVGL render profiler", NULL);
+#endif
@@ -0,0 +1,40 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/** @brief Start recording render and flush time for every LVGL refresh.
+ *         Must be called after LVGL and the display is initialized.
+*/
+void zsw_render_profiler_init(void);
+
+/** @brief Print per screen statistics and frame time histograms of the recorded frames.
+*/
+void zsw_render_profiler_dump(void);
+
+/** @brief                  Get the frame time over all recorded frames, for all screens.
+ *  @param p_frames         Set to the number of recorded frames
+ *  @param p_avg_frame_us   Set to the average render and flush time of a frame, 0 when nothing was recorded
+ *  @param p_max_frame_us   Set to the longest render and flush time of a frame
+*/
+void zsw_render_profiler_get_frame_stats(uint32_t *p_frames, uint32_t *p_avg_frame_us, uint32_t *p_max_frame_us);
+
+/** @brief Clear all recorded frames.
+*/
+void zsw_render_profiler_reset(void);
@@ -0,0 +1,118 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures the frame cost of every watchface on native_posix, run with:
+ *   zephyr.exe --render-bench=5 --render-bench-max-us=20000
+ * Shows each watchface for the given number of seconds while redrawing the whole screen every
+ * BENCH_REDRAW_INTERVAL_MS, prints the render profile of each and exits. Exits with 1 if the average frame time of
+ * any watchface is above --render-bench-max-us. The time depends on the host, so CI only turns that into a warning.
+ */
+
+#include <zephyr/kernel.h>
+#include <lvgl.h>
+
+#include "zsw_bench.h"
+#include "drivers/zsw_render_profiler.h"
+#include "applications/watchface/watchface_app.h"
+
+#define BENCH_SETTLE_MS             1000
+#define BENCH_REDRAW_INTERVAL_MS    100
+
+static void change_watchface_work_handler(struct k_work *work);
+static void redraw_work_handler(struct k_work *work);
+
+static K_WORK_DEFINE(change_watchface_work, change_watchface_work_handler);
+static K_WORK_DELAYABLE_DEFINE(redraw_work, redraw_work_handler);
+
+static uint32_t bench_seconds;
+static uint32_t bench_max_frame_us;
+static int bench_watchface;
+static bool redrawing;
+
+static struct args_struct_t bench_options[] = {
+    {
+        .option = "render-bench",
+        .name = "seconds",
+        .type = 'u',
+        .dest = (void *) &bench_seconds,
+        .descript = "Profile rendering of every watchface for this many seconds each, exits when done"
+    },
+    {
+        .option = "render-bench-max-us",
+        .name = "us",
+        .type = 'u',
+        .dest = (void *) &bench_max_frame_us,
+        .descript = "Exit with 1 if the average frame time of a watchface is above this, 0 to not check"
+    },
+    ARG_TABLE_ENDMARKER
+};
+
+// On native_posix main() runs lv_task_handler, while the watchface app is driven from the system work queue like on
+// the watch. Only one native_posix thread runs at a time and threads only switch when blocking, so the work items
+// below run between two lv_task_handler calls, the same as the watchface app's own updates.
+static void change_watchface_work_handler(struct k_work *work)
+{
+    watchface_change(bench_watchface);
+}
+
+static void redraw_work_handler(struct k_work *work)
+{
+    if (redrawing) {
+        lv_obj_invalidate(lv_scr_act());
+        k_work_schedule(&redraw_work, K_MSEC(BENCH_REDRAW_INTERVAL_MS));
+    }
+}
+
+static int render_bench(void)
+{
+    uint32_t frames;
+    uint32_t avg_frame_us;
+    uint32_t max_frame_us;
+    int num_failed = 0;
+    int num_faces = watchface_app_get_num_faces();
+
+    if (bench_seconds == 0) {
+        return ZSW_BENCH_NOT_RUN;
+    }
+
+    for (bench_watchface = 0; bench_watchface < num_faces; bench_watchface++) {
+        k_work_submit(&change_watchface_work);
+        k_msleep(BENCH_SETTLE_MS);
+
+        zsw_render_profiler_reset();
+        redrawing = true;
+        k_work_schedule(&redraw_work, K_NO_WAIT);
+        k_sleep(K_SECONDS(bench_seconds));
+        redrawing = false;
+        k_work_cancel_delayable(&redraw_work);
+
+        zsw_render_profiler_dump();
+        zsw_render_profiler_get_frame_stats(&frames, &avg_frame_us, &max_frame_us);
+        if (frames == 0 || (bench_max_frame_us != 0 && avg_frame_us > bench_max_frame_us)) {
+            printk("Watchface %d: %d frames, avg frame %d us, limit %d us, FAILED\n", bench_watchface, frames,
+                   avg_frame_us, bench_max_frame_us);
+            num_failed++;
+        }
+    }
+
+    printk("Render bench: %d watchfaces, %d failed\n", num_faces, num_failed);
+
+    return num_failed == 0 ? 0 : 1;
+}
+
+ZSW_BENCH_DEFINE(render_bench, 2048, bench_options, render_bench);
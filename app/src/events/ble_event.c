@@ -2,6 +2,9 @@
 
 #include "ble_event.h"
 
+// Large payloads are carried in ble_comm buffers, keep the message small as it is copied on every publish.
+BUILD_ASSERT(sizeof(struct ble_data_event) <= 128, "ble_data_event too large");
+
 ZBUS_CHAN_DEFINE(ble_comm_data_chan,
                  struct ble_data_event,
                  NULL,
@@ -1,15 +1,16 @@
 #include <zephyr/kernel.h>
 #include <zephyr/zbus/zbus.h>
 #include <events/periodic_event.h>
+#include <events/zsw_periodic_event.h>
 
-static struct k_work_delayable periodic_slow_work;
-static struct k_work_delayable periodic_fast_work;
-static struct k_work_delayable periodic_mid_work;
+static ZSW_PERIODIC_TIMER_DEFINE(periodic_slow_timer, zsw_periodic_chan_timeout);
+static ZSW_PERIODIC_TIMER_DEFINE(periodic_fast_timer, zsw_periodic_chan_timeout);
+static ZSW_PERIODIC_TIMER_DEFINE(periodic_mid_timer, zsw_periodic_chan_timeout);
 
 ZBUS_CHAN_DEFINE(periodic_event_10s_chan,
                  struct periodic_event,
                  NULL,
-                 &periodic_slow_work,
+                 &periodic_slow_timer,
                  ZBUS_OBSERVERS_EMPTY,
                  ZBUS_MSG_INIT()
                 );
@@ -17,7 +18,7 @@ ZBUS_CHAN_DEFINE(periodic_event_10s_chan,
 ZBUS_CHAN_DEFINE(periodic_event_100ms_chan,
                  struct periodic_event,
                  NULL,
-                 &periodic_fast_work,
+                 &periodic_fast_timer,
                  ZBUS_OBSERVERS_EMPTY,
                  ZBUS_MSG_INIT()
                 );
@@ -25,7 +26,7 @@ ZBUS_CHAN_DEFINE(periodic_event_100ms_chan,
 ZBUS_CHAN_DEFINE(periodic_event_1s_chan,
                  struct periodic_event,
                  NULL,
-                 &periodic_mid_work,
+                 &periodic_mid_timer,
                  ZBUS_OBSERVERS_EMPTY,
                  ZBUS_MSG_INIT()
-                );
\ No newline at end of file
+                );
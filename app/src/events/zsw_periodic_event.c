@@ -1,115 +1,193 @@
 #include <zephyr/kernel.h>
-#include <zephyr/init.h>
 #include <zephyr/zbus/zbus.h>
+#include <zephyr/sys/slist.h>
 
 #include "events/periodic_event.h"
+#include "events/zsw_periodic_event.h"
 
-#define PERIODIC_FAST_INTERVAL_MS 100
-#define PERIODIC_MID_INTERVAL_MS 1000
-#define PERIODIC_SLOW_INTERVAL_MS 10000
+// All periods are multiples of the wheel tick and fire aligned to uptime,
+// so the 1 s and 10 s channels fire in the same wakeup as the 100 ms channel.
+#define PERIODIC_TICK_MS            100
+#define PERIODIC_FAST_INTERVAL_MS   PERIODIC_TICK_MS
+#define PERIODIC_MID_INTERVAL_MS    1000
+#define PERIODIC_SLOW_INTERVAL_MS   10000
 
-static void handle_slow_timeout(struct k_work *item);
-static void handle_fast_timeout(struct k_work *item);
-static void handle_mid_timeout(struct k_work *item);
+static void handle_wheel_timeout(struct k_work *item);
 
 ZBUS_CHAN_DECLARE(periodic_event_10s_chan);
 ZBUS_CHAN_DECLARE(periodic_event_1s_chan);
 ZBUS_CHAN_DECLARE(periodic_event_100ms_chan);
 
-int zsw_periodic_chan_add_obs(const struct zbus_channel *chan, const struct zbus_observer *obs)
+static K_WORK_DELAYABLE_DEFINE(wheel_work, handle_wheel_timeout);
+static K_MUTEX_DEFINE(wheel_mutex);
+
+static sys_slist_t timers = SYS_SLIST_STATIC_INIT(&timers);
+static uint32_t num_wakeups;
+
+static uint32_t get_chan_interval_ms(const struct zbus_channel *chan)
 {
-    struct k_work_delayable *work = NULL;
-    int ret;
+    if (chan == &periodic_event_10s_chan) {
+        return PERIODIC_SLOW_INTERVAL_MS;
+    } else if (chan == &periodic_event_1s_chan) {
+        return PERIODIC_MID_INTERVAL_MS;
+    } else if (chan == &periodic_event_100ms_chan) {
+        return PERIODIC_FAST_INTERVAL_MS;
+    }
 
-    ret = zbus_chan_add_obs(chan, obs, K_MSEC(100));
+    __ASSERT(false, "Unknown channel");
+    return 0;
+}
 
-    if (ret != 0) {
-        return ret;
+static void schedule_next_locked(void)
+{
+    struct zsw_periodic_timer *timer;
+    int64_t next = INT64_MAX;
+
+    SYS_SLIST_FOR_EACH_CONTAINER(&timers, timer, node) {
+        next = MIN(next, timer->deadline_ms + timer->slack_ms);
+    }
+
+    if (next == INT64_MAX) {
+        // Nobody is listening, stop waking up.
+        k_work_cancel_delayable(&wheel_work);
+    } else {
+        k_work_reschedule(&wheel_work, K_MSEC(MAX(next - k_uptime_get(), 0)));
     }
+}
+
+static struct zsw_periodic_timer *get_pending_locked(void)
+{
+    struct zsw_periodic_timer *timer;
 
-    zbus_chan_claim(chan, K_FOREVER);
-    work = (struct k_work_delayable *)zbus_chan_user_data(chan);
-    __ASSERT(work != NULL, "Invalid channel");
-    if (!k_work_delayable_is_pending(work)) {
-        if (chan == &periodic_event_10s_chan) {
-            ret =  k_work_reschedule(work, K_MSEC(PERIODIC_SLOW_INTERVAL_MS));
-        } else if (chan == &periodic_event_1s_chan) {
-            ret =  k_work_reschedule(work, K_MSEC(PERIODIC_MID_INTERVAL_MS));
-        } else if (chan == &periodic_event_100ms_chan) {
-            ret =  k_work_reschedule(work, K_MSEC(PERIODIC_FAST_INTERVAL_MS));
-        } else {
-            __ASSERT(false, "Unknown channel");
+    SYS_SLIST_FOR_EACH_CONTAINER(&timers, timer, node) {
+        if (timer->pending) {
+            return timer;
         }
     }
-    zbus_chan_finish(chan);
 
-    return ret;
+    return NULL;
 }
 
-int zsw_periodic_chan_rm_obs(const struct zbus_channel *chan, const struct zbus_observer *obs)
+static void handle_wheel_timeout(struct k_work *item)
 {
-    struct k_work_delayable *work = NULL;
-    int ret = zbus_chan_rm_obs(chan, obs, K_MSEC(100));
-    if (ret == 0 && sys_slist_is_empty(&chan->data->observers)) {
-        work = (struct k_work_delayable *)zbus_chan_user_data(chan);
-        __ASSERT(k_work_delayable_is_pending(work), "Periodic slow work is not pending");
-        ret = k_work_cancel_delayable(work);
+    struct zsw_periodic_timer *timer;
+    int64_t now = k_uptime_get();
+
+    k_mutex_lock(&wheel_mutex, K_FOREVER);
+    num_wakeups++;
+
+    // Fire every timer that is due, including timers with slack left,
+    // to batch them into this wakeup.
+    SYS_SLIST_FOR_EACH_CONTAINER(&timers, timer, node) {
+        if (timer->deadline_ms <= now) {
+            timer->pending = true;
+            // Skip missed periods but keep the alignment.
+            timer->deadline_ms += ((now - timer->deadline_ms) / timer->period_ms + 1) * timer->period_ms;
+        }
     }
-    return ret;
+
+    // Handlers may start or stop timers, so find the next pending timer from the list every time.
+    while ((timer = get_pending_locked()) != NULL) {
+        timer->pending = false;
+        k_mutex_unlock(&wheel_mutex);
+        timer->handler(timer);
+        k_mutex_lock(&wheel_mutex, K_FOREVER);
+    }
+
+    schedule_next_locked();
+    k_mutex_unlock(&wheel_mutex);
 }
 
-static void handle_slow_timeout(struct k_work *item)
+int zsw_periodic_timer_start(struct zsw_periodic_timer *timer, uint32_t period_ms, uint32_t slack_ms)
 {
-    struct periodic_event evt = {
-    };
-    struct k_work_delayable *work = NULL;
-    zbus_chan_claim(&periodic_event_10s_chan, K_FOREVER);
-    work = (struct k_work_delayable *)zbus_chan_user_data(&periodic_event_10s_chan);
-    k_work_reschedule(work, K_MSEC(PERIODIC_SLOW_INTERVAL_MS));
-    zbus_chan_finish(&periodic_event_10s_chan);
+    int64_t now;
+
+    __ASSERT(timer->handler != NULL, "Timer has no handler");
 
-    zbus_chan_pub(&periodic_event_10s_chan, &evt, K_MSEC(250));
+    k_mutex_lock(&wheel_mutex, K_FOREVER);
+    if (timer->running) {
+        k_mutex_unlock(&wheel_mutex);
+        return -EALREADY;
+    }
+
+    now = k_uptime_get();
+    timer->period_ms = MAX(ROUND_UP(period_ms, PERIODIC_TICK_MS), PERIODIC_TICK_MS);
+    timer->slack_ms = MIN(slack_ms, timer->period_ms - PERIODIC_TICK_MS);
+    timer->deadline_ms = (now / timer->period_ms + 1) * timer->period_ms;
+    timer->pending = false;
+    timer->running = true;
+    sys_slist_append(&timers, &timer->node);
+    schedule_next_locked();
+    k_mutex_unlock(&wheel_mutex);
+
+    return 0;
 }
 
-static void handle_mid_timeout(struct k_work *item)
+int zsw_periodic_timer_stop(struct zsw_periodic_timer *timer)
 {
-    struct periodic_event evt = {
-    };
-    struct k_work_delayable *work = NULL;
-    zbus_chan_claim(&periodic_event_1s_chan, K_FOREVER);
-    work = (struct k_work_delayable *)zbus_chan_user_data(&periodic_event_1s_chan);
-    k_work_reschedule(work, K_MSEC(PERIODIC_MID_INTERVAL_MS));
-    zbus_chan_finish(&periodic_event_1s_chan);
+    k_mutex_lock(&wheel_mutex, K_FOREVER);
+    if (!timer->running) {
+        k_mutex_unlock(&wheel_mutex);
+        return -EALREADY;
+    }
+
+    sys_slist_find_and_remove(&timers, &timer->node);
+    timer->running = false;
+    timer->pending = false;
+    schedule_next_locked();
+    k_mutex_unlock(&wheel_mutex);
 
-    zbus_chan_pub(&periodic_event_1s_chan, &evt, K_MSEC(250));
+    return 0;
 }
 
-static void handle_fast_timeout(struct k_work *item)
+uint32_t zsw_periodic_get_num_wakeups(void)
 {
-    struct periodic_event evt = {
-    };
-    struct k_work_delayable *work = NULL;
-    zbus_chan_claim(&periodic_event_100ms_chan, K_FOREVER);
-    work = (struct k_work_delayable *)zbus_chan_user_data(&periodic_event_100ms_chan);
-    k_work_reschedule(work, K_MSEC(PERIODIC_FAST_INTERVAL_MS));
-    zbus_chan_finish(&periodic_event_100ms_chan);
-
-    zbus_chan_pub(&periodic_event_100ms_chan, &evt, K_MSEC(250));
+    return num_wakeups;
 }
 
-static int zsw_timer_init(void)
+int zsw_periodic_chan_add_obs(const struct zbus_channel *chan, const struct zbus_observer *obs)
 {
-    struct k_work_delayable *work = NULL;
-    work = (struct k_work_delayable *)zbus_chan_user_data(&periodic_event_10s_chan);
-    k_work_init_delayable(work, handle_slow_timeout);
+    struct zsw_periodic_timer *timer;
+    int ret;
 
-    // TODO: Use the RTC instead of the timer in rev 5 to generate this
-    work = (struct k_work_delayable *)zbus_chan_user_data(&periodic_event_1s_chan);
-    k_work_init_delayable(work, handle_mid_timeout);
+    ret = zbus_chan_add_obs(chan, obs, K_MSEC(100));
 
-    work = (struct k_work_delayable *)zbus_chan_user_data(&periodic_event_100ms_chan);
-    k_work_init_delayable(work, handle_fast_timeout);
-    return 0;
+    if (ret != 0) {
+        return ret;
+    }
+
+    timer = (struct zsw_periodic_timer *)zbus_chan_user_data(chan);
+    __ASSERT(timer != NULL, "Invalid channel");
+    ret = zsw_periodic_timer_start(timer, get_chan_interval_ms(chan), 0);
+
+    return ret == -EALREADY ? 0 : ret;
+}
+
+int zsw_periodic_chan_rm_obs(const struct zbus_channel *chan, const struct zbus_observer *obs)
+{
+    struct zsw_periodic_timer *timer;
+    int ret = zbus_chan_rm_obs(chan, obs, K_MSEC(100));
+
+    if (ret == 0 && sys_slist_is_empty(&chan->data->observers)) {
+        timer = (struct zsw_periodic_timer *)zbus_chan_user_data(chan);
+        ret = zsw_periodic_timer_stop(timer);
+    }
+    return ret;
 }
 
-SYS_INIT(zsw_timer_init, APPLICATION, 1);
\ No newline at end of file
+void zsw_periodic_chan_timeout(struct zsw_periodic_timer *timer)
+{
+    struct periodic_event evt = {
+    };
+    const struct zbus_channel *chan;
+
+    if (timer == zbus_chan_user_data(&periodic_event_10s_chan)) {
+        chan = &periodic_event_10s_chan;
+    } else if (timer == zbus_chan_user_data(&periodic_event_1s_chan)) {
+        chan = &periodic_event_1s_chan;
+    } else {
+        chan = &periodic_event_100ms_chan;
+    }
+
+    zbus_chan_pub(chan, &evt, K_MSEC(250));
+}
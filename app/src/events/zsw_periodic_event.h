@@ -1,9 +1,55 @@
-
 #pragma once
 
+#include <stdbool.h>
+#include <zephyr/kernel.h>
 #include <zephyr/zbus/zbus.h>
 
 #include "events/periodic_event.h"
 
+struct zsw_periodic_timer;
+
+typedef void (*zsw_periodic_timer_handler_t)(struct zsw_periodic_timer *timer);
+
+struct zsw_periodic_timer {
+    sys_snode_t node;
+    zsw_periodic_timer_handler_t handler;
+    uint32_t period_ms;
+    uint32_t slack_ms;
+    int64_t deadline_ms;
+    bool running;
+    bool pending;
+};
+
+#define ZSW_PERIODIC_TIMER_DEFINE(_name, _handler)      \
+    struct zsw_periodic_timer _name = {                 \
+        .handler = _handler,                            \
+    }
+
 int zsw_periodic_chan_add_obs(const struct zbus_channel *chan, const struct zbus_observer *obs);
 int zsw_periodic_chan_rm_obs(const struct zbus_channel *chan, const struct zbus_observer *obs);
+
+/** @brief Start a periodic timer on the shared timer wheel.
+ *         The period is rounded up to a multiple of the 100 ms wheel tick and the timer fires
+ *         on multiples of the period in uptime, so timers with related periods share wakeups.
+ *         The handler is called from the system workqueue.
+ *  @param timer Timer defined with ZSW_PERIODIC_TIMER_DEFINE.
+ *  @param period_ms Period in milliseconds.
+ *  @param slack_ms How late the timer may fire so it can be batched with another timer, 0 for no slack.
+ *  @return 0 on success, -EALREADY if already started.
+*/
+int zsw_periodic_timer_start(struct zsw_periodic_timer *timer, uint32_t period_ms, uint32_t slack_ms);
+
+/** @brief Stop a periodic timer. The wheel stops completely when no timer is running.
+ *  @param timer Timer to stop.
+ *  @return 0 on success, -EALREADY if not started.
+*/
+int zsw_periodic_timer_stop(struct zsw_periodic_timer *timer);
+
+/** @brief Timer handler of the periodic event channels, publishes on the channel the timer belongs to.
+ *  @param timer Timer from the user data of the channel.
+*/
+void zsw_periodic_chan_timeout(struct zsw_periodic_timer *timer);
+
+/** @brief Number of times the timer wheel has woken up since boot.
+*/
+uint32_t zsw_periodic_get_num_wakeups(void);
@@ -15,6 +15,30 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#pragma once
+
+#include <stdint.h>
+
+typedef struct zsw_filesystem_cache_stats_t {
+    uint32_t hits;                // Block lookups served from the read cache
+    uint32_t misses;              // Block lookups that required a flash read
+    uint32_t prefetched_blocks;   // Blocks loaded by sequential read ahead
+    uint32_t uncached_reads;      // Sector aligned reads done directly into the caller buffer
+    uint32_t flash_reads;         // Total number of flash transactions
+    uint32_t flash_bytes_read;    // Total number of bytes read from flash
+    uint32_t decompressed_chunks; // Number of compressed file chunks decompressed
+} zsw_filesystem_cache_stats_t;
+
 int zsw_filesytem_get_num_rawfs_files(void);
 
 int zsw_filesytem_get_total_size(void);
+
+/** @brief          Get read cache statistics for the raw LVGL filesystem. Also printed by the "rawfs stats"
+ *                  shell command. Only on hardware, the raw filesystem is not built for native_posix.
+ *  @param stats    Filled with the counters since boot or last reset
+*/
+void zsw_filesystem_get_cache_stats(zsw_filesystem_cache_stats_t *stats);
+
+/** @brief          Reset the read cache statistics, useful to measure a single screen load.
+*/
+void zsw_filesystem_reset_cache_stats(void);
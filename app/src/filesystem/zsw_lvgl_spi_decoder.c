@@ -21,12 +21,18 @@
 #include <zephyr/drivers/flash.h>
 #include <zephyr/storage/flash_map.h>
 #include <zephyr/sys/util.h>
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif
 #include <filesystem/zsw_filesystem.h>
+#include <filesystem/zsw_rle.h>
 #include <lvgl.h>
 #include "lv_conf.h"
 #include LV_MEM_CUSTOM_INCLUDE
 
-#define TABLE_HEADER_MAGIC 0x0A0A0A0A
+// Format 3: file headers are sorted by filename hash and preceded by an array of the hashes.
+// Each file header holds the compression used for that file.
+#define TABLE_HEADER_MAGIC 0x0A0A0A0C
 
 #define SPI_FLASH_SECTOR_SIZE        4096
 
@@ -36,62 +42,225 @@
 #define FLASH_PARTITION_DEVICE  FIXED_PARTITION_DEVICE(FLASH_PARTITION_NAME)
 #define FLASH_PARTITION_OFFSET  FIXED_PARTITION_OFFSET(FLASH_PARTITION_NAME)
 
-#define FILE_TABLE_MAX_LEN  32000
 #define MAX_FILE_NAME_LEN   32
 #define MAX_OPENED_FILES    64
+#define MAX_NUM_FILES       1024
+
+#define FNV_OFFSET_BASIS    2166136261u
+#define FNV_PRIME           16777619u
+
+#define COMPRESSION_NONE            0
+#define COMPRESSION_RLE             1
+#define COMPRESSION_TYPE(c)         ((c) & 0xFF)
+#define COMPRESSION_UNIT(c)         (((c) >> 8) & 0xFF)
+#define COMPRESSION_CHUNK_MAX_LEN   4096
+#define RLE_STREAM_BUF_LEN          64
 
 typedef struct file_header_t {
     uint8_t         filename[MAX_FILE_NAME_LEN];
     uint32_t        offset;
-    uint32_t        len;
+    uint32_t        len;        // Uncompressed length
+    uint32_t        stored_len; // Length in flash
+    uint32_t        compression;
 } file_header_t;
 
+/*
+ * Layout in flash:
+ * file_table_t
+ * uint32_t name_hashes[num_files]      Sorted ascending
+ * file_header_t file_headers[num_files] Same order as name_hashes
+ * File data
+ *
+ * A compressed file starts with uint32_t chunk_offsets[num_chunks + 1] relative to the
+ * start of the file, followed by the independently compressed chunks. Chunks are
+ * COMPRESSION_CHUNK_MAX_LEN rounded down to a multiple of the RLE unit size when
+ * uncompressed, so any position in the file can be reached by decompressing one chunk.
+ * See create_custom_resource_image.py for the RLE token format.
+ */
 typedef struct file_table_t {
     uint32_t        magic;
     uint32_t        header_length; // Image offset counted from after this.
     uint32_t        total_length;
     uint32_t        num_files;
-    file_header_t   file_headers[FILE_TABLE_MAX_LEN / sizeof(file_header_t)];
 } file_table_t;
 
 typedef struct opened_file_t {
-    file_header_t  *header;
+    bool            in_use;
+    uint32_t        offset;
+    uint32_t        len;
+    uint32_t        stored_len;
+    uint32_t        compression;
     uint32_t        index;
-    bool            is_cached;
-    uint32_t        cache_start;
-    uint32_t        cache_end;
+    uint32_t        next_sequential_index;
 } opened_file_t;
 
+typedef struct cache_block_t {
+    uint32_t        address; // Sector aligned offset into the partition
+    uint32_t        last_used;
+    bool            valid;
+} cache_block_t;
+
+typedef struct rle_stream_t {
+    uint32_t        address;
+    uint32_t        end_address;
+    uint32_t        file_end_address;
+    bool            sequential;
+    uint16_t        pos;
+    uint16_t        len;
+    uint8_t         buf[RLE_STREAM_BUF_LEN];
+} rle_stream_t;
+
+BUILD_ASSERT(CONFIG_ZSW_LVGL_SPI_DECODER_READ_AHEAD_BLOCKS < CONFIG_ZSW_LVGL_SPI_DECODER_CACHE_BLOCKS,
+             "Read ahead must fit in the cache together with the requested block");
+
 static file_table_t file_table;
+// Only the hashes are kept in RAM, file headers are read from flash on open.
+static uint32_t file_name_hashes[MAX_NUM_FILES];
 static opened_file_t opened_files[MAX_OPENED_FILES];
 
-static uint8_t file_cache_buffer[SPI_FLASH_SECTOR_SIZE];
-static opened_file_t *current_cached_file;
+static uint8_t cache_data[CONFIG_ZSW_LVGL_SPI_DECODER_CACHE_BLOCKS][SPI_FLASH_SECTOR_SIZE] __aligned(4);
+static cache_block_t cache_blocks[CONFIG_ZSW_LVGL_SPI_DECODER_CACHE_BLOCKS];
+static uint32_t cache_use_counter;
+static zsw_filesystem_cache_stats_t cache_stats;
+
+#ifdef CONFIG_ZSW_LVGL_SPI_DECODER_COMPRESSION
+static uint8_t decompressed_chunk[COMPRESSION_CHUNK_MAX_LEN];
+static uint32_t decompressed_chunk_len;
+static uint32_t decompressed_chunk_file_offset;
+static uint32_t decompressed_chunk_index;
+static bool decompressed_chunk_valid;
+#endif
 
 static const struct flash_area *flash_area;
 
 static lv_fs_drv_t fs_drv;
 
-static file_header_t *find_file(const char *name)
+static uint32_t file_name_hash(const char *name)
 {
-    for (int i = 0; i < file_table.num_files; i++) {
-        if (strncmp(name, file_table.file_headers[i].filename, MAX_FILE_NAME_LEN) == 0) {
-            return &file_table.file_headers[i];
+    uint32_t hash = FNV_OFFSET_BASIS;
+
+    for (int i = 0; i < MAX_FILE_NAME_LEN && name[i] != '\0'; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static int find_file(const char *name, file_header_t *header)
+{
+    int rc;
+    uint32_t hash = file_name_hash(name);
+    uint32_t low = 0;
+    uint32_t high = file_table.num_files;
+    uint32_t headers_offset = sizeof(file_table_t) + file_table.num_files * sizeof(uint32_t);
+
+    // Find the first entry with matching hash
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (file_name_hashes[mid] < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
     }
-    return NULL;
+
+    // Several files may share the same hash, compare names to find the right one.
+    for (uint32_t i = low; i < file_table.num_files && file_name_hashes[i] == hash; i++) {
+        rc = flash_area_read(flash_area, headers_offset + i * sizeof(file_header_t), header, sizeof(file_header_t));
+        if (rc != 0) {
+            printk("Flash read failed! %d\n", rc);
+            return rc;
+        }
+        if (strncmp(name, (const char *)header->filename, MAX_FILE_NAME_LEN) == 0) {
+            return 0;
+        }
+    }
+
+    return -ENOENT;
 }
 
 static opened_file_t *find_free_opened_file(void)
 {
     for (int i = 0; i < MAX_OPENED_FILES; i++) {
-        if (opened_files[i].header == NULL) {
+        if (!opened_files[i].in_use) {
             return &opened_files[i];
         }
     }
     return NULL;
 }
 
+static int cache_lookup(uint32_t block_address)
+{
+    for (int i = 0; i < CONFIG_ZSW_LVGL_SPI_DECODER_CACHE_BLOCKS; i++) {
+        if (cache_blocks[i].valid && cache_blocks[i].address == block_address) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int cache_find_victim(int num_blocks)
+{
+    int victim = 0;
+    uint32_t victim_last_used = UINT32_MAX;
+
+    // Adjacent slots are needed so that read ahead can be done in one flash transaction.
+    // Pick the window of slots where the most recently used slot is the oldest.
+    for (int i = 0; i <= CONFIG_ZSW_LVGL_SPI_DECODER_CACHE_BLOCKS - num_blocks; i++) {
+        uint32_t window_last_used = 0;
+        for (int j = i; j < i + num_blocks; j++) {
+            window_last_used = MAX(window_last_used, cache_blocks[j].valid ? cache_blocks[j].last_used : 0);
+        }
+        if (window_last_used < victim_last_used) {
+            victim = i;
+            victim_last_used = window_last_used;
+        }
+    }
+
+    return victim;
+}
+
+static int cache_fill(uint32_t block_address, uint32_t file_end_address, bool sequential)
+{
+    int rc;
+    int slot;
+    int num_blocks = 1;
+
+    if (sequential) {
+        while (num_blocks <= CONFIG_ZSW_LVGL_SPI_DECODER_READ_AHEAD_BLOCKS) {
+            uint32_t next_address = block_address + num_blocks * SPI_FLASH_SECTOR_SIZE;
+            if (next_address >= file_end_address || next_address >= flash_area->fa_size ||
+                cache_lookup(next_address) >= 0) {
+                break;
+            }
+            num_blocks++;
+        }
+    }
+
+    slot = cache_find_victim(num_blocks);
+
+    cache_stats.flash_reads++;
+    cache_stats.flash_bytes_read += num_blocks * SPI_FLASH_SECTOR_SIZE;
+    cache_stats.prefetched_blocks += num_blocks - 1;
+    cache_use_counter++;
+
+    rc = flash_area_read(flash_area, block_address, cache_data[slot], num_blocks * SPI_FLASH_SECTOR_SIZE);
+
+    for (int i = 0; i < num_blocks; i++) {
+        cache_blocks[slot + i].valid = rc == 0;
+        cache_blocks[slot + i].address = block_address + i * SPI_FLASH_SECTOR_SIZE;
+        cache_blocks[slot + i].last_used = cache_use_counter;
+    }
+
+    if (rc != 0) {
+        printk("Flash read failed! %d\n", rc);
+        return rc;
+    }
+
+    return slot;
+}
+
 static bool lvgl_fs_ready(struct _lv_fs_drv_t *drv)
 {
     return true;
@@ -136,26 +305,44 @@ static lv_fs_res_t errno_to_lv_fs_res(int err)
 
 static void *lvgl_fs_open(struct _lv_fs_drv_t *drv, const char *path, lv_fs_mode_t mode)
 {
-    file_header_t *file;
+    file_header_t file;
+    opened_file_t *open_file;
 
     if (file_table.magic != TABLE_HEADER_MAGIC) {
         return NULL;
     }
 
-    file = find_file(path);
-    opened_file_t *open_file;
-
-    if (!file) {
+    if (find_file(path, &file) != 0) {
         return NULL;
     }
 
+    switch (COMPRESSION_TYPE(file.compression)) {
+        case COMPRESSION_NONE:
+            break;
+#ifdef CONFIG_ZSW_LVGL_SPI_DECODER_COMPRESSION
+        case COMPRESSION_RLE:
+            if (COMPRESSION_UNIT(file.compression) == 0) {
+                return NULL;
+            }
+            break;
+#endif
+        default:
+            printk("%s uses unsupported compression 0x%x\n", path, file.compression);
+            return NULL;
+    }
+
     open_file = find_free_opened_file();
-    if (!file) {
+    if (!open_file) {
         return NULL;
     }
 
-    open_file->header = file;
+    open_file->in_use = true;
+    open_file->offset = file.offset;
+    open_file->len = file.len;
+    open_file->stored_len = file.stored_len;
+    open_file->compression = file.compression;
     open_file->index = 0;
+    open_file->next_sequential_index = 0;
 
     return open_file;
 }
@@ -163,80 +350,203 @@ static void *lvgl_fs_open(struct _lv_fs_drv_t *drv, const char *path, lv_fs_mode
 static lv_fs_res_t lvgl_fs_close(struct _lv_fs_drv_t *drv, void *file)
 {
     opened_file_t *open_file = (opened_file_t *)file;
-    open_file->header = NULL;
+    open_file->in_use = false;
     open_file->index = 0;
-    open_file->is_cached = false;
     return errno_to_lv_fs_res(0);
 }
 
-static lv_fs_res_t lvgl_fs_read(struct _lv_fs_drv_t *drv, void *file, void *buf, uint32_t btr,
-                                uint32_t *br)
+static int read_cached(uint32_t address, void *buf, uint32_t len, uint32_t file_end_address, bool sequential)
 {
     int rc;
-    uint32_t extra_bytes_start;
-    uint32_t extra_bytes_end;
-    uint32_t extra_cache_bytes;
-    uint32_t orig_read_address, read_address;
-    opened_file_t *open_file = (opened_file_t *)file;
+    int slot;
+    uint8_t *dst = buf;
+    uint32_t end_address = address + len;
+
+    while (address < end_address) {
+        uint32_t block_address = ROUND_DOWN(address, SPI_FLASH_SECTOR_SIZE);
+        uint32_t block_offset = address - block_address;
+        uint32_t chunk_len = MIN(SPI_FLASH_SECTOR_SIZE - block_offset, end_address - address);
+
+        slot = cache_lookup(block_address);
+
+        if (slot < 0 && block_offset == 0 && chunk_len == SPI_FLASH_SECTOR_SIZE) {
+            // Whole sectors that are not cached, read them straight into the
+            // callers buffer instead of thrashing the cache.
+            uint32_t direct_len = ROUND_DOWN(end_address - address, SPI_FLASH_SECTOR_SIZE);
+
+            cache_stats.uncached_reads++;
+            cache_stats.flash_reads++;
+            cache_stats.flash_bytes_read += direct_len;
+            rc = flash_area_read(flash_area, address, dst, direct_len);
+            if (rc != 0) {
+                printk("Flash read failed! %d\n", rc);
+                return rc;
+            }
+            address += direct_len;
+            dst += direct_len;
+            continue;
+        }
 
-    orig_read_address = open_file->header->offset + open_file->index + file_table.header_length;
+        if (slot < 0) {
+            cache_stats.misses++;
+            slot = cache_fill(block_address, file_end_address, sequential);
+            if (slot < 0) {
+                return slot;
+            }
+        } else {
+            cache_stats.hits++;
+            cache_blocks[slot].last_used = ++cache_use_counter;
+        }
 
-    if (open_file->is_cached && (orig_read_address >= current_cached_file->cache_start) &&
-        ((orig_read_address + btr) < current_cached_file->cache_end)) {
-        __ASSERT(current_cached_file == open_file, "Cached file mismatch");
-        memcpy(buf, file_cache_buffer + (orig_read_address - current_cached_file->cache_start), btr);
-        *br = btr;
-        open_file->index += btr;
-        return errno_to_lv_fs_res(0);
-    } else if (current_cached_file) {
-        // Cache miss
-        current_cached_file->is_cached = false;
-        current_cached_file = NULL;
+        memcpy(dst, &cache_data[slot][block_offset], chunk_len);
+        address += chunk_len;
+        dst += chunk_len;
     }
 
-    read_address = ROUND_DOWN(orig_read_address, 4);
+    return 0;
+}
 
-    if ((read_address != orig_read_address) && btr < sizeof(file_cache_buffer)) {
-        extra_bytes_start = orig_read_address - read_address;
-    } else {
-        extra_bytes_start = 0;
-        read_address = orig_read_address;
+#ifdef CONFIG_ZSW_LVGL_SPI_DECODER_COMPRESSION
+static int rle_stream_read(void *user_data, uint8_t *dst, uint32_t len)
+{
+    int rc;
+    rle_stream_t *stream = user_data;
+
+    while (len > 0) {
+        uint32_t copy_len;
+
+        if (stream->pos == stream->len) {
+            stream->len = MIN(RLE_STREAM_BUF_LEN, stream->end_address - stream->address);
+            stream->pos = 0;
+            if (stream->len == 0) {
+                // Compressed data ended before the chunk was complete
+                return -EBADF;
+            }
+            rc = read_cached(stream->address, stream->buf, stream->len, stream->file_end_address, stream->sequential);
+            if (rc != 0) {
+                stream->len = 0;
+                return rc;
+            }
+            stream->address += stream->len;
+        }
+
+        copy_len = MIN(len, stream->len - stream->pos);
+        memcpy(dst, &stream->buf[stream->pos], copy_len);
+        stream->pos += copy_len;
+        dst += copy_len;
+        len -= copy_len;
     }
 
-    if (!IS_ALIGNED(btr + extra_bytes_start, 4) && (ROUND_UP(btr + extra_bytes_start, 4) < sizeof(file_cache_buffer))) {
-        extra_bytes_end = ROUND_UP(btr + extra_bytes_start, 4) - (btr + extra_bytes_start);
-    } else {
-        extra_bytes_end = 0;
+    return 0;
+}
+
+static int decompress_chunk(opened_file_t *open_file, uint32_t chunk_index, bool sequential)
+{
+    int rc;
+    uint32_t chunk_offsets[2];
+    rle_stream_t stream;
+    uint32_t unit = COMPRESSION_UNIT(open_file->compression);
+    uint32_t chunk_len = ROUND_DOWN(COMPRESSION_CHUNK_MAX_LEN, unit);
+    uint32_t file_address = file_table.header_length + open_file->offset;
+    uint32_t file_end_address = file_address + open_file->stored_len;
+
+    decompressed_chunk_valid = false;
+    decompressed_chunk_len = MIN(chunk_len, open_file->len - chunk_index * chunk_len);
+
+    rc = read_cached(file_address + chunk_index * sizeof(uint32_t), chunk_offsets, sizeof(chunk_offsets),
+                     file_end_address, sequential);
+    if (rc != 0) {
+        return rc;
     }
 
-    uint32_t cache_max_len = sizeof(file_cache_buffer) - extra_bytes_start - btr - extra_bytes_end;
-    cache_max_len = MIN(cache_max_len, open_file->header->len - open_file->index);
-
-    if (!current_cached_file && btr != 4) {
-        current_cached_file = open_file;
-        current_cached_file->cache_start = read_address;
-        current_cached_file->cache_end = read_address + cache_max_len + btr + extra_bytes_start + extra_bytes_end;
-        current_cached_file->is_cached = true;
-        extra_cache_bytes = cache_max_len;
-    } else {
-        extra_cache_bytes = 0;
+    stream.address = file_address + chunk_offsets[0];
+    stream.end_address = file_address + chunk_offsets[1];
+    stream.file_end_address = file_end_address;
+    stream.sequential = sequential;
+    stream.pos = 0;
+    stream.len = 0;
+
+    if (chunk_offsets[0] > chunk_offsets[1] || chunk_offsets[1] > open_file->stored_len) {
+        return -EBADF;
     }
 
-    rc = flash_area_read(flash_area, read_address, (extra_bytes_start || extra_bytes_end ||
-                                                    current_cached_file) ? file_cache_buffer : buf,
-                         btr + extra_bytes_start + extra_bytes_end + extra_cache_bytes);
+    rc = zsw_rle_decode_chunk(rle_stream_read, &stream, decompressed_chunk, decompressed_chunk_len, unit);
     if (rc != 0) {
-        printk("Flash read failed! %d\n", rc);
-        *br = 0;
-        return errno_to_lv_fs_res(rc);
+        return rc;
     }
 
-    if (extra_bytes_start || current_cached_file) {
-        memcpy(buf, file_cache_buffer + extra_bytes_start, btr);
+    cache_stats.decompressed_chunks++;
+    decompressed_chunk_file_offset = open_file->offset;
+    decompressed_chunk_index = chunk_index;
+    decompressed_chunk_valid = true;
+
+    return 0;
+}
+
+static int read_compressed(opened_file_t *open_file, uint8_t *dst, uint32_t len, bool sequential)
+{
+    int rc;
+    uint32_t chunk_len = ROUND_DOWN(COMPRESSION_CHUNK_MAX_LEN, COMPRESSION_UNIT(open_file->compression));
+    uint32_t index = open_file->index;
+
+    while (len > 0) {
+        uint32_t chunk_index = index / chunk_len;
+        uint32_t chunk_offset = index % chunk_len;
+        uint32_t copy_len;
+
+        if (!decompressed_chunk_valid || decompressed_chunk_file_offset != open_file->offset ||
+            decompressed_chunk_index != chunk_index) {
+            rc = decompress_chunk(open_file, chunk_index, sequential);
+            if (rc != 0) {
+                printk("Decompression failed! %d\n", rc);
+                return rc;
+            }
+        }
+
+        copy_len = MIN(len, decompressed_chunk_len - chunk_offset);
+        memcpy(dst, &decompressed_chunk[chunk_offset], copy_len);
+        dst += copy_len;
+        index += copy_len;
+        len -= copy_len;
+    }
+
+    return 0;
+}
+#endif
+
+static lv_fs_res_t lvgl_fs_read(struct _lv_fs_drv_t *drv, void *file, void *buf, uint32_t btr,
+                                uint32_t *br)
+{
+    int rc;
+    uint32_t file_address;
+    opened_file_t *open_file = (opened_file_t *)file;
+    bool sequential = open_file->index == open_file->next_sequential_index;
+
+    *br = 0;
+    if (open_file->index >= open_file->len) {
+        return errno_to_lv_fs_res(0);
+    }
+    btr = MIN(btr, open_file->len - open_file->index);
+
+    file_address = file_table.header_length + open_file->offset;
+
+#ifdef CONFIG_ZSW_LVGL_SPI_DECODER_COMPRESSION
+    if (COMPRESSION_TYPE(open_file->compression) == COMPRESSION_RLE) {
+        rc = read_compressed(open_file, buf, btr, sequential);
+    } else
+#endif
+    {
+        rc = read_cached(file_address + open_file->index, buf, btr, file_address + open_file->stored_len, sequential);
+    }
+
+    if (rc != 0) {
+        return errno_to_lv_fs_res(rc);
     }
 
     *br = btr;
     open_file->index += btr;
+    open_file->next_sequential_index = open_file->index;
+
     return errno_to_lv_fs_res(0);
 }
 
@@ -253,7 +563,7 @@ static lv_fs_res_t lvgl_fs_seek(struct _lv_fs_drv_t *drv, void *file, uint32_t p
 
     switch (whence) {
         case LV_FS_SEEK_END:
-            open_file->index = open_file->header->len;
+            open_file->index = open_file->len;
             break;
         case LV_FS_SEEK_CUR:
             open_file->index += pos;
@@ -301,6 +611,54 @@ int zsw_filesytem_get_total_size(void)
     return file_table.total_length;
 }
 
+void zsw_filesystem_get_cache_stats(zsw_filesystem_cache_stats_t *stats)
+{
+    *stats = cache_stats;
+}
+
+void zsw_filesystem_reset_cache_stats(void)
+{
+    memset(&cache_stats, 0, sizeof(cache_stats));
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_rawfs_cache_stats(const struct shell *sh, size_t argc, char **argv)
+{
+    zsw_filesystem_cache_stats_t stats;
+    uint32_t lookups;
+
+    zsw_filesystem_get_cache_stats(&stats);
+    lookups = stats.hits + stats.misses;
+
+    shell_print(sh, "Cache blocks: %d, read ahead: %d", CONFIG_ZSW_LVGL_SPI_DECODER_CACHE_BLOCKS,
+                CONFIG_ZSW_LVGL_SPI_DECODER_READ_AHEAD_BLOCKS);
+    shell_print(sh, "Hits: %d, misses: %d (%d%% hit rate), prefetched blocks: %d, uncached reads: %d",
+                stats.hits, stats.misses, lookups > 0 ? stats.hits * 100 / lookups : 0, stats.prefetched_blocks,
+                stats.uncached_reads);
+    shell_print(sh, "Flash reads: %d, bytes: %d, decompressed chunks: %d", stats.flash_reads,
+                stats.flash_bytes_read, stats.decompressed_chunks);
+
+    return 0;
+}
+
+static int cmd_rawfs_cache_reset(const struct shell *sh, size_t argc, char **argv)
+{
+    zsw_filesystem_reset_cache_stats();
+    shell_print(sh, "Cache statistics reset");
+
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(rawfs_cmds,
+                               SHELL_CMD(stats, NULL, "Print read cache hits, misses and flash reads",
+                                         cmd_rawfs_cache_stats),
+                               SHELL_CMD(reset, NULL, "Reset the read cache statistics, e.g. before a screen load",
+                                         cmd_rawfs_cache_reset),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(rawfs, &rawfs_cmds, "Raw flash LVGL filesystem", NULL);
+#endif
+
 static int zsw_decoder_init(void)
 {
     int rc;
@@ -329,6 +687,7 @@ static int zsw_decoder_init(void)
     lv_fs_drv_register(&fs_drv);
 
     memset(opened_files, 0, sizeof(opened_files));
+    memset(cache_blocks, 0, sizeof(cache_blocks));
 
     rc = flash_area_open(FLASH_PARTITION_ID, &flash_area);
 
@@ -337,9 +696,23 @@ static int zsw_decoder_init(void)
         return 0;
     }
 
-    rc = flash_area_read(flash_area, 0, &file_table, FILE_TABLE_MAX_LEN);
+    rc = flash_area_read(flash_area, 0, &file_table, sizeof(file_table));
+    if (rc != 0) {
+        printk("Flash read failed! %d\n", rc);
+        return rc;
+    }
+
+    if (file_table.magic != TABLE_HEADER_MAGIC || file_table.num_files > MAX_NUM_FILES) {
+        printk("No valid file table found in flash, magic: 0x%x, num files: %d\n", file_table.magic,
+               file_table.num_files);
+        memset(&file_table, 0, sizeof(file_table));
+        return 0;
+    }
+
+    rc = flash_area_read(flash_area, sizeof(file_table), file_name_hashes, file_table.num_files * sizeof(uint32_t));
     if (rc != 0) {
         printk("Flash read failed! %d\n", rc);
+        memset(&file_table, 0, sizeof(file_table));
         return rc;
     }
     return 0;
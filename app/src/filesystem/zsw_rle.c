@@ -0,0 +1,66 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "filesystem/zsw_rle.h"
+
+int zsw_rle_decode_chunk(zsw_rle_read_t read, void *user_data, uint8_t *dst, uint32_t len, uint32_t unit)
+{
+    int rc;
+    uint8_t ctrl;
+    uint32_t count;
+    uint32_t pos = 0;
+
+    if (unit == 0) {
+        return -EINVAL;
+    }
+
+    while (pos + unit <= len) {
+        rc = read(user_data, &ctrl, 1);
+        if (rc != 0) {
+            return rc;
+        }
+        if (ctrl & 0x80) {
+            count = (ctrl & 0x7F) + 2;
+            if (pos + count * unit > len) {
+                return -EBADF;
+            }
+            rc = read(user_data, &dst[pos], unit);
+            if (rc != 0) {
+                return rc;
+            }
+            for (uint32_t i = 1; i < count; i++) {
+                memcpy(&dst[pos + i * unit], &dst[pos], unit);
+            }
+        } else {
+            count = ctrl + 1;
+            if (pos + count * unit > len) {
+                return -EBADF;
+            }
+            rc = read(user_data, &dst[pos], count * unit);
+            if (rc != 0) {
+                return rc;
+            }
+        }
+        pos += count * unit;
+    }
+
+    // Bytes after the last whole unit are stored raw
+    return read(user_data, &dst[pos], len - pos);
+}
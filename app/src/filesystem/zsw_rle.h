@@ -0,0 +1,40 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/** @brief              Read the next bytes of the compressed data.
+ *  @param user_data    User data given to zsw_rle_decode_chunk
+ *  @param dst          Where to put the bytes
+ *  @param len          Number of bytes to read
+ *  @return             0 when len bytes were read, negative error code otherwise
+*/
+typedef int (*zsw_rle_read_t)(void *user_data, uint8_t *dst, uint32_t len);
+
+/** @brief              Decompress one RLE chunk packed by create_custom_resource_image.py.
+ *                      A control byte with bit 7 set is followed by one unit repeated (ctrl & 0x7F) + 2 times,
+ *                      otherwise by ctrl + 1 literal units. Bytes after the last whole unit are stored raw.
+ *  @param read         Called to get the compressed data
+ *  @param user_data    Passed to read
+ *  @param dst          Filled with exactly len decompressed bytes
+ *  @param len          Uncompressed length of the chunk
+ *  @param unit         Size of the units the runs are counted in, 1 to 255 bytes
+ *  @return             0 when successful, -EBADF when the data would not fit in len bytes, or the error from read
+*/
+int zsw_rle_decode_chunk(zsw_rle_read_t read, void *user_data, uint8_t *dst, uint32_t len, uint32_t unit);
@@ -0,0 +1,284 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Round trip test of the RLE decoder used for compressed files in the raw flash resource image, run with:
+ *   zephyr.exe --rle-test=100
+ * Compresses generated chunks with an encoder producing the same tokens as create_custom_resource_image.py,
+ * decompresses them with zsw_rle_decode_chunk and compares. Also checks that corrupt and truncated data is
+ * rejected without writing outside the chunk. Prints the decompression throughput and exits with 0 on success.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#include "zsw_bench.h"
+#include "filesystem/zsw_rle.h"
+
+#define TEST_CHUNK_MAX_LEN  4096
+#define TEST_GUARD_LEN      64
+#define TEST_GUARD_BYTE     0xAA
+// Worst case is single literal units between runs, a control byte for every unit of one byte.
+#define TEST_COMPRESSED_MAX_LEN (2 * TEST_CHUNK_MAX_LEN)
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t len;
+    uint32_t pos;
+} test_reader_t;
+
+static uint32_t test_count;
+static uint32_t rand_state;
+static uint8_t chunk[TEST_CHUNK_MAX_LEN];
+static uint8_t compressed[TEST_COMPRESSED_MAX_LEN];
+static uint8_t decompressed[TEST_CHUNK_MAX_LEN + TEST_GUARD_LEN];
+
+static struct args_struct_t test_options[] = {
+    {
+        .option = "rle-test",
+        .name = "iterations",
+        .type = 'u',
+        .dest = (void *) &test_count,
+        .descript = "Round trip this many sets of generated chunks through the RLE decoder, exits when done"
+    },
+    ARG_TABLE_ENDMARKER
+};
+
+static uint32_t test_rand(uint32_t max)
+{
+    rand_state = rand_state * 1103515245 + 12345;
+
+    return (rand_state >> 16) % max;
+}
+
+// Like the flash stream in the decoder, copies what is left before failing.
+static int test_read(void *user_data, uint8_t *dst, uint32_t len)
+{
+    test_reader_t *reader = user_data;
+    uint32_t copy_len = MIN(len, reader->len - reader->pos);
+
+    memcpy(dst, &reader->data[reader->pos], copy_len);
+    reader->pos += copy_len;
+
+    return copy_len == len ? 0 : -ENODATA;
+}
+
+static uint32_t flush_literals(const uint8_t *data, uint32_t num_units, uint32_t unit, uint8_t *out)
+{
+    uint32_t out_len = 0;
+
+    while (num_units > 0) {
+        uint32_t part = MIN(num_units, 128);
+
+        out[out_len++] = part - 1;
+        memcpy(&out[out_len], data, part * unit);
+        out_len += part * unit;
+        data += part * unit;
+        num_units -= part;
+    }
+
+    return out_len;
+}
+
+// Same tokens as rle_compress_chunk in create_custom_resource_image.py.
+static uint32_t encode_chunk(const uint8_t *data, uint32_t len, uint32_t unit, uint8_t *out)
+{
+    uint32_t num_units = len / unit;
+    uint32_t literal_start = 0;
+    uint32_t out_len = 0;
+    uint32_t i = 0;
+
+    while (i < num_units) {
+        uint32_t run = 1;
+
+        while (i + run < num_units && run < 129 &&
+               memcmp(&data[(i + run) * unit], &data[i * unit], unit) == 0) {
+            run++;
+        }
+        if (run >= 2) {
+            out_len += flush_literals(&data[literal_start * unit], i - literal_start, unit, &out[out_len]);
+            out[out_len++] = 0x80 | (run - 2);
+            memcpy(&out[out_len], &data[i * unit], unit);
+            out_len += unit;
+            i += run;
+            literal_start = i;
+        } else {
+            i++;
+        }
+    }
+    out_len += flush_literals(&data[literal_start * unit], i - literal_start, unit, &out[out_len]);
+    memcpy(&out[out_len], &data[num_units * unit], len - num_units * unit);
+
+    return out_len + len - num_units * unit;
+}
+
+static int decode(const uint8_t *data, uint32_t data_len, uint32_t len, uint32_t unit)
+{
+    test_reader_t reader = { .data = data, .len = data_len, .pos = 0 };
+
+    memset(decompressed, TEST_GUARD_BYTE, sizeof(decompressed));
+    return zsw_rle_decode_chunk(test_read, &reader, decompressed, len, unit);
+}
+
+static bool guard_intact(uint32_t from)
+{
+    for (uint32_t i = from; i < sizeof(decompressed); i++) {
+        if (decompressed[i] != TEST_GUARD_BYTE) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Solid areas, short runs, noise and RGB565 like gradients, the kind of content in the image resources.
+static void generate_chunk(uint32_t pattern, uint32_t len, uint32_t unit)
+{
+    switch (pattern) {
+        case 0:
+            memset(chunk, 0, len);
+            break;
+        case 1:
+            for (uint32_t i = 0; i < len; i++) {
+                chunk[i] = test_rand(256);
+            }
+            break;
+        case 2:
+            for (uint32_t i = 0; i < len; i += unit) {
+                if (i == 0 || test_rand(8) == 0) {
+                    for (uint32_t j = 0; j < unit && i + j < len; j++) {
+                        chunk[i + j] = test_rand(256);
+                    }
+                } else {
+                    memcpy(&chunk[i], &chunk[i - unit], MIN(unit, len - i));
+                }
+            }
+            break;
+        default:
+            for (uint32_t i = 0; i < len; i += 2) {
+                uint16_t color = ((i / 64) & 0x1F) << 11 | ((i / 16) & 0x3F) << 5 | ((i / 256) & 0x1F);
+
+                chunk[i] = color & 0xFF;
+                if (i + 1 < len) {
+                    chunk[i + 1] = color >> 8;
+                }
+            }
+            break;
+    }
+}
+
+static int test_round_trip(uint32_t *p_num_bytes, int64_t *p_elapsed_us)
+{
+    static const uint32_t units[] = { 1, 2, 3, 4 };
+
+    for (uint32_t u = 0; u < ARRAY_SIZE(units); u++) {
+        uint32_t unit = units[u];
+
+        for (uint32_t pattern = 0; pattern < 4; pattern++) {
+            // Full chunks and the shorter last chunk of a file, which might end with a partial unit.
+            uint32_t len = test_rand(2) ? ROUND_DOWN(TEST_CHUNK_MAX_LEN, unit) : 1 + test_rand(TEST_CHUNK_MAX_LEN);
+            uint32_t compressed_len;
+            int64_t start_us;
+            int rc;
+
+            generate_chunk(pattern, len, unit);
+            compressed_len = encode_chunk(chunk, len, unit, compressed);
+
+            start_us = zsw_bench_time_us();
+            rc = decode(compressed, compressed_len, len, unit);
+            *p_elapsed_us += zsw_bench_time_us() - start_us;
+            *p_num_bytes += len;
+
+            if (rc != 0 || memcmp(decompressed, chunk, len) != 0 || !guard_intact(len)) {
+                printk("Round trip failed, unit %d, pattern %d, len %d: %d\n", unit, pattern, len, rc);
+                return 1;
+            }
+
+            // Every truncation must fail, also in the middle of a token, and never write past the chunk.
+            for (uint32_t cut = 0; cut < compressed_len; cut += 1 + test_rand(64)) {
+                rc = decode(compressed, cut, len, unit);
+                if (rc == 0 || !guard_intact(len)) {
+                    printk("Truncated data accepted, unit %d, pattern %d, len %d, cut %d: %d\n", unit, pattern,
+                           len, cut, rc);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int test_corrupt(void)
+{
+    // Repeat of 7 two byte units where the unit is cut short, the run must not be written.
+    static const uint8_t missing_repeat_unit[] = { 0x85, 0x11 };
+    // Repeat and literal tokens longer than the 8 byte chunk.
+    static const uint8_t long_repeat[] = { 0x83, 0x11, 0x22 };
+    static const uint8_t long_literal[] = { 0x04, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    int rc;
+
+    rc = decode(missing_repeat_unit, sizeof(missing_repeat_unit), 16, 2);
+    if (rc != -ENODATA || !guard_intact(1)) {
+        printk("Missing repeat unit not rejected: %d\n", rc);
+        return 1;
+    }
+
+    rc = decode(long_repeat, sizeof(long_repeat), 8, 2);
+    if (rc != -EBADF || !guard_intact(0)) {
+        printk("Too long repeat not rejected: %d\n", rc);
+        return 1;
+    }
+
+    rc = decode(long_literal, sizeof(long_literal), 8, 2);
+    if (rc != -EBADF || !guard_intact(0)) {
+        printk("Too long literal not rejected: %d\n", rc);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int rle_test(void)
+{
+    uint32_t num_bytes = 0;
+    int64_t elapsed_us = 0;
+
+    if (test_count == 0) {
+        return ZSW_BENCH_NOT_RUN;
+    }
+
+    rand_state = 1;
+    for (uint32_t i = 0; i < test_count; i++) {
+        if (test_round_trip(&num_bytes, &elapsed_us) != 0) {
+            return 1;
+        }
+    }
+
+    if (test_corrupt() != 0) {
+        return 1;
+    }
+
+    zsw_bench_print_result("Decompress (bytes)", num_bytes, elapsed_us);
+    printk("RLE test passed\n");
+
+    return 0;
+}
+
+ZSW_BENCH_DEFINE(rle_test, 2048, test_options, rle_test);
@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <time.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/zbus/zbus.h>
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif
+
+#include "history/zsw_activity_log.h"
+#include "events/zsw_periodic_event.h"
+#include "sensors/zsw_imu.h"
+#include "sensors/zsw_pressure_sensor.h"
+#include "sensors/zsw_environment_sensor.h"
+
+#define ACTIVITY_LOG_PATH           "/lvgl_lfs/activity"
+#define ACTIVITY_LOG_PERIOD_S       10
+
+BUILD_ASSERT(CONFIG_ZSW_ACTIVITY_LOG_INTERVAL_S % ACTIVITY_LOG_PERIOD_S == 0,
+             "Logged from the 10 s periodic channel");
+
+LOG_MODULE_REGISTER(zsw_activity_log, CONFIG_ZSW_HISTORY_LOG_LEVEL);
+
+static void zbus_periodic_slow_callback(const struct zbus_channel *chan);
+
+ZBUS_CHAN_DECLARE(periodic_event_10s_chan);
+ZBUS_LISTENER_DEFINE(zsw_activity_log_lis, zbus_periodic_slow_callback);
+
+static zsw_timeseries_t activity_log;
+static uint32_t seconds_since_log;
+static uint32_t seconds_since_flush;
+
+static void zbus_periodic_slow_callback(const struct zbus_channel *chan)
+{
+    int32_t values[ZSW_ACTIVITY_LOG_NUM_COLUMNS] = { 0 };
+    uint32_t steps;
+    float pressure;
+    float iaq;
+
+    seconds_since_log += ACTIVITY_LOG_PERIOD_S;
+    if (seconds_since_log < CONFIG_ZSW_ACTIVITY_LOG_INTERVAL_S) {
+        return;
+    }
+    seconds_since_log = 0;
+
+    // Missing sensors are logged as 0, which costs one byte per row.
+    if (zsw_imu_fetch_num_steps(&steps) == 0) {
+        values[ZSW_ACTIVITY_LOG_STEPS] = steps;
+    }
+    if (zsw_pressure_sensor_get_pressure(&pressure) == 0) {
+        values[ZSW_ACTIVITY_LOG_PRESSURE] = (int32_t)(pressure * 100);
+    }
+    if (zsw_environment_sensor_get_iaq(&iaq) == 0) {
+        values[ZSW_ACTIVITY_LOG_IAQ] = (int32_t)iaq;
+    }
+
+    // Only written to the filesystem when a block is full, or on the flush interval so not much is lost on reset.
+    zsw_timeseries_append(&activity_log, (uint32_t)time(NULL), values);
+
+    seconds_since_flush += CONFIG_ZSW_ACTIVITY_LOG_INTERVAL_S;
+    if (seconds_since_flush >= CONFIG_ZSW_ACTIVITY_LOG_FLUSH_INTERVAL_S) {
+        seconds_since_flush = 0;
+        zsw_timeseries_flush(&activity_log);
+    }
+}
+
+int zsw_activity_log_init(void)
+{
+    int ret;
+
+    ret = zsw_timeseries_init(&activity_log, ZSW_ACTIVITY_LOG_NUM_COLUMNS, ACTIVITY_LOG_PATH);
+    if (ret) {
+        LOG_ERR("Failed init activity log: %d", ret);
+        return ret;
+    }
+
+    zsw_periodic_chan_add_obs(&periodic_event_10s_chan, &zsw_activity_log_lis);
+
+    return 0;
+}
+
+zsw_timeseries_t *zsw_activity_log_get(void)
+{
+    return &activity_log;
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_activity_log_dump(const struct shell *sh, size_t argc, char **argv)
+{
+    static zsw_timeseries_reader_t reader;
+    int32_t values[ZSW_ACTIVITY_LOG_NUM_COLUMNS];
+    uint32_t from_timestamp = argc > 1 ? strtoul(argv[1], NULL, 10) : 0;
+    uint32_t timestamp;
+    uint32_t num_rows = 0;
+
+    zsw_timeseries_reader_open(&activity_log, &reader, from_timestamp);
+    while (zsw_timeseries_reader_next(&reader, &timestamp, values) == 0) {
+        shell_print(sh, "%u,%d,%d,%d", timestamp, values[ZSW_ACTIVITY_LOG_STEPS], values[ZSW_ACTIVITY_LOG_PRESSURE],
+                    values[ZSW_ACTIVITY_LOG_IAQ]);
+        num_rows++;
+    }
+    shell_print(sh, "%u rows", num_rows);
+
+    return 0;
+}
+
+static int cmd_activity_log_stats(const struct shell *sh, size_t argc, char **argv)
+{
+    zsw_timeseries_stats_t stats;
+
+    zsw_timeseries_get_stats(&activity_log, &stats);
+
+    shell_print(sh, "Rows appended: %u, blocks written: %u, rotations: %u", stats.rows_appended,
+                stats.blocks_written, stats.rotations);
+    shell_print(sh, "Bytes written: %u, unencoded: %u", stats.bytes_written, stats.raw_bytes);
+
+    return 0;
+}
+
+static int cmd_activity_log_flush(const struct shell *sh, size_t argc, char **argv)
+{
+    return zsw_timeseries_flush(&activity_log);
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(activity_log_cmds,
+                               SHELL_CMD_ARG(dump, NULL, "Print rows as CSV, optionally from a timestamp",
+                                             cmd_activity_log_dump, 1, 1),
+                               SHELL_CMD(stats, NULL, "Print the write statistics", cmd_activity_log_stats),
+                               SHELL_CMD(flush, NULL, "Write the rows in RAM to flash", cmd_activity_log_flush),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(activity_log, &activity_log_cmds, "Steps, pressure and IAQ log", NULL);
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "history/zsw_timeseries.h"
+
+/** @brief Columns of the activity log, logged every CONFIG_ZSW_ACTIVITY_LOG_INTERVAL_S seconds.
+*/
+typedef enum zsw_activity_log_column_t {
+    ZSW_ACTIVITY_LOG_STEPS,                 /**< Step count from zsw_imu_fetch_num_steps. */
+    ZSW_ACTIVITY_LOG_PRESSURE,              /**< Pressure from zsw_pressure_sensor_get_pressure times 100. */
+    ZSW_ACTIVITY_LOG_IAQ,                   /**< IAQ from zsw_environment_sensor_get_iaq. */
+    ZSW_ACTIVITY_LOG_NUM_COLUMNS
+} zsw_activity_log_column_t;
+
+/** @brief Start logging steps, pressure and IAQ to /lvgl_lfs/activity.
+ *  @return 0 when successful
+*/
+int zsw_activity_log_init(void);
+
+/** @brief Get the activity log, for reading it with zsw_timeseries_reader_open.
+ *  @return The activity log time series
+*/
+zsw_timeseries_t *zsw_activity_log_get(void);
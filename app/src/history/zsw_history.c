@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
@@ -8,61 +9,316 @@
 
 #include "zsw_history.h"
 
-#define ZSW_HISTORY_HEADER_EXTENSION    "head"
-#define ZSW_HISTORY_DATA_EXTENSION      "data"
+#define ZSW_HISTORY_HEADER_EXTENSION    "h"
+#define ZSW_HISTORY_SEGMENT_EXTENSION   "s"
+#define ZSW_HISTORY_JOURNAL_EXTENSION   "j"
+
+// Keys used before the journal, deleted when found.
+#define ZSW_HISTORY_LEGACY_HEADER       "head"
+#define ZSW_HISTORY_LEGACY_DATA         "data"
+
+// Max sample bytes in one journal record.
+#define ZSW_HISTORY_JOURNAL_RECORD_SIZE 256
+
+/** @brief Stored under <key>/h. Segments are stored under <key>/s/<index> and journal records under <key>/j/<slot>.
+*/
+typedef struct {
+    uint32_t max_samples;
+    uint32_t sample_size;
+    uint32_t first_seq;
+    uint32_t compacted_seq;
+} zsw_history_header_t;
+
+/** @brief Samples seq to seq + n - 1, n is given by the record length.
+*/
+typedef struct {
+    uint32_t seq;
+    uint8_t samples[ZSW_HISTORY_JOURNAL_RECORD_SIZE];
+} zsw_history_journal_record_t;
+
+typedef struct {
+    zsw_history_t *history;
+    bool header_found;
+    bool header_valid;
+    bool legacy_found;
+    zsw_history_header_t header;
+} zsw_history_load_ctx_t;
 
-// Text + 1 byte (_) + 6 byte extension (header) + 1 byte (\0)
-static char key_data[ZSW_HISTORY_MAX_KEY_LENGTH + 8];
-static char key_header[ZSW_HISTORY_MAX_KEY_LENGTH + 8];
+// Text + 1 byte (/) + 1 byte extension + 1 byte (/) + 5 byte index + 1 byte (\0)
+// Keys are built on the stack, compaction runs on the work queue while other histories are saved.
+#define KEY_BUF_LEN             (ZSW_HISTORY_MAX_KEY_LENGTH + 12)
 
 LOG_MODULE_REGISTER(zsw_history, CONFIG_ZSW_HISTORY_LOG_LEVEL);
 
-static int zsw_history_load_header_cb(const char *p_key, size_t len, settings_read_cb read_cb, void *p_cb_arg,
-                                      void *p_param)
+static void zsw_history_compact_work(struct k_work *work);
+
+static uint32_t num_segments(const zsw_history_t *p_history)
+{
+    return DIV_ROUND_UP(p_history->max_samples, CONFIG_ZSW_HISTORY_SEGMENT_SAMPLES);
+}
+
+static uint32_t segment_len(const zsw_history_t *p_history, uint32_t segment)
+{
+    uint32_t first_sample = segment * CONFIG_ZSW_HISTORY_SEGMENT_SAMPLES;
+
+    return MIN(CONFIG_ZSW_HISTORY_SEGMENT_SAMPLES, p_history->max_samples - first_sample) * p_history->sample_size;
+}
+
+static uint8_t *segment_ptr(const zsw_history_t *p_history, uint32_t segment)
+{
+    return (uint8_t *)p_history->samples + segment * CONFIG_ZSW_HISTORY_SEGMENT_SAMPLES * p_history->sample_size;
+}
+
+static uint8_t *sample_ptr(const zsw_history_t *p_history, uint32_t seq)
+{
+    return (uint8_t *)p_history->samples + ((seq - p_history->first_seq) % p_history->max_samples) *
+           p_history->sample_size;
+}
+
+static void update_indexes(zsw_history_t *p_history)
+{
+    p_history->write_index = (p_history->next_seq - p_history->first_seq) % p_history->max_samples;
+    p_history->num_samples = MIN(p_history->next_seq - p_history->first_seq, p_history->max_samples);
+}
+
+static int save_value(zsw_history_t *p_history, const char *p_key, const void *p_value, size_t len)
+{
+    int error = settings_save_one(p_key, p_value, len);
+
+    if (error) {
+        LOG_ERR("Error during saving of %s! Error: %i", p_key, error);
+        return -EFAULT;
+    }
+
+    p_history->stats.bytes_written += len;
+    p_history->stats.num_writes++;
+
+    return 0;
+}
+
+static int save_header(zsw_history_t *p_history)
 {
-    zsw_history_t *p_history;
-    zsw_history_t temp_stored_history;
-    uint32_t num_bytes_header;
+    zsw_history_header_t header = {
+        .max_samples = p_history->max_samples,
+        .sample_size = p_history->sample_size,
+        .first_seq = p_history->first_seq,
+        .compacted_seq = p_history->compacted_seq,
+    };
+    char key_buf[KEY_BUF_LEN];
 
-    p_history = (zsw_history_t *)p_param;
+    sprintf(key_buf, "%s/%s", p_history->key, ZSW_HISTORY_HEADER_EXTENSION);
 
-    num_bytes_header = read_cb(p_cb_arg, &temp_stored_history, sizeof(zsw_history_t));
-    LOG_DBG("Read %u header bytes, expecting: %d", num_bytes_header, sizeof(zsw_history_t));
+    return save_value(p_history, key_buf, &header, sizeof(header));
+}
 
-    // In case data structure or the user changed either sample size or number of max samples we need to handle that.
-    if ((num_bytes_header == 0) || (num_bytes_header != sizeof(zsw_history_t))) {
-        LOG_ERR("Invalid header. Struct size changed!");
-        zsw_history_del(p_history);
-    } else if (temp_stored_history.max_samples != p_history->max_samples) {
-        LOG_ERR("max_samples does not match what's stored in settings. Erasing history.");
-        zsw_history_del(p_history);
-    } else if (temp_stored_history.sample_size != p_history->sample_size) {
-        LOG_ERR("sample_size does not match what's stored in settings. Erasing history.");
-        zsw_history_del(p_history);
+/** @brief              Write all segments with samples added since the last compaction and move the compacted
+ *                      sequence number past them, the journal records are then stale and reused.
+ *                      Samples are taken from RAM, so samples not saved yet are also written.
+ *  @param p_history    History object, must be locked
+ *  @return             0 when successful
+*/
+static int compact(zsw_history_t *p_history)
+{
+    uint32_t first_seq;
+    uint32_t segment;
+    uint32_t last_segment = UINT32_MAX;
+    char key_buf[KEY_BUF_LEN];
+    int error;
+
+    if (p_history->next_seq == p_history->compacted_seq) {
+        return 0;
+    }
+
+    // Older samples have been overwritten in RAM, and all segments are written anyway.
+    first_seq = MAX(p_history->compacted_seq, p_history->next_seq - MIN(p_history->next_seq - p_history->first_seq,
+                                                                         p_history->max_samples));
+
+    for (uint32_t seq = first_seq; seq < p_history->next_seq; seq++) {
+        segment = ((seq - p_history->first_seq) % p_history->max_samples) / CONFIG_ZSW_HISTORY_SEGMENT_SAMPLES;
+        if (segment == last_segment) {
+            continue;
+        }
+        sprintf(key_buf, "%s/%s/%u", p_history->key, ZSW_HISTORY_SEGMENT_EXTENSION, segment);
+        error = save_value(p_history, key_buf, segment_ptr(p_history, segment), segment_len(p_history, segment));
+        if (error) {
+            return error;
+        }
+        last_segment = segment;
+    }
+
+    // A reset between writing the segments and the header only replays the journal onto the new segments.
+    p_history->compacted_seq = p_history->next_seq;
+    error = save_header(p_history);
+    if (error) {
+        return error;
+    }
+
+    p_history->saved_seq = p_history->next_seq;
+    p_history->journal_len = 0;
+    p_history->stats.num_compactions++;
+    LOG_DBG("Compacted %s up to %u", p_history->key, p_history->compacted_seq);
+
+    return 0;
+}
+
+static void zsw_history_compact_work(struct k_work *work)
+{
+    zsw_history_t *p_history = CONTAINER_OF(work, zsw_history_t, compact_work);
+
+    k_mutex_lock(&p_history->lock, K_FOREVER);
+    if (compact(p_history)) {
+        LOG_ERR("Error during compaction of %s", p_history->key);
+    }
+    k_mutex_unlock(&p_history->lock);
+}
+
+static bool journal_full(const zsw_history_t *p_history)
+{
+    // The journal never covers more than max_samples, so replaying it in any order gives the same result.
+    return p_history->journal_len >= CONFIG_ZSW_HISTORY_JOURNAL_LENGTH ||
+           p_history->next_seq - p_history->compacted_seq >= p_history->max_samples;
+}
+
+static void tier_add(zsw_history_tier_t *p_tier, const zsw_history_t *p_history, const void *p_sample)
+{
+    int16_t value;
+
+    for (uint8_t i = 0; i < p_history->num_channels; i++) {
+        value = p_history->value_cb(p_sample, i);
+        if (p_tier->current_count == 0) {
+            p_tier->current[i].min = value;
+            p_tier->current[i].max = value;
+            p_tier->current_sum[i] = 0;
+        } else {
+            p_tier->current[i].min = MIN(p_tier->current[i].min, value);
+            p_tier->current[i].max = MAX(p_tier->current[i].max, value);
+        }
+        p_tier->current_sum[i] += value;
+        p_tier->current[i].avg = p_tier->current_sum[i] / (int32_t)(p_tier->current_count + 1);
+    }
+
+    p_tier->current_count++;
+    if (p_tier->current_count == p_tier->samples_per_bucket) {
+        zsw_history_add(&p_tier->history, p_tier->current);
+        p_tier->current_count = 0;
+    }
+}
+
+/** @brief              Refill the bucket being filled from the newest samples after loading.
+ *  @param p_tier       Tier object
+ *  @param p_history    History object the tier belongs to
+*/
+static void tier_rebuild(zsw_history_tier_t *p_tier, const zsw_history_t *p_history)
+{
+    uint32_t count = MIN((p_history->next_seq - p_history->first_seq) % p_tier->samples_per_bucket,
+                         p_history->num_samples);
+
+    p_tier->current_count = 0;
+    for (uint32_t seq = p_history->next_seq - count; seq < p_history->next_seq; seq++) {
+        tier_add(p_tier, p_history, sample_ptr(p_history, seq));
+    }
+}
+
+/** @brief  Number of samples a tier has aggregated, including the bucket being filled.
+*/
+static uint32_t tier_coverage(const zsw_history_tier_t *p_tier)
+{
+    return p_tier->history.num_samples * p_tier->samples_per_bucket + p_tier->current_count;
+}
+
+static void get_point(const zsw_history_t *p_history, const zsw_history_tier_t *p_tier, uint32_t index,
+                      uint8_t channel, zsw_history_point_t *p_point)
+{
+    uint8_t sample[UINT8_MAX];
+    zsw_history_point_t points[ZSW_HISTORY_MAX_CHANNELS];
+
+    if (p_tier == NULL) {
+        zsw_history_get(p_history, sample, index);
+        p_point->min = p_history->value_cb(sample, channel);
+        p_point->max = p_point->min;
+        p_point->avg = p_point->min;
+    } else if (index < p_tier->history.num_samples) {
+        zsw_history_get(&p_tier->history, points, index);
+        *p_point = points[channel];
     } else {
-        // Everything is fine, we can load the history
-        p_history->write_index = temp_stored_history.write_index;
-        p_history->num_samples = temp_stored_history.num_samples;
+        *p_point = p_tier->current[channel];
+    }
+}
+
+static int zsw_history_load_cb(const char *p_key, size_t len, settings_read_cb read_cb, void *p_cb_arg,
+                               void *p_param)
+{
+    zsw_history_load_ctx_t *ctx = p_param;
+    zsw_history_t *p_history = ctx->history;
+    const char *p_next;
+    uint32_t segment;
+    ssize_t num_bytes;
+
+    if (p_key == NULL) {
+        return 0;
+    }
+
+    if (settings_name_steq(p_key, ZSW_HISTORY_HEADER_EXTENSION, NULL)) {
+        num_bytes = read_cb(p_cb_arg, &ctx->header, sizeof(ctx->header));
+        LOG_DBG("Read %d header bytes, expecting: %d", num_bytes, sizeof(ctx->header));
+
+        ctx->header_found = true;
+        // In case data structure or the user changed either sample size or number of max samples we need to handle that.
+        if (num_bytes != sizeof(ctx->header)) {
+            LOG_ERR("Invalid header. Struct size changed!");
+        } else if (ctx->header.max_samples != p_history->max_samples) {
+            LOG_ERR("max_samples does not match what's stored in settings. Erasing history.");
+        } else if (ctx->header.sample_size != p_history->sample_size) {
+            LOG_ERR("sample_size does not match what's stored in settings. Erasing history.");
+        } else {
+            ctx->header_valid = true;
+        }
+    } else if (settings_name_steq(p_key, ZSW_HISTORY_SEGMENT_EXTENSION, &p_next) && p_next != NULL) {
+        segment = strtoul(p_next, NULL, 10);
+        // Segments with the wrong size belong to a history with other dimensions, the header then erases them.
+        if (segment < num_segments(p_history) && len == segment_len(p_history, segment)) {
+            num_bytes = read_cb(p_cb_arg, segment_ptr(p_history, segment), len);
+            if (num_bytes != len) {
+                LOG_ERR("Invalid segment %u", segment);
+            }
+        }
+    } else if (settings_name_steq(p_key, ZSW_HISTORY_LEGACY_HEADER, NULL) ||
+               settings_name_steq(p_key, ZSW_HISTORY_LEGACY_DATA, NULL)) {
+        ctx->legacy_found = true;
     }
 
     return 0;
 }
 
-static int zsw_history_load_data_cb(const char *p_key, size_t len, settings_read_cb read_cb, void *p_cb_arg,
-                                    void *p_param)
+static int zsw_history_load_journal_cb(const char *p_key, size_t len, settings_read_cb read_cb, void *p_cb_arg,
+                                       void *p_param)
 {
-    zsw_history_t *history;
-    uint32_t num_bytes_data;
+    zsw_history_t *p_history = p_param;
+    zsw_history_journal_record_t record;
+    ssize_t num_bytes;
+    uint32_t num_samples;
 
-    history = (zsw_history_t *)p_param;
+    if (len <= sizeof(record.seq) || len > sizeof(record)) {
+        return 0;
+    }
 
-    num_bytes_data = read_cb(p_cb_arg, history->samples, len);
-    LOG_DBG("Read %u data bytes", num_bytes_data);
+    num_bytes = read_cb(p_cb_arg, &record, len);
+    num_samples = (len - sizeof(record.seq)) / p_history->sample_size;
+    if (num_bytes != len || (len - sizeof(record.seq)) % p_history->sample_size != 0) {
+        LOG_ERR("Invalid journal record %s", p_key);
+        return 0;
+    }
 
-    if ((num_bytes_data == 0) || (num_bytes_data != len) ||
-        (num_bytes_data % history->sample_size) != 0) {
-        LOG_ERR("Invalid data!");
-        return -EFAULT;
+    // Records from before the last compaction are stale.
+    for (uint32_t i = 0; i < num_samples; i++) {
+        if (record.seq + i >= p_history->compacted_seq) {
+            memcpy(sample_ptr(p_history, record.seq + i), &record.samples[i * p_history->sample_size],
+                   p_history->sample_size);
+        }
+    }
+    if (record.seq + num_samples > p_history->compacted_seq) {
+        p_history->next_seq = MAX(p_history->next_seq, record.seq + num_samples);
+        p_history->journal_len++;
     }
 
     return 0;
@@ -75,11 +331,12 @@ int zsw_history_init(zsw_history_t *p_history, uint32_t max_samples, uint8_t sam
 
     __ASSERT((p_history != NULL) && (p_samples != NULL) && (p_key != NULL), "Invalid parameters for zsw_history_init");
 
-    p_history->write_index = 0;
-    p_history->num_samples = 0;
+    memset(p_history, 0, sizeof(zsw_history_t));
     p_history->max_samples = max_samples;
     p_history->sample_size = sample_size;
     p_history->samples = p_samples;
+    k_mutex_init(&p_history->lock);
+    k_work_init(&p_history->compact_work, zsw_history_compact_work);
 
     memset(p_samples, 0, max_samples * sample_size);
     strcpy(p_history->key, p_key);
@@ -96,53 +353,56 @@ int zsw_history_init(zsw_history_t *p_history, uint32_t max_samples, uint8_t sam
 int zsw_history_del(zsw_history_t *p_history)
 {
     int32_t error;
+    char key_buf[KEY_BUF_LEN];
 
     __ASSERT(p_history != NULL, "Invalid parameter for zsw_history_del");
 
+    k_mutex_lock(&p_history->lock, K_FOREVER);
     memset(p_history->samples, 0, p_history->max_samples * p_history->sample_size);
-    p_history->write_index = 0;
-    p_history->num_samples = 0;
 
-    // First: Delete the header
-    sprintf(key_header, "%s/%s", p_history->key, ZSW_HISTORY_HEADER_EXTENSION);
-    error = settings_delete(key_header);
-    if (error) {
-        LOG_ERR("Error during erasing the header! Error: %i", error);
-        return -EFAULT;
+    // First: Delete the journal, segments are not deleted as they are overwritten before being read again.
+    for (uint32_t i = 0; i < CONFIG_ZSW_HISTORY_JOURNAL_LENGTH; i++) {
+        sprintf(key_buf, "%s/%s/%u", p_history->key, ZSW_HISTORY_JOURNAL_EXTENSION, i);
+        error = settings_delete(key_buf);
+        if (error) {
+            LOG_ERR("Error during erasing the journal! Error: %i", error);
+            k_mutex_unlock(&p_history->lock);
+            return -EFAULT;
+        }
     }
 
-    // Second: Delete the data
-    sprintf(key_data, "%s/%s", p_history->key, ZSW_HISTORY_DATA_EXTENSION);
-    error = settings_delete(key_data);
-    if (error) {
-        LOG_ERR("Error during erasing the data! Error: %i", error);
-        return -EFAULT;
+    // Second: Store a header that starts after all previous samples
+    p_history->first_seq = p_history->next_seq;
+    p_history->saved_seq = p_history->next_seq;
+    p_history->compacted_seq = p_history->next_seq;
+    p_history->journal_len = 0;
+    update_indexes(p_history);
+    error = save_header(p_history);
+
+    for (zsw_history_tier_t *p_tier = p_history->tiers; p_tier != NULL && !error; p_tier = p_tier->next) {
+        p_tier->current_count = 0;
+        error = zsw_history_del(&p_tier->history);
     }
+    k_mutex_unlock(&p_history->lock);
 
-    zsw_history_save(p_history);
-
-    return 0;
+    return error;
 }
 
 void zsw_history_add(zsw_history_t *p_history, const void *p_sample)
 {
-    uint8_t *start;
-
     __ASSERT((p_history != NULL) && (p_sample != NULL), "Invalid parameters for zsw_history_add");
 
-    start = p_history->samples;
-    start += p_history->sample_size * p_history->write_index;
-
+    k_mutex_lock(&p_history->lock, K_FOREVER);
     LOG_DBG("Add sample with size %d at index %d", p_history->sample_size, p_history->write_index);
-    memcpy(start, p_sample, p_history->sample_size);
+    memcpy(sample_ptr(p_history, p_history->next_seq), p_sample, p_history->sample_size);
 
-    if (p_history->write_index < (p_history->max_samples - 1)) {
-        p_history->write_index++;
-    } else {
-        p_history->write_index = 0;
-    }
+    p_history->next_seq++;
+    update_indexes(p_history);
 
-    p_history->num_samples = MIN(p_history->num_samples + 1, p_history->max_samples);
+    for (zsw_history_tier_t *p_tier = p_history->tiers; p_tier != NULL; p_tier = p_tier->next) {
+        tier_add(p_tier, p_history, p_sample);
+    }
+    k_mutex_unlock(&p_history->lock);
 }
 
 void zsw_history_get(const zsw_history_t *p_history, void *p_sample, uint32_t index)
@@ -166,62 +426,122 @@ void zsw_history_get(const zsw_history_t *p_history, void *p_sample, uint32_t in
 int zsw_history_load(zsw_history_t *p_history)
 {
     int32_t error;
+    uint32_t start_cycles;
+    char key_buf[KEY_BUF_LEN];
+    zsw_history_load_ctx_t ctx = {
+        .history = p_history,
+    };
 
     __ASSERT((p_history != NULL) &&
              (strlen(p_history->key) <= ZSW_HISTORY_MAX_KEY_LENGTH), "Invalid parameters for zsw_history_load");
 
-    sprintf(key_header, "%s/%s", p_history->key, ZSW_HISTORY_HEADER_EXTENSION);
-    error = settings_load_subtree_direct(key_header, zsw_history_load_header_cb, p_history);
+    start_cycles = k_cycle_get_32();
+    k_mutex_lock(&p_history->lock, K_FOREVER);
+
+    // First: Load the header and the segments
+    error = settings_load_subtree_direct(p_history->key, zsw_history_load_cb, &ctx);
+    if (error || !ctx.header_valid) {
+        if (error || ctx.header_found) {
+            LOG_ERR("Error during header loading! Error: %i. Erasing history.", error);
+        }
+        k_mutex_unlock(&p_history->lock);
+        return zsw_history_del(p_history);
+    }
+
+    p_history->first_seq = ctx.header.first_seq;
+    p_history->compacted_seq = ctx.header.compacted_seq;
+    p_history->next_seq = ctx.header.compacted_seq;
+    p_history->journal_len = 0;
 
+    // Second: Replay the journal on top of the segments
+    sprintf(key_buf, "%s/%s", p_history->key, ZSW_HISTORY_JOURNAL_EXTENSION);
+    error = settings_load_subtree_direct(key_buf, zsw_history_load_journal_cb, p_history);
     if (error) {
-        LOG_ERR("Error during header loading! Error: %i. Erasing history.", error);
-        zsw_history_del(p_history);
+        LOG_ERR("Error during journal loading! Error: %i", error);
+    }
+    p_history->saved_seq = p_history->next_seq;
+    update_indexes(p_history);
+
+    // Third: Load the tiers and refill the buckets that were being filled
+    for (zsw_history_tier_t *p_tier = p_history->tiers; p_tier != NULL; p_tier = p_tier->next) {
+        zsw_history_load(&p_tier->history);
+        tier_rebuild(p_tier, p_history);
+    }
+
+    if (ctx.legacy_found) {
+        LOG_INF("Deleting history stored in the old format");
+        sprintf(key_buf, "%s/%s", p_history->key, ZSW_HISTORY_LEGACY_HEADER);
+        settings_delete(key_buf);
+        sprintf(key_buf, "%s/%s", p_history->key, ZSW_HISTORY_LEGACY_DATA);
+        settings_delete(key_buf);
     }
 
-    LOG_DBG("Load header with key %s", key_header);
+    p_history->stats.load_time_us = k_cyc_to_us_floor32(k_cycle_get_32() - start_cycles);
+
+    LOG_DBG("Load history with key %s", p_history->key);
     LOG_DBG("   Num: %u", p_history->max_samples);
     LOG_DBG("   Sample size: %u", p_history->sample_size);
     LOG_DBG("   Write index: %u", p_history->write_index);
     LOG_DBG("   Num samples: %u", p_history->num_samples);
+    LOG_DBG("   Journal records: %u", p_history->journal_len);
+    LOG_DBG("   Load time: %u us", p_history->stats.load_time_us);
 
-    // Load the data
-    sprintf(key_data, "%s/%s", p_history->key, ZSW_HISTORY_DATA_EXTENSION);
-    error = settings_load_subtree_direct(key_data, zsw_history_load_data_cb, p_history);
-    LOG_DBG("Load data with key %s", key_data);
-    if (error) {
-        LOG_ERR("Error during data loading! Error: %i", error);
-        zsw_history_del(p_history);
-        return 0;
-    }
+    k_mutex_unlock(&p_history->lock);
 
     return 0;
 }
 
 int zsw_history_save(zsw_history_t *p_history)
 {
-    int32_t error;
+    int32_t error = 0;
+    zsw_history_journal_record_t record;
+    uint32_t max_record_samples;
+    uint32_t num_samples;
+    char key_buf[KEY_BUF_LEN];
 
     __ASSERT((p_history != NULL) &&
              (strlen(p_history->key) <= ZSW_HISTORY_MAX_KEY_LENGTH), "Invalid parameters for zsw_history_save");
 
-    // First: Store the header
-    sprintf(key_header, "%s/%s", p_history->key, ZSW_HISTORY_HEADER_EXTENSION);
-    LOG_DBG("Storing header with key %s", key_header);
-    error = settings_save_one(key_header, p_history, sizeof(zsw_history_t));
-    if (error) {
-        LOG_ERR("Error during saving of history header! Error: %i", error);
-        return -EFAULT;
+    k_mutex_lock(&p_history->lock, K_FOREVER);
+
+    // Samples that were overwritten before being saved are lost.
+    p_history->saved_seq = MAX(p_history->saved_seq, p_history->next_seq - p_history->num_samples);
+    max_record_samples = ZSW_HISTORY_JOURNAL_RECORD_SIZE / p_history->sample_size;
+
+    while (p_history->saved_seq < p_history->next_seq) {
+        if (journal_full(p_history)) {
+            // Background compaction didn't run yet, this also saves the remaining samples.
+            error = compact(p_history);
+            break;
+        }
+
+        // One record per save in the common case, split where the ring wraps.
+        num_samples = MIN(p_history->next_seq - p_history->saved_seq, max_record_samples);
+        num_samples = MIN(num_samples, p_history->max_samples -
+                          (p_history->saved_seq - p_history->first_seq) % p_history->max_samples);
+
+        record.seq = p_history->saved_seq;
+        memcpy(record.samples, sample_ptr(p_history, p_history->saved_seq), num_samples * p_history->sample_size);
+        sprintf(key_buf, "%s/%s/%u", p_history->key, ZSW_HISTORY_JOURNAL_EXTENSION, p_history->journal_len);
+        error = save_value(p_history, key_buf, &record, sizeof(record.seq) + num_samples * p_history->sample_size);
+        if (error) {
+            break;
+        }
+
+        p_history->saved_seq += num_samples;
+        p_history->journal_len++;
     }
 
-    // Second: Save the data
-    sprintf(key_data, "%s/%s", p_history->key, ZSW_HISTORY_DATA_EXTENSION);
-    error = settings_save_one(key_data, p_history->samples, p_history->write_index * p_history->sample_size);
-    if (error) {
-        LOG_ERR("Error during saving of history data! Error: %i", error);
-        return -EFAULT;
+    if (!error && journal_full(p_history)) {
+        k_work_submit(&p_history->compact_work);
     }
 
-    return 0;
+    for (zsw_history_tier_t *p_tier = p_history->tiers; p_tier != NULL && !error; p_tier = p_tier->next) {
+        error = zsw_history_save(&p_tier->history);
+    }
+    k_mutex_unlock(&p_history->lock);
+
+    return error;
 }
 
 int zsw_history_samples(zsw_history_t *p_history)
@@ -229,4 +549,125 @@ int zsw_history_samples(zsw_history_t *p_history)
     __ASSERT(p_history != NULL, "Invalid parameters for zsw_history_samples");
 
     return p_history->num_samples;
+}
+
+void zsw_history_get_stats(const zsw_history_t *p_history, zsw_history_stats_t *p_stats)
+{
+    __ASSERT((p_history != NULL) && (p_stats != NULL), "Invalid parameters for zsw_history_get_stats");
+
+    *p_stats = p_history->stats;
+}
+
+int zsw_history_rollup_init(zsw_history_t *p_history, zsw_history_value_cb_t value_cb, uint8_t num_channels)
+{
+    __ASSERT((p_history != NULL) && (value_cb != NULL), "Invalid parameters for zsw_history_rollup_init");
+
+    if ((num_channels == 0) || (num_channels > ZSW_HISTORY_MAX_CHANNELS)) {
+        return -EINVAL;
+    }
+
+    p_history->value_cb = value_cb;
+    p_history->num_channels = num_channels;
+
+    return 0;
+}
+
+int zsw_history_add_tier(zsw_history_t *p_history, zsw_history_tier_t *p_tier, uint32_t samples_per_bucket,
+                         uint32_t max_buckets, zsw_history_point_t *p_buckets, const char *p_key)
+{
+    int error;
+    zsw_history_tier_t **pp_last;
+
+    __ASSERT((p_history != NULL) && (p_tier != NULL) && (p_buckets != NULL) && (p_key != NULL),
+             "Invalid parameters for zsw_history_add_tier");
+
+    // The bucket being filled is refilled from the samples on load.
+    if ((p_history->value_cb == NULL) || (samples_per_bucket == 0) ||
+        (samples_per_bucket > p_history->max_samples)) {
+        return -EINVAL;
+    }
+
+    error = zsw_history_init(&p_tier->history, max_buckets, p_history->num_channels * sizeof(zsw_history_point_t),
+                             p_buckets, p_key);
+    if (error) {
+        return error;
+    }
+
+    p_tier->samples_per_bucket = samples_per_bucket;
+    p_tier->current_count = 0;
+    p_tier->next = NULL;
+
+    for (pp_last = &p_history->tiers; *pp_last != NULL; pp_last = &(*pp_last)->next) {
+        __ASSERT((*pp_last)->samples_per_bucket < samples_per_bucket, "Tiers must be added finest first");
+    }
+    *pp_last = p_tier;
+
+    return 0;
+}
+
+int zsw_history_query(zsw_history_t *p_history, uint32_t num_samples, uint8_t channel, zsw_history_point_t *p_points,
+                      uint32_t max_points)
+{
+    zsw_history_tier_t *p_tier = NULL;
+    zsw_history_point_t point;
+    uint32_t max_available;
+    uint32_t samples_per_point;
+    uint32_t num_stored;
+    uint32_t num_src;
+    uint32_t merge;
+    uint32_t num_points = 0;
+    int32_t sum = 0;
+    bool fits;
+
+    __ASSERT((p_history != NULL) && (p_points != NULL), "Invalid parameters for zsw_history_query");
+
+    if ((p_history->value_cb == NULL) || (channel >= p_history->num_channels) || (max_points == 0)) {
+        return -EINVAL;
+    }
+
+    k_mutex_lock(&p_history->lock, K_FOREVER);
+
+    max_available = p_history->num_samples;
+    for (zsw_history_tier_t *p_candidate = p_history->tiers; p_candidate != NULL; p_candidate = p_candidate->next) {
+        max_available = MAX(max_available, tier_coverage(p_candidate));
+    }
+    num_samples = MIN(num_samples, max_available);
+
+    // The finest resolution that has the whole range and fits in max_points, otherwise the coarsest that has
+    // the whole range and its buckets are merged.
+    fits = (p_history->num_samples >= num_samples) && (num_samples <= max_points);
+    for (zsw_history_tier_t *p_candidate = p_history->tiers; p_candidate != NULL && !fits;
+         p_candidate = p_candidate->next) {
+        if (tier_coverage(p_candidate) >= num_samples) {
+            p_tier = p_candidate;
+            fits = DIV_ROUND_UP(num_samples, p_candidate->samples_per_bucket) <= max_points;
+        }
+    }
+
+    if (p_tier == NULL) {
+        samples_per_point = 1;
+        num_stored = p_history->num_samples;
+    } else {
+        samples_per_point = p_tier->samples_per_bucket;
+        num_stored = p_tier->history.num_samples + (p_tier->current_count > 0 ? 1 : 0);
+    }
+    num_src = MIN(DIV_ROUND_UP(num_samples, samples_per_point), num_stored);
+    merge = DIV_ROUND_UP(num_src, max_points);
+
+    for (uint32_t i = 0; i < num_src; i++) {
+        get_point(p_history, p_tier, num_stored - num_src + i, channel, &point);
+        if (i % merge == 0) {
+            p_points[num_points] = point;
+            sum = point.avg;
+            num_points++;
+        } else {
+            p_points[num_points - 1].min = MIN(p_points[num_points - 1].min, point.min);
+            p_points[num_points - 1].max = MAX(p_points[num_points - 1].max, point.max);
+            sum += point.avg;
+            p_points[num_points - 1].avg = sum / (int32_t)(i % merge + 1);
+        }
+    }
+    k_mutex_unlock(&p_history->lock);
+
+    return num_points;
 }
\ No newline at end of file
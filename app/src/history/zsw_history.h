@@ -2,10 +2,43 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <zephyr/kernel.h>
 
 #define ZSW_HISTORY_MAX_KEY_LENGTH      64
 
+/** @brief Maximum number of values in a sample that can be rolled up.
+*/
+#define ZSW_HISTORY_MAX_CHANNELS        4
+
+struct zsw_history_tier;
+
+/** @brief Aggregated value of one channel over a range of samples.
+*/
+typedef struct {
+    int16_t min;
+    int16_t max;
+    int16_t avg;
+} zsw_history_point_t;
+
+/** @brief              Get one value from a sample, used for the rollup tiers and range queries.
+ *  @param p_sample     Sample
+ *  @param channel      Which value to get, less than the number of channels
+ *  @return             The value
+*/
+typedef int16_t (*zsw_history_value_cb_t)(const void *p_sample, uint8_t channel);
+
+/** @brief Statistics of the NVS writes and loads of a history.
+*/
+typedef struct {
+    uint32_t bytes_written;                     /**< Value bytes written to the NVS, without NVS overhead. */
+    uint32_t num_writes;                        /**< Number of NVS writes. */
+    uint32_t num_compactions;                   /**< Number of times the journal was compacted. */
+    uint32_t load_time_us;                      /**< Duration of the last zsw_history_load. */
+} zsw_history_stats_t;
+
 /** @brief ZSWatch history object definition.
+ *         The samples are stored in the NVS as a journal of new samples, that is compacted into segments of
+ *         CONFIG_ZSW_HISTORY_SEGMENT_SAMPLES samples in the background.
 */
 typedef struct {
     uint32_t write_index;
@@ -14,8 +47,31 @@ typedef struct {
     uint32_t num_samples;                       /**< Number of valid samples stored. */
     char key[ZSW_HISTORY_MAX_KEY_LENGTH];       /**< */
     void *samples;                              /**< Pointer to sample storage. */
+    uint32_t first_seq;                         /**< Sequence number of the first sample since the last delete. */
+    uint32_t next_seq;                          /**< Sequence number of the next added sample. */
+    uint32_t saved_seq;                         /**< Samples before this are saved in the journal or segments. */
+    uint32_t compacted_seq;                     /**< Samples before this are saved in the segments. */
+    uint8_t journal_len;                        /**< Journal records written since the last compaction. */
+    struct k_mutex lock;
+    struct k_work compact_work;
+    zsw_history_stats_t stats;
+    zsw_history_value_cb_t value_cb;            /**< Set when the history has rollup tiers. */
+    uint8_t num_channels;                       /**< Number of values in a sample. */
+    struct zsw_history_tier *tiers;             /**< Rollup tiers, finest first. */
 } zsw_history_t;
 
+/** @brief Downsampled copy of a history, each bucket holds min, max and average of samples_per_bucket samples.
+ *         Maintained on zsw_history_add and stored with its own key.
+*/
+typedef struct zsw_history_tier {
+    zsw_history_t history;                                      /**< Buckets, one point per channel. */
+    uint32_t samples_per_bucket;
+    uint32_t current_count;                                     /**< Samples in the bucket being filled. */
+    int32_t current_sum[ZSW_HISTORY_MAX_CHANNELS];
+    zsw_history_point_t current[ZSW_HISTORY_MAX_CHANNELS];
+    struct zsw_history_tier *next;
+} zsw_history_tier_t;
+
 /** @brief              Initialize a history object.
  *  @param p_history    History object
  *  @param max_samples  Length of the sample storage in samples
@@ -27,6 +83,39 @@ typedef struct {
 int zsw_history_init(zsw_history_t *p_history, uint32_t max_samples, uint8_t sample_size, void *samples,
                      const char *p_key);
 
+/** @brief              Enable rollup tiers and range queries for a history. Call before adding tiers.
+ *  @param p_history    History object
+ *  @param value_cb     Gets the values to roll up from a sample
+ *  @param num_channels Number of values in a sample, max. ZSW_HISTORY_MAX_CHANNELS
+ *  @return             0 when successful
+*/
+int zsw_history_rollup_init(zsw_history_t *p_history, zsw_history_value_cb_t value_cb, uint8_t num_channels);
+
+/** @brief                      Add a rollup tier. Tiers must be added before zsw_history_load, with increasing
+ *                              samples_per_bucket, and are loaded, saved and deleted together with the history.
+ *  @param p_history            History object
+ *  @param p_tier               Tier object
+ *  @param samples_per_bucket   Number of samples in one bucket, max. the history length
+ *  @param max_buckets          Length of the bucket storage in buckets
+ *  @param p_buckets            Pointer to the bucket storage, max_buckets * num_channels points
+ *  @param p_key                Pointer to the NVS key of the tier (max. length 64 bytes)
+ *  @return                     0 when successful
+*/
+int zsw_history_add_tier(zsw_history_t *p_history, zsw_history_tier_t *p_tier, uint32_t samples_per_bucket,
+                         uint32_t max_buckets, zsw_history_point_t *p_buckets, const char *p_key);
+
+/** @brief              Get the newest samples of one channel as at most max_points points, oldest first.
+ *                      Uses the finest resolution that fits, and merges buckets of the coarsest tier when needed.
+ *  @param p_history    History object
+ *  @param num_samples  Range to get, in samples. Less is returned when less is stored.
+ *  @param channel      Channel to get
+ *  @param p_points     Pointer to the point storage
+ *  @param max_points   Length of the point storage
+ *  @return             Number of points, or negative on error
+*/
+int zsw_history_query(zsw_history_t *p_history, uint32_t num_samples, uint8_t channel, zsw_history_point_t *p_points,
+                      uint32_t max_points);
+
 /** @brief              Clear the sample storage and reset the sample counter.
  *  @param p_history    History object
  *  @return             0 when successful
@@ -47,13 +136,14 @@ void zsw_history_add(zsw_history_t *p_history, const void *p_sample);
 */
 void zsw_history_get(const zsw_history_t *p_history, void *p_sample, uint32_t index);
 
-/** @brief              Load a history from the NVS.
+/** @brief              Load a history from the NVS. The segments are loaded first and then the journal is replayed.
  *  @param p_history    History object
- *  @return             0 when successfulconst
+ *  @return             0 when successful
 */
 int zsw_history_load(zsw_history_t *p_history);
 
-/** @brief              Writes the history in the NVS.
+/** @brief              Writes the samples added since the last save to the journal in the NVS.
+ *                      The journal is compacted in the background when it is full.
  *  @param p_history    History object
  *  @return             0 when successful
 */
@@ -63,4 +153,10 @@ int zsw_history_save(zsw_history_t *p_history);
  *  @param p_history    History object
  *  @return             Number of samples
 */
-int zsw_history_samples(zsw_history_t *p_history);
\ No newline at end of file
+int zsw_history_samples(zsw_history_t *p_history);
+
+/** @brief              Get the NVS statistics of the history.
+ *  @param p_history    History object
+ *  @param p_stats      Statistics
+*/
+void zsw_history_get_stats(const zsw_history_t *p_history, zsw_history_stats_t *p_stats);
\ No newline at end of file
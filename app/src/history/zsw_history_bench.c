@@ -0,0 +1,108 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmarks the history storage on the simulated flash on native_posix. Run with:
+ *   zephyr.exe --history-bench
+ * Adds and saves a week of 15 minute battery samples like the battery app, prints the NVS bytes written per
+ * sample and how long loading the full history takes, then exits.
+ */
+
+#include <stdio.h>
+#include <zephyr/kernel.h>
+
+#include "zsw_bench.h"
+#include "history/zsw_history.h"
+
+#define BENCH_KEY           "bench/hist"
+#define BENCH_NUM_SAMPLES   (7 * 24 * 4)
+// Overhead of one NVS write, the allocation table entry.
+#define NVS_ATE_SIZE        8
+// Size of the header written on every save before the journal, zsw_history_t on a 32 bit target.
+#define LEGACY_HEADER_SIZE  84
+
+typedef struct {
+    uint8_t mv_with_decimals;
+    uint8_t percent;
+} bench_sample_t;
+
+static bool bench_enabled;
+static bench_sample_t samples[BENCH_NUM_SAMPLES];
+static zsw_history_t history;
+
+static struct args_struct_t bench_options[] = {
+    {
+        .is_switch = true,
+        .option = "history-bench",
+        .type = 'b',
+        .dest = (void *) &bench_enabled,
+        .descript = "Save a week of history samples to the simulated flash and time loading it, exits when done"
+    },
+    ARG_TABLE_ENDMARKER
+};
+
+static int history_bench(void)
+{
+    bench_sample_t sample;
+    zsw_history_stats_t stats;
+    int64_t start_us;
+    int64_t save_us;
+    int64_t load_us;
+    uint32_t legacy_bytes;
+
+    if (!bench_enabled) {
+        return ZSW_BENCH_NOT_RUN;
+    }
+
+    zsw_history_init(&history, BENCH_NUM_SAMPLES, sizeof(bench_sample_t), samples, BENCH_KEY);
+    zsw_history_del(&history);
+
+    start_us = zsw_bench_time_us();
+    for (uint32_t i = 0; i < BENCH_NUM_SAMPLES; i++) {
+        sample.mv_with_decimals = i % 200;
+        sample.percent = 100 - i % 100;
+        zsw_history_add(&history, &sample);
+        zsw_history_save(&history);
+    }
+    // Let the background compaction finish.
+    k_msleep(100);
+    save_us = zsw_bench_time_us() - start_us;
+
+    zsw_history_get_stats(&history, &stats);
+    // The whole ring and the header was written on every save before.
+    legacy_bytes = BENCH_NUM_SAMPLES * sizeof(bench_sample_t) + LEGACY_HEADER_SIZE + 2 * NVS_ATE_SIZE;
+
+    printk("Saved %d samples in %lld us, %d NVS writes, %d compactions\n", BENCH_NUM_SAMPLES, save_us,
+           stats.num_writes, stats.num_compactions);
+    printk("Bytes written per sample: %d (%d with NVS overhead), full rewrite: %d\n",
+           stats.bytes_written / BENCH_NUM_SAMPLES,
+           (stats.bytes_written + stats.num_writes * NVS_ATE_SIZE) / BENCH_NUM_SAMPLES, legacy_bytes);
+
+    zsw_history_init(&history, BENCH_NUM_SAMPLES, sizeof(bench_sample_t), samples, BENCH_KEY);
+    start_us = zsw_bench_time_us();
+    zsw_history_load(&history);
+    load_us = zsw_bench_time_us() - start_us;
+
+    printk("Loaded %d samples in %lld us\n", zsw_history_samples(&history), load_us);
+
+    zsw_history_del(&history);
+
+    return 0;
+}
+
+// Started after the settings subsystem is initialized.
+ZSW_BENCH_DEFINE(history_bench, 2048, bench_options, history_bench);
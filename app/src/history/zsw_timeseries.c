@@ -0,0 +1,549 @@
+#include <string.h>
+#include <stdio.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/fs/fs.h>
+
+#include "zsw_timeseries.h"
+
+#define ZSW_TIMESERIES_BLOCK_MAGIC      0x5453
+#define ZSW_TIMESERIES_FILE_PATH_LENGTH (ZSW_TIMESERIES_MAX_PATH_LENGTH + 2)
+#define ZSW_TIMESERIES_MAX_VARINT_LEN   5
+
+// Encoded columns are written to the file through a buffer of this size.
+#define ZSW_TIMESERIES_WRITE_BUFFER_SIZE    64
+
+/** @brief Start of a block. Followed by the length of each column, timestamps first, then the columns.
+*/
+typedef struct __packed {
+    uint16_t magic;
+    uint8_t num_columns;
+    uint8_t num_rows;
+    uint16_t len;                               /**< Size of the whole block. */
+} zsw_timeseries_block_header_t;
+
+BUILD_ASSERT(CONFIG_ZSW_TIMESERIES_BLOCK_ROWS <= UINT8_MAX);
+BUILD_ASSERT(CONFIG_ZSW_TIMESERIES_BLOCK_SIZE >= sizeof(zsw_timeseries_block_header_t) +
+             (ZSW_TIMESERIES_MAX_COLUMNS + 1) * (sizeof(uint16_t) + ZSW_TIMESERIES_MAX_VARINT_LEN),
+             "A block must fit at least one row");
+
+LOG_MODULE_REGISTER(zsw_timeseries, CONFIG_ZSW_HISTORY_LOG_LEVEL);
+
+static uint32_t zigzag_encode(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t zigzag_decode(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static uint8_t varint_len(uint32_t value)
+{
+    uint8_t len = 1;
+
+    while (value >= 0x80) {
+        value >>= 7;
+        len++;
+    }
+
+    return len;
+}
+
+static uint8_t varint_encode(uint32_t value, uint8_t *p_buf)
+{
+    uint8_t len = 0;
+
+    while (value >= 0x80) {
+        p_buf[len++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    p_buf[len++] = value;
+
+    return len;
+}
+
+static int varint_decode(const uint8_t *p_buf, uint16_t *p_offset, uint16_t end, uint32_t *p_value)
+{
+    uint32_t value = 0;
+
+    for (uint8_t shift = 0; shift < 7 * ZSW_TIMESERIES_MAX_VARINT_LEN; shift += 7) {
+        if (*p_offset >= end) {
+            break;
+        }
+        value |= (uint32_t)(p_buf[*p_offset] & 0x7F) << shift;
+        if ((p_buf[(*p_offset)++] & 0x80) == 0) {
+            *p_value = value;
+            return 0;
+        }
+    }
+
+    return -EBADMSG;
+}
+
+static uint16_t block_header_len(uint8_t num_columns)
+{
+    return sizeof(zsw_timeseries_block_header_t) + (num_columns + 1) * sizeof(uint16_t);
+}
+
+static void file_path(const zsw_timeseries_t *p_series, uint8_t num, char *p_path)
+{
+    snprintf(p_path, ZSW_TIMESERIES_FILE_PATH_LENGTH, "%s.%c", p_series->path, '0' + num);
+}
+
+// Column 0 is the timestamp.
+static uint32_t column_value(const zsw_timeseries_t *p_series, uint16_t row, uint8_t column)
+{
+    return column == 0 ? p_series->timestamps[row] : (uint32_t)p_series->values[row][column - 1];
+}
+
+// The first row in a block is stored as the delta to 0 so blocks can be decoded on their own.
+static uint32_t encoded_delta(const zsw_timeseries_t *p_series, uint16_t row, uint8_t column)
+{
+    uint32_t prev = row == 0 ? 0 : column_value(p_series, row - 1, column);
+
+    return zigzag_encode((int32_t)(column_value(p_series, row, column) - prev));
+}
+
+static uint16_t row_len(const zsw_timeseries_t *p_series, uint16_t row)
+{
+    uint16_t len = 0;
+
+    for (uint8_t column = 0; column <= p_series->num_columns; column++) {
+        len += varint_len(encoded_delta(p_series, row, column));
+    }
+
+    return len;
+}
+
+static int write_all(struct fs_file_t *p_file, const void *p_data, size_t len)
+{
+    ssize_t written = fs_write(p_file, p_data, len);
+
+    if (written < 0) {
+        return written;
+    }
+
+    return written == (ssize_t)len ? 0 : -ENOSPC;
+}
+
+static int read_all(struct fs_file_t *p_file, void *p_data, size_t len)
+{
+    ssize_t read = fs_read(p_file, p_data, len);
+
+    if (read < 0) {
+        return read;
+    }
+
+    if (read == 0) {
+        return -ENODATA;
+    }
+
+    return read == (ssize_t)len ? 0 : -EBADMSG;
+}
+
+static int rotate_if_full(zsw_timeseries_t *p_series)
+{
+    char path[ZSW_TIMESERIES_FILE_PATH_LENGTH];
+    char old_path[ZSW_TIMESERIES_FILE_PATH_LENGTH];
+    struct fs_dirent entry;
+    int ret;
+
+    file_path(p_series, 0, path);
+    ret = fs_stat(path, &entry);
+    if (ret == -ENOENT) {
+        return 0;
+    } else if (ret) {
+        return ret;
+    }
+
+    if (entry.size + p_series->encoded_len <= CONFIG_ZSW_TIMESERIES_MAX_FILE_SIZE) {
+        return 0;
+    }
+
+    file_path(p_series, 1, old_path);
+    ret = fs_unlink(old_path);
+    if (ret && ret != -ENOENT) {
+        return ret;
+    }
+
+    ret = fs_rename(path, old_path);
+    if (ret == 0) {
+        p_series->stats.rotations++;
+    }
+
+    return ret;
+}
+
+static int write_block(zsw_timeseries_t *p_series, struct fs_file_t *p_file)
+{
+    zsw_timeseries_block_header_t header;
+    uint16_t column_lens[ZSW_TIMESERIES_MAX_COLUMNS + 1] = { 0 };
+    uint8_t buf[ZSW_TIMESERIES_WRITE_BUFFER_SIZE];
+    uint8_t buf_len = 0;
+    int ret;
+
+    header.magic = ZSW_TIMESERIES_BLOCK_MAGIC;
+    header.num_columns = p_series->num_columns;
+    header.num_rows = p_series->num_rows;
+    header.len = p_series->encoded_len;
+
+    for (uint8_t column = 0; column <= p_series->num_columns; column++) {
+        for (uint16_t row = 0; row < p_series->num_rows; row++) {
+            column_lens[column] += varint_len(encoded_delta(p_series, row, column));
+        }
+    }
+
+    ret = write_all(p_file, &header, sizeof(header));
+    if (ret == 0) {
+        ret = write_all(p_file, column_lens, (p_series->num_columns + 1) * sizeof(uint16_t));
+    }
+
+    for (uint8_t column = 0; column <= p_series->num_columns && ret == 0; column++) {
+        for (uint16_t row = 0; row < p_series->num_rows && ret == 0; row++) {
+            if (sizeof(buf) - buf_len < ZSW_TIMESERIES_MAX_VARINT_LEN) {
+                ret = write_all(p_file, buf, buf_len);
+                buf_len = 0;
+            }
+            buf_len += varint_encode(encoded_delta(p_series, row, column), &buf[buf_len]);
+        }
+    }
+
+    if (ret == 0 && buf_len > 0) {
+        ret = write_all(p_file, buf, buf_len);
+    }
+
+    return ret;
+}
+
+static int flush_locked(zsw_timeseries_t *p_series)
+{
+    char path[ZSW_TIMESERIES_FILE_PATH_LENGTH];
+    struct fs_file_t file;
+    int ret;
+
+    if (p_series->num_rows == 0) {
+        return 0;
+    }
+
+    ret = rotate_if_full(p_series);
+    if (ret == 0) {
+        file_path(p_series, 0, path);
+        fs_file_t_init(&file);
+        ret = fs_open(&file, path, FS_O_CREATE | FS_O_WRITE | FS_O_APPEND);
+    }
+
+    if (ret == 0) {
+        ret = write_block(p_series, &file);
+        if (fs_close(&file) && ret == 0) {
+            ret = -EIO;
+        }
+    }
+
+    if (ret == 0) {
+        p_series->stats.raw_bytes += p_series->num_rows * (p_series->num_columns + 1) * sizeof(uint32_t);
+        p_series->stats.bytes_written += p_series->encoded_len;
+        p_series->stats.blocks_written++;
+    } else {
+        LOG_ERR("Error during writing of %s! Error: %i", p_series->path, ret);
+    }
+
+    // Dropped on error, the filesystem is not likely to recover.
+    p_series->num_rows = 0;
+
+    return ret;
+}
+
+int zsw_timeseries_init(zsw_timeseries_t *p_series, uint8_t num_columns, const char *p_path)
+{
+    if (num_columns == 0 || num_columns > ZSW_TIMESERIES_MAX_COLUMNS ||
+        strlen(p_path) >= ZSW_TIMESERIES_MAX_PATH_LENGTH) {
+        return -EINVAL;
+    }
+
+    memset(p_series, 0, sizeof(zsw_timeseries_t));
+    strcpy(p_series->path, p_path);
+    p_series->num_columns = num_columns;
+    k_mutex_init(&p_series->lock);
+
+    return 0;
+}
+
+int zsw_timeseries_append(zsw_timeseries_t *p_series, uint32_t timestamp, const int32_t *p_values)
+{
+    uint16_t len;
+    int ret = 0;
+
+    k_mutex_lock(&p_series->lock, K_FOREVER);
+
+    if (p_series->num_rows == CONFIG_ZSW_TIMESERIES_BLOCK_ROWS) {
+        ret = flush_locked(p_series);
+    }
+
+    if (p_series->num_rows == 0) {
+        p_series->encoded_len = block_header_len(p_series->num_columns);
+    }
+
+    p_series->timestamps[p_series->num_rows] = timestamp;
+    memcpy(p_series->values[p_series->num_rows], p_values, p_series->num_columns * sizeof(int32_t));
+    len = row_len(p_series, p_series->num_rows);
+
+    if (p_series->encoded_len + len > CONFIG_ZSW_TIMESERIES_BLOCK_SIZE) {
+        // The new row is after the rows written, so it's kept. It starts the next block.
+        ret = flush_locked(p_series);
+        p_series->timestamps[0] = timestamp;
+        memcpy(p_series->values[0], p_values, p_series->num_columns * sizeof(int32_t));
+        p_series->encoded_len = block_header_len(p_series->num_columns);
+        len = row_len(p_series, 0);
+    }
+
+    p_series->encoded_len += len;
+    p_series->num_rows++;
+    p_series->stats.rows_appended++;
+
+    k_mutex_unlock(&p_series->lock);
+
+    return ret;
+}
+
+int zsw_timeseries_flush(zsw_timeseries_t *p_series)
+{
+    int ret;
+
+    k_mutex_lock(&p_series->lock, K_FOREVER);
+    ret = flush_locked(p_series);
+    k_mutex_unlock(&p_series->lock);
+
+    return ret;
+}
+
+int zsw_timeseries_delete(zsw_timeseries_t *p_series)
+{
+    char path[ZSW_TIMESERIES_FILE_PATH_LENGTH];
+    int ret = 0;
+    int err;
+
+    k_mutex_lock(&p_series->lock, K_FOREVER);
+
+    p_series->num_rows = 0;
+    for (uint8_t num = 0; num < 2; num++) {
+        file_path(p_series, num, path);
+        err = fs_unlink(path);
+        if (err && err != -ENOENT) {
+            LOG_ERR("Error during deleting of %s! Error: %i", path, err);
+            ret = err;
+        }
+    }
+
+    k_mutex_unlock(&p_series->lock);
+
+    return ret;
+}
+
+void zsw_timeseries_get_stats(zsw_timeseries_t *p_series, zsw_timeseries_stats_t *p_stats)
+{
+    k_mutex_lock(&p_series->lock, K_FOREVER);
+    *p_stats = p_series->stats;
+    k_mutex_unlock(&p_series->lock);
+}
+
+static void next_file(zsw_timeseries_reader_t *p_reader)
+{
+    p_reader->file_num++;
+    p_reader->offset = 0;
+}
+
+static int read_block_from_file(zsw_timeseries_reader_t *p_reader, struct fs_file_t *p_file)
+{
+    zsw_timeseries_t *p_series = p_reader->series;
+    zsw_timeseries_block_header_t header;
+    uint16_t header_len = block_header_len(p_series->num_columns);
+    uint16_t column_len;
+    uint16_t offset;
+    int ret;
+
+    ret = fs_seek(p_file, p_reader->offset, FS_SEEK_SET);
+    if (ret == 0) {
+        ret = read_all(p_file, &header, sizeof(header));
+    }
+    if (ret) {
+        return ret;
+    }
+
+    if (header.magic != ZSW_TIMESERIES_BLOCK_MAGIC || header.num_columns != p_series->num_columns ||
+        header.len < header_len || header.len > CONFIG_ZSW_TIMESERIES_BLOCK_SIZE) {
+        return -EBADMSG;
+    }
+
+    memcpy(p_reader->block, &header, sizeof(header));
+    ret = read_all(p_file, &p_reader->block[sizeof(header)], header.len - sizeof(header));
+    if (ret) {
+        return ret == -ENODATA ? -EBADMSG : ret;
+    }
+
+    offset = header_len;
+    for (uint8_t column = 0; column <= p_series->num_columns; column++) {
+        memcpy(&column_len, &p_reader->block[sizeof(header) + column * sizeof(uint16_t)], sizeof(uint16_t));
+        p_reader->column_offsets[column] = offset;
+        offset += column_len;
+    }
+    if (offset != header.len) {
+        return -EBADMSG;
+    }
+
+    p_reader->offset += header.len;
+    p_reader->block_len = header.len;
+    p_reader->rows_left = header.num_rows;
+    p_reader->timestamp = 0;
+    memset(p_reader->values, 0, sizeof(p_reader->values));
+
+    return 0;
+}
+
+// Must be called with the series locked, so the files are not written or rotated while reading.
+static int read_block(zsw_timeseries_reader_t *p_reader)
+{
+    zsw_timeseries_t *p_series = p_reader->series;
+    char path[ZSW_TIMESERIES_FILE_PATH_LENGTH];
+    struct fs_file_t file;
+    int ret;
+
+    // After a rotation <path>.0 is found in <path>.1 and the blocks in the old <path>.1 are gone.
+    for (; p_reader->rotations != p_series->stats.rotations; p_reader->rotations++) {
+        if (p_reader->file_num == 1) {
+            p_reader->file_num = 0;
+        } else {
+            p_reader->offset = 0;
+        }
+    }
+
+    while (true) {
+        file_path(p_series, 1 - p_reader->file_num, path);
+        fs_file_t_init(&file);
+        ret = fs_open(&file, path, FS_O_READ);
+        if (ret == -ENOENT) {
+            ret = -ENODATA;
+        } else if (ret == 0) {
+            ret = read_block_from_file(p_reader, &file);
+            fs_close(&file);
+            if (ret == 0) {
+                return 0;
+            }
+        }
+
+        if (ret == -EBADMSG) {
+            LOG_WRN("Invalid block in %s at %d, skipping rest of file", path, (int)p_reader->offset);
+        } else if (ret != -ENODATA) {
+            return ret;
+        }
+
+        // Blocks are appended to <path>.0, stay at the end of it.
+        if (p_reader->file_num == 1) {
+            return -ENODATA;
+        }
+        next_file(p_reader);
+    }
+}
+
+static int decode_row(zsw_timeseries_reader_t *p_reader)
+{
+    uint8_t num_columns = p_reader->series->num_columns;
+    uint32_t delta;
+    uint16_t end;
+    int ret;
+
+    for (uint8_t column = 0; column <= num_columns; column++) {
+        end = column == num_columns ? p_reader->block_len : p_reader->column_offsets[column + 1];
+        ret = varint_decode(p_reader->block, &p_reader->column_offsets[column], end, &delta);
+        if (ret) {
+            return ret;
+        }
+
+        if (column == 0) {
+            p_reader->timestamp += (uint32_t)zigzag_decode(delta);
+        } else {
+            p_reader->values[column - 1] = (int32_t)((uint32_t)p_reader->values[column - 1] +
+                                                     (uint32_t)zigzag_decode(delta));
+        }
+    }
+
+    return 0;
+}
+
+void zsw_timeseries_reader_open(zsw_timeseries_t *p_series, zsw_timeseries_reader_t *p_reader,
+                                uint32_t from_timestamp)
+{
+    memset(p_reader, 0, offsetof(zsw_timeseries_reader_t, block));
+    p_reader->series = p_series;
+    p_reader->from_timestamp = from_timestamp;
+
+    k_mutex_lock(&p_series->lock, K_FOREVER);
+    p_reader->rotations = p_series->stats.rotations;
+    k_mutex_unlock(&p_series->lock);
+}
+
+int zsw_timeseries_reader_next(zsw_timeseries_reader_t *p_reader, uint32_t *p_timestamp, int32_t *p_values)
+{
+    zsw_timeseries_t *p_series = p_reader->series;
+    int ret;
+
+    while (true) {
+        if (p_reader->rows_left > 0) {
+            // Each column has its own read position, a row is decoded without reading the rest of the block.
+            ret = decode_row(p_reader);
+            if (ret) {
+                LOG_WRN("Invalid block in %s", p_series->path);
+                p_reader->rows_left = 0;
+                continue;
+            }
+            p_reader->rows_left--;
+            if (p_reader->skip_rows > 0) {
+                p_reader->skip_rows--;
+                continue;
+            }
+        } else {
+            k_mutex_lock(&p_series->lock, K_FOREVER);
+
+            if (!p_reader->reading_ram) {
+                ret = read_block(p_reader);
+                if (ret != -ENODATA) {
+                    k_mutex_unlock(&p_series->lock);
+                    if (ret) {
+                        return ret;
+                    }
+                    continue;
+                }
+                p_reader->reading_ram = true;
+                p_reader->ram_index = 0;
+                p_reader->blocks_written = p_series->stats.blocks_written;
+            }
+
+            if (p_reader->blocks_written != p_series->stats.blocks_written) {
+                // The rows in RAM were written as a block, continue in the file without the rows already read.
+                p_reader->reading_ram = false;
+                p_reader->skip_rows = p_reader->ram_index;
+                k_mutex_unlock(&p_series->lock);
+                continue;
+            }
+
+            if (p_reader->ram_index >= p_series->num_rows) {
+                k_mutex_unlock(&p_series->lock);
+                return -ENODATA;
+            }
+
+            p_reader->timestamp = p_series->timestamps[p_reader->ram_index];
+            memcpy(p_reader->values, p_series->values[p_reader->ram_index], sizeof(p_reader->values));
+            p_reader->ram_index++;
+
+            k_mutex_unlock(&p_series->lock);
+        }
+
+        if (p_reader->timestamp >= p_reader->from_timestamp) {
+            *p_timestamp = p_reader->timestamp;
+            memcpy(p_values, p_reader->values, p_series->num_columns * sizeof(int32_t));
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fs.h>
+
+/** @brief Maximum number of value columns in a time series, not counting the timestamp.
+*/
+#define ZSW_TIMESERIES_MAX_COLUMNS          4
+#define ZSW_TIMESERIES_MAX_PATH_LENGTH      48
+
+/** @brief Statistics of the writes to a time series.
+*/
+typedef struct {
+    uint32_t rows_appended;                     /**< Number of rows appended since init. */
+    uint32_t raw_bytes;                         /**< Size of the written rows unencoded, 4 bytes per column. */
+    uint32_t bytes_written;                     /**< Bytes written to the filesystem. */
+    uint32_t blocks_written;                    /**< Number of blocks written to the filesystem. */
+    uint32_t rotations;                         /**< Number of times the current file was moved to the old file. */
+} zsw_timeseries_stats_t;
+
+/** @brief ZSWatch time series object definition.
+ *         Rows of a timestamp and up to ZSW_TIMESERIES_MAX_COLUMNS values are kept in RAM until they fill a
+ *         block of CONFIG_ZSW_TIMESERIES_BLOCK_SIZE bytes. The block is then appended to the file <path>.0 with
+ *         each column stored as zigzag varint encoded deltas to the previous row. When <path>.0 grows larger
+ *         than CONFIG_ZSW_TIMESERIES_MAX_FILE_SIZE it replaces <path>.1.
+*/
+typedef struct {
+    char path[ZSW_TIMESERIES_MAX_PATH_LENGTH];  /**< Path of the files without the .0 and .1 suffix. */
+    uint8_t num_columns;                        /**< Number of values in a row. */
+    uint16_t num_rows;                          /**< Number of rows not written to the filesystem yet. */
+    uint16_t encoded_len;                       /**< Size of the block the rows not written yet will be encoded to. */
+    uint32_t timestamps[CONFIG_ZSW_TIMESERIES_BLOCK_ROWS];
+    int32_t values[CONFIG_ZSW_TIMESERIES_BLOCK_ROWS][ZSW_TIMESERIES_MAX_COLUMNS];
+    struct k_mutex lock;
+    zsw_timeseries_stats_t stats;
+} zsw_timeseries_t;
+
+/** @brief Streaming reader of a time series, decodes one block at a time.
+*/
+typedef struct {
+    zsw_timeseries_t *series;
+    uint32_t from_timestamp;                    /**< Rows with an earlier timestamp are skipped. */
+    uint8_t file_num;                           /**< 0 when reading <path>.1, 1 when reading <path>.0. */
+    off_t offset;                               /**< Offset of the next block in the file. */
+    uint32_t rotations;                         /**< Rotations of the series when the last block was read. */
+    uint32_t blocks_written;                    /**< Blocks written when the files were read to the end. */
+    bool reading_ram;                           /**< Set when all blocks are read and the rows in RAM are next. */
+    uint16_t ram_index;                         /**< Next row in RAM to read. */
+    uint16_t skip_rows;                         /**< Rows at the start of the next block that were read from RAM. */
+    uint16_t rows_left;                         /**< Rows left to decode in the current block. */
+    uint16_t block_len;                         /**< Size of the current block. */
+    uint16_t column_offsets[ZSW_TIMESERIES_MAX_COLUMNS + 1];
+    uint32_t timestamp;                         /**< Last decoded row. */
+    int32_t values[ZSW_TIMESERIES_MAX_COLUMNS];
+    uint8_t block[CONFIG_ZSW_TIMESERIES_BLOCK_SIZE];
+} zsw_timeseries_reader_t;
+
+/** @brief              Initialize a time series. Rows already in the filesystem are kept.
+ *  @param p_series     Pointer to time series object
+ *  @param num_columns  Number of values in a row, at most ZSW_TIMESERIES_MAX_COLUMNS
+ *  @param p_path       Path of the files without the .0 and .1 suffix, for example "/lvgl_lfs/activity"
+ *  @return             0 when successful
+*/
+int zsw_timeseries_init(zsw_timeseries_t *p_series, uint8_t num_columns, const char *p_path);
+
+/** @brief              Append a row. Only writes to the filesystem when the current block is full.
+ *  @param p_series     Pointer to time series object
+ *  @param timestamp    Timestamp of the row, in seconds
+ *  @param p_values     num_columns values
+ *  @return             0 when successful
+*/
+int zsw_timeseries_append(zsw_timeseries_t *p_series, uint32_t timestamp, const int32_t *p_values);
+
+/** @brief              Write the rows in RAM to the filesystem as a block, even if it is not full.
+ *  @param p_series     Pointer to time series object
+ *  @return             0 when successful
+*/
+int zsw_timeseries_flush(zsw_timeseries_t *p_series);
+
+/** @brief              Delete all rows of a time series, in RAM and in the filesystem.
+ *  @param p_series     Pointer to time series object
+ *  @return             0 when successful
+*/
+int zsw_timeseries_delete(zsw_timeseries_t *p_series);
+
+/** @brief              Get the write statistics of a time series.
+ *  @param p_series     Pointer to time series object
+ *  @param p_stats      Filled with the statistics
+*/
+void zsw_timeseries_get_stats(zsw_timeseries_t *p_series, zsw_timeseries_stats_t *p_stats);
+
+/** @brief                  Start reading a time series, oldest row first. Rows appended or rotated out of the
+ *                          filesystem while reading might not be returned.
+ *  @param p_series         Pointer to time series object
+ *  @param p_reader         Reader to initialize
+ *  @param from_timestamp   Skip rows with an earlier timestamp, 0 to read all rows
+*/
+void zsw_timeseries_reader_open(zsw_timeseries_t *p_series, zsw_timeseries_reader_t *p_reader,
+                                uint32_t from_timestamp);
+
+/** @brief              Read the next row.
+ *  @param p_reader     Reader opened with zsw_timeseries_reader_open
+ *  @param p_timestamp  Set to the timestamp of the row
+ *  @param p_values     Filled with num_columns values
+ *  @return             0 when a row was read, -ENODATA when there are no more rows
+*/
+int zsw_timeseries_reader_next(zsw_timeseries_reader_t *p_reader, uint32_t *p_timestamp, int32_t *p_values);
@@ -0,0 +1,176 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmarks the time series storage on LittleFS on the simulated flash on native_posix. native_posix has no
+ * filesystem by default, build with:
+ *   west build -b native_posix -- -DEXTRA_CONF_FILE=boards/timeseries_bench.conf
+ * and run with:
+ *   zephyr.exe --timeseries-bench=10000
+ * Appends the given number of activity log like rows, 5 minutes apart, to a time series on the scratch partition,
+ * prints the append throughput and compression ratio, reads the rows back and checks them, then exits.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fs.h>
+#include <zephyr/fs/littlefs.h>
+#include <zephyr/storage/flash_map.h>
+
+#include "zsw_bench.h"
+#include "history/zsw_timeseries.h"
+
+#define BENCH_MOUNT_POINT   "/ts_bench"
+#define BENCH_PATH          BENCH_MOUNT_POINT "/activity"
+#define BENCH_NUM_COLUMNS   3
+#define BENCH_INTERVAL_S    300
+
+FS_LITTLEFS_DECLARE_DEFAULT_CONFIG(bench_lfs_data);
+
+static struct fs_mount_t bench_mount = {
+    .type = FS_LITTLEFS,
+    .fs_data = &bench_lfs_data,
+    .storage_dev = (void *)FIXED_PARTITION_ID(scratch_partition),
+    .mnt_point = BENCH_MOUNT_POINT,
+};
+
+static uint32_t bench_count;
+static uint32_t rand_state;
+static zsw_timeseries_t series;
+static zsw_timeseries_reader_t reader;
+
+static struct args_struct_t bench_options[] = {
+    {
+        .option = "timeseries-bench",
+        .name = "rows",
+        .type = 'u',
+        .dest = (void *) &bench_count,
+        .descript = "Append and read back this many rows in a time series on the simulated flash, exits when done"
+    },
+    ARG_TABLE_ENDMARKER
+};
+
+// Deterministic so the rows can be generated again when checking what was read.
+static uint32_t bench_rand(uint32_t max)
+{
+    rand_state = rand_state * 1103515245 + 12345;
+
+    return (rand_state >> 16) % max;
+}
+
+// Steps reset at midnight, pressure in Pa * 100 and IAQ drift slowly.
+static void bench_row(uint32_t index, uint32_t *p_timestamp, int32_t *p_values)
+{
+    uint32_t timestamp = 1704067200 + index * BENCH_INTERVAL_S;
+    uint32_t hour = (timestamp / 3600) % 24;
+
+    if (index == 0) {
+        rand_state = 1;
+        p_values[0] = 0;
+        p_values[1] = 10132500;
+        p_values[2] = 50;
+    }
+
+    if (hour == 0 && timestamp % 3600 == 0) {
+        p_values[0] = 0;
+    } else if (hour >= 7 && hour < 22) {
+        p_values[0] += bench_rand(4) == 0 ? bench_rand(1000) : bench_rand(50);
+    }
+    p_values[1] += (int32_t)bench_rand(2001) - 1000;
+    p_values[2] = CLAMP(p_values[2] + (int32_t)bench_rand(7) - 3, 0, 500);
+
+    *p_timestamp = timestamp;
+}
+
+static uint32_t file_size(const char *p_path)
+{
+    struct fs_dirent entry;
+
+    return fs_stat(p_path, &entry) == 0 ? entry.size : 0;
+}
+
+static int timeseries_bench(void)
+{
+    int32_t values[BENCH_NUM_COLUMNS];
+    int32_t expected_values[BENCH_NUM_COLUMNS];
+    uint32_t timestamp;
+    uint32_t expected_timestamp;
+    zsw_timeseries_stats_t stats;
+    int64_t start_us;
+    uint32_t num_read = 0;
+    uint32_t num_wrong = 0;
+    uint32_t first_index = 0;
+    int ret;
+
+    if (bench_count == 0) {
+        return ZSW_BENCH_NOT_RUN;
+    }
+
+    ret = fs_mount(&bench_mount);
+    if (ret) {
+        printk("Failed mounting %s: %d\n", BENCH_MOUNT_POINT, ret);
+        return 1;
+    }
+
+    zsw_timeseries_init(&series, BENCH_NUM_COLUMNS, BENCH_PATH);
+    zsw_timeseries_delete(&series);
+
+    start_us = zsw_bench_time_us();
+    for (uint32_t i = 0; i < bench_count; i++) {
+        bench_row(i, &timestamp, values);
+        zsw_timeseries_append(&series, timestamp, values);
+    }
+    zsw_timeseries_flush(&series);
+    zsw_bench_print_result("Append", bench_count, zsw_bench_time_us() - start_us);
+
+    zsw_timeseries_get_stats(&series, &stats);
+    printk("Blocks: %d, rotations: %d, unencoded: %d bytes, encoded: %d bytes, %d.%02d bytes per row\n",
+           stats.blocks_written, stats.rotations, stats.raw_bytes, stats.bytes_written,
+           stats.bytes_written / bench_count, stats.bytes_written * 100 / bench_count % 100);
+    printk("Compression ratio: %d.%02d, in files: %d bytes\n", stats.raw_bytes / MAX(stats.bytes_written, 1),
+           stats.raw_bytes * 100 / MAX(stats.bytes_written, 1) % 100,
+           file_size(BENCH_PATH ".0") + file_size(BENCH_PATH ".1"));
+
+    start_us = zsw_bench_time_us();
+    zsw_timeseries_reader_open(&series, &reader, 0);
+    while (zsw_timeseries_reader_next(&reader, &timestamp, values) == 0) {
+        // Rows rotated out of the files are gone, the rows read are the last ones appended.
+        if (num_read == 0) {
+            for (first_index = 0; first_index < bench_count; first_index++) {
+                bench_row(first_index, &expected_timestamp, expected_values);
+                if (expected_timestamp == timestamp) {
+                    break;
+                }
+            }
+        } else {
+            bench_row(first_index + num_read, &expected_timestamp, expected_values);
+        }
+        if (timestamp != expected_timestamp || memcmp(values, expected_values, sizeof(values)) != 0) {
+            num_wrong++;
+        }
+        num_read++;
+    }
+    zsw_bench_print_result("Read and check", num_read, zsw_bench_time_us() - start_us);
+    printk("Read rows %d to %d of %d, %d wrong\n", first_index, first_index + num_read, bench_count, num_wrong);
+
+    zsw_timeseries_delete(&series);
+    fs_unmount(&bench_mount);
+    return num_wrong == 0 && first_index + num_read == bench_count ? 0 : 1;
+}
+
+ZSW_BENCH_DEFINE(timeseries_bench, 4096, bench_options, timeseries_bench);
@@ -61,8 +61,10 @@
 #include "ble/ble_ams.h"
 #include "ble/ble_ancs.h"
 #include "ble/ble_cts.h"
+#include "ble/ble_imu_stream.h"
 #include <zsw_coredump.h>
 #include "fuel_gauge/zsw_pmic.h"
+#include "history/zsw_activity_log.h"
 
 LOG_MODULE_REGISTER(main, CONFIG_ZSW_APP_LOG_LEVEL);
 
@@ -222,6 +224,9 @@ static void run_init_work(struct k_work *item)
     zsw_pressure_sensor_init();
     zsw_light_sensor_init();
     zsw_environment_sensor_init();
+#ifdef CONFIG_ZSW_ACTIVITY_LOG
+    zsw_activity_log_init();
+#endif
 
     // Need to enable the gpio-keys as they are suspended by default
     pm_device_action_run(DEVICE_DT_GET(DT_NODELABEL(buttons)), PM_DEVICE_ACTION_RESUME);
@@ -345,6 +350,9 @@ static void enable_bluetooth(void)
 
     __ASSERT_NO_MSG(ble_comm_init() == 0);
     bleAoaInit();
+#ifdef CONFIG_ZSW_IMU_STREAM
+    ble_imu_stream_init();
+#endif
 
     ble_ams_init();
     ble_cts_init();
@@ -360,8 +368,11 @@ static void print_retention_ram(void)
 
 static void open_notification_popup(void *data)
 {
-    zsw_not_mngr_notification_t *not = zsw_notification_manager_get_newest();
-    if (not != NULL) {
+    // Copied, the notification can be removed before the popup is shown.
+    static zsw_not_mngr_notification_copy_t copy;
+    zsw_not_mngr_notification_t *not = &copy.notification;
+
+    if (zsw_notification_manager_get_newest(&copy) == 0) {
         lv_group_set_default(temp_group);
         lv_indev_set_group(enc_indev, temp_group);
         zsw_vibration_run_pattern(ZSW_VIBRATION_PATTERN_NOTIFICATION);
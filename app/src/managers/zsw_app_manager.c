@@ -24,13 +24,29 @@
 
 LOG_MODULE_REGISTER(APP_MANAGER, LOG_LEVEL_INF);
 
-#define MAX_APPS        20
+#define MAX_APPS        64
 #define INVALID_APP_ID  0xFF
 
+// Rows kept alive in the app picker, the visible rows and a margin above and below. Each row stores the list
+// index of the app it shows, rows scrolled out of the window are bound to the apps scrolled into it.
+#define PICKER_NUM_ROWS         9
+#define PICKER_ICON_SIZE        32
+#define PICKER_ROW_PADDING      6
+#define PICKER_ROW_SPACING      2
+#define PICKER_UNBOUND          -1
+
+typedef struct {
+    lv_obj_t *cont;
+    lv_obj_t *img;
+    lv_obj_t *title;
+    int16_t list_index;
+    lv_coord_t translate_x;
+} picker_row_t;
+
 static void draw_application_picker(void);
-static void app_clicked(lv_event_t *e);
 static void async_app_start(lv_timer_t *timer);
 static void async_app_close(lv_timer_t *timer);
+static void app_manager_close_button_pressed(void);
 
 ZSW_LV_IMG_DECLARE(close_icon);
 
@@ -48,6 +64,16 @@ static bool is_deleting_app_picker;
 static lv_timer_t *async_app_start_timer;
 static lv_timer_t *async_app_close_timer;
 
+static uint8_t list_apps[MAX_APPS];
+static picker_row_t picker_rows[PICKER_NUM_ROWS];
+static uint8_t num_picker_rows;
+static lv_obj_t *picker_spacer;
+// Row numbers in the order they were added to the group, kept in list order so the buttons move to the next app.
+static uint8_t picker_group_order[PICKER_NUM_ROWS];
+// Looked up once, the close icon is stored last.
+static lv_img_header_t icon_headers[MAX_APPS + 1];
+static lv_coord_t max_icon_height = PICKER_ICON_SIZE;
+
 static void delete_application_picker(void)
 {
     if (grid != NULL) {
@@ -61,48 +87,267 @@ static void delete_application_picker(void)
     }
 }
 
-static void row_focused(lv_event_t *e)
+static uint8_t num_list_rows(void)
+{
+    // The close button is last.
+    return num_visible_apps + 1;
+}
+
+static lv_coord_t row_y(int16_t list_index)
+{
+    return list_index * (max_icon_height + PICKER_ROW_PADDING + PICKER_ROW_SPACING);
+}
+
+static int16_t wrap_list_index(int16_t list_index)
 {
-    lv_obj_t *row = lv_event_get_target(e);
-    int app_id = (int)lv_event_get_user_data(e);
-    if (row && lv_obj_get_child_cnt(row) > 0 && !is_deleting_app_picker) {
-        // Don't show close button as last focused row
-        if (apps[app_id]->private_list_index != num_visible_apps - 1) {
-            last_index = app_id;
+    return (list_index % num_list_rows() + num_list_rows()) % num_list_rows();
+}
+
+static picker_row_t *find_row(int16_t list_index)
+{
+    for (int i = 0; i < num_picker_rows; i++) {
+        if (picker_rows[i].list_index == list_index) {
+            return &picker_rows[i];
         }
-        lv_obj_t *title_label = lv_obj_get_user_data(row);
-        if (title_label) {
-            lv_obj_set_style_text_color(title_label, lv_color_white(), LV_PART_MAIN);
+    }
+
+    return NULL;
+}
+
+static picker_row_t *get_focused_row(void)
+{
+    lv_obj_t *focused = lv_group_get_focused(group_obj);
+
+    for (int i = 0; i < num_picker_rows; i++) {
+        if (picker_rows[i].cont == focused) {
+            return &picker_rows[i];
         }
     }
+
+    return NULL;
 }
 
-static void row_unfocused(lv_event_t *e)
+static void set_title_color(picker_row_t *row)
+{
+    bool focused = lv_obj_has_state(row->cont, LV_STATE_FOCUSED);
+
+    lv_obj_set_style_text_color(row->title, focused ? lv_color_white() : lv_palette_main(LV_PALETTE_GREY),
+                                LV_PART_MAIN);
+}
+
+static void relayout_rows(void)
+{
+    for (int i = 0; i < num_picker_rows; i++) {
+        if (picker_rows[i].list_index != PICKER_UNBOUND) {
+            lv_obj_set_height(picker_rows[i].cont, max_icon_height + PICKER_ROW_PADDING);
+            lv_obj_set_y(picker_rows[i].cont, row_y(picker_rows[i].list_index));
+        }
+    }
+    // Gives the grid the scroll height of all rows, not only the ones alive.
+    lv_obj_set_height(picker_spacer, max_icon_height + PICKER_ROW_PADDING);
+    lv_obj_set_y(picker_spacer, row_y(num_list_rows() - 1));
+}
+
+static const lv_img_header_t *get_icon_header(int cache_index, const void *icon)
+{
+    lv_img_header_t *header = &icon_headers[cache_index];
+
+    // Icons are files in external flash, only open them the first time.
+    if (header->w == 0 && lv_img_decoder_get_info(icon, header) != LV_RES_OK) {
+        header->w = PICKER_ICON_SIZE;
+        header->h = PICKER_ICON_SIZE;
+    }
+
+    return header;
+}
+
+static void bind_row(picker_row_t *row, int16_t list_index)
+{
+    const lv_img_header_t *header;
+    const void *icon;
+    const char *name;
+    int cache_index;
+
+    if (row->list_index == list_index) {
+        return;
+    }
+
+    if (list_index == num_visible_apps) {
+        icon = ZSW_LV_IMG_USE(close_icon);
+        name = "Close";
+        cache_index = MAX_APPS;
+    } else {
+        icon = apps[list_apps[list_index]]->icon;
+        name = apps[list_apps[list_index]]->name;
+        cache_index = list_apps[list_index];
+    }
+
+    row->list_index = list_index;
+    header = get_icon_header(cache_index, icon);
+
+    lv_img_set_src(row->img, icon);
+    lv_obj_set_size(row->img, header->w, header->h);
+    lv_label_set_text_static(row->title, name);
+    lv_obj_align(row->title, LV_ALIGN_LEFT_MID, header->w + 15, 0);
+    set_title_color(row);
+    lv_obj_set_y(row->cont, row_y(list_index));
+    // Recalculated on the next scroll event.
+    row->translate_x = LV_COORD_MIN;
+
+    if (header->h > max_icon_height) {
+        max_icon_height = header->h;
+        relayout_rows();
+    }
+}
+
+static void add_wanted_index(int16_t *wanted, uint8_t *num_wanted, int16_t list_index)
+{
+    list_index = wrap_list_index(list_index);
+
+    for (int i = 0; i < *num_wanted; i++) {
+        if (wanted[i] == list_index) {
+            return;
+        }
+    }
+    if (*num_wanted < num_picker_rows) {
+        wanted[(*num_wanted)++] = list_index;
+    }
+}
+
+static void sort_group_order(picker_row_t *focused_row)
+{
+    uint8_t sorted[PICKER_NUM_ROWS];
+    uint8_t target[PICKER_NUM_ROWS];
+    uint8_t focused_rank = 0;
+    uint8_t focused_pos = 0;
+
+    for (int i = 0; i < num_picker_rows; i++) {
+        int j = i;
+        while (j > 0 && picker_rows[sorted[j - 1]].list_index > picker_rows[i].list_index) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = i;
+    }
+
+    // Only the cyclic order matters for moving the focus. Rotate the order so the focused row keeps its place,
+    // swapping it in the group would focus it again.
+    for (int i = 0; i < num_picker_rows; i++) {
+        if (focused_row == &picker_rows[sorted[i]]) {
+            focused_rank = i;
+        }
+        if (focused_row == &picker_rows[picker_group_order[i]]) {
+            focused_pos = i;
+        }
+    }
+    for (int i = 0; i < num_picker_rows; i++) {
+        target[(focused_pos + i) % num_picker_rows] = sorted[(focused_rank + i) % num_picker_rows];
+    }
+
+    for (int i = 0; i < num_picker_rows; i++) {
+        for (int j = i + 1; j < num_picker_rows && picker_group_order[i] != target[i]; j++) {
+            if (picker_group_order[j] == target[i]) {
+                lv_group_swap_obj(picker_rows[picker_group_order[i]].cont, picker_rows[picker_group_order[j]].cont);
+                picker_group_order[j] = picker_group_order[i];
+                picker_group_order[i] = target[i];
+            }
+        }
+    }
+}
+
+static void update_picker_window(int16_t center_index)
 {
-    lv_obj_t *row = lv_event_get_target(e);
-    // Need to check child count as during delete we get this callback called, but without children.
-    // The image is deleted already.
-    if (row && lv_obj_get_child_cnt(row) > 0) {
-        lv_obj_t *title_label = lv_obj_get_user_data(row);
-        if (title_label) {
-            lv_obj_set_style_text_color(title_label, lv_palette_main(LV_PALETTE_GREY), LV_PART_MAIN);
+    int16_t wanted[PICKER_NUM_ROWS];
+    uint8_t num_wanted = 0;
+    picker_row_t *focused_row = get_focused_row();
+    picker_row_t *free_rows[PICKER_NUM_ROWS];
+    uint8_t num_free = 0;
+    bool is_wanted;
+
+    // The focused row and the ones next to it stay bound while touch scrolling away from it, so the buttons
+    // still move to the app next to it. The list wraps around, past the close button is the first app.
+    if (focused_row && focused_row->list_index != PICKER_UNBOUND) {
+        add_wanted_index(wanted, &num_wanted, focused_row->list_index - 1);
+        add_wanted_index(wanted, &num_wanted, focused_row->list_index);
+        add_wanted_index(wanted, &num_wanted, focused_row->list_index + 1);
+    }
+    add_wanted_index(wanted, &num_wanted, center_index);
+    for (int16_t offset = 1; num_wanted < num_picker_rows; offset++) {
+        add_wanted_index(wanted, &num_wanted, center_index + offset);
+        add_wanted_index(wanted, &num_wanted, center_index - offset);
+    }
+
+    // Rows already showing a wanted app are left as they are, the others are bound to the apps not shown yet.
+    for (int i = 0; i < num_picker_rows; i++) {
+        is_wanted = false;
+        for (int j = 0; j < num_wanted; j++) {
+            is_wanted |= picker_rows[i].list_index == wanted[j];
+        }
+        if (!is_wanted) {
+            free_rows[num_free++] = &picker_rows[i];
+        }
+    }
+    for (int i = 0; i < num_wanted && num_free > 0; i++) {
+        if (find_row(wanted[i]) == NULL) {
+            bind_row(free_rows[--num_free], wanted[i]);
         }
     }
+
+    sort_group_order(focused_row);
+}
+
+static void focus_list_index(int16_t list_index)
+{
+    picker_row_t *row;
+
+    update_picker_window(list_index);
+    row = find_row(list_index);
+    lv_group_focus_obj(row->cont);
+    lv_obj_scroll_to_view(row->cont, LV_ANIM_OFF);
 }
 
-static void app_clicked(lv_event_t *e)
+static void row_focused(lv_event_t *e)
 {
-    int app_id = (int)lv_event_get_user_data(e);
-    current_app = app_id;
-    last_index = app_id;
-    // This function may be called within a lvgl callback such
-    // as a button click. If we create a new ui in this callback
-    // which registers a button press callback then that callback
-    // may get called, but we don't want that. So delay the opening
-    // of the new application some time.
-    if (async_app_start_timer == NULL) {
-        async_app_start_timer = lv_timer_create(async_app_start, 500,  NULL);
-        lv_timer_set_repeat_count(async_app_start_timer, 1);
+    picker_row_t *row = lv_event_get_user_data(e);
+
+    if (is_deleting_app_picker || row->list_index == PICKER_UNBOUND) {
+        return;
+    }
+
+    // Don't show close button as last focused row
+    if (row->list_index != num_visible_apps) {
+        last_index = list_apps[row->list_index];
+    }
+    set_title_color(row);
+}
+
+static void row_unfocused(lv_event_t *e)
+{
+    picker_row_t *row = lv_event_get_user_data(e);
+
+    if (!is_deleting_app_picker) {
+        set_title_color(row);
+    }
+}
+
+static void row_clicked(lv_event_t *e)
+{
+    picker_row_t *row = lv_event_get_user_data(e);
+
+    if (row->list_index == num_visible_apps) {
+        app_manager_close_button_pressed();
+    } else if (row->list_index != PICKER_UNBOUND) {
+        current_app = list_apps[row->list_index];
+        last_index = current_app;
+        // This function may be called within a lvgl callback such
+        // as a button click. If we create a new ui in this callback
+        // which registers a button press callback then that callback
+        // may get called, but we don't want that. So delay the opening
+        // of the new application some time.
+        if (async_app_start_timer == NULL) {
+            async_app_start_timer = lv_timer_create(async_app_start, 500,  NULL);
+            lv_timer_set_repeat_count(async_app_start_timer, 1);
+        }
     }
 }
 
@@ -150,7 +395,7 @@ static void async_app_manager_close(lv_timer_t *timer)
     close_cb_func();
 }
 
-static void app_manager_close_button_pressed(lv_event_t *e)
+static void app_manager_close_button_pressed(void)
 {
     lv_timer_t *timer = lv_timer_create(async_app_manager_close, 500,  NULL);
     lv_timer_set_repeat_count(timer, 1);
@@ -166,12 +411,12 @@ static void scroll_event_cb(lv_event_t *e)
     lv_coord_t cont_y_center = cont_a.y1 + lv_area_get_height(&cont_a) / 2;
     lv_coord_t r = lv_obj_get_height(cont) * 5 / 9;
 
-    uint32_t i;
-    uint32_t child_cnt = lv_obj_get_child_cnt(cont);
-    for (i = 0; i < child_cnt; i++) {
-        lv_obj_t *child = lv_obj_get_child(cont, i);
+    update_picker_window((lv_obj_get_scroll_y(cont) + lv_obj_get_height(cont) / 2) / row_y(1));
+
+    for (int i = 0; i < num_picker_rows; i++) {
+        picker_row_t *row = &picker_rows[i];
         lv_area_t child_a;
-        lv_obj_get_coords(child, &child_a);
+        lv_obj_get_coords(row->cont, &child_a);
 
         lv_coord_t child_y_center = child_a.y1 + lv_area_get_height(&child_a) / 2;
 
@@ -191,9 +436,11 @@ static void scroll_event_cb(lv_event_t *e)
             x = r - res.i - 20; /* Added - 20 here to pull all a bit more to the left side */
         }
 
-        /* Translate the item by the calculated X coordinate */
-        lv_obj_set_style_translate_x(child, x, 0);
-        lv_obj_set_style_translate_y(child, -13, 0);
+        /* Translate the item by the calculated X coordinate, only rows that moved need a redraw */
+        if (x != row->translate_x) {
+            row->translate_x = x;
+            lv_obj_set_style_translate_x(row->cont, x, 0);
+        }
 
         /* Uncomment if to use some opacity with larger translations */
         //lv_opa_t opa = lv_map(x, 0, r, LV_OPA_TRANSP, LV_OPA_COVER);
@@ -201,53 +448,43 @@ static void scroll_event_cb(lv_event_t *e)
     }
 }
 
-static lv_obj_t *create_application_list_entry(lv_obj_t *grid, const void *icon, const char *name, int app_id)
+static void create_picker_row(lv_obj_t *grid, picker_row_t *row)
 {
     lv_obj_t *cont = lv_obj_create(grid);
-    lv_obj_center(cont);
     lv_obj_set_style_border_side(cont, LV_BORDER_SIDE_NONE, 0);
     lv_obj_set_scrollbar_mode(cont, LV_SCROLLBAR_MODE_OFF);
     lv_obj_set_style_bg_opa(cont, LV_OPA_TRANSP, LV_PART_MAIN);
+    lv_obj_set_style_translate_y(cont, -13, 0);
 
-    lv_img_header_t header;
-    lv_img_decoder_get_info(icon, &header);
-
-    lv_obj_set_size(cont, LV_PCT(100), header.h + 6);
+    lv_obj_set_size(cont, LV_PCT(100), max_icon_height + PICKER_ROW_PADDING);
     lv_obj_clear_flag(cont,
                       LV_OBJ_FLAG_SCROLLABLE); // Needed, otherwise indev will first focus on this cont before it's contents.
 
-    lv_obj_add_event_cb(cont, row_focused, LV_EVENT_FOCUSED, (void *)app_id);
-    lv_obj_add_event_cb(cont, row_unfocused, LV_EVENT_DEFOCUSED, (void *)app_id);
+    lv_obj_add_event_cb(cont, row_focused, LV_EVENT_FOCUSED, row);
+    lv_obj_add_event_cb(cont, row_unfocused, LV_EVENT_DEFOCUSED, row);
+    lv_obj_add_event_cb(cont, row_clicked, LV_EVENT_CLICKED, row);
     lv_group_add_obj(group_obj, cont);
     lv_obj_add_flag(cont, LV_OBJ_FLAG_SCROLL_ON_FOCUS);
 
     lv_obj_t *img_icon = lv_img_create(cont);
-    lv_img_set_src(img_icon, icon);
-    lv_obj_set_size(img_icon, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
     lv_obj_align(img_icon, LV_ALIGN_LEFT_MID, 0, 0);
 
     lv_obj_t *title = lv_label_create(cont);
-    lv_label_set_text(title, name);
     lv_obj_set_size(title, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
-    lv_obj_align_to(title, img_icon, LV_ALIGN_OUT_RIGHT_MID, 15, 0);
     lv_obj_set_style_text_font(title, &lv_font_montserrat_16, 0);
-    lv_obj_set_style_text_color(title, lv_palette_main(LV_PALETTE_GREY), LV_PART_MAIN);
     lv_obj_set_style_text_align(title, LV_ALIGN_OUT_LEFT_MID, LV_PART_MAIN);
 
-    lv_obj_set_user_data(cont, title);
-
-    return cont;
+    row->cont = cont;
+    row->img = img_icon;
+    row->title = title;
+    row->list_index = PICKER_UNBOUND;
+    row->translate_x = LV_COORD_MIN;
 }
 
 static void draw_application_picker(void)
 {
-    lv_obj_t *entry;
     static lv_style_t style;
     lv_style_init(&style);
-    lv_style_set_flex_flow(&style, LV_FLEX_FLOW_ROW);
-    lv_style_set_flex_main_place(&style, LV_FLEX_ALIGN_START);
-    lv_style_set_layout(&style, LV_LAYOUT_FLEX);
-
     lv_style_set_bg_opa(&style, LV_OPA_TRANSP);
     lv_obj_set_scrollbar_mode(lv_scr_act(), LV_SCROLLBAR_MODE_OFF);
 
@@ -256,34 +493,31 @@ static void draw_application_picker(void)
     lv_obj_add_style(grid, &style, 0);
     lv_obj_set_scrollbar_mode(root_obj, LV_SCROLLBAR_MODE_OFF);
     lv_obj_set_style_border_side(grid, LV_BORDER_SIDE_NONE, 0);
-    lv_obj_set_style_pad_row(grid, 2, 0);
 
     lv_obj_set_size(grid, LV_PCT(100), LV_PCT(100));
     lv_obj_center(grid);
-    lv_obj_set_flex_flow(grid, LV_FLEX_FLOW_COLUMN);
     lv_obj_set_scroll_dir(grid, LV_DIR_VER);
     lv_obj_set_scroll_snap_y(grid, LV_SCROLL_SNAP_CENTER);
     lv_obj_set_scrollbar_mode(grid, LV_SCROLLBAR_MODE_OFF);
     lv_obj_add_event_cb(grid, scroll_event_cb, LV_EVENT_SCROLL, NULL);
 
-    for (int i = 0; i < num_apps; i++) {
-        LOG_DBG("Apps[%d]: %s", i, apps[i]->name);
-        if (!apps[i]->hidden) {
-            entry = create_application_list_entry(grid, apps[i]->icon, apps[i]->name, i);
-            lv_obj_add_event_cb(entry, app_clicked, LV_EVENT_CLICKED, (void *)i);
-        }
+    // Only the rows around the visible ones are created, they are bound to apps when scrolled into view.
+    num_picker_rows = MIN(PICKER_NUM_ROWS, num_list_rows());
+    for (int i = 0; i < num_picker_rows; i++) {
+        create_picker_row(grid, &picker_rows[i]);
+        picker_group_order[i] = i;
     }
 
-    entry = create_application_list_entry(grid, ZSW_LV_IMG_USE(close_icon), "Close", num_visible_apps);
-    lv_obj_add_event_cb(entry, app_manager_close_button_pressed, LV_EVENT_CLICKED, NULL);
+    picker_spacer = lv_obj_create(grid);
+    lv_obj_remove_style_all(picker_spacer);
+    lv_obj_clear_flag(picker_spacer, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SNAPPABLE);
+    lv_obj_set_width(picker_spacer, 1);
+    relayout_rows();
 
-    lv_group_focus_obj(lv_obj_get_child(grid, apps[last_index]->private_list_index));
+    focus_list_index(apps[last_index]->private_list_index);
 
     /* Update the notifications position manually firt time */
     lv_event_send(grid, LV_EVENT_SCROLL, NULL);
-
-    /* Be sure the fist notification is in the middle */
-    lv_obj_scroll_to_view(lv_obj_get_child(grid, apps[last_index]->private_list_index), LV_ANIM_OFF);
 }
 
 int zsw_app_manager_show(on_app_manager_cb_fn close_cb, lv_obj_t *root, lv_group_t *group, char *app_name)
@@ -334,11 +568,12 @@ void zsw_app_manager_add_application(application_t *app)
 {
     __ASSERT_NO_MSG(num_apps < MAX_APPS);
     apps[num_apps] = app;
-    num_apps++;
     if (!app->hidden) {
         app->private_list_index = num_visible_apps;
+        list_apps[num_visible_apps] = num_apps;
         num_visible_apps++;
     }
+    num_apps++;
 }
 
 void zsw_app_manager_exit_app(void)
@@ -367,7 +602,7 @@ void zsw_app_manager_set_index(int index)
     }
 
     if (grid) {
-        lv_group_focus_obj(lv_obj_get_child(grid, apps[last_index]->private_list_index));
+        focus_list_index(apps[last_index]->private_list_index);
     }
 }
 
@@ -376,6 +611,16 @@ int zsw_app_manager_get_num_apps(void)
     return num_apps;
 }
 
+const char *zsw_app_manager_get_current_app_name(void)
+{
+    if (current_app < num_apps) {
+        return apps[current_app]->name;
+    } else if (grid != NULL) {
+        return "App picker";
+    }
+    return NULL;
+}
+
 static int application_manager_init(void)
 {
     memset(apps, 0, sizeof(apps));
@@ -66,4 +66,10 @@ void zsw_app_manager_set_index(int index);
 
 /** @brief Get number of registrated applications
 */
-int zsw_app_manager_get_num_apps(void);
\ No newline at end of file
+int zsw_app_manager_get_num_apps(void);
+
+/** @brief Get name of what the application manager currently shows
+ *  @return Name of the running application, "App picker" when the picker is shown, or NULL when the
+ *          application manager is not open.
+*/
+const char *zsw_app_manager_get_current_app_name(void);
@@ -1,6 +1,11 @@
 #include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/dlist.h>
 #include <zephyr/zbus/zbus.h>
 #include <zephyr/logging/log.h>
+#ifdef CONFIG_ZSW_NOTIFICATION_MGR_PERSIST
+#include <zephyr/fs/fs.h>
+#endif
 
 #include <time.h>
 #include <string.h>
@@ -10,86 +15,432 @@
 #include "events/zsw_notification_event.h"
 #include "zsw_notification_manager.h"
 
-LOG_MODULE_REGISTER(notification_mgr, LOG_LEVEL_DBG);
+LOG_MODULE_REGISTER(notification_mgr, CONFIG_ZSW_NOTIFICATION_MGR_LOG_LEVEL);
 
-#define ZSW_NOTIFICATION_MGR_INVALID_ID         0xFFFFFFFF
-#define NOTIFICATION_INVALID_INDEX              0xFFFFFFFF
+// Power of two and at least twice the number of source names.
+#define SOURCE_TABLE_SIZE                       32
+#define SOURCE_TABLE_MASK                       (SOURCE_TABLE_SIZE - 1)
+
+#define PERSIST_PATH                            "/lvgl_lfs/notifications.bin"
+#define PERSIST_MAGIC                           0x544F4E5A
+#define PERSIST_VERSION                         1
+#define PERSIST_DELAY_MS                        5000
+
+/** @brief Notification stored in the arena. The sender, title and body strings follow the record.
+*/
+typedef struct notification_record {
+    sys_dnode_t node;
+    zsw_not_mngr_notification_t notification;
+    uint16_t size;                                              /**< Bytes used in the arena, including strings. */
+    char strings[];
+} notification_record_t;
+
+typedef struct notification_source {
+    const char *name;
+    zsw_notification_src_t src;
+} notification_source_t;
+
+#define RECORD_MAX_SIZE ROUND_UP(sizeof(notification_record_t) + 2 * ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN + \
+                                 CONFIG_ZSW_NOTIFICATION_MGR_MAX_BODY_LEN + 1, sizeof(void *))
+
+BUILD_ASSERT(CONFIG_ZSW_NOTIFICATION_MGR_ARENA_SIZE >= 2 * RECORD_MAX_SIZE,
+             "Notification arena must fit at least two notifications of maximum size");
+
+#ifdef CONFIG_ZSW_NOTIFICATION_MGR_PERSIST
+typedef struct persist_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_notifications;
+} persist_header_t;
+
+// Followed by the sender, title and body separated by null terminators.
+typedef struct persist_entry {
+    uint32_t id;
+    uint32_t timestamp;
+    uint8_t src;
+    uint8_t sender_len;
+    uint8_t title_len;
+    uint8_t reserved;
+    uint16_t body_len;
+} __packed persist_entry_t;
+
+static void notification_mgr_persist_worker(struct k_work *item);
+static K_WORK_DELAYABLE_DEFINE(persist_work, notification_mgr_persist_worker);
+#endif
 
 static void notification_mgr_zbus_ble_comm_data_callback(const struct zbus_channel *chan);
 static void notification_mgr_update_worker(struct k_work *item);
 
-static uint8_t num_notifications;
-static zsw_not_mngr_notification_t notifications[ZSW_NOTIFICATION_MGR_MAX_STORED];
+static const notification_source_t sources[] = {
+    // {"t":"notify","id":1700974318,"src":"WhatsApp","title":"Daniel Kampert","subject":"","body":"H","sender":""}
+    { "WhatsApp", NOTIFICATION_SRC_WHATSAPP },
+    // {t:"notify",id:1670967782,src:"Gmail",title:"Jakob Krantz",body:"Nytt test\nDetta YR NÖTT"
+    // TODO Subject is before first \n in body so extract that into title field.
+    { "Gmail", NOTIFICATION_SRC_GMAIL },
+    { "Messenger", NOTIFICATION_SRC_FB_MESSENGER },
+    // {"t":"notify","id":1701847200,"src":"Home Assistant","title":"Message.","subject":"","body":"Gute Nacht","sender":""}
+    { "Home Assistant", NOTIFICATION_SRC_HOME_ASSISTANT },
+    { "Discord", NOTIFICATION_SRC_DISCORD },
+    { "LinkedIn", NOTIFICATION_SRC_LINKEDIN },
+    { "Reddit", NOTIFICATION_SRC_REDDIT },
+    { "YouTube", NOTIFICATION_SRC_YOUTUBE },
+    { "Messages", NOTIFICATION_SRC_COMMON_MESSENGER },
+    { "Calendar", NOTIFICATION_SRC_CALENDAR },
+    { "Kalender", NOTIFICATION_SRC_CALENDAR },
+};
+
+BUILD_ASSERT(ARRAY_SIZE(sources) * 2 <= SOURCE_TABLE_SIZE, "Increase SOURCE_TABLE_SIZE");
+
+// Open addressing hash table of the sources, built on init.
+static const notification_source_t *source_table[SOURCE_TABLE_SIZE];
+
+// Ring of variable length records. Records are allocated at arena_head and freed from the oldest,
+// when a record doesn't fit before the end of the arena it wraps around to the start.
+static uint8_t arena[CONFIG_ZSW_NOTIFICATION_MGR_ARENA_SIZE] __aligned(sizeof(void *));
+static uint32_t arena_head;
+// All stored notifications, oldest first.
+static sys_dlist_t records = SYS_DLIST_STATIC_INIT(&records);
+static uint32_t num_notifications;
+static K_MUTEX_DEFINE(notification_mutex);
 
 static K_WORK_DEFINE(notification_work, notification_mgr_update_worker);
 ZBUS_LISTENER_DEFINE(notification_mgr_ble_comm_lis, notification_mgr_zbus_ble_comm_data_callback);
 ZBUS_CHAN_DECLARE(zsw_notification_mgr_chan);
 ZBUS_CHAN_DECLARE(zsw_notification_mgr_remove_chan);
 
-/** @brief      Find a notification index by a given notification ID.
- *  @param id   Notification ID
- *  @return     Notification array index of the notification
+/** @brief      FNV-1a hash of a string that is not null terminated.
+ *  @param str
+ *  @param len
+ *  @return     Hash
 */
-static uint32_t find_notification_idx(uint32_t id)
+static uint32_t hash_str(const char *str, size_t len)
 {
-    for (uint32_t i = 0; i < ZSW_NOTIFICATION_MGR_MAX_STORED; i++) {
-        if (notifications[i].id == id) {
-            return i;
+    uint32_t hash = 2166136261U;
+
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)str[i]) * 16777619U;
+    }
+
+    return hash;
+}
+
+static void source_table_init(void)
+{
+    uint32_t idx;
+
+    memset(source_table, 0, sizeof(source_table));
+    for (int i = 0; i < ARRAY_SIZE(sources); i++) {
+        idx = hash_str(sources[i].name, strlen(sources[i].name)) & SOURCE_TABLE_MASK;
+        while (source_table[idx] != NULL) {
+            idx = (idx + 1) & SOURCE_TABLE_MASK;
         }
+        source_table[idx] = &sources[i];
     }
+}
 
-    return NOTIFICATION_INVALID_INDEX;
+/** @brief      Look up a notification source by the name from the phone.
+ *  @param name Source name, not null terminated
+ *  @param len  Length of the name
+ *  @return     The source, or NOTIFICATION_SRC_NONE when unknown
+*/
+static zsw_notification_src_t find_source(const char *name, size_t len)
+{
+    uint32_t idx = hash_str(name, len) & SOURCE_TABLE_MASK;
+
+    while (source_table[idx] != NULL) {
+        if (strlen(source_table[idx]->name) == len && memcmp(source_table[idx]->name, name, len) == 0) {
+            return source_table[idx]->src;
+        }
+        idx = (idx + 1) & SOURCE_TABLE_MASK;
+    }
+
+    return NOTIFICATION_SRC_NONE;
+}
+
+static notification_record_t *oldest_record(void)
+{
+    sys_dnode_t *node = sys_dlist_peek_head(&records);
+
+    return node ? CONTAINER_OF(node, notification_record_t, node) : NULL;
 }
 
-/** @brief  Get the next free notification index.
- *  @return Free notification array index
+static notification_record_t *newest_record(void)
+{
+    sys_dnode_t *node = sys_dlist_peek_tail(&records);
+
+    return node ? CONTAINER_OF(node, notification_record_t, node) : NULL;
+}
+
+/** @brief      Find a notification by a given notification ID.
+ *  @param id   Notification ID
+ *  @return     The notification record, or NULL when not found
 */
-static uint32_t find_free_notification_idx(void)
+static notification_record_t *find_record(uint32_t id)
 {
-    for (uint32_t i = 0; i < ZSW_NOTIFICATION_MGR_MAX_STORED; i++) {
-        if (notifications[i].id == ZSW_NOTIFICATION_MGR_INVALID_ID) {
-            return i;
+    sys_dnode_t *node;
+    notification_record_t *record;
+
+    // Newest first, removals from the phone are usually for recent notifications.
+    for (node = sys_dlist_peek_tail(&records); node != NULL; node = sys_dlist_peek_prev(&records, node)) {
+        record = CONTAINER_OF(node, notification_record_t, node);
+        if (record->notification.id == id) {
+            return record;
         }
     }
 
-    return NOTIFICATION_INVALID_INDEX;
+    return NULL;
 }
 
-/** @brief  Find the oldest notification.
- *  @return Notification index of the oldest notification
+static void schedule_persist(void)
+{
+#ifdef CONFIG_ZSW_NOTIFICATION_MGR_PERSIST
+    // Not rescheduled, so a steady stream of notifications is still written every PERSIST_DELAY_MS.
+    k_work_schedule(&persist_work, K_MSEC(PERSIST_DELAY_MS));
+#endif
+}
+
+static void remove_record(notification_record_t *record)
+{
+    struct zsw_notification_remove_event evt;
+
+    LOG_DBG("Remove notification with ID: %u", record->notification.id);
+
+    // NOTE: We pass a copy of the notification into the ZBUS event. The strings are only valid during the
+    // event, as the arena space is reused after the listeners have executed.
+    memcpy(&evt.notification, &record->notification, sizeof(zsw_not_mngr_notification_t));
+    zbus_chan_pub(&zsw_notification_mgr_remove_chan, &evt, K_NO_WAIT);
+
+    sys_dlist_remove(&record->node);
+    num_notifications--;
+
+    // Restart from the beginning when empty to avoid wrapping.
+    if (num_notifications == 0) {
+        arena_head = 0;
+    }
+
+    LOG_DBG("Notifications: %u", num_notifications);
+    schedule_persist();
+}
+
+/** @brief      Allocate a record at the arena head, removing the oldest notifications until it fits.
+ *  @param size Record size including strings, aligned to sizeof(void *)
+ *  @return     The record
 */
-static uint32_t find_oldest_notification_idx(void)
+static notification_record_t *alloc_record(uint32_t size)
 {
-    uint32_t oldest_idx = ZSW_NOTIFICATION_MGR_INVALID_ID;
-    uint32_t oldest_id = NOTIFICATION_INVALID_INDEX;
+    notification_record_t *oldest;
+    notification_record_t *record;
+    uint32_t oldest_offset;
+
+    if (num_notifications >= ZSW_NOTIFICATION_MGR_MAX_STORED) {
+        LOG_DBG("Notification buffer full");
+        remove_record(oldest_record());
+    }
 
-    for (uint32_t i = 0; i < ZSW_NOTIFICATION_MGR_MAX_STORED; i++) {
-        if ((notifications[i].id != ZSW_NOTIFICATION_MGR_INVALID_ID) && (notifications[i].id < oldest_id)) {
-            oldest_idx = i;
-            oldest_id = notifications[i].id;
+    while ((oldest = oldest_record()) != NULL) {
+        oldest_offset = (uint8_t *)oldest - arena;
+        if (arena_head > oldest_offset) {
+            // Free space is after the head and before the oldest record.
+            if (sizeof(arena) - arena_head >= size) {
+                break;
+            } else if (oldest_offset >= size) {
+                arena_head = 0;
+                break;
+            }
+        } else if (oldest_offset - arena_head >= size) {
+            break;
         }
+        LOG_DBG("Notification arena full");
+        remove_record(oldest);
     }
 
-    return oldest_idx;
+    record = (notification_record_t *)&arena[arena_head];
+    record->size = size;
+    arena_head += size;
+
+    return record;
+}
+
+static uint32_t record_size(size_t sender_len, size_t title_len, size_t body_len)
+{
+    return ROUND_UP(sizeof(notification_record_t) + sender_len + 1 + title_len + 1 + body_len + 1, sizeof(void *));
+}
+
+static const char *copy_str(char **dst, const char *src, size_t len)
+{
+    char *str = *dst;
+
+    memcpy(str, src, len);
+    str[len] = '\0';
+    *dst += len + 1;
+
+    return str;
 }
 
-/** @brief  Find the newest notification.
- *  @return Notification index of the newest notification
+/** @brief              Store a notification with copies of the strings.
+ *  @param notification Notification with the strings to copy, they don't need to be null terminated
+ *  @param sender_len
+ *  @param title_len
+ *  @param body_len
+ *  @return             The stored notification
 */
-static uint32_t find_newest_notification_idx(void)
+static notification_record_t *store_notification(const zsw_not_mngr_notification_t *notification, size_t sender_len,
+                                                 size_t title_len, size_t body_len)
 {
-    uint32_t newest_idx = ZSW_NOTIFICATION_MGR_INVALID_ID;
-    uint32_t newest_id = 0;
+    notification_record_t *record;
+    char *strings;
+
+    sender_len = MIN(sender_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1);
+    title_len = MIN(title_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1);
+    body_len = MIN(body_len, CONFIG_ZSW_NOTIFICATION_MGR_MAX_BODY_LEN);
+
+    record = alloc_record(record_size(sender_len, title_len, body_len));
+    strings = record->strings;
+    record->notification.id = notification->id;
+    record->notification.timestamp = notification->timestamp;
+    record->notification.src = notification->src;
+    record->notification.sender = copy_str(&strings, notification->sender, sender_len);
+    record->notification.title = copy_str(&strings, notification->title, title_len);
+    record->notification.body = copy_str(&strings, notification->body, body_len);
+
+    sys_dlist_append(&records, &record->node);
+    num_notifications++;
+
+    return record;
+}
 
-    for (uint32_t i = 0; i < ZSW_NOTIFICATION_MGR_MAX_STORED; i++) {
-        if ((notifications[i].id != ZSW_NOTIFICATION_MGR_INVALID_ID) && (notifications[i].id > newest_id)) {
-            newest_idx = i;
-            newest_id = notifications[i].id;
+/** @brief          Copy a stored notification and its strings, so it can be used after the mutex is released.
+ *  @param record
+ *  @param copy
+*/
+static void copy_notification(const notification_record_t *record, zsw_not_mngr_notification_copy_t *copy)
+{
+    const zsw_not_mngr_notification_t *notification = &record->notification;
+    // The sender, title and body are stored after each other with their null terminators.
+    size_t strings_len = notification->body - record->strings + strlen(notification->body) + 1;
+
+    __ASSERT_NO_MSG(strings_len <= sizeof(copy->strings));
+
+    memcpy(copy->strings, record->strings, strings_len);
+    copy->notification = *notification;
+    copy->notification.sender = copy->strings + (notification->sender - record->strings);
+    copy->notification.title = copy->strings + (notification->title - record->strings);
+    copy->notification.body = copy->strings + (notification->body - record->strings);
+}
+
+#ifdef CONFIG_ZSW_NOTIFICATION_MGR_PERSIST
+static void notification_mgr_persist_worker(struct k_work *item)
+{
+    int err;
+    struct fs_file_t file;
+    notification_record_t *record;
+    persist_header_t header;
+    persist_entry_t entry;
+
+    fs_unlink(PERSIST_PATH);
+
+    k_mutex_lock(&notification_mutex, K_FOREVER);
+    if (num_notifications == 0) {
+        k_mutex_unlock(&notification_mutex);
+        return;
+    }
+
+    fs_file_t_init(&file);
+    err = fs_open(&file, PERSIST_PATH, FS_O_CREATE | FS_O_WRITE);
+    if (err) {
+        LOG_ERR("Failed to open %s (%d)", PERSIST_PATH, err);
+        k_mutex_unlock(&notification_mutex);
+        return;
+    }
+
+    header.magic = PERSIST_MAGIC;
+    header.version = PERSIST_VERSION;
+    header.num_notifications = num_notifications;
+    err = fs_write(&file, &header, sizeof(header));
+
+    SYS_DLIST_FOR_EACH_CONTAINER(&records, record, node) {
+        if (err < 0) {
+            break;
+        }
+        entry.id = record->notification.id;
+        entry.timestamp = record->notification.timestamp;
+        entry.src = record->notification.src;
+        entry.sender_len = strlen(record->notification.sender);
+        entry.title_len = strlen(record->notification.title);
+        entry.reserved = 0;
+        entry.body_len = strlen(record->notification.body);
+
+        err = fs_write(&file, &entry, sizeof(entry));
+        if (err >= 0) {
+            // The strings are stored after each other including the null terminators.
+            err = fs_write(&file, record->strings, entry.sender_len + 1 + entry.title_len + 1 + entry.body_len);
+        }
+    }
+    k_mutex_unlock(&notification_mutex);
+
+    if (err < 0) {
+        LOG_ERR("Failed to write notifications: %d", err);
+    }
+    fs_close(&file);
+}
+
+static void load_notifications(void)
+{
+    int err;
+    struct fs_file_t file;
+    persist_header_t header;
+    persist_entry_t entry;
+    notification_record_t *record;
+    size_t strings_len;
+
+    fs_file_t_init(&file);
+    err = fs_open(&file, PERSIST_PATH, FS_O_READ);
+    if (err) {
+        return;
+    }
+
+    err = fs_read(&file, &header, sizeof(header));
+    if (err != sizeof(header) || header.magic != PERSIST_MAGIC || header.version != PERSIST_VERSION) {
+        LOG_WRN("Invalid %s", PERSIST_PATH);
+        fs_close(&file);
+        return;
+    }
+
+    for (int i = 0; i < header.num_notifications; i++) {
+        if (fs_read(&file, &entry, sizeof(entry)) != sizeof(entry) ||
+            entry.sender_len >= ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN ||
+            entry.title_len >= ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN ||
+            entry.body_len > CONFIG_ZSW_NOTIFICATION_MGR_MAX_BODY_LEN || entry.src > NOTIFICATION_SRC_NONE) {
+            LOG_WRN("Invalid notification in %s", PERSIST_PATH);
+            break;
+        }
+
+        // The strings are read straight into the arena.
+        strings_len = entry.sender_len + 1 + entry.title_len + 1 + entry.body_len;
+        record = alloc_record(record_size(entry.sender_len, entry.title_len, entry.body_len));
+        err = fs_read(&file, record->strings, strings_len);
+        if (err != strings_len) {
+            LOG_WRN("Truncated %s", PERSIST_PATH);
+            // Not linked yet, give the space back.
+            arena_head -= record->size;
+            break;
         }
+        record->strings[strings_len] = '\0';
+        record->notification.id = entry.id;
+        record->notification.timestamp = entry.timestamp;
+        record->notification.src = entry.src;
+        record->notification.sender = record->strings;
+        record->notification.title = record->notification.sender + entry.sender_len + 1;
+        record->notification.body = record->notification.title + entry.title_len + 1;
+
+        sys_dlist_append(&records, &record->node);
+        num_notifications++;
     }
 
-    return newest_idx;
+    fs_close(&file);
+    LOG_DBG("Loaded %u notifications", num_notifications);
 }
+#endif
 
 /** @brief
  *  @param item
@@ -104,8 +455,6 @@ static void notification_mgr_update_worker(struct k_work *item)
 */
 static void notification_mgr_zbus_ble_comm_data_callback(const struct zbus_channel *chan)
 {
-    zsw_not_mngr_notification_t *not;
-
     // Need to context switch to not get stack overflow.
     // We are here in host bluetooth thread.
     const struct ble_data_event *event = zbus_chan_const_msg(chan);
@@ -115,18 +464,10 @@ static void notification_mgr_zbus_ble_comm_data_callback(const struct zbus_chann
         if (event->data.data.notify.src_len == 0) {
             return;
         }
-        not = zsw_notification_manager_add(&event->data.data.notify);
-        if (!not) {
+        if (zsw_notification_manager_add(&event->data.data.notify, NULL) != 0) {
             return;
         }
 
-        LOG_DBG("ID: %u", not->id);
-        LOG_DBG("Source: %u", not->src);
-        LOG_DBG("Sender: %s", not->sender);
-        LOG_DBG("Title: %s", not->title);
-        LOG_DBG("Body: %s", not->body);
-        LOG_DBG("Time: %u", not->timestamp);
-
         k_work_submit(&notification_work);
     } else if (event->data.type == BLE_COMM_DATA_TYPE_NOTIFY_REMOVE) {
         LOG_DBG("Remove notification with ID %u", event->data.data.notify_remove.id);
@@ -139,174 +480,122 @@ static void notification_mgr_zbus_ble_comm_data_callback(const struct zbus_chann
 
 void zsw_notification_manager_init(void)
 {
-    memset(notifications, 0, sizeof(notifications));
-    for (uint32_t i = 0; i < ZSW_NOTIFICATION_MGR_MAX_STORED; i++) {
-        notifications[i].id = ZSW_NOTIFICATION_MGR_INVALID_ID;
-    }
+    k_mutex_lock(&notification_mutex, K_FOREVER);
+    source_table_init();
+    sys_dlist_init(&records);
+    arena_head = 0;
     num_notifications = 0;
+#ifdef CONFIG_ZSW_NOTIFICATION_MGR_PERSIST
+    load_notifications();
+#endif
+    k_mutex_unlock(&notification_mutex);
 }
 
-zsw_not_mngr_notification_t *zsw_notification_manager_add(const ble_comm_notify_t *not)
+int32_t zsw_notification_manager_add(const ble_comm_notify_t *not, zsw_not_mngr_notification_copy_t *copy)
 {
-    uint32_t idx;
+    notification_record_t *record;
+    zsw_not_mngr_notification_t notification;
+    size_t sender_len;
+    size_t title_len;
+
+    k_mutex_lock(&notification_mutex, K_FOREVER);
 
     // Prevent double notifications with the same ID. Return the double notification when found.
-    for (uint32_t i = 0; i < ZSW_NOTIFICATION_MGR_MAX_STORED; i++) {
-        if (notifications[i].id == not->id) {
-            return &notifications[i];
+    record = find_record(not->id);
+    if (record) {
+        if (copy) {
+            copy_notification(record, copy);
         }
+        k_mutex_unlock(&notification_mutex);
+        return 0;
     }
 
-    idx = find_free_notification_idx();
-    // List full. We remove the oldest notification.
-    if (idx == NOTIFICATION_INVALID_INDEX) {
-        LOG_DBG("Notification buffer full");
-
-        idx = find_oldest_notification_idx();
-        zsw_notification_manager_remove(notifications[idx].id);
-
-        // No check needed because we have removed one notification.
-        idx = find_free_notification_idx();
-    }
+    notification.id = not->id;
+    notification.timestamp = time(NULL);
+    notification.src = find_source(not->src, not->src_len);
+    notification.body = not->body;
 
-    memset(&notifications[idx], 0, sizeof(zsw_not_mngr_notification_t));
-
-    if (strncmp(not->src, "Messenger", not->src_len) == 0) {
-        notifications[idx].src = NOTIFICATION_SRC_FB_MESSENGER;
-        notifications[idx].id = not->id;
-        memcpy(notifications[idx].body, not->body, MIN(not->body_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-        memcpy(notifications[idx].sender, not->title, MIN(not->title_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-    } else if (strncmp(not->src, "WhatsApp", not->src_len) == 0) {
-        // {"t":"notify","id":1700974318,"src":"WhatsApp","title":"Daniel Kampert","subject":"","body":"H","sender":""}
-
-        notifications[idx].src = NOTIFICATION_SRC_WHATSAPP;
-        notifications[idx].id = not->id;
-        memcpy(notifications[idx].sender, not->title, MIN(not->title_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-        memcpy(notifications[idx].body, not->body, MIN(not->body_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-    } else if (strncmp(not->src, "Gmail", not->src_len) == 0) {
-        // {t:"notify",id:1670967782,src:"Gmail",title:"Jakob Krantz",body:"Nytt test\nDetta YR NÖTT"
-
-        // TODO Subject is before first \n in body so extract that into title field.
-        notifications[idx].src = NOTIFICATION_SRC_GMAIL;
-        notifications[idx].id = not->id;
-        memcpy(notifications[idx].body, not->body, MIN(not->body_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-        memcpy(notifications[idx].sender, not->title, MIN(not->title_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-    } else if (strncmp(not->src, "Home Assistant", not->src_len) == 0) {
-        // {"t":"notify","id":1701847200,"src":"Home Assistant","title":"Message.","subject":"","body":"Gute Nacht","sender":""}
-
-        notifications[idx].src = NOTIFICATION_SRC_HOME_ASSISTANT;
-        notifications[idx].id = not->id;
-        memcpy(notifications[idx].body, not->body, MIN(not->body_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-        memcpy(notifications[idx].sender, not->title, MIN(not->title_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-    } else if (strncmp(not->src, "Discord", not->src_len) == 0) {
-        // {"t":"notify","id":1701847200,"src":"Discord","title":"Message.","subject":"","body":"Gute Nacht","sender":""}
-
-        notifications[idx].src = NOTIFICATION_SRC_DISCORD;
-        notifications[idx].id = not->id;
-        memcpy(notifications[idx].body, not->body, MIN(not->body_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-        memcpy(notifications[idx].sender, not->title, MIN(not->title_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-    } else if (strncmp(not->src, "LinkedIn", not->src_len) == 0) {
-        // {"t":"notify","id":1701847200,"src":"LinkedIn","title":"Message.","subject":"","body":"Gute Nacht","sender":""}
-
-        notifications[idx].src = NOTIFICATION_SRC_LINKEDIN;
-        notifications[idx].id = not->id;
-        memcpy(notifications[idx].body, not->body, MIN(not->body_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-        memcpy(notifications[idx].sender, not->title, MIN(not->title_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-    } else if (strncmp(not->src, "Reddit", not->src_len) == 0) {
-        notifications[idx].src = NOTIFICATION_SRC_REDDIT;
-        notifications[idx].id = not->id;
-        memcpy(notifications[idx].body, not->body, MIN(not->body_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-        memcpy(notifications[idx].sender, not->title, MIN(not->title_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-    } else if (strncmp(not->src, "YouTube", not->src_len) == 0) {
-        notifications[idx].src = NOTIFICATION_SRC_YOUTUBE;
-        notifications[idx].id = not->id;
-        memcpy(notifications[idx].body, not->body, MIN(not->body_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-        memcpy(notifications[idx].sender, not->title, MIN(not->title_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-    } else if (strncmp(not->src, "Messages", not->src_len) == 0) {
-        notifications[idx].src = NOTIFICATION_SRC_COMMON_MESSENGER;
-        notifications[idx].id = not->id;
-        memcpy(notifications[idx].body, not->body, MIN(not->body_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-        memcpy(notifications[idx].sender, not->title, MIN(not->title_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-    } else if (strncmp(not->src, "Calendar", not->src_len) == 0 || strncmp(not->src, "Kalender", not->src_len) == 0) {
-        notifications[idx].src = NOTIFICATION_SRC_CALENDAR;
-        notifications[idx].id = not->id;
-        memcpy(notifications[idx].body, not->body, MIN(not->body_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-        memcpy(notifications[idx].sender, not->title, MIN(not->title_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
+    if (notification.src != NOTIFICATION_SRC_NONE) {
+        notification.sender = not->title;
+        sender_len = not->title_len;
+        notification.title = "";
+        title_len = 0;
     } else {
         // TODO add more
         // For example debug notfication
         // {t:"notify",id:1670967783,src:"Bangle.js Gadgetbridge",subject:"Testar",body:"Testar",sender:"Testar",tel:"Testar"}
-        notifications[idx].src = NOTIFICATION_SRC_NONE;
-        notifications[idx].id = not->id;
-        memcpy(notifications[idx].title, not->src, MIN(not->src_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-        memcpy(notifications[idx].body, not->body, MIN(not->body_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
-        memcpy(notifications[idx].sender, not->sender, MIN(not->sender_len, ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN - 1));
+        notification.sender = not->sender;
+        sender_len = not->sender_len;
+        notification.title = not->src;
+        title_len = not->src_len;
     }
 
-    notifications[idx].timestamp = time(NULL);
-
-    if (num_notifications < ZSW_NOTIFICATION_MGR_MAX_STORED) {
-        num_notifications++;
-    }
+    record = store_notification(&notification, sender_len, title_len, not->body_len);
+    schedule_persist();
 
+    LOG_DBG("ID: %u", record->notification.id);
+    LOG_DBG("Source: %u", record->notification.src);
+    LOG_DBG("Sender: %s", record->notification.sender);
+    LOG_DBG("Title: %s", record->notification.title);
+    LOG_DBG("Body: %s", record->notification.body);
+    LOG_DBG("Time: %u", record->notification.timestamp);
     LOG_DBG("Notifications: %u", num_notifications);
 
-    return &notifications[idx];
+    if (copy) {
+        copy_notification(record, copy);
+    }
+    k_mutex_unlock(&notification_mutex);
+
+    return 0;
 }
 
 int32_t zsw_notification_manager_remove(uint32_t id)
 {
-    uint32_t idx = find_notification_idx(id);
-
-    if (idx != NOTIFICATION_INVALID_INDEX) {
-        struct zsw_notification_remove_event evt;
-
-        LOG_DBG("Remove notification on place %u with ID: %u", idx, notifications[idx].id);
+    notification_record_t *record;
 
-        // NOTE: We pass a copy of the notification into the ZBUS event. This help the listeners to
-        // handle the notification, because the data in the notification buffer can change before
-        // the listeners have ececuted their operations.
-        memcpy(&evt.notification, &notifications[idx], sizeof(zsw_not_mngr_notification_t));
-        zbus_chan_pub(&zsw_notification_mgr_remove_chan, &evt, K_NO_WAIT);
-
-        notifications[idx].id = ZSW_NOTIFICATION_MGR_INVALID_ID;
-
-        if (num_notifications > 0) {
-            num_notifications--;
-        }
-
-        LOG_DBG("Notifications: %u", num_notifications);
-
-        return 0;
+    k_mutex_lock(&notification_mutex, K_FOREVER);
+    record = find_record(id);
+    if (record) {
+        remove_record(record);
     }
+    k_mutex_unlock(&notification_mutex);
 
-    return -ENOENT;
+    return record ? 0 : -ENOENT;
 }
 
-void zsw_notification_manager_get_all(zsw_not_mngr_notification_t *nots, uint32_t *num_notifications)
+void zsw_notification_manager_for_each(zsw_notification_manager_cb_t cb, void *user_data)
 {
-    uint32_t num_stored = 0;
-    for (uint32_t i = 0; i < ZSW_NOTIFICATION_MGR_MAX_STORED; i++) {
-        if (notifications[i].id != ZSW_NOTIFICATION_MGR_INVALID_ID) {
-            nots[num_stored] = notifications[i];
-            num_stored++;
-        }
-    }
+    notification_record_t *record;
 
-    *num_notifications = num_stored;
+    // The strings live in the arena, so they are only valid while the mutex is held.
+    k_mutex_lock(&notification_mutex, K_FOREVER);
+    SYS_DLIST_FOR_EACH_CONTAINER(&records, record, node) {
+        cb(&record->notification, user_data);
+    }
+    k_mutex_unlock(&notification_mutex);
 }
 
 int32_t zsw_notification_manager_get_num(void)
 {
-    return num_notifications;
+    uint32_t num;
+
+    k_mutex_lock(&notification_mutex, K_FOREVER);
+    num = num_notifications;
+    k_mutex_unlock(&notification_mutex);
+
+    return num;
 }
 
-zsw_not_mngr_notification_t *zsw_notification_manager_get_newest(void)
+int32_t zsw_notification_manager_get_newest(zsw_not_mngr_notification_copy_t *copy)
 {
-    int idx = find_newest_notification_idx();
-    if (idx != ZSW_NOTIFICATION_MGR_INVALID_ID) {
-        return &notifications[idx];
+    notification_record_t *record;
+
+    k_mutex_lock(&notification_mutex, K_FOREVER);
+    record = newest_record();
+    if (record) {
+        copy_notification(record, copy);
     }
+    k_mutex_unlock(&notification_mutex);
 
-    return NULL;
-}
\ No newline at end of file
+    return record ? 0 : -ENODATA;
+}
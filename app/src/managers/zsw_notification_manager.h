@@ -21,13 +21,14 @@
 
 #include "ble/ble_comm.h"
 
-/** @brief
+/** @brief Maximum length of the sender and title, including the null terminator.
 */
 #define ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN      50
 
-/** @brief Maximum number of notification stored at a time.
+/** @brief Maximum number of notification stored at a time. Fewer are stored when they do not fit in
+ *         CONFIG_ZSW_NOTIFICATION_MGR_ARENA_SIZE.
 */
-#define ZSW_NOTIFICATION_MGR_MAX_STORED         10
+#define ZSW_NOTIFICATION_MGR_MAX_STORED         CONFIG_ZSW_NOTIFICATION_MGR_MAX_STORED
 
 /** @brief Notification sources definitions.
 */
@@ -46,26 +47,39 @@ typedef enum {
     NOTIFICATION_SRC_NONE                                       /**< */
 } zsw_notification_src_t;
 
-/** @brief Notification object definition.
+/** @brief Notification object definition. The strings are stored with the notification and are valid until
+ *         it is removed.
 */
 typedef struct not_mngr_notification {
     uint32_t id;                                                /**< Notification ID. */
     uint32_t timestamp;                                         /**< Active notification time in seconds. */
-    char sender[ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN];            /**< Contains the notification sender (e-mail address or name in WhatsApp). */
-    char title[ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN];             /**< */
-    char body[ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN];              /**< */
+    const char *sender;                                         /**< Contains the notification sender (e-mail address or name in WhatsApp). */
+    const char *title;                                          /**< */
+    const char *body;                                           /**< */
     zsw_notification_src_t src;                                 /**< */
 } zsw_not_mngr_notification_t;
 
+/** @brief Copy of a notification with room for its strings, valid also after the notification is removed.
+*/
+typedef struct {
+    zsw_not_mngr_notification_t notification;                   /**< The strings point into strings below. */
+    char strings[2 * ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN + CONFIG_ZSW_NOTIFICATION_MGR_MAX_BODY_LEN + 1];
+} zsw_not_mngr_notification_copy_t;
+
+/** @brief Called for each stored notification. The notification and its strings are only valid during the call.
+*/
+typedef void (*zsw_notification_manager_cb_t)(const zsw_not_mngr_notification_t *notification, void *user_data);
+
 /** @brief
 */
 void zsw_notification_manager_init(void);
 
-/** @brief
+/** @brief Store a notification, the oldest notifications are removed when full.
  *  @param notification
- *  @return
+ *  @param copy         Filled with a copy of the stored notification, or NULL
+ *  @return             0 when successful
 */
-zsw_not_mngr_notification_t *zsw_notification_manager_add(const ble_comm_notify_t *notification);
+int32_t zsw_notification_manager_add(const ble_comm_notify_t *notification, zsw_not_mngr_notification_copy_t *copy);
 
 /** @brief
  *  @param id   Notification ID
@@ -73,25 +87,20 @@ zsw_not_mngr_notification_t *zsw_notification_manager_add(const ble_comm_notify_
 */
 int32_t zsw_notification_manager_remove(uint32_t id);
 
-/** @brief
- *  @param id               Notification ID
- *  @param notification
- *  @return
+/** @brief Call a function for all notifications from oldest to newest. The notification manager is locked
+ *         during the calls, so the callback must not call any other notification manager function.
+ *  @param cb
+ *  @param user_data    Passed to cb
 */
-int32_t zsw_notification_manager_get(uint32_t id, zsw_not_mngr_notification_t *notifcation);
-
-/** @brief
- *  @param notifications
- *  @param num_notifications
-*/
-void zsw_notification_manager_get_all(zsw_not_mngr_notification_t *notifcations, uint32_t *num_notifications);
+void zsw_notification_manager_for_each(zsw_notification_manager_cb_t cb, void *user_data);
 
 /** @brief
  *  @return
 */
 int32_t zsw_notification_manager_get_num(void);
 
-/** @brief
- *  @return
+/** @brief Get a copy of the newest notification.
+ *  @param copy Filled with the notification
+ *  @return     0 when successful, -ENODATA when there are no notifications
 */
-zsw_not_mngr_notification_t *zsw_notification_manager_get_newest(void);
\ No newline at end of file
+int32_t zsw_notification_manager_get_newest(zsw_not_mngr_notification_copy_t *copy);
\ No newline at end of file
@@ -0,0 +1,125 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmarks the notification manager on native_posix. Run with:
+ *   zephyr.exe --notification-bench=10000
+ * Adds the given number of notifications with random sources and lengths, then adds the same number again
+ * while removing every other one, prints the throughput and exits.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+
+#include "zsw_bench.h"
+#include "managers/zsw_notification_manager.h"
+
+static const char *const bench_sources[] = {
+    "WhatsApp", "Gmail", "Messenger", "Calendar", "Bangle.js Gadgetbridge", "Unknown app"
+};
+
+static char bench_text[CONFIG_ZSW_NOTIFICATION_MGR_MAX_BODY_LEN + 16];
+static uint32_t bench_count;
+static uint32_t rand_state = 1;
+
+static struct args_struct_t bench_options[] = {
+    {
+        .option = "notification-bench",
+        .name = "count",
+        .type = 'u',
+        .dest = (void *) &bench_count,
+        .descript = "Add and remove this many notifications in the notification manager, exits when done"
+    },
+    ARG_TABLE_ENDMARKER
+};
+
+// Deterministic so runs can be compared.
+static uint32_t bench_rand(uint32_t max)
+{
+    rand_state = rand_state * 1103515245 + 12345;
+
+    return (rand_state >> 16) % max;
+}
+
+static void add_notification(uint32_t id)
+{
+    ble_comm_notify_t not;
+    const char *src = bench_sources[bench_rand(ARRAY_SIZE(bench_sources))];
+
+    not.id = id;
+    not.src = (char *)src;
+    not.src_len = strlen(src);
+    not.title = bench_text;
+    not.title_len = bench_rand(ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN);
+    not.sender = bench_text;
+    not.sender_len = bench_rand(ZSW_NOTIFICATION_MGR_MAX_FIELD_LEN);
+    not.subject = bench_text;
+    not.subject_len = 0;
+    not.body = bench_text;
+    // Mostly short messages with some long ones that are truncated.
+    not.body_len = bench_rand(4) == 0 ? sizeof(bench_text) : bench_rand(CONFIG_ZSW_NOTIFICATION_MGR_MAX_BODY_LEN / 2);
+
+    zsw_notification_manager_add(&not, NULL);
+}
+
+static int notification_bench(void)
+{
+    int64_t start_us;
+    uint32_t num_stored;
+
+    if (bench_count == 0) {
+        return ZSW_BENCH_NOT_RUN;
+    }
+
+    for (int i = 0; i < sizeof(bench_text); i++) {
+        bench_text[i] = 'a' + i % 26;
+    }
+
+    // Fills the store, after that every add removes the oldest notifications.
+    start_us = zsw_bench_time_us();
+    for (uint32_t i = 1; i <= bench_count; i++) {
+        add_notification(i);
+    }
+    zsw_bench_print_result("Add", bench_count, zsw_bench_time_us() - start_us);
+    num_stored = zsw_notification_manager_get_num();
+
+    // Empty the store before the next run.
+    for (uint32_t i = bench_count - num_stored + 1; i <= bench_count; i++) {
+        zsw_notification_manager_remove(i);
+    }
+
+    // Every other notification is removed after the next is added, which leaves holes in the arena
+    // until the notifications before them are removed.
+    start_us = zsw_bench_time_us();
+    for (uint32_t i = 1; i <= bench_count; i++) {
+        add_notification(bench_count + i);
+        if (i % 2 == 0) {
+            zsw_notification_manager_remove(bench_count + i - 1);
+        }
+    }
+    zsw_bench_print_result("Add and remove", bench_count + bench_count / 2, zsw_bench_time_us() - start_us);
+
+    printk("Stored when full: %d of max %d, %d bytes per notification in a %d byte arena\n", num_stored,
+           ZSW_NOTIFICATION_MGR_MAX_STORED, CONFIG_ZSW_NOTIFICATION_MGR_ARENA_SIZE / MAX(num_stored, 1),
+           CONFIG_ZSW_NOTIFICATION_MGR_ARENA_SIZE);
+
+    return 0;
+}
+
+// Started after main has initialized the notification manager.
+ZSW_BENCH_DEFINE(notification_bench, 2048, bench_options, notification_bench);
@@ -19,30 +19,59 @@
  * @see https://github.com/xioTechnologies/Fusion
  */
 
+#include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/zbus/zbus.h>
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif
 
 #include "../ext_drivers/fusion/Fusion/Fusion.h"
 #include "../ext_drivers/fusion/Fusion/FusionCompass.h"
 
 #include "sensor_fusion/zsw_sensor_fusion.h"
+#include "sensor_fusion/zsw_sensor_fusion_replay.h"
 #include "../sensors/zsw_imu.h"
 #include "../sensors/zsw_magnetometer.h"
 #include "../ble/zsw_gatt_sensor_server.h"
 #include <string.h>
+#include <stdlib.h>
 
 #ifdef CONFIG_SEND_SENSOR_READING_OVER_RTT
 #include <SEGGER_RTT.h>
 #endif
 
-#define SAMPLE_RATE_HZ  100
-#define SENSOR_GF       9.806650
+#define SAMPLE_RATE_HZ      CONFIG_ZSW_SENSOR_FUSION_RATE_HZ
+#define SAMPLE_PERIOD_US    (1000000 / SAMPLE_RATE_HZ)
+#define SENSOR_GF           9.806650
+
+BUILD_ASSERT(SAMPLE_RATE_HZ == 50 || SAMPLE_RATE_HZ == 100 || SAMPLE_RATE_HZ == 200 || SAMPLE_RATE_HZ == 400,
+             "The IMU only supports 25 Hz times a power of two");
 
 LOG_MODULE_REGISTER(sf, CONFIG_ZSW_SENSORS_FUSION_LOG_LEVEL);
 
-static void sensor_fusion_timeout(struct k_work *item);
-K_WORK_DELAYABLE_DEFINE(sensor_fusion_timer, sensor_fusion_timeout);
+typedef struct fusion_sample {
+    FusionVector accelerometer;
+    FusionVector gyroscope;
+    FusionVector magnetometer;
+    int64_t timestamp_us;
+} fusion_sample_t;
+
+static void sensor_fusion_thread(void *arg1, void *arg2, void *arg3);
+
+K_MSGQ_DEFINE(sample_queue, sizeof(fusion_sample_t), CONFIG_ZSW_SENSOR_FUSION_QUEUE_SIZE, 8);
+K_THREAD_DEFINE(sensor_fusion_tid, CONFIG_ZSW_SENSOR_FUSION_THREAD_STACK_SIZE, sensor_fusion_thread, NULL, NULL, NULL,
+                CONFIG_ZSW_SENSOR_FUSION_THREAD_PRIORITY, 0, 0);
+static K_MUTEX_DEFINE(fusion_mutex);
 
+#ifndef CONFIG_ZSW_IMU_BATCHING
+static void sensor_fusion_poll(struct k_work *item);
+static void sensor_fusion_timer_expiry(struct k_timer *timer);
+K_WORK_DEFINE(sensor_fusion_poll_work, sensor_fusion_poll);
+K_TIMER_DEFINE(sensor_fusion_timer, sensor_fusion_timer_expiry, NULL);
+#endif
+
+#ifdef CONFIG_ZSW_SENSOR_FUSION_CALIBRATION
 // Define calibration (replace with actual calibration data if available)
 static const FusionMatrix gyroscopeMisalignment = {.element.xx = 1.0f,
                                                    .element.xy = 0.0f,
@@ -79,74 +108,93 @@ static const FusionMatrix softIronMatrix = {.element.xx = 1.0f,
                                             .element.zz = 1.0f
                                            };
 static const FusionVector hardIronOffset = {{0.0f, 0.0f, 0.0f}};
+#endif
 
 // Initialise algorithms
 static FusionOffset offset;
 static FusionAhrs ahrs;
-static int32_t previousTimestamp;
 static sensor_fusion_t readings;
-static struct k_work_sync cancel_work_sync;
+static sensor_fusion_stats_t stats;
+static uint64_t latency_sum_us;
+static uint64_t jitter_sum_us;
+static int64_t last_timestamp_us;
 
-#ifdef CONFIG_SEND_SENSOR_READING_OVER_RTT
 #define UP_BUFFER_SIZE 256
+#ifdef CONFIG_SEND_SENSOR_READING_OVER_RTT
 static uint8_t up_buffer[UP_BUFFER_SIZE];
 #endif
+#ifdef CONFIG_ZSW_SENSOR_FUSION_REPLAY
+// Latency and update time has no meaning when replaying in simulated time.
+static bool replaying;
+static uint32_t replay_fed;
+#endif
 
-static void sensor_fusion_timeout(struct k_work *)
+static void queue_sample(fusion_sample_t *sample)
 {
-    int ret = 0;
+    if (k_msgq_put(&sample_queue, sample, K_NO_WAIT) != 0) {
+        k_mutex_lock(&fusion_mutex, K_FOREVER);
+        stats.dropped++;
+        k_mutex_unlock(&fusion_mutex);
+    }
+}
 
-    FusionVector gyroscope;
-    FusionVector accelerometer;
-    FusionVector magnetometer;
+#ifdef CONFIG_ZSW_IMU_BATCHING
+static void sensor_fusion_batch_callback(const zsw_imu_batch_t *batch)
+{
+    int ret;
+    fusion_sample_t sample;
 
-    uint32_t start = k_uptime_get_32();
-    ret = zsw_imu_fetch_gyro_f(&gyroscope.axis.x, &gyroscope.axis.y, &gyroscope.axis.z);
+    // The magnetometer is slower than the IMU, one reading per batch is enough.
+    ret = zsw_magnetometer_get_all(&sample.magnetometer.axis.x, &sample.magnetometer.axis.y,
+                                   &sample.magnetometer.axis.z);
     if (ret != 0) {
-        LOG_ERR("zsw_imu_fetch_gyro_f err: %d", ret);
+        LOG_ERR("zsw_magnetometer_get_all err: %d", ret);
     }
-    // Convert from rad/s to deg/s
-    gyroscope.axis.x = gyroscope.axis.x * (180.0F / M_PI);
-    gyroscope.axis.y = gyroscope.axis.y * (180.0F / M_PI);
-    gyroscope.axis.z = gyroscope.axis.z * (180.0F / M_PI);
 
-    ret = zsw_imu_fetch_accel_f(&accelerometer.axis.x, &accelerometer.axis.y, &accelerometer.axis.z);
-    if (ret != 0) {
-        LOG_ERR("zsw_imu_fetch_gyro_f err: %d", ret);
+    for (int i = 0; i < batch->num_samples; i++) {
+        memcpy(sample.accelerometer.array, batch->samples[i].acc, sizeof(sample.accelerometer.array));
+        memcpy(sample.gyroscope.array, batch->samples[i].gyr, sizeof(sample.gyroscope.array));
+        sample.timestamp_us = batch->timestamp_us + (int64_t)i * batch->period_us;
+        queue_sample(&sample);
     }
-    // IMU driver converts to m/s2 by multiplying to 10, convert back to g-force
-    accelerometer.axis.x /= SENSOR_GF;
-    accelerometer.axis.y /= SENSOR_GF;
-    accelerometer.axis.z /= SENSOR_GF;
+}
+#else
+static void sensor_fusion_timer_expiry(struct k_timer *timer)
+{
+    k_work_submit(&sensor_fusion_poll_work);
+}
 
-    ret = zsw_magnetometer_get_all(&magnetometer.axis.x, &magnetometer.axis.y, &magnetometer.axis.z);
-    if (ret != 0) {
-        LOG_ERR("zsw_imu_fetch_gyro_f err: %d", ret);
-    }
+static void sensor_fusion_poll(struct k_work *item)
+{
+    int ret;
+    zsw_imu_data_all_t imu;
+    fusion_sample_t sample;
 
-    // Apply calibration
-    gyroscope = FusionCalibrationInertial(gyroscope, gyroscopeMisalignment, gyroscopeSensitivity, gyroscopeOffset);
-    accelerometer = FusionCalibrationInertial(accelerometer, accelerometerMisalignment, accelerometerSensitivity,
-                                              accelerometerOffset);
-    magnetometer = FusionCalibrationMagnetic(magnetometer, softIronMatrix, hardIronOffset);
+    sample.timestamp_us = k_ticks_to_us_floor64(k_uptime_ticks());
 
-    // Update gyroscope offset correction algorithm
-    gyroscope = FusionOffsetUpdate(&offset, gyroscope);
+    ret = zsw_imu_fetch_all(&imu, false);
+    if (ret != 0) {
+        LOG_ERR("zsw_imu_fetch_all err: %d", ret);
+        return;
+    }
+    sample.gyroscope = (FusionVector) {{imu.gyro.x, imu.gyro.y, imu.gyro.z}};
+    sample.accelerometer = (FusionVector) {{imu.accel.x, imu.accel.y, imu.accel.z}};
 
-    // Calculate delta time (in seconds) to account for gyroscope sample clock error
-    const float deltaTime = (start - previousTimestamp) / 1000.0f;
-    previousTimestamp = start;
+    ret = zsw_magnetometer_get_all(&sample.magnetometer.axis.x, &sample.magnetometer.axis.y,
+                                   &sample.magnetometer.axis.z);
+    if (ret != 0) {
+        LOG_ERR("zsw_magnetometer_get_all err: %d", ret);
+    }
 
-    // Update gyroscope AHRS algorithm
-#ifdef CONFIG_SENSOR_FUSION_INCLUDE_MAGNETOMETER
-    FusionAhrsUpdate(&ahrs, gyroscope, accelerometer, magnetometer, deltaTime);
-#else
-    FusionAhrsUpdateNoMagnetometer(&ahrs, gyroscope, accelerometer, deltaTime);
+    queue_sample(&sample);
+}
 #endif
-    // Print algorithm outputs
+
+static void sensor_fusion_output(FusionVector gyroscope, FusionVector accelerometer, FusionVector magnetometer,
+                                 int64_t timestamp_us)
+{
     const FusionEuler euler = FusionQuaternionToEuler(FusionAhrsGetQuaternion(&ahrs));
     const FusionVector earth = FusionAhrsGetEarthAcceleration(&ahrs);
-    float heading = FusionCompassCalculateHeading(FusionConventionNwu, accelerometer, magnetometer);
 
     readings.pitch = euler.angle.pitch;
     readings.roll = euler.angle.roll;
@@ -157,34 +205,145 @@ static void sensor_fusion_timeout(struct k_work *)
 
     LOG_DBG("Roll %0.1f, Pitch %0.1f, Yaw %0.1f, Head: %01f, X %0.2f, Y %0.2f, Z %0.1f, X %0.1f, Y %0.1f, Z %0.1f, X %0.1f, Y %0.1f, Z %0.1f\n",
             euler.angle.roll, euler.angle.pitch,
-            euler.angle.yaw, heading, /*earth.axis.x, earth.axis.y, earth.axis.z*/ accelerometer.axis.x, accelerometer.axis.y,
+            euler.angle.yaw, FusionCompassCalculateHeading(FusionConventionNwu, accelerometer, magnetometer),
+            /*earth.axis.x, earth.axis.y, earth.axis.z*/ accelerometer.axis.x, accelerometer.axis.y,
             accelerometer.axis.z, gyroscope.axis.x, gyroscope.axis.y, gyroscope.axis.z, magnetometer.axis.x, magnetometer.axis.y,
             magnetometer.axis.z );
-#if CONFIG_SEND_SENSOR_READING_OVER_RTT
+#if defined(CONFIG_SEND_SENSOR_READING_OVER_RTT) || defined(CONFIG_ZSW_SENSOR_FUSION_REPLAY)
     uint8_t data_buf[UP_BUFFER_SIZE];
     int len = snprintf(data_buf, UP_BUFFER_SIZE,
-                       "%0.5f, %0.1f, %0.1f, %0.1f, %0.5f, %0.5f, %0.5f, %0.5f, %0.5f, %0.5f, %0.5f, %0.5f, %0.5f\n",
-                       k_uptime_get_32() / 1000.0, euler.angle.roll, euler.angle.pitch,
+                       "%0.6f, %0.1f, %0.1f, %0.1f, %0.5f, %0.5f, %0.5f, %0.5f, %0.5f, %0.5f, %0.5f, %0.5f, %0.5f\n",
+                       timestamp_us / 1000000.0, euler.angle.roll, euler.angle.pitch,
                        euler.angle.yaw, gyroscope.axis.x,
                        gyroscope.axis.y, gyroscope.axis.z,  accelerometer.axis.x, accelerometer.axis.y, accelerometer.axis.z,
                        magnetometer.axis.x, magnetometer.axis.y, magnetometer.axis.z);
+#ifdef CONFIG_SEND_SENSOR_READING_OVER_RTT
     len = SEGGER_RTT_Write(CONFIG_SENSOR_LOG_RTT_TRANSFER_CHANNEL, data_buf, len);
 #endif
+#ifdef CONFIG_ZSW_SENSOR_FUSION_REPLAY
+    if (replaying) {
+        zsw_sensor_fusion_replay_output(data_buf, len);
+    }
+#endif
+#endif
+}
 
-    k_work_schedule(&sensor_fusion_timer, K_MSEC((1000 / SAMPLE_RATE_HZ) - (k_uptime_get_32() - start)));
+static bool sensor_fusion_output_every_sample(void)
+{
+#if defined(CONFIG_SEND_SENSOR_READING_OVER_RTT)
+    return true;
+#elif defined(CONFIG_ZSW_SENSOR_FUSION_REPLAY)
+    return replaying && zsw_sensor_fusion_replay_has_output();
+#else
+    return false;
+#endif
 }
 
-void zsw_sensor_fusion_init(void)
+static void sensor_fusion_update(FusionVector gyroscope, FusionVector accelerometer, FusionVector magnetometer,
+                                 float deltaTime, int64_t timestamp_us, bool output)
 {
-#if CONFIG_SEND_SENSOR_READING_OVER_RTT
-    SEGGER_RTT_ConfigUpBuffer(CONFIG_SENSOR_LOG_RTT_TRANSFER_CHANNEL, "FUSION",
-                              up_buffer, UP_BUFFER_SIZE,
-                              SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+    // Convert from rad/s to deg/s
+    gyroscope = FusionVectorMultiplyScalar(gyroscope, 180.0F / M_PI);
+
+    // IMU driver converts to m/s2 by multiplying to 10, convert back to g-force
+    accelerometer = FusionVectorMultiplyScalar(accelerometer, 1.0F / SENSOR_GF);
+
+#ifdef CONFIG_ZSW_SENSOR_FUSION_CALIBRATION
+    // Apply calibration
+    gyroscope = FusionCalibrationInertial(gyroscope, gyroscopeMisalignment, gyroscopeSensitivity, gyroscopeOffset);
+    accelerometer = FusionCalibrationInertial(accelerometer, accelerometerMisalignment, accelerometerSensitivity,
+                                              accelerometerOffset);
+    magnetometer = FusionCalibrationMagnetic(magnetometer, softIronMatrix, hardIronOffset);
 #endif
-    zsw_imu_feature_enable(ZSW_IMU_FEATURE_GYRO, false);
-    zsw_magnetometer_set_enable(true);
 
+    // Update gyroscope offset correction algorithm
+    gyroscope = FusionOffsetUpdate(&offset, gyroscope);
+
+    // Update gyroscope AHRS algorithm
+#ifdef CONFIG_SENSOR_FUSION_INCLUDE_MAGNETOMETER
+    FusionAhrsUpdate(&ahrs, gyroscope, accelerometer, magnetometer, deltaTime);
+#else
+    FusionAhrsUpdateNoMagnetometer(&ahrs, gyroscope, accelerometer, deltaTime);
+#endif
+
+    // The orientation is only read by the apps every now and then, converting it for every
+    // sample costs about as much as the AHRS update itself.
+    if (output || sensor_fusion_output_every_sample()) {
+        sensor_fusion_output(gyroscope, accelerometer, magnetometer, timestamp_us);
+    }
+}
+
+static void sensor_fusion_process(const fusion_sample_t *sample, bool last_in_batch)
+{
+    int64_t delta_us = sample->timestamp_us - last_timestamp_us;
+    uint32_t start = k_cycle_get_32();
+    uint32_t update_us;
+    uint32_t latency_us;
+    uint32_t jitter_us;
+
+    // The first sample, or a gap after samples was lost, has no valid delta.
+    if ((last_timestamp_us == 0) || (delta_us <= 0) || (delta_us > 10 * SAMPLE_PERIOD_US)) {
+        stats.gaps += last_timestamp_us != 0;
+        delta_us = SAMPLE_PERIOD_US;
+    } else {
+        jitter_us = abs((int32_t)delta_us - SAMPLE_PERIOD_US);
+        jitter_sum_us += jitter_us;
+        stats.jitter_max_us = MAX(stats.jitter_max_us, jitter_us);
+    }
+    last_timestamp_us = sample->timestamp_us;
+
+    sensor_fusion_update(sample->gyroscope, sample->accelerometer, sample->magnetometer, delta_us / 1000000.0f,
+                         sample->timestamp_us, last_in_batch);
+
+    stats.updates++;
+#ifdef CONFIG_ZSW_SENSOR_FUSION_REPLAY
+    if (replaying) {
+        return;
+    }
+#endif
+
+    update_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+    latency_us = k_ticks_to_us_floor64(k_uptime_ticks()) - sample->timestamp_us;
+
+    stats.update_max_us = MAX(stats.update_max_us, update_us);
+    stats.latency_max_us = MAX(stats.latency_max_us, latency_us);
+    latency_sum_us += latency_us;
+}
+
+static void sensor_fusion_thread(void *arg1, void *arg2, void *arg3)
+{
+    // Only used by this thread, static to keep the stack small.
+    static fusion_sample_t samples[CONFIG_ZSW_SENSOR_FUSION_BATCH_SIZE];
+    int num_samples;
+
+    while (true) {
+        k_msgq_get(&sample_queue, &samples[0], K_FOREVER);
+
+        // Process everything already queued, like a full IMU FIFO batch, in one go.
+        num_samples = 1;
+        while (num_samples < ARRAY_SIZE(samples) &&
+               k_msgq_get(&sample_queue, &samples[num_samples], K_NO_WAIT) == 0) {
+            num_samples++;
+        }
+
+        k_mutex_lock(&fusion_mutex, K_FOREVER);
+        stats.batches++;
+        for (int i = 0; i < num_samples; i++) {
+            sensor_fusion_process(&samples[i], i == num_samples - 1);
+        }
+        k_mutex_unlock(&fusion_mutex);
+    }
+}
+
+static void sensor_fusion_reset(void)
+{
+    k_mutex_lock(&fusion_mutex, K_FOREVER);
+    k_msgq_purge(&sample_queue);
     memset(&ahrs, 0, sizeof(ahrs));
+    memset(&stats, 0, sizeof(stats));
+    latency_sum_us = 0;
+    jitter_sum_us = 0;
+    last_timestamp_us = 0;
 
     FusionOffsetInitialise(&offset, SAMPLE_RATE_HZ);
     FusionAhrsInitialise(&ahrs);
@@ -201,13 +360,41 @@ void zsw_sensor_fusion_init(void)
     };
 
     FusionAhrsSetSettings(&ahrs, &settings);
+    k_mutex_unlock(&fusion_mutex);
+}
+
+void zsw_sensor_fusion_init(void)
+{
+#if CONFIG_SEND_SENSOR_READING_OVER_RTT
+    SEGGER_RTT_ConfigUpBuffer(CONFIG_SENSOR_LOG_RTT_TRANSFER_CHANNEL, "FUSION",
+                              up_buffer, UP_BUFFER_SIZE,
+                              SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+#endif
+    zsw_imu_feature_enable(ZSW_IMU_FEATURE_GYRO, false);
+    zsw_magnetometer_set_enable(true);
+    zsw_imu_request_sample_rate(SAMPLE_RATE_HZ);
 
-    k_work_schedule(&sensor_fusion_timer, K_MSEC(1000 / SAMPLE_RATE_HZ));
+    sensor_fusion_reset();
+
+#ifdef CONFIG_ZSW_IMU_BATCHING
+    zsw_imu_batch_subscribe(sensor_fusion_batch_callback);
+#else
+    k_timer_start(&sensor_fusion_timer, K_USEC(SAMPLE_PERIOD_US), K_USEC(SAMPLE_PERIOD_US));
+#endif
 }
 
 void zsw_sensor_fusion_deinit(void)
 {
-    k_work_cancel_delayable_sync(&sensor_fusion_timer, &cancel_work_sync);
+#ifdef CONFIG_ZSW_IMU_BATCHING
+    // Waits for an ongoing batch to be queued.
+    zsw_imu_batch_unsubscribe(sensor_fusion_batch_callback);
+#else
+    struct k_work_sync sync;
+
+    k_timer_stop(&sensor_fusion_timer);
+    k_work_cancel_sync(&sensor_fusion_poll_work, &sync);
+#endif
+    zsw_imu_release_sample_rate(SAMPLE_RATE_HZ);
     zsw_imu_feature_disable(ZSW_IMU_FEATURE_GYRO);
     zsw_magnetometer_set_enable(false);
 }
@@ -223,4 +410,82 @@ int zsw_sensor_fusion_get_heading(float *heading)
     // @todo: implement, this is not correct magnetic heading. Use FusionCompassCalculateHeading
     *heading = readings.yaw;
     return 0;
-}
\ No newline at end of file
+}
+
+void zsw_sensor_fusion_get_stats(sensor_fusion_stats_t *p_stats)
+{
+    uint32_t num_deltas;
+
+    k_mutex_lock(&fusion_mutex, K_FOREVER);
+    memcpy(p_stats, &stats, sizeof(stats));
+    num_deltas = stats.updates - stats.gaps - (stats.updates > 0);
+    p_stats->latency_avg_us = stats.updates > 0 ? latency_sum_us / stats.updates : 0;
+    p_stats->jitter_avg_us = num_deltas > 0 ? jitter_sum_us / num_deltas : 0;
+    k_mutex_unlock(&fusion_mutex);
+}
+
+#ifdef CONFIG_ZSW_SENSOR_FUSION_REPLAY
+void zsw_sensor_fusion_replay_begin(void)
+{
+    sensor_fusion_reset();
+    replay_fed = 0;
+    replaying = true;
+}
+
+void zsw_sensor_fusion_replay_feed(const float accel[3], const float gyro[3], const float magn[3],
+                                   int64_t timestamp_us)
+{
+    fusion_sample_t sample;
+
+    memcpy(sample.accelerometer.array, accel, sizeof(sample.accelerometer.array));
+    memcpy(sample.gyroscope.array, gyro, sizeof(sample.gyroscope.array));
+    memcpy(sample.magnetometer.array, magn, sizeof(sample.magnetometer.array));
+    sample.timestamp_us = timestamp_us;
+
+    // Block instead of dropping, the replay runs as fast as the fusion thread can process.
+    k_msgq_put(&sample_queue, &sample, K_FOREVER);
+    replay_fed++;
+}
+
+void zsw_sensor_fusion_replay_end(void)
+{
+    bool done = false;
+
+    // Wait for the fusion thread to process everything fed.
+    while (!done) {
+        k_mutex_lock(&fusion_mutex, K_FOREVER);
+        done = stats.updates == replay_fed;
+        if (done) {
+            replaying = false;
+        }
+        k_mutex_unlock(&fusion_mutex);
+        if (!done) {
+            k_sleep(K_MSEC(1));
+        }
+    }
+}
+#endif
+
+#ifdef CONFIG_SHELL
+static int cmd_fusion_stats(const struct shell *sh, size_t argc, char **argv)
+{
+    sensor_fusion_stats_t fusion_stats;
+
+    zsw_sensor_fusion_get_stats(&fusion_stats);
+
+    shell_print(sh, "Rate: %d Hz, updates: %d, batches: %d, dropped: %d, gaps: %d", SAMPLE_RATE_HZ,
+                fusion_stats.updates, fusion_stats.batches, fusion_stats.dropped, fusion_stats.gaps);
+    shell_print(sh, "Latency avg: %d us, max: %d us", fusion_stats.latency_avg_us, fusion_stats.latency_max_us);
+    shell_print(sh, "Delta time jitter avg: %d us, max: %d us", fusion_stats.jitter_avg_us,
+                fusion_stats.jitter_max_us);
+    shell_print(sh, "Update time max: %d us", fusion_stats.update_max_us);
+
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(fusion_cmds,
+                               SHELL_CMD(stats, NULL, "Print sensor fusion latency and jitter", cmd_fusion_stats),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(fusion, &fusion_cmds, "Sensor fusion", NULL);
+#endif
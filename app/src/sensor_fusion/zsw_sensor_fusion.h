@@ -9,6 +9,18 @@ typedef struct sensor_fusion {
     float z;
 } sensor_fusion_t;
 
+typedef struct sensor_fusion_stats {
+    uint32_t updates;
+    uint32_t batches;           // Times the fusion thread woke up, each processing one or more samples
+    uint32_t dropped;           // Samples not processed because the queue was full
+    uint32_t gaps;              // Times the time between two samples was not valid, like after lost samples
+    uint32_t latency_avg_us;    // From the sample was taken until the fusion was updated with it
+    uint32_t latency_max_us;
+    uint32_t jitter_avg_us;     // Deviation of the time between two samples from the sample period
+    uint32_t jitter_max_us;
+    uint32_t update_max_us;     // Time spent running the fusion for one sample
+} sensor_fusion_stats_t;
+
 void zsw_sensor_fusion_init(void);
 
 void zsw_sensor_fusion_deinit(void);
@@ -17,3 +29,4 @@ int zsw_sensor_fusion_fetch_all(sensor_fusion_t *p_readings);
 
 int zsw_sensor_fusion_get_heading(float *heading);
 
+void zsw_sensor_fusion_get_stats(sensor_fusion_stats_t *p_stats);
@@ -0,0 +1,164 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Replays a sensor fusion CSV recorded over RTT (see scripts/sensor_fusion_analyze.py) through the
+ * sensor fusion on native_posix. Run with:
+ *   zephyr.exe --fusion-replay=recording.csv --fusion-replay-out=output.csv
+ * The output has the same format as the recording and can be compared with:
+ *   python scripts/sensor_fusion_analyze.py --compare recording.csv output.csv
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "zsw_bench.h"
+#include "sensor_fusion/zsw_sensor_fusion.h"
+#include "sensor_fusion/zsw_sensor_fusion_replay.h"
+
+#define SENSOR_GF           9.806650
+#define REPLAY_NUM_COLUMNS  13
+
+LOG_MODULE_REGISTER(sf_replay, CONFIG_ZSW_SENSORS_FUSION_LOG_LEVEL);
+
+static char *replay_path;
+static char *replay_out_path;
+static FILE *replay_out_file;
+
+static struct args_struct_t replay_options[] = {
+    {
+        .option = "fusion-replay",
+        .name = "path",
+        .type = 's',
+        .dest = (void *) &replay_path,
+        .descript = "Sensor fusion CSV recording to replay through the sensor fusion, exits when done"
+    },
+    {
+        .option = "fusion-replay-out",
+        .name = "path",
+        .type = 's',
+        .dest = (void *) &replay_out_path,
+        .descript = "Write the sensor fusion output from the replay to this CSV file"
+    },
+    ARG_TABLE_ENDMARKER
+};
+
+static bool parse_line(const char *line, float accel[3], float gyro[3], float magn[3], int64_t *timestamp_us)
+{
+    double t;
+    float roll, pitch, yaw;
+
+    // t, roll, pitch, yaw, gyro (deg/s), accel (g), magn
+    if (sscanf(line, "%lf, %f, %f, %f, %f, %f, %f, %f, %f, %f, %f, %f, %f", &t, &roll, &pitch, &yaw,
+               &gyro[0], &gyro[1], &gyro[2], &accel[0], &accel[1], &accel[2],
+               &magn[0], &magn[1], &magn[2]) != REPLAY_NUM_COLUMNS) {
+        return false;
+    }
+
+    // Convert back to the units from the IMU driver, the sensor fusion converts again.
+    for (int i = 0; i < 3; i++) {
+        gyro[i] = gyro[i] * (M_PI / 180.0F);
+        accel[i] = accel[i] * SENSOR_GF;
+    }
+    *timestamp_us = llround(t * 1000000.0);
+
+    return true;
+}
+
+static int sensor_fusion_replay(void)
+{
+    FILE *file;
+    char line[256];
+    float accel[3];
+    float gyro[3];
+    float magn[3];
+    int64_t timestamp_us;
+    int64_t start_us;
+    int64_t elapsed_us;
+    uint32_t num_samples = 0;
+    uint32_t num_skipped = 0;
+    sensor_fusion_stats_t stats;
+
+    if (replay_path == NULL) {
+        return ZSW_BENCH_NOT_RUN;
+    }
+
+    file = fopen(replay_path, "r");
+    if (file == NULL) {
+        LOG_ERR("Failed opening %s", replay_path);
+        return 1;
+    }
+
+    if (replay_out_path != NULL) {
+        replay_out_file = fopen(replay_out_path, "w");
+        if (replay_out_file == NULL) {
+            LOG_ERR("Failed opening %s", replay_out_path);
+            fclose(file);
+            return 1;
+        }
+    }
+
+    zsw_sensor_fusion_replay_begin();
+    start_us = zsw_bench_time_us();
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        // Header lines and lines broken by a lost RTT buffer are skipped.
+        if (!parse_line(line, accel, gyro, magn, &timestamp_us)) {
+            num_skipped++;
+            continue;
+        }
+        zsw_sensor_fusion_replay_feed(accel, gyro, magn, timestamp_us);
+        num_samples++;
+    }
+
+    zsw_sensor_fusion_replay_end();
+    elapsed_us = MAX(zsw_bench_time_us() - start_us, 1);
+
+    fclose(file);
+    if (replay_out_file != NULL) {
+        fclose(replay_out_file);
+        replay_out_file = NULL;
+    }
+
+    zsw_sensor_fusion_get_stats(&stats);
+
+    printk("Replayed %d samples (%d lines skipped) in %lld us, %lld updates/s, %lld us/update\n",
+           num_samples, num_skipped, elapsed_us, (int64_t)num_samples * 1000000 / elapsed_us,
+           elapsed_us / MAX(num_samples, 1));
+    printk("Fusion updates: %d, batches: %d, gaps: %d, delta time jitter avg: %d us, max: %d us\n",
+           stats.updates, stats.batches, stats.gaps, stats.jitter_avg_us, stats.jitter_max_us);
+
+    return 0;
+}
+
+// Runs above the fusion thread and fills the queue, so the fusion processes full batches like with the IMU FIFO.
+ZSW_BENCH_DEFINE_PRIO(sensor_fusion_replay, 2048, CONFIG_ZSW_SENSOR_FUSION_THREAD_PRIORITY - 1, 0, replay_options,
+                      sensor_fusion_replay);
+
+bool zsw_sensor_fusion_replay_has_output(void)
+{
+    return replay_out_file != NULL;
+}
+
+void zsw_sensor_fusion_replay_output(const char *line, int len)
+{
+    if (replay_out_file != NULL) {
+        fwrite(line, 1, len, replay_out_file);
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/** @brief Reset the fusion state for a replay. Sensors are not started.
+*/
+void zsw_sensor_fusion_replay_begin(void);
+
+/** @brief Feed one recorded sample, blocks until there is room in the fusion queue.
+ *  @param accel Acceleration in m/s2, same as from the IMU driver.
+ *  @param gyro Angular rate in rad/s, same as from the IMU driver.
+ *  @param magn Magnetic field in gauss.
+ *  @param timestamp_us Time the sample was taken.
+*/
+void zsw_sensor_fusion_replay_feed(const float accel[3], const float gyro[3], const float magn[3],
+                                   int64_t timestamp_us);
+
+/** @brief Wait for all fed samples to be processed and stop writing replay output.
+*/
+void zsw_sensor_fusion_replay_end(void);
+
+/** @brief Check if the replay output is written to a file.
+ *  @return true if the fusion must output every sample, false if only the last of every batch.
+*/
+bool zsw_sensor_fusion_replay_has_output(void);
+
+/** @brief Called by the fusion for every processed sample during a replay.
+ *  @param line One CSV line in the same format as sent over RTT.
+ *  @param len Length of line.
+*/
+void zsw_sensor_fusion_replay_output(const char *line, int len);
@@ -15,8 +15,12 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/zbus/zbus.h>
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif
 
 #include "zsw_clock.h"
 
@@ -36,6 +40,54 @@ ZBUS_LISTENER_DEFINE(zsw_imu_lis, zbus_periodic_slow_callback);
 static const struct device *const bmi270 = DEVICE_DT_GET_OR_NULL(DT_NODELABEL(bmi270));
 static struct sensor_trigger bmi270_trigger;
 
+enum sample_value {
+    SAMPLE_ACCEL_X,
+    SAMPLE_ACCEL_Y,
+    SAMPLE_ACCEL_Z,
+    SAMPLE_GYRO_X,
+    SAMPLE_GYRO_Y,
+    SAMPLE_GYRO_Z,
+    SAMPLE_TEMP,
+    SAMPLE_NUM_VALUES,
+};
+
+static struct {
+    struct sensor_value values[SAMPLE_NUM_VALUES];
+    uint32_t epoch;
+    bool has_temperature;
+    bool valid;
+} sample_cache;
+static K_MUTEX_DEFINE(sample_cache_mutex);
+static zsw_imu_fetch_stats_t fetch_stats;
+
+#define DEFAULT_SAMPLE_RATE_ODR BOSCH_BMI270_ACC_ODR_100_HZ
+#define NUM_SAMPLE_RATES        (BOSCH_BMI270_ACC_ODR_1600_HZ - BOSCH_BMI270_ACC_ODR_25_HZ + 1)
+
+// Several users can need the gyroscope and a sample rate at the same time, like sensor fusion and the IMU stream.
+static K_MUTEX_DEFINE(config_mutex);
+static uint8_t sample_rate_requests[NUM_SAMPLE_RATES];
+static uint8_t sample_rate_odr;
+static uint8_t num_gyro_users;
+
+static int apply_sample_rate(void);
+
+#ifdef CONFIG_ZSW_IMU_BATCHING
+#define MAX_BATCH_SUBSCRIBERS   2
+
+static struct sensor_trigger fifo_trigger = {
+    .type = SENSOR_TRIG_FIFO_WATERMARK,
+    .chan = SENSOR_CHAN_FIFO,
+};
+static K_MUTEX_DEFINE(batch_mutex);
+static zsw_imu_batch_cb_t batch_subscribers[MAX_BATCH_SUBSCRIBERS];
+static int num_batch_subscribers;
+static struct bmi270_fifo_frame batch_samples[CONFIG_BMI270_PLUS_FIFO_MAX_FRAMES];
+static zsw_imu_batch_stats_t batch_stats;
+static uint32_t batch_start_ms;
+// Timestamp of the next sample in the FIFO, counted from the number of frames read.
+static int64_t batch_next_us;
+#endif
+
 static void zbus_periodic_slow_callback(const struct zbus_channel *chan)
 {
     zsw_timeval_t time;
@@ -143,117 +195,253 @@ int zsw_imu_init(void)
 
     sensor_trigger_set(bmi270, &bmi270_trigger, bmi270_trigger_handler);
 
+    k_mutex_lock(&config_mutex, K_FOREVER);
+    apply_sample_rate();
+    k_mutex_unlock(&config_mutex);
+
     zsw_periodic_chan_add_obs(&periodic_event_1s_chan, &zsw_imu_lis);
 
     return 0;
 }
 
-int zsw_imu_fetch_accel_f(float *x, float *y, float *z)
+static int fetch_sample(bool with_temperature, bool use_cache)
 {
-    struct sensor_value x_temp;
-    struct sensor_value y_temp;
-    struct sensor_value z_temp;
+    uint32_t epoch;
+    enum sensor_channel channel;
+    struct sensor_value *values = sample_cache.values;
 
     if (!device_is_ready(bmi270)) {
         return -ENODEV;
     }
 
-    if (sensor_sample_fetch_chan(bmi270, SENSOR_CHAN_ALL) != 0) {
+    // Consumers asking within the same epoch get the sample read by the first one.
+    epoch = k_uptime_get() / MAX(CONFIG_ZSW_IMU_SAMPLE_CACHE_MS, 1);
+    if (use_cache && (CONFIG_ZSW_IMU_SAMPLE_CACHE_MS > 0) && sample_cache.valid && (sample_cache.epoch == epoch) &&
+        (sample_cache.has_temperature || !with_temperature)) {
+        fetch_stats.cache_hits++;
+        return 0;
+    }
+
+    // Accelerometer and gyroscope are read in one burst for any of their channels,
+    // the temperature needs another transaction.
+    channel = with_temperature ? SENSOR_CHAN_ALL : SENSOR_CHAN_ACCEL_XYZ;
+    fetch_stats.fetches++;
+    sample_cache.valid = false;
+
+    if (sensor_sample_fetch_chan(bmi270, channel) != 0) {
+        return -ENODATA;
+    }
+
+    if ((sensor_channel_get(bmi270, SENSOR_CHAN_ACCEL_XYZ, &values[SAMPLE_ACCEL_X]) != 0) ||
+        (sensor_channel_get(bmi270, SENSOR_CHAN_GYRO_XYZ, &values[SAMPLE_GYRO_X]) != 0)) {
         return -ENODATA;
     }
 
-    if ((sensor_channel_get(bmi270, SENSOR_CHAN_ACCEL_X, &x_temp) != 0) ||
-        (sensor_channel_get(bmi270, SENSOR_CHAN_ACCEL_Y, &y_temp) != 0) ||
-        (sensor_channel_get(bmi270, SENSOR_CHAN_ACCEL_Z, &z_temp) != 0)) {
+    if (with_temperature && (sensor_channel_get(bmi270, SENSOR_CHAN_AMBIENT_TEMP, &values[SAMPLE_TEMP]) != 0)) {
         return -ENODATA;
     }
 
-    *x = sensor_value_to_float(&x_temp);
-    *y = sensor_value_to_float(&y_temp);
-    *z = sensor_value_to_float(&z_temp);
+    sample_cache.epoch = epoch;
+    sample_cache.has_temperature = with_temperature;
+    sample_cache.valid = true;
 
     return 0;
 }
 
+int zsw_imu_fetch_all(zsw_imu_data_all_t *data, bool with_temperature)
+{
+    int ret;
+    struct sensor_value *values = sample_cache.values;
+
+    k_mutex_lock(&sample_cache_mutex, K_FOREVER);
+    // Sensor fusion polls faster than the cache period at 200 and 400 Hz, so always read a new sample.
+    // It still refreshes the cache for the other consumers.
+    ret = fetch_sample(with_temperature, false);
+    if (ret == 0) {
+        data->accel.x = sensor_value_to_float(&values[SAMPLE_ACCEL_X]);
+        data->accel.y = sensor_value_to_float(&values[SAMPLE_ACCEL_Y]);
+        data->accel.z = sensor_value_to_float(&values[SAMPLE_ACCEL_Z]);
+        data->gyro.x = sensor_value_to_float(&values[SAMPLE_GYRO_X]);
+        data->gyro.y = sensor_value_to_float(&values[SAMPLE_GYRO_Y]);
+        data->gyro.z = sensor_value_to_float(&values[SAMPLE_GYRO_Z]);
+        data->temperature = with_temperature ? sensor_value_to_float(&values[SAMPLE_TEMP]) : 0;
+        data->epoch = sample_cache.epoch;
+    }
+    k_mutex_unlock(&sample_cache_mutex);
+
+    return ret;
+}
+
+static int fetch_xyz_f(int first, float *x, float *y, float *z)
+{
+    int ret;
+    struct sensor_value *values = sample_cache.values;
+
+    k_mutex_lock(&sample_cache_mutex, K_FOREVER);
+    ret = fetch_sample(false, true);
+    if (ret == 0) {
+        *x = sensor_value_to_float(&values[first]);
+        *y = sensor_value_to_float(&values[first + 1]);
+        *z = sensor_value_to_float(&values[first + 2]);
+    }
+    k_mutex_unlock(&sample_cache_mutex);
+
+    return ret;
+}
+
+static int fetch_xyz(int first, int16_t *x, int16_t *y, int16_t *z)
+{
+    int ret;
+    struct sensor_value *values = sample_cache.values;
+
+    k_mutex_lock(&sample_cache_mutex, K_FOREVER);
+    ret = fetch_sample(false, true);
+    if (ret == 0) {
+        *x = values[first].val1;
+        *y = values[first + 1].val1;
+        *z = values[first + 2].val1;
+    }
+    k_mutex_unlock(&sample_cache_mutex);
+
+    return ret;
+}
+
+int zsw_imu_fetch_accel_f(float *x, float *y, float *z)
+{
+    return fetch_xyz_f(SAMPLE_ACCEL_X, x, y, z);
+}
+
 int zsw_imu_fetch_gyro_f(float *x, float *y, float *z)
 {
-    struct sensor_value x_temp;
-    struct sensor_value y_temp;
-    struct sensor_value z_temp;
+    return fetch_xyz_f(SAMPLE_GYRO_X, x, y, z);
+}
 
-    if (!device_is_ready(bmi270)) {
-        return -ENODEV;
+int zsw_imu_fetch_accel(int16_t *x, int16_t *y, int16_t *z)
+{
+    return fetch_xyz(SAMPLE_ACCEL_X, x, y, z);
+}
+
+int zsw_imu_fetch_gyro(int16_t *x, int16_t *y, int16_t *z)
+{
+    return fetch_xyz(SAMPLE_GYRO_X, x, y, z);
+}
+
+void zsw_imu_get_fetch_stats(zsw_imu_fetch_stats_t *stats)
+{
+    k_mutex_lock(&sample_cache_mutex, K_FOREVER);
+    memcpy(stats, &fetch_stats, sizeof(fetch_stats));
+    k_mutex_unlock(&sample_cache_mutex);
+}
+
+static int rate_to_odr(uint16_t rate_hz)
+{
+    int odr = BOSCH_BMI270_ACC_ODR_25_HZ;
+
+    // Every ODR step doubles the rate.
+    for (uint32_t hz = 25; hz < rate_hz; hz *= 2) {
+        odr++;
     }
 
-    if (sensor_sample_fetch_chan(bmi270, SENSOR_CHAN_ALL) != 0) {
-        return -ENODATA;
+    if ((odr > BOSCH_BMI270_ACC_ODR_1600_HZ) || ((25 << (odr - BOSCH_BMI270_ACC_ODR_25_HZ)) != rate_hz)) {
+        return -EINVAL;
     }
 
-    if ((sensor_channel_get(bmi270, SENSOR_CHAN_GYRO_X, &x_temp) != 0) ||
-        (sensor_channel_get(bmi270, SENSOR_CHAN_GYRO_Y, &y_temp) != 0) ||
-        (sensor_channel_get(bmi270, SENSOR_CHAN_GYRO_Z, &z_temp) != 0)) {
-        return -ENODATA;
+    return odr;
+}
+
+// Called with config_mutex locked.
+static int apply_sample_rate(void)
+{
+    int ret = 0;
+    struct sensor_value odr = {
+        .val1 = DEFAULT_SAMPLE_RATE_ODR,
+    };
+
+    // The highest rate requested is used, users get their sample period with the samples.
+    for (int i = NUM_SAMPLE_RATES - 1; i >= 0; i--) {
+        if (sample_rate_requests[i] > 0) {
+            odr.val1 = BOSCH_BMI270_ACC_ODR_25_HZ + i;
+            break;
+        }
     }
 
-    *x = sensor_value_to_float(&x_temp);
-    *y = sensor_value_to_float(&y_temp);
-    *z = sensor_value_to_float(&z_temp);
+    if (odr.val1 == sample_rate_odr) {
+        return 0;
+    }
 
-    return 0;
+    // The gyroscope runs at the same rate, the driver only copies the accelerometer rate to it when the FIFO is
+    // configured. So the FIFO is configured again below when batching.
+    if ((sensor_attr_set(bmi270, SENSOR_CHAN_ACCEL_XYZ, SENSOR_ATTR_SAMPLING_FREQUENCY, &odr) != 0) ||
+        (sensor_attr_set(bmi270, SENSOR_CHAN_GYRO_XYZ, SENSOR_ATTR_SAMPLING_FREQUENCY, &odr) != 0)) {
+        LOG_ERR("Failed setting IMU rate %d Hz", 25 << (odr.val1 - BOSCH_BMI270_ACC_ODR_25_HZ));
+        return -EFAULT;
+    }
+    sample_rate_odr = odr.val1;
+
+#ifdef CONFIG_ZSW_IMU_BATCHING
+    k_mutex_lock(&batch_mutex, K_FOREVER);
+    if (num_batch_subscribers > 0) {
+        struct sensor_value watermark = {
+            .val1 = CONFIG_ZSW_IMU_BATCH_WATERMARK,
+        };
+
+        ret = sensor_attr_set(bmi270, SENSOR_CHAN_FIFO, SENSOR_ATTR_CONFIGURATION, &watermark);
+        // The FIFO is flushed, sync the timestamps to the MCU clock again.
+        batch_next_us = 0;
+    }
+    k_mutex_unlock(&batch_mutex);
+#endif
+
+    return ret;
 }
 
-int zsw_imu_fetch_accel(int16_t *x, int16_t *y, int16_t *z)
+int zsw_imu_request_sample_rate(uint16_t rate_hz)
 {
-    struct sensor_value x_temp;
-    struct sensor_value y_temp;
-    struct sensor_value z_temp;
+    int ret;
+    int odr = rate_to_odr(rate_hz);
 
     if (!device_is_ready(bmi270)) {
         return -ENODEV;
     }
 
-    if (sensor_sample_fetch_chan(bmi270, SENSOR_CHAN_ALL) != 0) {
-        return -ENODATA;
+    if (odr < 0) {
+        return odr;
     }
 
-    if ((sensor_channel_get(bmi270, SENSOR_CHAN_ACCEL_X, &x_temp) != 0) ||
-        (sensor_channel_get(bmi270, SENSOR_CHAN_ACCEL_Y, &y_temp) != 0) ||
-        (sensor_channel_get(bmi270, SENSOR_CHAN_ACCEL_Z, &z_temp) != 0)) {
-        return -ENODATA;
+    k_mutex_lock(&config_mutex, K_FOREVER);
+    sample_rate_requests[odr - BOSCH_BMI270_ACC_ODR_25_HZ]++;
+    ret = apply_sample_rate();
+    if (ret != 0) {
+        sample_rate_requests[odr - BOSCH_BMI270_ACC_ODR_25_HZ]--;
     }
+    k_mutex_unlock(&config_mutex);
 
-    *x = x_temp.val1;
-    *y = y_temp.val1;
-    *z = z_temp.val1;
-
-    return 0;
+    return ret;
 }
 
-int zsw_imu_fetch_gyro(int16_t *x, int16_t *y, int16_t *z)
+int zsw_imu_release_sample_rate(uint16_t rate_hz)
 {
-    struct sensor_value x_temp;
-    struct sensor_value y_temp;
-    struct sensor_value z_temp;
+    int ret;
+    int odr = rate_to_odr(rate_hz);
 
     if (!device_is_ready(bmi270)) {
         return -ENODEV;
     }
 
-    if (sensor_sample_fetch_chan(bmi270, SENSOR_CHAN_ALL) != 0) {
-        return -ENODATA;
+    if (odr < 0) {
+        return odr;
     }
 
-    if ((sensor_channel_get(bmi270, SENSOR_CHAN_GYRO_X, &x_temp) != 0) ||
-        (sensor_channel_get(bmi270, SENSOR_CHAN_GYRO_Y, &y_temp) != 0) ||
-        (sensor_channel_get(bmi270, SENSOR_CHAN_GYRO_Z, &z_temp) != 0)) {
-        return -ENODATA;
+    k_mutex_lock(&config_mutex, K_FOREVER);
+    if (sample_rate_requests[odr - BOSCH_BMI270_ACC_ODR_25_HZ] == 0) {
+        ret = -EALREADY;
+    } else {
+        sample_rate_requests[odr - BOSCH_BMI270_ACC_ODR_25_HZ]--;
+        ret = apply_sample_rate();
     }
+    k_mutex_unlock(&config_mutex);
 
-    *x = x_temp.val1;
-    *y = y_temp.val1;
-    *z = z_temp.val1;
-
-    return 0;
+    return ret;
 }
 
 int zsw_imu_fetch_num_steps(uint32_t *num_steps)
@@ -279,23 +467,16 @@ int zsw_imu_fetch_num_steps(uint32_t *num_steps)
 
 int zsw_imu_fetch_temperature(float *temperature)
 {
-    struct sensor_value sensor_val;
-
-    if (!device_is_ready(bmi270)) {
-        return -ENODEV;
-    }
-
-    if (sensor_sample_fetch_chan(bmi270, SENSOR_CHAN_AMBIENT_TEMP) != 0) {
-        return -ENODATA;
-    }
+    int ret;
 
-    if (sensor_channel_get(bmi270, SENSOR_CHAN_AMBIENT_TEMP, &sensor_val) != 0) {
-        return -ENODATA;
+    k_mutex_lock(&sample_cache_mutex, K_FOREVER);
+    ret = fetch_sample(true, true);
+    if (ret == 0) {
+        *temperature = sensor_value_to_float(&sample_cache.values[SAMPLE_TEMP]);
     }
+    k_mutex_unlock(&sample_cache_mutex);
 
-    *temperature = sensor_value_to_float(&sensor_val);
-
-    return 0;
+    return ret;
 }
 
 int zsw_imu_reset_step_count(void)
@@ -316,16 +497,12 @@ int zsw_imu_reset_step_count(void)
     return 0;
 }
 
-int zsw_imu_feature_disable(zsw_imu_feature_t feature)
+static int set_feature(zsw_imu_feature_t feature, bool enable, bool int_en)
 {
     struct sensor_value value;
 
-    if (!device_is_ready(bmi270)) {
-        return -ENODEV;
-    }
-
     value.val1 = feature;
-    value.val2 = BOSCH_BMI270_FEAT_DISABLE;
+    value.val2 = enable ? ((int_en << 1) | BOSCH_BMI270_FEAT_ENABLE) : BOSCH_BMI270_FEAT_DISABLE;
 
     if (sensor_attr_set(bmi270, SENSOR_CHAN_FEATURE, SENSOR_ATTR_CONFIGURATION, &value) != 0) {
         return -EFAULT;
@@ -334,20 +511,246 @@ int zsw_imu_feature_disable(zsw_imu_feature_t feature)
     return 0;
 }
 
+int zsw_imu_feature_disable(zsw_imu_feature_t feature)
+{
+    int ret = 0;
+
+    if (!device_is_ready(bmi270)) {
+        return -ENODEV;
+    }
+
+    if (feature != ZSW_IMU_FEATURE_GYRO) {
+        return set_feature(feature, false, false);
+    }
+
+    // The gyroscope is only turned off when the last user disables it.
+    k_mutex_lock(&config_mutex, K_FOREVER);
+    if (num_gyro_users == 0) {
+        ret = -EALREADY;
+    } else if (num_gyro_users == 1) {
+        ret = set_feature(feature, false, false);
+    }
+    if (ret == 0) {
+        num_gyro_users--;
+    }
+    k_mutex_unlock(&config_mutex);
+
+    return ret;
+}
+
 int zsw_imu_feature_enable(zsw_imu_feature_t feature, bool int_en)
 {
-    struct sensor_value value;
+    int ret = 0;
 
     if (!device_is_ready(bmi270)) {
         return -ENODEV;
     }
 
-    value.val1 = feature;
-    value.val2 = (int_en << 1) | BOSCH_BMI270_FEAT_ENABLE;
+    if (feature != ZSW_IMU_FEATURE_GYRO) {
+        return set_feature(feature, true, int_en);
+    }
 
-    if (sensor_attr_set(bmi270, SENSOR_CHAN_FEATURE, SENSOR_ATTR_CONFIGURATION, &value) != 0) {
-        return -EFAULT;
+    k_mutex_lock(&config_mutex, K_FOREVER);
+    if (num_gyro_users == 0) {
+        ret = set_feature(feature, true, int_en);
     }
+    if (ret == 0) {
+        num_gyro_users++;
+    }
+    k_mutex_unlock(&config_mutex);
+
+    return ret;
+}
+
+#ifdef CONFIG_ZSW_IMU_BATCHING
+static void fifo_watermark_handler(const struct device *dev, const struct sensor_trigger *trig)
+{
+    int ret;
+    uint32_t period_us;
+    zsw_imu_batch_t batch;
+    int64_t now_us = k_ticks_to_us_floor64(k_uptime_ticks());
+
+    k_mutex_lock(&batch_mutex, K_FOREVER);
+    batch_stats.wakeups++;
+
+    ret = bmi270_fifo_read(dev, batch_samples, ARRAY_SIZE(batch_samples), &period_us);
+    if (ret < 0) {
+        LOG_ERR("Failed reading IMU FIFO: %d", ret);
+        batch_stats.errors++;
+        k_mutex_unlock(&batch_mutex);
+        return;
+    }
+
+    batch_stats.samples += ret;
+
+    if (ret > 0) {
+        int64_t newest_us = batch_next_us + (int64_t)(ret - 1) * period_us;
+
+        // Samples are timestamped by counting frames, so there is no jitter from when the FIFO is read.
+        // The newest sample in a fully drained FIFO was taken less than a period before it was read,
+        // otherwise the IMU clock drifted or frames were lost and the count is synced to the MCU clock.
+        if ((batch_next_us == 0) || (newest_us > now_us) ||
+            ((ret < ARRAY_SIZE(batch_samples)) && (newest_us < now_us - 2 * period_us))) {
+            newest_us = now_us;
+            batch_stats.resyncs++;
+        }
+
+        batch.samples = batch_samples;
+        batch.num_samples = ret;
+        batch.period_us = period_us;
+        batch.timestamp_us = newest_us - (int64_t)(ret - 1) * period_us;
+        batch_next_us = newest_us + period_us;
+
+        for (int i = 0; i < num_batch_subscribers; i++) {
+            batch_subscribers[i](&batch);
+        }
+    }
+    k_mutex_unlock(&batch_mutex);
+}
+
+static int set_batching_enabled(bool enable)
+{
+    int ret;
+    struct sensor_value value = {
+        .val1 = enable ? CONFIG_ZSW_IMU_BATCH_WATERMARK : 0,
+    };
+
+    if (enable) {
+        ret = sensor_trigger_set(bmi270, &fifo_trigger, fifo_watermark_handler);
+        if (ret == 0) {
+            ret = sensor_attr_set(bmi270, SENSOR_CHAN_FIFO, SENSOR_ATTR_CONFIGURATION, &value);
+        }
+        batch_start_ms = k_uptime_get_32();
+        batch_next_us = 0;
+    } else {
+        struct sensor_value odr = {
+            .val1 = sample_rate_odr,
+        };
+
+        ret = sensor_attr_set(bmi270, SENSOR_CHAN_FIFO, SENSOR_ATTR_CONFIGURATION, &value);
+        // Disabling the FIFO restores the gyroscope rate from when it was enabled, it might have changed since.
+        if (ret == 0) {
+            ret = sensor_attr_set(bmi270, SENSOR_CHAN_GYRO_XYZ, SENSOR_ATTR_SAMPLING_FREQUENCY, &odr);
+        }
+        sensor_trigger_set(bmi270, &fifo_trigger, NULL);
+        batch_stats.active_time_ms += k_uptime_get_32() - batch_start_ms;
+    }
+
+    return ret;
+}
+
+int zsw_imu_batch_subscribe(zsw_imu_batch_cb_t callback)
+{
+    int ret = 0;
+
+    if (!device_is_ready(bmi270)) {
+        return -ENODEV;
+    }
+
+    k_mutex_lock(&batch_mutex, K_FOREVER);
+    if (num_batch_subscribers == ARRAY_SIZE(batch_subscribers)) {
+        ret = -ENOMEM;
+    } else if (num_batch_subscribers == 0) {
+        ret = set_batching_enabled(true);
+    }
+
+    if (ret == 0) {
+        batch_subscribers[num_batch_subscribers++] = callback;
+    } else {
+        LOG_ERR("Failed subscribing to IMU batches: %d", ret);
+    }
+    k_mutex_unlock(&batch_mutex);
+
+    return ret;
+}
+
+int zsw_imu_batch_unsubscribe(zsw_imu_batch_cb_t callback)
+{
+    int ret = -ENOENT;
+
+    // Locked before the batch mutex like when the rate is changed, disabling the FIFO sets the gyroscope rate.
+    k_mutex_lock(&config_mutex, K_FOREVER);
+    k_mutex_lock(&batch_mutex, K_FOREVER);
+    for (int i = 0; i < num_batch_subscribers; i++) {
+        if (batch_subscribers[i] == callback) {
+            batch_subscribers[i] = batch_subscribers[--num_batch_subscribers];
+            ret = 0;
+            break;
+        }
+    }
+
+    if (ret == 0 && num_batch_subscribers == 0) {
+        ret = set_batching_enabled(false);
+    }
+    k_mutex_unlock(&batch_mutex);
+    k_mutex_unlock(&config_mutex);
+
+    return ret;
+}
+
+void zsw_imu_batch_get_stats(zsw_imu_batch_stats_t *stats)
+{
+    k_mutex_lock(&batch_mutex, K_FOREVER);
+    memcpy(stats, &batch_stats, sizeof(batch_stats));
+    if (num_batch_subscribers > 0) {
+        stats->active_time_ms += k_uptime_get_32() - batch_start_ms;
+    }
+    k_mutex_unlock(&batch_mutex);
+}
+#else
+int zsw_imu_batch_subscribe(zsw_imu_batch_cb_t callback)
+{
+    return -ENOTSUP;
+}
+
+int zsw_imu_batch_unsubscribe(zsw_imu_batch_cb_t callback)
+{
+    return -ENOTSUP;
+}
+
+void zsw_imu_batch_get_stats(zsw_imu_batch_stats_t *stats)
+{
+    memset(stats, 0, sizeof(zsw_imu_batch_stats_t));
+}
+#endif
+
+#ifdef CONFIG_SHELL
+static int cmd_imu_fetch_stats(const struct shell *sh, size_t argc, char **argv)
+{
+    zsw_imu_fetch_stats_t stats;
+    uint32_t seconds = MAX(k_uptime_get_32() / 1000, 1);
+
+    zsw_imu_get_fetch_stats(&stats);
+
+    shell_print(sh, "Fetches: %d (%d/s), cache hits: %d (%d/s), cache time: %d ms",
+                stats.fetches, stats.fetches / seconds, stats.cache_hits, stats.cache_hits / seconds,
+                CONFIG_ZSW_IMU_SAMPLE_CACHE_MS);
 
     return 0;
-}
\ No newline at end of file
+}
+
+static int cmd_imu_batch_stats(const struct shell *sh, size_t argc, char **argv)
+{
+    zsw_imu_batch_stats_t stats;
+    uint32_t seconds;
+
+    zsw_imu_batch_get_stats(&stats);
+    seconds = MAX(stats.active_time_ms / 1000, 1);
+
+    shell_print(sh, "Active: %d s, wakeups: %d (%d/s), samples: %d (%d/s), errors: %d",
+                stats.active_time_ms / 1000, stats.wakeups, stats.wakeups / seconds,
+                stats.samples, stats.samples / seconds, stats.errors);
+    shell_print(sh, "Samples per wakeup: %d, timestamp resyncs: %d",
+                stats.wakeups > 0 ? stats.samples / stats.wakeups : 0, stats.resyncs);
+
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(imu_cmds,
+                               SHELL_CMD(fetch, NULL, "Print IMU bus fetches and cache hits since boot",
+                                         cmd_imu_fetch_stats),
+                               SHELL_CMD(batch, NULL, "Print IMU FIFO wakeups and samples read", cmd_imu_batch_stats),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(imu, &imu_cmds, "IMU statistics", NULL);
+#endif
\ No newline at end of file
@@ -82,8 +82,55 @@ typedef struct zsw_imu_evt_t {
     } data;
 } zsw_imu_evt_t;
 
+typedef struct zsw_imu_data_xyz_f_t {
+    float x;
+    float y;
+    float z;
+} zsw_imu_data_xyz_f_t;
+
+typedef struct zsw_imu_data_all_t {
+    zsw_imu_data_xyz_f_t accel;     // m/s^2
+    zsw_imu_data_xyz_f_t gyro;      // rad/s
+    float temperature;              // Only set when requested
+    uint32_t epoch;                 // Same epoch means the same sample
+} zsw_imu_data_all_t;
+
+typedef struct zsw_imu_fetch_stats_t {
+    uint32_t fetches;
+    uint32_t cache_hits;
+} zsw_imu_fetch_stats_t;
+
+typedef struct zsw_imu_batch_t {
+    const struct bmi270_fifo_frame *samples;    // Oldest first, accelerometer in m/s^2 and gyroscope in rad/s
+    uint16_t num_samples;
+    int64_t timestamp_us;                       // Uptime when the first sample was taken, from the frame count
+    uint32_t period_us;                         // Time between two samples
+} zsw_imu_batch_t;
+
+typedef void (*zsw_imu_batch_cb_t)(const zsw_imu_batch_t *batch);
+
+typedef struct zsw_imu_batch_stats_t {
+    uint32_t wakeups;
+    uint32_t samples;
+    uint32_t errors;
+    uint32_t resyncs;
+    uint32_t active_time_ms;
+} zsw_imu_batch_stats_t;
+
 int zsw_imu_init(void);
 
+/*
+* Get accelerometer, gyroscope and optionally temperature from one sample fetch.
+* Always reads a new sample from the IMU and stores it in the sample cache used by the other
+* fetch functions, calls to those within CONFIG_ZSW_IMU_SAMPLE_CACHE_MS get it without accessing the bus.
+*/
+int zsw_imu_fetch_all(zsw_imu_data_all_t *data, bool with_temperature);
+
+/*
+* Number of sample fetches from the IMU and fetches served from the cache since boot.
+*/
+void zsw_imu_get_fetch_stats(zsw_imu_fetch_stats_t *stats);
+
 /*
 * Get the accelerometer data in m/s^2.
 */
@@ -100,10 +147,36 @@ int zsw_imu_fetch_gyro(int16_t *x, int16_t *y, int16_t *z);
 
 int zsw_imu_fetch_temperature(float *temperature);
 
+/*
+* Request an accelerometer and gyroscope sample rate, 25 Hz times a power of two up to 1600 Hz.
+* The IMU runs at the highest rate requested, 100 Hz when there are no requests.
+* Every request is released with zsw_imu_release_sample_rate with the same rate.
+*/
+int zsw_imu_request_sample_rate(uint16_t rate_hz);
+
+int zsw_imu_release_sample_rate(uint16_t rate_hz);
+
 int zsw_imu_fetch_num_steps(uint32_t *num_steps);
 
 int zsw_imu_reset_step_count(void);
 
+/*
+* The gyroscope is reference counted, it is enabled until every enable is matched by a disable.
+*/
 int zsw_imu_feature_disable(zsw_imu_feature_t feature);
 
-int zsw_imu_feature_enable(zsw_imu_feature_t feature, bool int_en);
\ No newline at end of file
+int zsw_imu_feature_enable(zsw_imu_feature_t feature, bool int_en);
+
+/*
+* Get every accelerometer and gyroscope sample in batches read from the IMU FIFO.
+* The FIFO is enabled while there is at least one subscriber.
+* The callback is called from the IMU interrupt context (work queue or thread).
+*/
+int zsw_imu_batch_subscribe(zsw_imu_batch_cb_t callback);
+
+int zsw_imu_batch_unsubscribe(zsw_imu_batch_cb_t callback);
+
+/*
+* Wakeups and samples read since boot, to compare with one wakeup per sample when polling.
+*/
+void zsw_imu_batch_get_stats(zsw_imu_batch_stats_t *stats);
@@ -0,0 +1,49 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <time.h>
+#include <zephyr/kernel.h>
+
+#include "posix_board_if.h"
+
+#include "zsw_bench.h"
+
+void zsw_bench_thread(void *arg1, void *arg2, void *arg3)
+{
+    zsw_bench_fn_t fn = (zsw_bench_fn_t)arg1;
+    int ret = fn();
+
+    if (ret != ZSW_BENCH_NOT_RUN) {
+        posix_exit(ret);
+    }
+}
+
+int64_t zsw_bench_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void zsw_bench_print_result(const char *name, uint32_t num_ops, int64_t elapsed_us)
+{
+    elapsed_us = MAX(elapsed_us, 1);
+    printk("%s: %d in %lld us, %lld ops/s, %lld ns/op\n", name, num_ops, elapsed_us,
+           (int64_t)num_ops * 1000000 / elapsed_us, elapsed_us * 1000 / MAX(num_ops, 1));
+}
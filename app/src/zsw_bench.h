@@ -0,0 +1,79 @@
+/*
+ * This file is part of ZSWatch project <https://github.com/jakkra/ZSWatch/>.
+ * Copyright (c) 2024 Jakob Krantz.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+#include "cmdline.h"
+#include "soc.h"
+
+/** @brief Return value of a benchmark that was not asked for on the command line, zephyr.exe keeps running.
+*/
+#define ZSW_BENCH_NOT_RUN               -1
+
+/** @brief Benchmarks start after main is done initializing.
+*/
+#define ZSW_BENCH_START_DELAY_MS        1000
+
+/** @brief      Benchmark body, run in its own thread.
+ *  @return     Exit code of zephyr.exe, or ZSW_BENCH_NOT_RUN when its command line option was not given
+*/
+typedef int (*zsw_bench_fn_t)(void);
+
+/** @brief              Define a benchmark on native_posix, run at the lowest application priority after main.
+ *  @param name         Name of the benchmark
+ *  @param stack_size   Stack size of the benchmark thread
+ *  @param options      struct args_struct_t array with the command line options, ending with ARG_TABLE_ENDMARKER
+ *  @param fn           zsw_bench_fn_t with the benchmark
+*/
+#define ZSW_BENCH_DEFINE(name, stack_size, options, fn)                                                 \
+    ZSW_BENCH_DEFINE_PRIO(name, stack_size, K_LOWEST_APPLICATION_THREAD_PRIO, ZSW_BENCH_START_DELAY_MS, \
+                          options, fn)
+
+/** @brief              Define a benchmark on native_posix with a given thread priority and start delay.
+ *  @param name         Name of the benchmark
+ *  @param stack_size   Stack size of the benchmark thread
+ *  @param prio         Priority of the benchmark thread
+ *  @param delay_ms     Time after boot to start the benchmark
+ *  @param options      struct args_struct_t array with the command line options, ending with ARG_TABLE_ENDMARKER
+ *  @param fn           zsw_bench_fn_t with the benchmark
+*/
+#define ZSW_BENCH_DEFINE_PRIO(name, stack_size, prio, delay_ms, options, fn)                            \
+    static void name##_add_options(void)                                                                \
+    {                                                                                                   \
+        native_add_command_line_opts(options);                                                          \
+    }                                                                                                   \
+    NATIVE_TASK(name##_add_options, PRE_BOOT_1, 1);                                                     \
+    K_THREAD_DEFINE(name##_tid, stack_size, zsw_bench_thread, (void *)(fn), NULL, NULL, prio, 0, delay_ms)
+
+/** @brief Thread entry of the benchmarks, runs the zsw_bench_fn_t in arg1 and exits with its return value.
+*/
+void zsw_bench_thread(void *arg1, void *arg2, void *arg3);
+
+/** @brief  Time from the host clock. Simulated time does not advance while a benchmark runs.
+ *  @return Monotonic time in us
+*/
+int64_t zsw_bench_time_us(void);
+
+/** @brief              Print the throughput of an operation.
+ *  @param name         Name of the operation
+ *  @param num_ops      Number of operations done
+ *  @param elapsed_us   Time from zsw_bench_time_us the operations took
+*/
+void zsw_bench_print_result(const char *name, uint32_t num_ops, int64_t elapsed_us);